@@ -11,9 +11,22 @@
 
 #include "stateful_handle_wrapper.c"
 #include "callback_accumulator.c"
+#include "completion_queue.c"
+#include "deadline.c"
+#include "job.c"
+#include "admission.c"
+#include "content_cache.c"
+#include "batch.c"
+#include "property_cache.c"
+#include "workerpool.c"
+#include "pipeline.c"
+#include "transfer.c"
+#include "archive.c"
+#include "staging.c"
 
 #include "snapshot.c"
 #include "vm.c"
+#include "watcher.c"
 #include "host.c"
 
 #include "constants.c"
@@ -23,6 +36,18 @@ static PyMethodDef vix_globalMethods[] = {
         initSupport_Constants,
         METH_VARARGS
       },
+    { "slabStats",
+        (PyCFunction) pyf_slabStats,
+        METH_NOARGS
+      },
+    { "configureWorkerPool",
+        (PyCFunction) pyf_configureWorkerPool,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    { "workerPoolStats",
+        (PyCFunction) pyf_workerPoolStats,
+        METH_NOARGS
+      },
     {NULL, NULL, 0, NULL}
   };
 
@@ -35,6 +60,8 @@ init_vixmodule(void) {
   if (m == NULL) { goto fail; }
 
   if (initSupport_errorHandling(m) != SUCCEEDED) { goto fail; }
+  initSupport_callbackAccumulator();
+  if (initSupport_WorkerPool() != SUCCEEDED) { goto fail; }
 
   #define _INIT_C_TYPE_AND_SYS(type_name) { \
     status status = initSupport_ ## type_name(); \
@@ -54,6 +81,10 @@ init_vixmodule(void) {
   _INIT_C_TYPE_AND_SYS(Host);
   _INIT_C_TYPE_AND_SYS(VM);
   _INIT_C_TYPE_AND_SYS(Snapshot);
+  _INIT_C_TYPE_AND_SYS(Job);
+  _INIT_C_TYPE_AND_SYS(CompletionQueue);
+  _INIT_C_TYPE_AND_SYS(Deadline);
+  _INIT_C_TYPE_AND_SYS(PowerStateWatcher);
 
   return;
   fail:
@@ -13,6 +13,7 @@
 #define PY_SSIZE_T_CLEAN
 
 #include "Python.h"
+#include "structmember.h" /* offsetof */
 #include "vix.h"
 
 /************************ PYTHON VERSION HOOP-JUMPING ************************/
@@ -78,6 +79,8 @@ const Py_ssize_t PY_SSIZE_T_MAX__CIRCUMVENT_COMPILER_COMPLAINT = PY_SSIZE_T_MAX;
 
 /***************************** CONVENIENCE DEFS ******************************/
 const int32 NO_TIMEOUT = -1;
+/* Deadlines are expressed on PyVixClock_now's scale; this one never comes: */
+#define NO_DEADLINE -1.0
 
 /******************************** TYPE DEFS **********************************/
 #define VixHandle_EXTRACTION_CODE "i"
@@ -96,9 +99,10 @@ typedef enum {
 /******************************* CLASS DEFS **********************************/
 
 /* Supporting code used by some of the class defs: */
+#include "thread_sync.h"
 #include "memory_systems.h"
 #include "lock_manip.h"
-#include "lifo_linked_list.h"
+#include "intrusive_tracker.h"
 
 /* StatefulHandleWrapper acts as a sort of "unofficial superclass" for all
  * Python types that primarily wrap VixHandles. */
@@ -118,26 +122,200 @@ typedef struct _StatefulHandleWrapper {
   StatefulHandleWrapper_HEAD
 } StatefulHandleWrapper;
 
+/* A StatefulHandleWrapperFreeList keeps up to maxLength deallocated instances
+ * of exactly type (never of a subclass, whose instances may be larger) for
+ * reuse, linked through their ob_type fields.  Like pymalloc, it's protected
+ * by the GIL. */
+typedef struct {
+  PyTypeObject *type;
+  StatefulHandleWrapper *head;
+  int length;
+  int maxLength;
+} StatefulHandleWrapperFreeList;
+
+
+/* Per-Host admission control (see admission.c).  Each VM operation belongs to
+ * one of these classes, whose operations a Host may limit separately: */
+typedef enum {
+  ADMISSION_POWER    = 0,
+  ADMISSION_SNAPSHOT = 1,
+  ADMISSION_GUEST_IO = 2
+} AdmissionClass;
+#define N_ADMISSION_CLASSES 3
+
+/* An operation waiting for admission; it lives on the waiting thread's
+ * stack: */
+typedef struct _AdmissionWaiter {
+  PyVixEvent granted;
+  bool admitted;
+  double queuedAt;
+  struct _AdmissionWaiter *next;
+} AdmissionWaiter;
+
+typedef struct {
+  /* The most operations of the class that may be in flight at once (0 for no
+   * limit), and the number that are: */
+  int limit;
+  int inFlight;
+  /* The operations waiting for a slot, oldest first: */
+  AdmissionWaiter *head;
+  AdmissionWaiter *tail;
+  int nWaiting;
+
+  unsigned long nAdmitted;
+  /* How many of the admitted operations had to wait, and for how long: */
+  unsigned long nQueued;
+  double totalWaitTime;
+  double maxWaitTime;
+  /* How many gave up waiting when their deadlines passed: */
+  unsigned long nTimedOut;
+} AdmissionQueue;
+
+/* An AdmissionGate is allocated with pyvix_plain_* and reference counted
+ * under its own mutex:  one reference belongs to the Host, and one to each
+ * JobCompletion holding one of its slots, so that VIX's worker threads can
+ * give slots back without the GIL, even after the Host has gone away. */
+typedef struct _AdmissionGate {
+  PyVixMutex lock;
+  int refCount;
+  AdmissionQueue queues[N_ADMISSION_CLASSES];
+} AdmissionGate;
+
+
+/* A VM's record of the content it has copied into the guest (see
+ * content_cache.c).  Contents are identified by their SHA-256 digests: */
+#define CONTENT_DIGEST_SIZE 32
+
+typedef struct _ContentRecordEntry {
+  /* The guest path, exactly as it was passed to the copy: */
+  char *guestPath;
+  unsigned char digest[CONTENT_DIGEST_SIZE];
+  struct _ContentRecordEntry *next;
+} ContentRecordEntry;
+
+/* A hash table of ContentRecordEntries, keyed by guestPath: */
+typedef struct {
+  ContentRecordEntry **buckets;
+  size_t nBuckets;
+  size_t nEntries;
+} ContentRecord;
+
+/* The record that was current when a snapshot was taken: */
+typedef struct _SnapshotContentRecord {
+  char *snapshotName;
+  /* Whether more than one snapshot has been taken under snapshotName (VIX
+   * allows that), in which case record is empty, since it can't be told
+   * which of them a revert goes back to: */
+  bool ambiguous;
+  ContentRecord record;
+  struct _SnapshotContentRecord *next;
+} SnapshotContentRecord;
+
+/* A ContentCache is allocated with pyvix_plain_* and reference counted under
+ * its own mutex, like an AdmissionGate:  one reference belongs to the VM, and
+ * one to each JobCompletion that will update it when VIX reports (and to each
+ * pipeline run or tree transfer that submits such jobs). */
+typedef struct _ContentCache {
+  PyVixMutex lock;
+  int refCount;
+  ContentRecord current;
+  SnapshotContentRecord *snapshots;
+
+  /* How many hashed copies were skipped (and how many bytes they would have
+   * copied), and how many weren't: */
+  unsigned long nHits;
+  unsigned long nMisses;
+  int64 bytesSkipped;
+  /* How many times the current record was replaced by a revert: */
+  unsigned long nReverts;
+} ContentCache;
+
+/* How a job updates its VM's ContentCache once VIX reports that it
+ * succeeded: */
+typedef enum {
+  /* The guest path contentKey now holds contentDigest: */
+  CONTENT_UPDATE_STORED           = 0,
+  /* The snapshot named contentKey was taken, or removed, or reverted to: */
+  CONTENT_UPDATE_SNAPSHOT_TAKEN   = 1,
+  CONTENT_UPDATE_SNAPSHOT_REMOVED = 2,
+  CONTENT_UPDATE_REVERTED         = 3
+} ContentUpdateKind;
+
 
 /* Host class: */
+DEFINE_TRACKER_TYPES(VM)
+
 typedef struct _Host {
   StatefulHandleWrapper_HEAD
 
-  struct _VMTracker *openVMs;
+  VMTracker openVMs;
+  /* Indexes the VMs in openVMs by vmxPath:  a dict that maps each path to a
+   * weak reference to the open VM, so that reopening a path needn't consult
+   * VIX (or traverse openVMs). */
+  PyObject *vmsByPath;
+  /* The running PowerStateWatcher of openVMs, if any: */
+  struct _PowerStateWatcher *watcher;
+  /* The number of the worker pool's threads that are running this Host's
+   * tasks, and the most that may (0 for no limit, or -1 to follow the pool's
+   * per_host_limit).  Both are protected by the pool's lock: */
+  int poolActive;
+  int poolLimit;
+  /* Limits how many of each class of VM operation are in flight at once: */
+  AdmissionGate *admission;
 } Host;
 extern PyTypeObject HostType;
 
 
 /* VM class: */
+DEFINE_TRACKER_TYPES(Snapshot)
+
+#define POWER_STATE_UNKNOWN -1
+
+/* A VM's opt-in cache of property values (see property_cache.c): */
+typedef struct {
+  /* The number of seconds for which a fetched value is served from the cache;
+   * the cache is disabled while ttl is zero (the default): */
+  double ttl;
+  /* Maps each cached property ID to a (value, expiry time) tuple; NULL until
+   * the cache is first enabled: */
+  PyObject *entries;
+  /* The completions of this VM's state-changing jobs that might still be
+   * running, each holding a reference.  While any of them is, the cache is
+   * bypassed: */
+  struct _JobCompletion **pendingJobs;
+  Py_ssize_t nPendingJobs;
+  Py_ssize_t pendingJobsCapacity;
+
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long invalidations;
+} VMPropertyCache;
+
 typedef struct _VM {
   StatefulHandleWrapper_HEAD
 
   Host *host;
-  struct _SnapshotTracker *openSnapshots;
+  /* Links self into host->openVMs: */
+  TRACKER_LINKS(VM)
+  SnapshotTracker openSnapshots;
   char * vmxPath;
+  PyObject *weakreflist;
+  VMPropertyCache propCache;
+  /* What self has copied into the guest, for dedupe and syncToGuest: */
+  ContentCache *contentCache;
+  /* The power state that host->watcher last observed, or
+   * POWER_STATE_UNKNOWN: */
+  int watchedPowerState;
 } VM;
 extern PyTypeObject VMType;
-DEFINE_TRACKER_TYPES(VM)
+
+/* The power operations that can be applied to a VM, singly or in batches: */
+typedef enum {
+  VM_POWER_ON  = 0,
+  VM_POWER_OFF = 1,
+  VM_RESET     = 2,
+  VM_SUSPEND   = 3
+} VMPowerOp;
 
 
 /* Snapshot class: */
@@ -145,16 +323,542 @@ typedef struct _Snapshot {
   StatefulHandleWrapper_HEAD
 
   VM *vm;
+  /* Links self into vm->openSnapshots: */
+  TRACKER_LINKS(Snapshot)
 } Snapshot;
 extern PyTypeObject SnapshotType;
-DEFINE_TRACKER_TYPES(Snapshot)
 
 
+/* VixEventRecord holds the raw data of one VIX event, as extracted (without
+ * the GIL) by the VIX worker thread that reported it.  str, if not NULL, was
+ * allocated by VIX and must be released with pyvix_vix_buffer_free. */
+typedef struct _VixEventRecord {
+  VixEventType eventType;
+  VixError err;
+  char *str;
+
+  /* Only used while the record is on a VixEventRing's overflow list: */
+  struct _VixEventRecord *next;
+} VixEventRecord;
+
+/* VixStringArena is a growable buffer of NUL-terminated strings, stored back
+ * to back in chars, with the offset of each recorded in starts.  It's
+ * allocated with pyvix_plain_*, so it may be filled without the GIL. */
+typedef struct {
+  char *chars;
+  size_t nChars;
+  size_t charsCapacity;
+
+  size_t *starts;
+  Py_ssize_t nItems;
+  Py_ssize_t startsCapacity;
+} VixStringArena;
+
+/* VixEventRing is a bounded, lock-free multi-producer/single-consumer queue of
+ * VixEventRecords.  Any number of VIX worker threads may push into it
+ * concurrently; the single consumer is whichever thread holds consumerLock
+ * (in practice, the thread reporting the job's completion, or a Python thread
+ * streaming the job's items), and it moves records into the collected arena
+ * in batches.  Each slot's seq tells producers and the consumer whose turn it
+ * is to touch the slot (after D. Vyukov's bounded queue).  If the ring is
+ * full, producers spill into a mutex-protected overflow list rather than
+ * waiting for the consumer, since the consumer might not drain until the job
+ * has finished. */
+#define VIX_EVENT_RING_CAPACITY 256 /* must be a power of 2 */
+
+typedef struct {
+  PyVixAtomic seq;
+  VixEventRecord rec;
+} VixEventRingSlot;
+
+typedef struct {
+  VixEventRingSlot slots[VIX_EVENT_RING_CAPACITY];
+  /* Next position to be claimed by a producer: */
+  PyVixAtomic tail;
+  /* Next position to be consumed (touched only by the consumer): */
+  unsigned long head;
+
+  PyVixMutex overflowLock;
+  PyVixAtomic nOverflowed;
+  /* Records dropped because even the overflow list couldn't be extended: */
+  PyVixAtomic nLost;
+  VixEventRecord *overflowHead;
+  VixEventRecord *overflowTail;
+
+  /* The remaining fields are only touched with consumerLock held: */
+  PyVixMutex consumerLock;
+  VixStringArena collected;
+  VixError firstErr;
+
+  /* If signalOnPush is nonzero, producers signal pushed after each push, for
+   * the benefit of a consumer that's streaming the items: */
+  PyVixAtomic signalOnPush;
+  PyVixEvent pushed;
+} VixEventRing;
+
 /* VixCallbackAccumulator is designed to make the C code in pyvix that handles
  * callbacks from VIX more future-proof, by providing a place to put as-yet-
- * unanticipated fields. */
+ * unanticipated fields.  The VIX callback side only ever touches ring; target
+ * is built from the ring's collected strings under the GIL, by
+ * VixCallbackAccumulator_flush. */
 typedef struct {
   PyObject *target;
+  VixEventRing *ring;
 } VixCallbackAccumulator;
 
+
+/* Deadline class: */
+
+/* A Deadline is a time budget shared by a sequence of operations:  each job
+ * issued against it takes whatever remains of the budget as its timeout, and
+ * records how long it took. */
+typedef struct _Deadline {
+  PyObject_HEAD
+
+  double startedAt;
+  double expiresAt;
+  /* A list of (name, seconds, outcome) tuples, one per step: */
+  PyObject *steps;
+  /* While the Deadline is entered as a context manager, the Deadline that it
+   * displaced as its thread's current one (or Py_None); otherwise NULL: */
+  PyObject *previous;
+} Deadline;
+extern PyTypeObject DeadlineType;
+
+/* JobDeadline describes the deadline of an operation that's about to issue a
+ * job.  budget is a borrowed reference, which the caller's arguments or
+ * thread state keep alive for the duration of the call. */
+typedef struct {
+  /* The deadline of the job itself, or NO_DEADLINE: */
+  double at;
+  /* The Deadline on whose budget the job draws, or NULL: */
+  Deadline *budget;
+  const char *opName;
+  double startedAt;
+} JobDeadline;
+
+
+/* Job class: */
+typedef enum {
+  JOB_RESULT_NONE        = 0,
+  JOB_RESULT_SNAPSHOT    = 1,
+  JOB_RESULT_STRING_LIST = 2,
+  JOB_RESULT_TOOLS_STATE = 3,
+  JOB_RESULT_VM          = 4,
+  JOB_RESULT_TASK        = 5,
+  JOB_RESULT_STAGED      = 6,
+  /* The job's result handle, as an int, for Host and VM construction; the
+   * caller takes ownership of the handle: */
+  JOB_RESULT_HANDLE      = 7
+} JobResultKind;
+
+/* JobCompletion holds the part of a Job that VIX's worker threads touch when
+ * they report on the job.  It's allocated with pyvix_plain_* and reference
+ * counted under its own mutex (one reference belongs to the Job object, the
+ * other to VIX until the job completes), so that recording completion never
+ * requires the GIL. */
+typedef struct _JobCompletion {
+  PyVixMutex lock;
+  PyVixEvent finished;
+  int refCount;
+
+  bool completed;
+  /* Whether VIX has reported on the job (or refused it).  Ordinarily this is
+   * set along with completed, but it lags behind when the job is cancelled,
+   * since VIX keeps working on the job regardless: */
+  bool vixFinished;
+  VixHandle jobH;
+  VixError err;
+  bool wantsResultHandle;
+  VixHandle resultH;
+  double completedAt;
+
+  /* The AdmissionGate (if any) whose slot the job holds until VIX has
+   * reported on it, and the slot's class: */
+  AdmissionGate *admission;
+  AdmissionClass admissionClass;
+
+  /* The ContentCache (if any) that the job updates once VIX reports that it
+   * succeeded, and how: */
+  ContentCache *contentCache;
+  ContentUpdateKind contentUpdate;
+  char *contentKey;
+  unsigned char contentDigest[CONTENT_DIGEST_SIZE];
+
+  /* The host file (if any) through which the job's data passes, which
+   * outlives VIX's use of it (see staging.c): */
+  struct _StagedFile *staged;
+
+  /* The CompletionPort (if any) into which the job should be posted upon
+   * completion, and the link used while it's waiting there to be drained: */
+  struct _CompletionPort *port;
+  struct _JobCompletion *portNext;
+
+  /* The remaining fields refer to Python objects, and must only be
+   * dereferenced while the GIL is held: */
+  VixCallbackAccumulator acc;
+  /* A list of (callable, args) tuples to invoke upon completion: */
+  PyObject *doneCallbacks;
+  /* The Job that a CompletionPort will deliver (a strong reference): */
+  PyObject *portJob;
+  /* The result that a WorkerTask produced for a JOB_RESULT_TASK job: */
+  PyObject *taskResult;
+} JobCompletion;
+
+typedef struct _Job {
+  StatefulHandleWrapper_HEAD
+
+  /* The Host or VM that issued the job: */
+  PyObject *owner;
+  JobResultKind resultKind;
+  /* For JOB_RESULT_VM, the vmxPath of the VM being opened; otherwise NULL: */
+  PyObject *resultArg;
+  JobCompletion *completion;
+  PyObject *result;
+
+  /* The deadline by which the job must complete (see the timeout argument of
+   * the methods that issue jobs), or NO_DEADLINE; and whether the job was
+   * cancelled for missing it: */
+  double deadline;
+  bool timedOut;
+
+  /* The Deadline (if any) whose budget the job drew upon, until the job's
+   * step has been recorded there; the job's name for that purpose; and when
+   * its operation started: */
+  Deadline *budget;
+  const char *opName;
+  double startedAt;
+} Job;
+extern PyTypeObject JobType;
+
+/* JobItemIterator yields the items of a JOB_RESULT_STRING_LIST job as VIX
+ * reports them, rather than all at once upon completion. */
+typedef struct _JobItemIterator {
+  PyObject_HEAD
+
+  Job *job;
+  /* The most recently collected batch of items, and how many of them have
+   * been yielded: */
+  PyObject *pending;
+  Py_ssize_t nConsumed;
+} JobItemIterator;
+extern PyTypeObject JobItemIteratorType;
+
+
+/* Batches of jobs (see batch.c): */
+
+/* The number of a batch's jobs that may be in flight at once, unless the
+ * client program specifies max_parallel: */
+#define DEFAULT_MAX_PARALLEL_JOBS 16
+
+/* A BatchSubmitFunc submits the i'th job of a batch, passing Job_vixCallback
+ * and clientData to the VIX job function, and returns the job's handle.  It's
+ * called without the GIL. */
+typedef VixHandle (*BatchSubmitFunc)(void *context, Py_ssize_t i,
+    void *clientData
+  );
+
+
+/* Pipelines of jobs (see pipeline.c): */
+typedef enum {
+  PIPELINE_REVERT         = 0,
+  PIPELINE_POWER_ON       = 1,
+  PIPELINE_POWER_OFF      = 2,
+  PIPELINE_RESET          = 3,
+  PIPELINE_SUSPEND        = 4,
+  PIPELINE_WAIT_FOR_TOOLS = 5,
+  PIPELINE_LOGIN          = 6,
+  PIPELINE_COPY_IN        = 7,
+  PIPELINE_COPY_OUT       = 8,
+  PIPELINE_RUN            = 9,
+  PIPELINE_DELETE         = 10
+} PipelineStepKind;
+
+/* A PipelineStep is the parsed form of one step of a pipeline.  Its strings
+ * are borrowed from the step's tuple, which the caller keeps alive until the
+ * pipeline has finished. */
+typedef struct {
+  PipelineStepKind kind;
+  const char *name;
+  /* Whether the step may change the VM's properties: */
+  bool changesState;
+  /* The step's arguments; which of them are used depends on kind: */
+  char *arg1;
+  char *arg2;
+  int intArg;
+  /* The snapshot to revert to, if one was passed as a Snapshot: */
+  VixHandle snapH;
+} PipelineStep;
+
+typedef enum {
+  PIPELINE_STEP_SKIPPED = 0,
+  PIPELINE_STEP_OK      = 1,
+  PIPELINE_STEP_ERROR   = 2,
+  PIPELINE_STEP_TIMEOUT = 3,
+  /* A tree entry that the guest already held (see content_cache.c): */
+  PIPELINE_STEP_UNCHANGED = 4
+} PipelineStepOutcome;
+
+typedef struct {
+  PipelineStepOutcome outcome;
+  double seconds;
+  VixError err;
+  /* For a waitForTools step, whether the tools turned out to be running: */
+  bool toolsRunning;
+  /* For a run step, the guest program's exit code: */
+  int exitCode;
+} PipelineStepResult;
+
+/* A PipelineRun tracks the progress of one VM through a pipeline; it's only
+ * touched by the thread that drives the pipeline, without the GIL. */
+typedef struct {
+  VixHandle vmH;
+  /* One JobCompletion and one result per step: */
+  JobCompletion **jcs;
+  PipelineStepResult *results;
+  /* The number of steps submitted so far; while inFlight, the last of them
+   * is still running: */
+  Py_ssize_t nSubmitted;
+  bool inFlight;
+  double stepStartedAt;
+  /* While a waitForTools step is in flight, when its timeoutSecs run out
+   * (which VIX doesn't always enforce by itself), or NO_DEADLINE: */
+  double toolsDeadline;
+  /* The snapshot handle that the step in flight looked up, if any: */
+  VixHandle snapH;
+  /* The VM's Host's AdmissionGate, which admits each step (see
+   * admission.c): */
+  AdmissionGate *admission;
+  /* The VM's record of what it holds in the guest, which the steps keep up
+   * to date (see content_cache.c): */
+  ContentCache *contentCache;
+} PipelineRun;
+
+/* PipelineExecution holds the state of a pipeline in progress: */
+typedef struct {
+  const PipelineStep *steps;
+  Py_ssize_t nSteps;
+  PipelineRun *runs;
+  Py_ssize_t nRuns;
+  /* The JobCompletions of every run's steps, nSteps per run: */
+  JobCompletion **jcs;
+  int maxParallel;
+  double deadline;
+  struct _CompletionPort *port;
+  /* The completion of the Job (if any) that stands for the whole pipeline,
+   * whose cancellation stops it: */
+  JobCompletion *owner;
+} PipelineExecution;
+
+/* Directory tree transfers (see transfer.c): */
+typedef enum {
+  TREE_TO_GUEST   = 0,
+  TREE_FROM_GUEST = 1
+} TreeDirection;
+
+/* A TreeEntry is one file or directory of a tree being transferred: */
+typedef struct {
+  /* The entry's path relative to the root of the tree, with '/' as the
+   * separator ("" for the root itself): */
+  char *relPath;
+  bool isDir;
+  int64 bytes;
+  PipelineStepOutcome outcome;
+  VixError err;
+  double startedAt;
+  double seconds;
+  /* The entry's job, while it's in flight: */
+  JobCompletion *jc;
+} TreeEntry;
+
+/* A TreeTransfer is only touched by the thread that drives it, without the
+ * GIL, except while it's being set up and reported on. */
+typedef struct {
+  TreeDirection direction;
+  /* Whether only to list the tree's directories, without copying any files
+   * (see archive.c): */
+  bool scanOnly;
+  VixHandle vmH;
+  AdmissionGate *admission;
+  /* The VM's record of what it holds, and whether to consult it so as to
+   * skip what's unchanged (see content_cache.c): */
+  ContentCache *contentCache;
+  bool dedupe;
+  /* The roots of the tree on either side, and the guest's path separator: */
+  char *hostRoot;
+  char *guestRoot;
+  char guestSep;
+
+  /* Every entry found so far, parents before their children; entries are
+   * found as their directories are created (or listed): */
+  TreeEntry *entries;
+  Py_ssize_t nEntries;
+  Py_ssize_t capacity;
+  /* The indices of the entries waiting to be started, in the order they were
+   * found (each entry is queued at most once, so this has room for
+   * capacity indices):  ready[readyHead:readyTail]. */
+  Py_ssize_t *ready;
+  Py_ssize_t readyHead;
+  Py_ssize_t readyTail;
+  /* The indices of the entries in flight: */
+  Py_ssize_t *inFlight;
+  int nInFlight;
+  int maxParallel;
+
+  double deadline;
+  struct _CompletionPort *port;
+} TreeTransfer;
+
+/* How a tree is transferred (see archive.c): */
+typedef enum {
+  TREE_MODE_FILES   = 0,
+  TREE_MODE_ARCHIVE = 1,
+  TREE_MODE_AUTO    = 2
+} TreeMode;
+
+typedef struct {
+  TreeMode mode;
+  /* The guest program that unpacks (or packs) the archive, and the template
+   * of its command line; NULL for the defaults: */
+  const char *program;
+  const char *argsTemplate;
+  /* Under TREE_MODE_AUTO, a tree is packed if it holds at least minFiles
+   * files, of at most maxBytes in all: */
+  int minFiles;
+  int64 maxBytes;
+  /* The host directory in which archives are staged; NULL for the system's
+   * temporary directory: */
+  const char *stagingDir;
+} TreeArchiveOptions;
+
+
+/* Guest file contents passed to and from Python without temporary files (see
+ * staging.c).  A StagedFile is allocated with pyvix_plain_*; each
+ * JobCompletion of a copy that uses it holds a reference to it. */
+typedef struct _StagedFile {
+  PyVixMutex lock;
+  int refCount;
+
+  /* An open descriptor of the file, and the host path by which VIX reaches
+   * it: */
+  int fd;
+  char *path;
+  /* Whether path names a file of its own, which must be deleted, rather than
+   * a view of fd: */
+  bool ownsPath;
+  /* Whether the file can go as soon as VIX has reported on the job: */
+  bool discardWhenDone;
+} StagedFile;
+
+/* The native worker pool (see workerpool.c): */
+typedef struct _WorkerTask WorkerTask;
+
+/* A WorkerTask's run function is called on a worker thread without the GIL;
+ * its finish function is then called on the same thread with the GIL held,
+ * and must release everything the task holds except jc.  finish is called
+ * even if the task's job was cancelled before run could be, in which case run
+ * is skipped. */
+typedef void (*WorkerTaskFunc)(WorkerTask *task);
+
+struct _WorkerTask {
+  WorkerTaskFunc run;
+  WorkerTaskFunc finish;
+  /* The completion of the task's Job, which the pool completes with err once
+   * the task has finished (the task holds the reference that would otherwise
+   * be VIX's): */
+  JobCompletion *jc;
+  VixError err;
+  /* The Host against whose limit the task counts (a strong reference, which
+   * finish must drop): */
+  Host *host;
+  double enqueuedAt;
+  double startedAt;
+  WorkerTask *next;
+};
+
+typedef struct {
+  PyVixMutex lock;
+  /* Signalled while the queue might hold a task that a worker may start, and
+   * while it has room for another, respectively: */
+  PyVixEvent workAvailable;
+  PyVixEvent spaceAvailable;
+  WorkerTask *head;
+  WorkerTask *tail;
+  Py_ssize_t queueDepth;
+  Py_ssize_t queueSize;
+
+  int nWorkers;
+  int targetWorkers;
+  int nActive;
+  int perHostLimit;
+
+  unsigned long nSubmitted;
+  unsigned long nCompleted;
+  unsigned long nRejected;
+  double totalWaitTime;
+  double maxWaitTime;
+  double totalRunTime;
+  double maxRunTime;
+} WorkerPool;
+
+/* CompletionQueue class: */
+
+/* CompletionPort is the GIL-free core of a CompletionQueue:  VIX's worker
+ * threads post finished jobs into it, and it signals their arrival both via
+ * an event (for pyvix's own blocking waits) and via a self-pipe whose read end
+ * client programs can poll.  Like JobCompletion, it's allocated with
+ * pyvix_plain_* and reference counted under its own mutex, since a job may
+ * outlive the CompletionQueue it was added to. */
+typedef struct _CompletionPort {
+  PyVixMutex lock;
+  int refCount;
+  bool closed;
+
+  JobCompletion *head;
+  JobCompletion *tail;
+  Py_ssize_t nPending;
+
+  PyVixEvent nonEmpty;
+  int pipeFDs[2];
+  bool pipeSignalled;
+} CompletionPort;
+
+typedef struct _CompletionQueue {
+  PyObject_HEAD
+
+  CompletionPort *port;
+} CompletionQueue;
+extern PyTypeObject CompletionQueueType;
+
+/* PowerStateWatcher class: */
+
+/* A PowerStateWatcher runs a thread of its own, which polls the power state
+ * of its Host's open VMs.  Except during its waits and VIX calls, the thread
+ * holds the GIL, which also guards every field. */
+typedef struct _PowerStateWatcher {
+  PyObject_HEAD
+
+  /* A borrowed reference (the Host stops its watcher before it goes away), or
+   * NULL once the watcher has been told to stop: */
+  Host *host;
+  PyObject *callback;
+  double interval;
+
+  /* Signalled to cut the thread's wait between sweeps short: */
+  PyVixEvent wakeup;
+  /* Signalled by the thread as it exits: */
+  PyVixEvent exited;
+  bool threadStarted;
+  long threadID;
+
+  unsigned long nSweeps;
+  unsigned long nChanges;
+  unsigned long nPollErrors;
+  unsigned long nCallbackErrors;
+  double lastSweepSeconds;
+  double maxSweepSeconds;
+  double totalSweepSeconds;
+} PowerStateWatcher;
+extern PyTypeObject PowerStateWatcherType;
+
 #endif /* ndef VIXMODULE_H */
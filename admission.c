@@ -0,0 +1,299 @@
+/******************************************************************************
+ * pyvix - Per-Host Admission Control
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* When too many power or snapshot operations are fired at one host at once,
+ * VIX starts failing them with VIX_E_OBJECT_IS_BUSY and the like, and retrying
+ * only makes matters worse.  So each Host has an AdmissionGate, which limits
+ * how many operations of each AdmissionClass may be in flight on the host at
+ * once.  An operation that finds its class at the limit waits its turn in a
+ * FIFO queue (without the GIL), until a slot is handed to it or its deadline
+ * passes.  A slot is held from the moment the job is submitted until VIX
+ * reports on it (see JobCompletion_complete), even if the job was cancelled
+ * in the meantime, since VIX keeps working on it regardless.
+ *
+ * No class is limited until Host.setAdmissionLimits says otherwise. */
+
+static AdmissionGate *AdmissionGate_new(void) {
+  /* The GIL need not be held. */
+  int i;
+  AdmissionGate *gate = pyvix_plain_malloc(sizeof(AdmissionGate));
+  if (gate == NULL) { return NULL; }
+
+  PyVixMutex_init(&gate->lock);
+  gate->refCount = 1;
+  for (i = 0; i < N_ADMISSION_CLASSES; i++) {
+    AdmissionQueue *q = &gate->queues[i];
+    q->limit = 0;
+    q->inFlight = 0;
+    q->head = q->tail = NULL;
+    q->nWaiting = 0;
+    q->nAdmitted = 0;
+    q->nQueued = 0;
+    q->totalWaitTime = 0.0;
+    q->maxWaitTime = 0.0;
+    q->nTimedOut = 0;
+  }
+
+  return gate;
+} /* AdmissionGate_new */
+
+static void AdmissionGate_addRef(AdmissionGate *gate) {
+  PyVixMutex_lock(&gate->lock);
+  gate->refCount++;
+  PyVixMutex_unlock(&gate->lock);
+} /* AdmissionGate_addRef */
+
+static void AdmissionGate_release(AdmissionGate *gate) {
+  /* Drops one reference to gate, freeing it if that was the last.  The GIL
+   * need not be held. */
+  bool isLast;
+
+  PyVixMutex_lock(&gate->lock);
+  isLast = (--gate->refCount == 0);
+  PyVixMutex_unlock(&gate->lock);
+  if (!isLast) { return; }
+
+  /* Every waiter holds a reference (via its Host or pipeline), so none can
+   * remain: */
+  PyVixMutex_destroy(&gate->lock);
+  pyvix_plain_free(gate);
+} /* AdmissionGate_release */
+
+static bool AdmissionQueue_hasRoom(const AdmissionQueue *q) {
+  return q->limit == 0 || q->inFlight < q->limit;
+} /* AdmissionQueue_hasRoom */
+
+static void AdmissionQueue_dispatchLocked(AdmissionQueue *q) {
+  /* Hands free slots to the oldest waiters.  The gate's lock must be
+   * held. */
+  while (q->head != NULL && AdmissionQueue_hasRoom(q)) {
+    AdmissionWaiter *w = q->head;
+    q->head = w->next;
+    if (q->head == NULL) { q->tail = NULL; }
+    q->nWaiting--;
+
+    q->inFlight++;
+    w->admitted = true;
+    /* Signalled under the gate's lock, so that the waiter can't destroy the
+     * event before this returns: */
+    PyVixEvent_signal(&w->granted);
+  }
+} /* AdmissionQueue_dispatchLocked */
+
+static void AdmissionQueue_noteAdmittedLocked(AdmissionQueue *q,
+    double waitTime
+  )
+{
+  q->nAdmitted++;
+  if (waitTime > 0.0) {
+    q->nQueued++;
+    q->totalWaitTime += waitTime;
+    if (waitTime > q->maxWaitTime) { q->maxWaitTime = waitTime; }
+  }
+} /* AdmissionQueue_noteAdmittedLocked */
+
+static bool AdmissionGate_tryEnter(AdmissionGate *gate, AdmissionClass cls) {
+  /* Takes a slot of class cls if one is free and nobody is waiting for it;
+   * returns whether it did.  The GIL need not be held. */
+  AdmissionQueue *q = &gate->queues[cls];
+  bool admitted = false;
+
+  PyVixMutex_lock(&gate->lock);
+  if (q->head == NULL && AdmissionQueue_hasRoom(q)) {
+    q->inFlight++;
+    AdmissionQueue_noteAdmittedLocked(q, 0.0);
+    admitted = true;
+  }
+  PyVixMutex_unlock(&gate->lock);
+
+  return admitted;
+} /* AdmissionGate_tryEnter */
+
+static VixError AdmissionGate_enter(AdmissionGate *gate, AdmissionClass cls,
+    double deadline
+  )
+{
+  /* Takes a slot of class cls, waiting behind any earlier arrivals until one
+   * is handed over or deadline passes.  Returns VIX_OK if a slot was taken,
+   * VIX_E_CANCELLED if deadline passed first, or VIX_E_OUT_OF_MEMORY if the
+   * wait couldn't be set up.  The GIL must not be held. */
+  AdmissionQueue *q = &gate->queues[cls];
+  AdmissionWaiter w;
+  bool admitted;
+
+  if (AdmissionGate_tryEnter(gate, cls)) { return VIX_OK; }
+
+  if (PyVixEvent_init(&w.granted) != SUCCEEDED) { return VIX_E_OUT_OF_MEMORY; }
+  w.admitted = false;
+  w.queuedAt = PyVixClock_now();
+  w.next = NULL;
+
+  PyVixMutex_lock(&gate->lock);
+  if (q->tail == NULL) {
+    q->head = q->tail = &w;
+  } else {
+    q->tail->next = &w;
+    q->tail = &w;
+  }
+  q->nWaiting++;
+  /* A slot may have come free since tryEnter looked: */
+  AdmissionQueue_dispatchLocked(q);
+  PyVixMutex_unlock(&gate->lock);
+
+  PyVixEvent_wait(&w.granted, millisUntilDeadline(deadline));
+
+  PyVixMutex_lock(&gate->lock);
+  admitted = w.admitted;
+  if (admitted) {
+    AdmissionQueue_noteAdmittedLocked(q, PyVixClock_now() - w.queuedAt);
+  } else {
+    /* Gave up waiting; w must leave the queue before it goes out of
+     * scope: */
+    AdmissionWaiter **link = &q->head;
+    AdmissionWaiter *prev = NULL;
+    while (*link != &w) {
+      prev = *link;
+      link = &(*link)->next;
+    }
+    *link = w.next;
+    if (q->tail == &w) { q->tail = prev; }
+    q->nWaiting--;
+    q->nTimedOut++;
+  }
+  PyVixMutex_unlock(&gate->lock);
+
+  PyVixEvent_destroy(&w.granted);
+  return (admitted ? VIX_OK : VIX_E_CANCELLED);
+} /* AdmissionGate_enter */
+
+static void AdmissionGate_leave(AdmissionGate *gate, AdmissionClass cls) {
+  /* Gives back a slot of class cls, handing it to the oldest waiter, if any.
+   * The GIL need not be held. */
+  AdmissionQueue *q = &gate->queues[cls];
+
+  PyVixMutex_lock(&gate->lock);
+  assert (q->inFlight > 0);
+  q->inFlight--;
+  AdmissionQueue_dispatchLocked(q);
+  PyVixMutex_unlock(&gate->lock);
+} /* AdmissionGate_leave */
+
+static void AdmissionGate_attach(AdmissionGate *gate, AdmissionClass cls,
+    JobCompletion *jc
+  )
+{
+  /* Makes jc, which hasn't been passed to VIX yet, responsible for giving
+   * back the slot of class cls that was just taken on its behalf. */
+  assert (jc->admission == NULL);
+  AdmissionGate_addRef(gate);
+  jc->admission = gate;
+  jc->admissionClass = cls;
+} /* AdmissionGate_attach */
+
+static void AdmissionGate_setLimit(AdmissionGate *gate, AdmissionClass cls,
+    int limit
+  )
+{
+  AdmissionQueue *q = &gate->queues[cls];
+
+  PyVixMutex_lock(&gate->lock);
+  q->limit = limit;
+  /* A raised limit frees slots for the waiters: */
+  AdmissionQueue_dispatchLocked(q);
+  PyVixMutex_unlock(&gate->lock);
+} /* AdmissionGate_setLimit */
+
+static const char *AdmissionClass_names[N_ADMISSION_CLASSES] = {
+    "power", "snapshot", "guest_io"
+  };
+
+static PyObject *AdmissionGate_stats(AdmissionGate *gate) {
+  /* Returns a dict that maps the name of each class to a dict of its limit,
+   * its current occupancy, and its queueing statistics.  The GIL must be
+   * held. */
+  AdmissionQueue snapshot[N_ADMISSION_CLASSES];
+  PyObject *stats = NULL;
+  int i;
+
+  PyVixMutex_lock(&gate->lock);
+  memcpy(snapshot, gate->queues, sizeof(snapshot));
+  PyVixMutex_unlock(&gate->lock);
+
+  stats = PyDict_New();
+  if (stats == NULL) { goto fail; }
+  for (i = 0; i < N_ADMISSION_CLASSES; i++) {
+    const AdmissionQueue *q = &snapshot[i];
+    PyObject *classStats = Py_BuildValue(
+        "{s:i,s:i,s:i,s:k,s:k,s:k,s:d,s:d}",
+        "limit", q->limit,
+        "inFlight", q->inFlight,
+        "waiting", q->nWaiting,
+        "admitted", q->nAdmitted,
+        "queued", q->nQueued,
+        "timedOut", q->nTimedOut,
+        "totalWaitTime", q->totalWaitTime,
+        "maxWaitTime", q->maxWaitTime
+      );
+    if (classStats == NULL) { goto fail; }
+    if (PyDict_SetItemString(stats, AdmissionClass_names[i], classStats)
+        != 0
+       )
+    {
+      Py_DECREF(classStats);
+      goto fail;
+    }
+    Py_DECREF(classStats);
+  }
+
+  return stats;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(stats);
+    return NULL;
+} /* AdmissionGate_stats */
+
+static status Job_admit(Job *job, AdmissionGate *gate, AdmissionClass cls,
+    const JobDeadline *deadline
+  )
+{
+  /* Takes a slot of class cls on behalf of job, which hasn't been passed to
+   * VIX yet, waiting (without the GIL) until deadline if need be.  If no
+   * slot comes free in time, raises VIXTimeoutError and disposes of job, as
+   * though VIX had refused it; likewise with the corresponding error if the
+   * wait fails.  deadline may be NULL for none.  The GIL must be held. */
+  VixError err = (AdmissionGate_tryEnter(gate, cls) ? VIX_OK
+      : VIX_E_CANCELLED
+    );
+
+  if (err != VIX_OK) {
+    const double waitDeadline = (deadline != NULL ? deadline->at
+        : NO_DEADLINE
+      );
+    LEAVE_PYTHON
+    err = AdmissionGate_enter(gate, cls, waitDeadline);
+    ENTER_PYTHON
+  }
+
+  if (err == VIX_OK) {
+    AdmissionGate_attach(gate, cls, job->completion);
+    return SUCCEEDED;
+  }
+
+  JobCompletion_issued(job->completion, VIX_INVALID_HANDLE);
+  Py_DECREF(job);
+  /* The wait counts against the operation's Deadline, like any timeout: */
+  if (deadline != NULL
+      && JobDeadline_recordStep(deadline,
+            (err == VIX_E_CANCELLED ? "timeout" : "error")
+          ) != SUCCEEDED
+     )
+  { return FAILED; }
+  if (err != VIX_E_CANCELLED) { return autoRaiseVIXError(err); }
+  raiseNonNumericVIXError(VIXTimeoutError,
+      "The Host stayed saturated with operations of this kind until the"
+      " timeout."
+    );
+  return FAILED;
+} /* Job_admit */
@@ -0,0 +1,1078 @@
+/******************************************************************************
+ * pyvix - Packed Tree Transfers
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* However many jobs copyTree keeps in flight, a tree of thousands of small
+ * files is dominated by VIX's per-file overhead.  So a tree may instead be
+ * packed into a single tar archive in a host staging directory, copied with
+ * a single job, and unpacked in the guest by a guest program (or, from the
+ * guest, packed by a guest program, copied back, and unpacked on the host).
+ * The guest's part runs as a pipeline (see pipeline.c) of copyIn, run and
+ * delete steps.
+ *
+ * The host reads and writes the archives itself, so that it needs no tar of
+ * its own:  they're POSIX ustar archives, with GNU long names for paths that
+ * don't fit in a header, which is what GNU tar and busybox tar write and
+ * read.  Only directories and regular files are transferred.
+ *
+ * The default guest commands assume a POSIX guest with /bin/sh and tar; for
+ * any other guest, the caller passes its own (program, args) command, in
+ * whose args "{archive}" and "{dir}" stand for the guest paths of the
+ * archive and of the root of the tree.  They're substituted as they stand,
+ * so the caller's command must quote them as its guest requires. */
+
+#define TREE_ARCHIVE_DEFAULT_PROGRAM "/bin/sh"
+#define TREE_ARCHIVE_DEFAULT_UNPACK_ARGS \
+  "-c \"mkdir -p '{dir}' && tar -xf '{archive}' -C '{dir}'\""
+#define TREE_ARCHIVE_DEFAULT_PACK_ARGS \
+  "-c \"tar -cf '{archive}' -C '{dir}' .\""
+
+/* Under mode='auto', trees with at least this many files, of at most this
+ * many bytes in all, are packed: */
+#define TREE_ARCHIVE_DEFAULT_MIN_FILES 64
+#define TREE_ARCHIVE_DEFAULT_MAX_BYTES (256 * 1024 * 1024)
+
+#define TAR_BLOCK_SIZE      512
+#define TAR_NAME_SIZE       100
+#define TAR_IO_BUFFER_SIZE  (64 * 1024)
+
+/* Offsets of the fields of a ustar header: */
+#define TAR_OFF_NAME        0
+#define TAR_OFF_MODE        100
+#define TAR_OFF_UID         108
+#define TAR_OFF_GID         116
+#define TAR_OFF_SIZE        124
+#define TAR_OFF_MTIME       136
+#define TAR_OFF_CHECKSUM    148
+#define TAR_OFF_TYPE        156
+#define TAR_OFF_MAGIC       257
+#define TAR_OFF_VERSION     263
+#define TAR_OFF_PREFIX      345
+
+#define TAR_TYPE_FILE       '0'
+#define TAR_TYPE_OLD_FILE   '\0'
+#define TAR_TYPE_CONTIGUOUS '7'
+#define TAR_TYPE_DIR        '5'
+#define TAR_TYPE_LONG_NAME  'L'
+#define TAR_TYPE_PAX        'x'
+
+/****************************** Tar Headers **********************************/
+
+static void Tar_setNumber(unsigned char *field, size_t width, int64 value) {
+  /* Stores value in the numeric header field of width bytes:  as octal digits
+   * followed by a NUL if it fits, or else (as GNU tar does) in base 256. */
+  const int64 limit = ((int64) 1) << (3 * (width - 1));
+  size_t i = width;
+
+  if (value >= 0 && value < limit) {
+    field[--i] = '\0';
+    while (i > 0) {
+      field[--i] = (unsigned char) ('0' + (value & 7));
+      value >>= 3;
+    }
+  } else {
+    while (i > 1) {
+      field[--i] = (unsigned char) (value & 0xFF);
+      value >>= 8;
+    }
+    field[0] = 0x80;
+  }
+} /* Tar_setNumber */
+
+static int64 Tar_getNumber(const unsigned char *field, size_t width) {
+  int64 value = 0;
+  size_t i = 0;
+
+  if (field[0] & 0x80) {
+    for (i = 1; i < width; i++) { value = (value << 8) | field[i]; }
+    return value;
+  }
+  while (i < width && field[i] == ' ') { i++; }
+  for (; i < width && field[i] >= '0' && field[i] <= '7'; i++) {
+    value = (value << 3) | (field[i] - '0');
+  }
+  return value;
+} /* Tar_getNumber */
+
+static unsigned long Tar_checksum(const unsigned char *h) {
+  /* The checksum of header h, as computed with its checksum field blank: */
+  unsigned long sum = 0;
+  size_t i;
+
+  for (i = 0; i < TAR_BLOCK_SIZE; i++) {
+    sum += (i >= TAR_OFF_CHECKSUM && i < TAR_OFF_CHECKSUM + 8 ? ' ' : h[i]);
+  }
+  return sum;
+} /* Tar_checksum */
+
+static bool Tar_isZeroBlock(const unsigned char *h) {
+  size_t i;
+  for (i = 0; i < TAR_BLOCK_SIZE; i++) {
+    if (h[i] != 0) { return false; }
+  }
+  return true;
+} /* Tar_isZeroBlock */
+
+/***************************** Writing Archives ******************************/
+
+static VixError Tar_pad(FILE *out, int64 size) {
+  /* Pads the data of size bytes that was just written to a whole number of
+   * blocks. */
+  static const char zeros[TAR_BLOCK_SIZE] = {0};
+  const size_t padding = (size_t) ((TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE)
+      % TAR_BLOCK_SIZE
+    );
+
+  if (padding > 0 && fwrite(zeros, 1, padding, out) != padding) {
+    return VIX_E_FILE_ERROR;
+  }
+  return VIX_OK;
+} /* Tar_pad */
+
+static VixError Tar_writeHeader(FILE *out, const char *name, char type,
+    int64 size, int mode, int64 mtime
+  )
+{
+  /* Writes the header of an entry called name, preceded by a GNU long name
+   * entry if name doesn't fit. */
+  unsigned char h[TAR_BLOCK_SIZE];
+  const size_t nameLen = strlen(name);
+
+  if (nameLen > TAR_NAME_SIZE) {
+    VixError err = Tar_writeHeader(out, "././@LongLink", TAR_TYPE_LONG_NAME,
+        (int64) nameLen + 1, 0, 0
+      );
+    if (VIX_FAILED(err)) { return err; }
+    if (fwrite(name, 1, nameLen + 1, out) != nameLen + 1) {
+      return VIX_E_FILE_ERROR;
+    }
+    err = Tar_pad(out, (int64) nameLen + 1);
+    if (VIX_FAILED(err)) { return err; }
+  }
+
+  memset(h, 0, sizeof(h));
+  memcpy(h + TAR_OFF_NAME, name,
+      (nameLen > TAR_NAME_SIZE ? TAR_NAME_SIZE : nameLen)
+    );
+  Tar_setNumber(h + TAR_OFF_MODE, 8, mode);
+  Tar_setNumber(h + TAR_OFF_UID, 8, 0);
+  Tar_setNumber(h + TAR_OFF_GID, 8, 0);
+  Tar_setNumber(h + TAR_OFF_SIZE, 12, size);
+  Tar_setNumber(h + TAR_OFF_MTIME, 12, mtime);
+  h[TAR_OFF_TYPE] = (unsigned char) type;
+  memcpy(h + TAR_OFF_MAGIC, "ustar", 6);
+  memcpy(h + TAR_OFF_VERSION, "00", 2);
+  sprintf((char *) h + TAR_OFF_CHECKSUM, "%06lo", Tar_checksum(h) & 0777777);
+  h[TAR_OFF_CHECKSUM + 7] = ' ';
+
+  if (fwrite(h, 1, TAR_BLOCK_SIZE, out) != TAR_BLOCK_SIZE) {
+    return VIX_E_FILE_ERROR;
+  }
+  return VIX_OK;
+} /* Tar_writeHeader */
+
+static VixError Tar_packFile(FILE *out, const char *name,
+    const char *hostPath, int64 *bytes, char *buf
+  )
+{
+  /* Appends the host file at hostPath as an entry called name, and sets
+   * *bytes to its size. */
+  VixError err;
+  FILE *in = fopen(hostPath, "rb");
+  int64 size;
+  int64 remaining;
+  int mode = 0644;
+  int64 mtime = (int64) time(NULL);
+
+  if (in == NULL) {
+    return (errno == ENOENT ? VIX_E_FILE_NOT_FOUND : VIX_E_FILE_ACCESS_ERROR);
+  }
+#ifdef _WIN32
+  if (_fseeki64(in, 0, SEEK_END) != 0) {
+    err = VIX_E_FILE_ERROR;
+    goto cleanup;
+  }
+  size = _ftelli64(in);
+  rewind(in);
+#else
+  {
+    struct stat st;
+    if (fstat(fileno(in), &st) != 0) {
+      err = VIX_E_FILE_ERROR;
+      goto cleanup;
+    }
+    size = (int64) st.st_size;
+    mode = (int) (st.st_mode & 07777);
+    mtime = (int64) st.st_mtime;
+  }
+#endif
+
+  err = Tar_writeHeader(out, name, TAR_TYPE_FILE, size, mode, mtime);
+  if (VIX_FAILED(err)) { goto cleanup; }
+  for (remaining = size; remaining > 0; ) {
+    const size_t want = (size_t) (remaining < TAR_IO_BUFFER_SIZE ? remaining
+        : TAR_IO_BUFFER_SIZE
+      );
+    /* A file that shrank since it was sized would leave the archive
+     * corrupt: */
+    if (fread(buf, 1, want, in) != want) {
+      err = VIX_E_FILE_ERROR;
+      goto cleanup;
+    }
+    if (fwrite(buf, 1, want, out) != want) {
+      err = VIX_E_FILE_ERROR;
+      goto cleanup;
+    }
+    remaining -= want;
+  }
+  err = Tar_pad(out, size);
+  *bytes = size;
+
+  cleanup:
+    fclose(in);
+    return err;
+} /* Tar_packFile */
+
+static VixError Tar_pack(TreeTransfer *t, const char *archivePath) {
+  /* Writes every entry of t below the root (which must all have been found
+   * already) to a new archive at archivePath.  The GIL need not be held. */
+  VixError err = VIX_OK;
+  FILE *out = NULL;
+  char *buf = pyvix_plain_malloc(TAR_IO_BUFFER_SIZE);
+  Py_ssize_t i;
+
+  if (buf == NULL) { return VIX_E_OUT_OF_MEMORY; }
+  out = fopen(archivePath, "wb");
+  if (out == NULL) {
+    err = VIX_E_FILE_ACCESS_ERROR;
+    goto cleanup;
+  }
+
+  for (i = 1; i < t->nEntries && !VIX_FAILED(err); i++) {
+    TreeEntry *e = &t->entries[i];
+
+    if (e->isDir) {
+      char *name = TreeTransfer_join(e->relPath, "/", '/');
+      if (name == NULL) {
+        err = VIX_E_OUT_OF_MEMORY;
+        break;
+      }
+      err = Tar_writeHeader(out, name, TAR_TYPE_DIR, 0, 0755,
+          (int64) time(NULL)
+        );
+      pyvix_plain_free(name);
+    } else {
+      char *hostPath = TreeTransfer_hostPath(t, i);
+      if (hostPath == NULL) {
+        err = VIX_E_OUT_OF_MEMORY;
+        break;
+      }
+      err = Tar_packFile(out, e->relPath, hostPath, &e->bytes, buf);
+      pyvix_plain_free(hostPath);
+    }
+  }
+  if (!VIX_FAILED(err)) {
+    /* The end of the archive is marked by two zero blocks: */
+    memset(buf, 0, 2 * TAR_BLOCK_SIZE);
+    if (fwrite(buf, 1, 2 * TAR_BLOCK_SIZE, out) != 2 * TAR_BLOCK_SIZE) {
+      err = VIX_E_FILE_ERROR;
+    }
+  }
+
+  cleanup:
+    if (out != NULL && fclose(out) != 0 && !VIX_FAILED(err)) {
+      err = VIX_E_FILE_ERROR;
+    }
+    pyvix_plain_free(buf);
+    return err;
+} /* Tar_pack */
+
+/***************************** Reading Archives ******************************/
+
+static VixError Tar_copyData(FILE *in, FILE *out, int64 size, char *buf) {
+  /* Copies the size bytes of data that follow a header from in to out (or,
+   * if out is NULL, skips them), along with their padding. */
+  int64 remaining = size + (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE)
+      % TAR_BLOCK_SIZE;
+  int64 toWrite = size;
+
+  while (remaining > 0) {
+    const size_t want = (size_t) (remaining < TAR_IO_BUFFER_SIZE ? remaining
+        : TAR_IO_BUFFER_SIZE
+      );
+    const size_t nWrite = (size_t) (toWrite < (int64) want ? toWrite : want);
+    if (fread(buf, 1, want, in) != want) { return VIX_E_FILE_ERROR; }
+    if (out != NULL && nWrite > 0 && fwrite(buf, 1, nWrite, out) != nWrite) {
+      return VIX_E_FILE_ERROR;
+    }
+    remaining -= want;
+    toWrite -= nWrite;
+  }
+  return VIX_OK;
+} /* Tar_copyData */
+
+static VixError Tar_readLongName(FILE *in, int64 size, char type, char *buf,
+    char **name
+  )
+{
+  /* Reads the data of a GNU long name or pax header entry, setting *name to
+   * the name that it gives the next entry (allocated with
+   * pyvix_plain_malloc), or to NULL if it gives none.  Either way, the
+   * entry's data is consumed, unless the archive turns out to be corrupt. */
+  const size_t padding = (size_t) ((TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE)
+      % TAR_BLOCK_SIZE
+    );
+  char *data;
+
+  *name = NULL;
+  if (size < 0) { return VIX_E_FILE_ERROR; }
+  if (size > TAR_IO_BUFFER_SIZE) {
+    /* No name is that long, but a pax header may carry other records that
+     * are, which are of no interest: */
+    if (type == TAR_TYPE_LONG_NAME) { return VIX_E_FILE_ERROR; }
+    return Tar_copyData(in, NULL, size, buf);
+  }
+  data = pyvix_plain_malloc((size_t) size + 1);
+  if (data == NULL) { return VIX_E_OUT_OF_MEMORY; }
+  if (fread(data, 1, (size_t) size, in) != (size_t) size
+      || fread(buf, 1, padding, in) != padding
+     )
+  {
+    pyvix_plain_free(data);
+    return VIX_E_FILE_ERROR;
+  }
+  data[size] = '\0';
+
+  if (type == TAR_TYPE_LONG_NAME) {
+    if (size == 0) {
+      pyvix_plain_free(data);
+      return VIX_E_FILE_ERROR;
+    }
+    *name = data;
+    return VIX_OK;
+  }
+
+  {
+    /* A pax header is a series of "<length> <key>=<value>\n" records: */
+    const char *rec = data;
+    while (rec < data + size) {
+      char *end;
+      const long recLen = strtol(rec, &end, 10);
+      if (recLen <= 0 || *end != ' ' || rec + recLen > data + size) { break; }
+      if (strncmp(end + 1, "path=", 5) == 0) {
+        const char *value = end + 6;
+        const size_t valueLen = (size_t) (rec + recLen - 1 - value);
+        *name = pyvix_plain_malloc(valueLen + 1);
+        if (*name == NULL) {
+          pyvix_plain_free(data);
+          return VIX_E_OUT_OF_MEMORY;
+        }
+        memcpy(*name, value, valueLen);
+        (*name)[valueLen] = '\0';
+        break;
+      }
+      rec += recLen;
+    }
+  }
+  pyvix_plain_free(data);
+  return VIX_OK;
+} /* Tar_readLongName */
+
+static char *Tar_headerName(const unsigned char *h) {
+  /* Returns the name in header h, which may be split between its prefix and
+   * name fields (allocated with pyvix_plain_malloc). */
+  char name[TAR_NAME_SIZE + 1];
+  char prefix[156];
+  char *full;
+
+  memcpy(name, h + TAR_OFF_NAME, TAR_NAME_SIZE);
+  name[TAR_NAME_SIZE] = '\0';
+  prefix[0] = '\0';
+  if (memcmp(h + TAR_OFF_MAGIC, "ustar", 5) == 0) {
+    memcpy(prefix, h + TAR_OFF_PREFIX, 155);
+    prefix[155] = '\0';
+  }
+
+  if (prefix[0] == '\0') { return TreeTransfer_strdup(name); }
+  full = pyvix_plain_malloc(strlen(prefix) + 1 + strlen(name) + 1);
+  if (full != NULL) { sprintf(full, "%s/%s", prefix, name); }
+  return full;
+} /* Tar_headerName */
+
+static const char *Tar_normalizeName(char *name) {
+  /* Strips the leading "./"s and trailing '/'s from name in place, and
+   * returns what's left ("" for the root of the archive), or NULL if name
+   * would escape the root of the tree. */
+  char *p;
+  size_t len;
+
+  while (name[0] == '.' && name[1] == '/') {
+    name += 2;
+    while (*name == '/') { name++; }
+  }
+  if (strcmp(name, ".") == 0) { name[0] = '\0'; }
+  len = strlen(name);
+  while (len > 0 && name[len - 1] == '/') { name[--len] = '\0'; }
+
+  if (name[0] == '/') { return NULL; }
+  for (p = name; *p != '\0'; ) {
+    const size_t compLen = strcspn(p, "/");
+    if (compLen == 2 && p[0] == '.' && p[1] == '.') { return NULL; }
+#ifdef _WIN32
+    if (memchr(p, '\\', compLen) != NULL || memchr(p, ':', compLen) != NULL) {
+      return NULL;
+    }
+#endif
+    p += compLen;
+    while (*p == '/') { p++; }
+  }
+  return name;
+} /* Tar_normalizeName */
+
+static VixError Tar_makeDirs(TreeTransfer *t, char *relPath, bool includeLast)
+{
+  /* Creates the host directories on the way to relPath beneath the host root
+   * (and relPath itself, if includeLast). */
+  char *p = relPath;
+
+  for (;;) {
+    char *slash = strchr(p, '/');
+    char *hostPath;
+    int res;
+
+    if (slash == NULL && !includeLast) { break; }
+    if (slash != NULL) { *slash = '\0'; }
+    hostPath = TreeTransfer_join(t->hostRoot, relPath, TREE_HOST_SEP);
+    res = (hostPath == NULL ? -1 : pyvix_mkdir(hostPath));
+    if (slash != NULL) { *slash = '/'; }
+    if (hostPath == NULL) { return VIX_E_OUT_OF_MEMORY; }
+    pyvix_plain_free(hostPath);
+    if (res != 0 && errno != EEXIST) { return VIX_E_FILE_ACCESS_ERROR; }
+
+    if (slash == NULL) { break; }
+    p = slash + 1;
+  }
+  return VIX_OK;
+} /* Tar_makeDirs */
+
+static VixError Tar_unpackEntry(FILE *in, TreeTransfer *t, char *relPath,
+    char type, int64 size, int mode, char *buf
+  )
+{
+  /* Unpacks the entry whose header was just read, and adds it to t.  A
+   * file's permission bits are kept, so that scripts stay executable. */
+  VixError err;
+  const bool isDir = (type == TAR_TYPE_DIR);
+  char *hostPath;
+  FILE *out;
+
+  if (!isDir && type != TAR_TYPE_FILE && type != TAR_TYPE_OLD_FILE
+      && type != TAR_TYPE_CONTIGUOUS
+     )
+  {
+    /* Links, devices and the like aren't transferred: */
+    return Tar_copyData(in, NULL, size, buf);
+  }
+  if (relPath[0] == '\0') {
+    /* The root of the tree, which is already in place: */
+    return Tar_copyData(in, NULL, size, buf);
+  }
+
+  err = Tar_makeDirs(t, relPath, isDir);
+  if (VIX_FAILED(err)) { return err; }
+  if (isDir) {
+    err = Tar_copyData(in, NULL, size, buf);
+  } else {
+    hostPath = TreeTransfer_join(t->hostRoot, relPath, TREE_HOST_SEP);
+    if (hostPath == NULL) { return VIX_E_OUT_OF_MEMORY; }
+    out = fopen(hostPath, "wb");
+    if (out == NULL) {
+      pyvix_plain_free(hostPath);
+      return VIX_E_FILE_ACCESS_ERROR;
+    }
+    err = Tar_copyData(in, out, size, buf);
+    if (fclose(out) != 0 && !VIX_FAILED(err)) { err = VIX_E_FILE_ERROR; }
+#ifndef _WIN32
+    if (!VIX_FAILED(err)) { chmod(hostPath, (mode_t) (mode & 0777)); }
+#endif
+    pyvix_plain_free(hostPath);
+  }
+  if (VIX_FAILED(err)) { return err; }
+
+  /* Every entry is named relative to the root: */
+  if (!TreeTransfer_addEntry(t, 0, relPath, isDir, (isDir ? 0 : size))) {
+    return VIX_E_OUT_OF_MEMORY;
+  }
+  return VIX_OK;
+} /* Tar_unpackEntry */
+
+static VixError Tar_unpack(TreeTransfer *t, const char *archivePath) {
+  /* Unpacks the archive at archivePath beneath the host root of t, which
+   * must exist, adding each of its entries to t.  The GIL need not be
+   * held. */
+  VixError err = VIX_OK;
+  FILE *in = NULL;
+  char *buf = pyvix_plain_malloc(TAR_IO_BUFFER_SIZE);
+  char *longName = NULL;
+  unsigned char h[TAR_BLOCK_SIZE];
+
+  if (buf == NULL) { return VIX_E_OUT_OF_MEMORY; }
+  in = fopen(archivePath, "rb");
+  if (in == NULL) {
+    err = VIX_E_FILE_ACCESS_ERROR;
+    goto cleanup;
+  }
+
+  for (;;) {
+    const size_t got = fread(h, 1, TAR_BLOCK_SIZE, in);
+    char *name;
+    const char *relPath;
+    int64 size;
+    char type;
+
+    /* Some writers omit the zero blocks at the end: */
+    if (got == 0 && feof(in)) { break; }
+    if (got != TAR_BLOCK_SIZE) {
+      err = VIX_E_FILE_ERROR;
+      break;
+    }
+    if (Tar_isZeroBlock(h)) { break; }
+    if ((unsigned long) Tar_getNumber(h + TAR_OFF_CHECKSUM, 8)
+        != Tar_checksum(h)
+       )
+    {
+      err = VIX_E_FILE_ERROR;
+      break;
+    }
+    size = Tar_getNumber(h + TAR_OFF_SIZE, 12);
+    type = (char) h[TAR_OFF_TYPE];
+
+    if (type == TAR_TYPE_LONG_NAME || type == TAR_TYPE_PAX) {
+      char *next;
+      err = Tar_readLongName(in, size, type, buf, &next);
+      if (VIX_FAILED(err)) { break; }
+      if (next != NULL) {
+        if (longName != NULL) { pyvix_plain_free(longName); }
+        longName = next;
+      }
+      continue;
+    }
+
+    if (longName != NULL) {
+      name = longName;
+      longName = NULL;
+    } else {
+      name = Tar_headerName(h);
+      if (name == NULL) {
+        err = VIX_E_OUT_OF_MEMORY;
+        break;
+      }
+    }
+    relPath = Tar_normalizeName(name);
+    err = (relPath == NULL ? VIX_E_INVALID_ARG
+        : Tar_unpackEntry(in, t, (char *) relPath, type, size,
+            (int) Tar_getNumber(h + TAR_OFF_MODE, 8), buf
+          )
+      );
+    pyvix_plain_free(name);
+    if (VIX_FAILED(err)) { break; }
+  }
+
+  cleanup:
+    if (in != NULL) { fclose(in); }
+    if (longName != NULL) { pyvix_plain_free(longName); }
+    pyvix_plain_free(buf);
+    return err;
+} /* Tar_unpack */
+
+/****************************** Staging **************************************/
+
+static char *TreeArchive_stagingPath(const char *stagingDir) {
+  /* Creates an empty file with a unique name in stagingDir (or in the
+   * system's temporary directory, if stagingDir is NULL), and returns its
+   * path (allocated with pyvix_plain_malloc), or NULL if that failed. */
+#ifdef _WIN32
+  char tempDir[MAX_PATH + 1];
+  char path[MAX_PATH + 1];
+
+  if (stagingDir == NULL) {
+    if (GetTempPathA(sizeof(tempDir), tempDir) == 0) { return NULL; }
+    stagingDir = tempDir;
+  }
+  if (GetTempFileNameA(stagingDir, "pvx", 0, path) == 0) { return NULL; }
+  return TreeTransfer_strdup(path);
+#else
+  char *path;
+  int fd;
+
+  if (stagingDir == NULL) {
+    stagingDir = getenv("TMPDIR");
+    if (stagingDir == NULL || stagingDir[0] == '\0') { stagingDir = "/tmp"; }
+  }
+  path = TreeTransfer_join(stagingDir, "pyvix-XXXXXX", '/');
+  if (path == NULL) { return NULL; }
+  fd = mkstemp(path);
+  if (fd < 0) {
+    pyvix_plain_free(path);
+    return NULL;
+  }
+  close(fd);
+  return path;
+#endif
+} /* TreeArchive_stagingPath */
+
+static char *TreeArchive_guestArchivePath(const TreeTransfer *t,
+    const char *stagingPath
+  )
+{
+  /* Returns the guest path of the archive:  beside the root of the tree,
+   * named after the staged archive, so that it's just as unique. */
+  const char *base = stagingPath + strlen(stagingPath);
+  size_t rootLen = strlen(t->guestRoot);
+  char *path;
+
+  while (base > stagingPath && base[-1] != '/' && base[-1] != '\\') { base--; }
+  while (rootLen > 1 && t->guestRoot[rootLen - 1] == t->guestSep) {
+    rootLen--;
+  }
+
+  path = pyvix_plain_malloc(rootLen + 1 + strlen(base) + 5);
+  if (path == NULL) { return NULL; }
+  memcpy(path, t->guestRoot, rootLen);
+  sprintf(path + rootLen, ".%s.tar", base);
+  return path;
+} /* TreeArchive_guestArchivePath */
+
+static size_t TreeArchive_substituteInto(const char *value, bool quoted,
+    char *out
+  )
+{
+  /* Writes value to out (unless it's NULL), and returns its length.  If
+   * quoted, value stands within single quotes, so each single quote in it is
+   * written as '\'' (which closes the quotes, adds a quote, and reopens
+   * them). */
+  size_t len = 0;
+
+  for (; *value != '\0'; value++) {
+    if (quoted && *value == '\'') {
+      if (out != NULL) { memcpy(out + len, "'\\''", 4); }
+      len += 4;
+    } else {
+      if (out != NULL) { out[len] = *value; }
+      len++;
+    }
+  }
+  return len;
+} /* TreeArchive_substituteInto */
+
+static size_t TreeArchive_expandInto(const char *argsTemplate,
+    const char *archive, const char *dir, bool quoted, char *out
+  )
+{
+  /* Writes argsTemplate, with each "{archive}" and "{dir}" replaced by
+   * archive and dir, to out (unless it's NULL), and returns its length.
+   * quoted says whether the template puts them within single quotes, as the
+   * default commands do. */
+  size_t len = 0;
+  const char *p = argsTemplate;
+
+  while (*p != '\0') {
+    if (strncmp(p, "{archive}", 9) == 0) {
+      len += TreeArchive_substituteInto(archive, quoted,
+          (out != NULL ? out + len : NULL)
+        );
+      p += 9;
+    } else if (strncmp(p, "{dir}", 5) == 0) {
+      len += TreeArchive_substituteInto(dir, quoted,
+          (out != NULL ? out + len : NULL)
+        );
+      p += 5;
+    } else {
+      if (out != NULL) { out[len] = *p; }
+      len++;
+      p++;
+    }
+  }
+  if (out != NULL) { out[len] = '\0'; }
+  return len;
+} /* TreeArchive_expandInto */
+
+static char *TreeArchive_expand(const char *argsTemplate, const char *archive,
+    const char *dir, bool quoted
+  )
+{
+  /* Returns the expansion of argsTemplate (see TreeArchive_expandInto),
+   * allocated with pyvix_plain_malloc, or NULL if memory ran out. */
+  char *args = pyvix_plain_malloc(
+      TreeArchive_expandInto(argsTemplate, archive, dir, quoted, NULL) + 1
+    );
+  if (args != NULL) {
+    TreeArchive_expandInto(argsTemplate, archive, dir, quoted, args);
+  }
+  return args;
+} /* TreeArchive_expand */
+
+/***************************** Packed Transfers ******************************/
+
+static status TreeArchiveOptions_fromPython(TreeArchiveOptions *options,
+    const char *mode, PyObject *pyCommand, int minFiles,
+    PY_LONG_LONG maxBytes, const char *stagingDir
+  )
+{
+  /* Fills options from the arguments of copyTreeToGuest or
+   * copyTreeFromGuest; its strings are borrowed from them.  The GIL must be
+   * held. */
+  if (mode == NULL || strcmp(mode, "files") == 0) {
+    options->mode = TREE_MODE_FILES;
+  } else if (strcmp(mode, "archive") == 0) {
+    options->mode = TREE_MODE_ARCHIVE;
+  } else if (strcmp(mode, "auto") == 0) {
+    options->mode = TREE_MODE_AUTO;
+  } else {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "mode must be 'files', 'archive' or 'auto'."
+      );
+    return FAILED;
+  }
+
+  options->program = NULL;
+  options->argsTemplate = NULL;
+  if (pyCommand != NULL && pyCommand != Py_None) {
+    if (!PyTuple_Check(pyCommand) || PyTuple_GET_SIZE(pyCommand) != 2
+        || !PyString_Check(PyTuple_GET_ITEM(pyCommand, 0))
+        || !PyString_Check(PyTuple_GET_ITEM(pyCommand, 1))
+       )
+    {
+      raiseNonNumericVIXError(VIXClientProgrammerError,
+          "The archive command must be a (program, args) tuple of strings."
+        );
+      return FAILED;
+    }
+    options->program = PyString_AS_STRING(PyTuple_GET_ITEM(pyCommand, 0));
+    options->argsTemplate = PyString_AS_STRING(
+        PyTuple_GET_ITEM(pyCommand, 1)
+      );
+  }
+
+  if (minFiles < 0 || maxBytes < 0) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "archive_min_files and archive_max_bytes must not be negative."
+      );
+    return FAILED;
+  }
+  options->minFiles = minFiles;
+  options->maxBytes = (int64) maxBytes;
+  options->stagingDir = stagingDir;
+
+  return SUCCEEDED;
+} /* TreeArchiveOptions_fromPython */
+
+static VixError TreeArchive_scanHost(TreeTransfer *t) {
+  /* Finds every entry of the host tree of t.  The GIL need not be held. */
+  Py_ssize_t i;
+
+  for (i = 0; i < t->nEntries; i++) {
+    if (t->entries[i].isDir) {
+      const VixError err = TreeTransfer_readHostDir(t, i);
+      if (VIX_FAILED(err)) { return err; }
+    }
+  }
+  t->entries[0].outcome = PIPELINE_STEP_OK;
+  return VIX_OK;
+} /* TreeArchive_scanHost */
+
+static bool TreeArchive_worthPacking(const TreeTransfer *t,
+    const TreeArchiveOptions *options
+  )
+{
+  Py_ssize_t nFiles = 0;
+  int64 nBytes = 0;
+  Py_ssize_t i;
+
+  for (i = 1; i < t->nEntries; i++) {
+    if (!t->entries[i].isDir) {
+      nFiles++;
+      nBytes += t->entries[i].bytes;
+    }
+  }
+  return nFiles >= options->minFiles && nBytes <= options->maxBytes;
+} /* TreeArchive_worthPacking */
+
+static void TreeArchive_setStep(PipelineStep *step, PipelineStepKind kind,
+    const char *name, char *arg1, char *arg2
+  )
+{
+  step->kind = kind;
+  step->name = name;
+  step->changesState = false;
+  step->arg1 = arg1;
+  step->arg2 = arg2;
+  step->intArg = 0;
+  step->snapH = VIX_INVALID_HANDLE;
+} /* TreeArchive_setStep */
+
+static status TreeArchive_checkSteps(const PipelineStep *steps,
+    const PipelineStepResult *results, Py_ssize_t nSteps,
+    const char **outcome
+  )
+{
+  /* Raises the failure of the first of steps[0:nSteps] that failed, or whose
+   * guest program exited with a non-zero status, and sets *outcome to how
+   * the transfer as a whole turned out.  The GIL must be held. */
+  Py_ssize_t j;
+
+  for (j = 0; j < nSteps; j++) {
+    const PipelineStepResult *res = &results[j];
+
+    switch (res->outcome) {
+      case PIPELINE_STEP_OK:
+        if (steps[j].kind == PIPELINE_RUN && res->exitCode != 0) {
+          *outcome = "error";
+          PyErr_Format(VIXException,
+              "The guest's archive command exited with status %d.",
+              res->exitCode
+            );
+          return FAILED;
+        }
+        break;
+      case PIPELINE_STEP_ERROR:
+        *outcome = "error";
+        autoRaiseVIXError(res->err);
+        return FAILED;
+      default:
+        *outcome = "timeout";
+        raiseNonNumericVIXError(VIXTimeoutError,
+            "The packed tree was not transferred within the timeout."
+          );
+        return FAILED;
+    }
+  }
+  *outcome = "ok";
+  return SUCCEEDED;
+} /* TreeArchive_checkSteps */
+
+static PyObject *TreeArchive_transfer(VM *vm, TreeTransfer *t,
+    const char *program, const char *argsTemplate,
+    const TreeArchiveOptions *options, const char **outcome
+  )
+{
+  /* Transfers the tree of t as an archive.  When packing on the host, every
+   * entry of t must already have been found; when unpacking on the host, t
+   * must hold only its root, and gains the entries of the archive.  Returns
+   * the manifest, in which every entry shares the time that the whole
+   * transfer took.  The GIL must be held, and is released while the transfer
+   * runs. */
+  PipelineStep steps[3];
+  PipelineStepResult results[3];
+  char *stagingPath = NULL;
+  char *guestArchive = NULL;
+  char *args = NULL;
+  VixError err = VIX_OK;
+  const double startedAt = PyVixClock_now();
+  double seconds;
+  PyObject *manifest = NULL;
+  Py_ssize_t i;
+
+  *outcome = "error";
+  stagingPath = TreeArchive_stagingPath(options->stagingDir);
+  if (stagingPath == NULL) {
+    raiseNonNumericVIXError(VIXException,
+        "Could not create an archive in the staging directory."
+      );
+    goto fail;
+  }
+  guestArchive = TreeArchive_guestArchivePath(t, stagingPath);
+  args = (guestArchive == NULL ? NULL
+      : TreeArchive_expand(argsTemplate, guestArchive, t->guestRoot,
+          options->program == NULL
+        )
+    );
+  if (args == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  if (t->direction == TREE_TO_GUEST) {
+    LEAVE_PYTHON
+    err = Tar_pack(t, stagingPath);
+    ENTER_PYTHON
+    CHECK_VIX_ERROR(err);
+
+    TreeArchive_setStep(&steps[0], PIPELINE_COPY_IN, "copyIn", stagingPath,
+        guestArchive
+      );
+    TreeArchive_setStep(&steps[1], PIPELINE_RUN, "run", (char *) program,
+        args
+      );
+  } else {
+    TreeArchive_setStep(&steps[0], PIPELINE_RUN, "run", (char *) program,
+        args
+      );
+    TreeArchive_setStep(&steps[1], PIPELINE_COPY_OUT, "copyOut",
+        guestArchive, stagingPath
+      );
+  }
+  TreeArchive_setStep(&steps[2], PIPELINE_DELETE, "delete", guestArchive,
+      NULL
+    );
+  /* Whatever the archive overwrites is no longer known to the VM's
+   * ContentCache: */
+  if (t->direction == TREE_TO_GUEST) {
+    ContentCache_forgetBeneath(t->contentCache, t->guestRoot, t->guestSep);
+  }
+
+  if (Pipeline_execute(&vm, 1, steps, 3, 1, t->deadline, results)
+      != SUCCEEDED
+     )
+  { goto fail; }
+  /* The guest's copy of the archive is only a convenience, so its deletion
+   * doesn't count: */
+  if (TreeArchive_checkSteps(steps, results, 2, outcome) != SUCCEEDED) {
+    goto fail;
+  }
+
+  if (t->direction == TREE_FROM_GUEST) {
+    LEAVE_PYTHON
+    if (pyvix_mkdir(t->hostRoot) != 0 && errno != EEXIST) {
+      err = VIX_E_FILE_ACCESS_ERROR;
+    } else {
+      err = Tar_unpack(t, stagingPath);
+    }
+    ENTER_PYTHON
+    if (VIX_FAILED(err)) {
+      *outcome = "error";
+      autoRaiseVIXError(err);
+      goto fail;
+    }
+  }
+
+  seconds = PyVixClock_now() - startedAt;
+  for (i = 0; i < t->nEntries; i++) {
+    t->entries[i].outcome = PIPELINE_STEP_OK;
+    t->entries[i].seconds = seconds;
+  }
+  manifest = TreeTransfer_manifest(t);
+  if (manifest == NULL) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    /* Fall through to cleanup: */
+  cleanup:
+    if (stagingPath != NULL) {
+      remove(stagingPath);
+      pyvix_plain_free(stagingPath);
+    }
+    if (guestArchive != NULL) { pyvix_plain_free(guestArchive); }
+    if (args != NULL) { pyvix_plain_free(args); }
+    return manifest;
+} /* TreeArchive_transfer */
+
+static PyObject *TreeArchive_run(VM *vm, TreeDirection direction,
+    const char *hostDir, const char *guestDir, int maxParallel,
+    const TreeArchiveOptions *options, const JobDeadline *deadline
+  )
+{
+  /* Transfers the tree rooted at hostDir to guestDir within vm (or vice
+   * versa) as an archive, or under TREE_MODE_AUTO, file by file if the tree
+   * isn't worth packing (see TreeTransfer_run).  To decide, a host tree is
+   * read beforehand, and a guest tree listed directory by directory.  The
+   * GIL must be held, and is released while the transfer runs. */
+  TreeTransfer t;
+  const char *program = options->program;
+  const char *argsTemplate = options->argsTemplate;
+  const char *outcome = "error";
+  PyObject *manifest = NULL;
+  bool pack = true;
+
+  if (TreeTransfer_init(&t, vm, direction, hostDir, guestDir, maxParallel,
+        deadline->at
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  if (program == NULL) {
+    char *unusable = NULL;
+    if (t.guestSep != '/') {
+      unusable = "There is no default archive command for this guest; pass"
+        " one.";
+    } else if (strpbrk(guestDir, "\"\\$`") != NULL) {
+      /* The guest's shell would interpret these within the default
+       * command's double quotes (single quotes are escaped instead; see
+       * TreeArchive_substituteInto): */
+      unusable = "The default archive command can't take a guestDir that"
+        " contains '\"', '\\', '$' or '`'; pass one.";
+    }
+    if (unusable != NULL) {
+      if (options->mode == TREE_MODE_ARCHIVE) {
+        raiseNonNumericVIXError(VIXClientProgrammerError, unusable);
+        goto fail;
+      }
+      pack = false;
+    }
+    program = TREE_ARCHIVE_DEFAULT_PROGRAM;
+    argsTemplate = (direction == TREE_TO_GUEST
+        ? TREE_ARCHIVE_DEFAULT_UNPACK_ARGS : TREE_ARCHIVE_DEFAULT_PACK_ARGS
+      );
+  }
+
+  if (direction == TREE_TO_GUEST) {
+    VixError err;
+    LEAVE_PYTHON
+    err = TreeArchive_scanHost(&t);
+    ENTER_PYTHON
+    CHECK_VIX_ERROR(err);
+  } else if (options->mode == TREE_MODE_AUTO && pack) {
+    t.scanOnly = true;
+    LEAVE_PYTHON
+    TreeTransfer_drive(&t);
+    ENTER_PYTHON
+    if (TreeTransfer_checkRoot(&t) != SUCCEEDED) { goto fail; }
+  }
+  if (options->mode == TREE_MODE_AUTO) {
+    pack = pack && TreeArchive_worthPacking(&t, options);
+  }
+  if (!pack) {
+    TreeTransfer_destroy(&t);
+    return TreeTransfer_run(vm, direction, hostDir, guestDir, maxParallel,
+        false, deadline
+      );
+  }
+
+  if (direction == TREE_FROM_GUEST) {
+    /* The entries are found afresh as the archive is unpacked: */
+    TreeTransfer_destroy(&t);
+    if (TreeTransfer_init(&t, vm, direction, hostDir, guestDir, maxParallel,
+          deadline->at
+        ) != SUCCEEDED
+       )
+    { goto fail; }
+  }
+
+  manifest = TreeArchive_transfer(vm, &t, program, argsTemplate, options,
+      &outcome
+    );
+  if (manifest == NULL) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    /* Fall through to cleanup: */
+  cleanup:
+    TreeTransfer_destroy(&t);
+    {
+      /* Recorded with the transfer's failure (if any) set aside: */
+      PyObject *excType, *excValue, *excTraceback;
+      PyErr_Fetch(&excType, &excValue, &excTraceback);
+      if (JobDeadline_recordStep(deadline, outcome) != SUCCEEDED) {
+        Py_CLEAR(manifest);
+        Py_XDECREF(excType);
+        Py_XDECREF(excValue);
+        Py_XDECREF(excTraceback);
+      } else {
+        PyErr_Restore(excType, excValue, excTraceback);
+      }
+    }
+    return manifest;
+} /* TreeArchive_run */
@@ -0,0 +1,227 @@
+/******************************************************************************
+ * pyvix - Batch Submission of VIX Jobs
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Batch_run submits a whole batch of VIX jobs and waits for all of them to
+ * finish, with the GIL released throughout.  At most maxParallel of the jobs
+ * are in flight at once, because VIX on a single host degrades when too many
+ * jobs pile up:  whenever the limit has been reached, the next job is only
+ * submitted once an earlier one has finished.  Finished jobs are counted via
+ * a private CompletionPort, into which JobCompletion_complete posts them.
+ *
+ * If the batch's deadline passes, the jobs still in flight are cancelled and
+ * the rest are never submitted; all of them then fail with VIXTimeoutError.
+ * That includes time spent waiting for the Host's AdmissionGate (if any) to
+ * admit the next job, which it does on top of maxParallel. */
+
+static Py_ssize_t Batch_awaitFinished(CompletionPort *port, double deadline) {
+  /* Waits until at least one job has been posted to port, or until deadline,
+   * then returns the number of jobs that were.  The GIL need not be held. */
+  Py_ssize_t nFinished = 0;
+  JobCompletion *chain;
+
+  if (!PyVixEvent_wait(&port->nonEmpty, millisUntilDeadline(deadline))) {
+    return 0;
+  }
+
+  PyVixMutex_lock(&port->lock);
+  chain = CompletionPort_takeLocked(port, -1);
+  PyVixMutex_unlock(&port->lock);
+
+  while (chain != NULL) {
+    JobCompletion *jc = chain;
+    chain = jc->portNext;
+    jc->portNext = NULL;
+    nFinished++;
+  }
+
+  return nFinished;
+} /* Batch_awaitFinished */
+
+static bool Batch_deadlinePassed(double deadline) {
+  return millisUntilDeadline(deadline) == 0;
+} /* Batch_deadlinePassed */
+
+static status Batch_run(Job **jobs, Py_ssize_t nJobs, int maxParallel,
+    double deadline, AdmissionGate *admission, AdmissionClass admissionClass,
+    BatchSubmitFunc submit, void *context
+  )
+{
+  /* Submits each of the Jobs in jobs[0:nJobs] (skipping NULL entries) by
+   * calling submit(context, i, Job_CLIENT_DATA(jobs[i])) without the GIL,
+   * once admission (if not NULL) has admitted it as an operation of class
+   * admissionClass, then waits for all of them to finish, or for deadline
+   * (NO_DEADLINE for none) to pass.  On return, every Job is OPEN and
+   * completed; the caller collects the results.  Returns FAILED (with an
+   * exception set) only if the batch couldn't be started at all.  The GIL
+   * must be held. */
+  CompletionPort *port = NULL;
+  VixHandle *jobHandles = NULL;
+  Py_ssize_t i;
+  Py_ssize_t nInFlight = 0;
+  Py_ssize_t nFinished;
+  /* The jobs from this index on were never submitted: */
+  Py_ssize_t firstUnsubmitted;
+  bool expired = false;
+
+  if (maxParallel < 1) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "max_parallel must be at least 1."
+      );
+    goto fail;
+  }
+
+  port = CompletionPort_new();
+  if (port == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  jobHandles = pyvix_main_malloc(sizeof(VixHandle) * (nJobs > 0 ? nJobs : 1));
+  if (jobHandles == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  for (i = 0; i < nJobs; i++) {
+    JobCompletion *jc;
+    jobHandles[i] = VIX_INVALID_HANDLE;
+    if (jobs[i] == NULL) { continue; }
+
+    /* No Python object is needed to represent the job in the port, since
+     * Batch_awaitFinished merely counts the arrivals: */
+    jc = jobs[i]->completion;
+    CompletionPort_addRef(port);
+    PyVixMutex_lock(&jc->lock);
+    assert (jc->port == NULL);
+    jc->port = port;
+    PyVixMutex_unlock(&jc->lock);
+  }
+
+  LEAVE_PYTHON
+  for (i = 0; i < nJobs; i++) {
+    if (jobs[i] == NULL) { continue; }
+
+    while (nInFlight >= maxParallel && !expired) {
+      nFinished = Batch_awaitFinished(port, deadline);
+      nInFlight -= nFinished;
+      expired = (nFinished == 0 && Batch_deadlinePassed(deadline));
+    }
+    if (expired) { break; }
+
+    if (admission != NULL) {
+      const VixError err = AdmissionGate_enter(admission, admissionClass,
+          deadline
+        );
+      if (err == VIX_E_CANCELLED) {
+        expired = true;
+        break;
+      } else if (VIX_FAILED(err)) {
+        /* This job alone fails, as though VIX had refused it, and arrives at
+         * port immediately: */
+        JobCompletion_complete(jobs[i]->completion, VIX_INVALID_HANDLE, err,
+            true
+          );
+        JobCompletion_release(jobs[i]->completion);
+        nInFlight++;
+        continue;
+      }
+      AdmissionGate_attach(admission, admissionClass, jobs[i]->completion);
+    }
+
+    jobHandles[i] = submit(context, i, Job_CLIENT_DATA(jobs[i]));
+    nInFlight++;
+    /* If VIX refused the job, this posts it to port immediately: */
+    JobCompletion_issued(jobs[i]->completion, jobHandles[i]);
+  }
+  firstUnsubmitted = i;
+  while (nInFlight > 0 && !expired) {
+    nFinished = Batch_awaitFinished(port, deadline);
+    nInFlight -= nFinished;
+    expired = (nFinished == 0 && Batch_deadlinePassed(deadline));
+  }
+  ENTER_PYTHON
+
+  if (expired) {
+    for (i = 0; i < nJobs; i++) {
+      JobCompletion *jc;
+      if (jobs[i] == NULL) { continue; }
+
+      jc = jobs[i]->completion;
+      if (JobCompletion_cancel(jc)) { jobs[i]->timedOut = true; }
+      if (i >= firstUnsubmitted) {
+        /* VIX never saw this job, so its reference is dropped here: */
+        JobCompletion_issued(jc, VIX_INVALID_HANDLE);
+      }
+    }
+  }
+
+  for (i = 0; i < nJobs; i++) {
+    if (jobs[i] == NULL) { continue; }
+    if (Job_markIssued(jobs[i], jobHandles[i]) != SUCCEEDED) { goto fail; }
+  }
+
+  pyvix_main_free(jobHandles);
+  CompletionPort_close(port);
+  return SUCCEEDED;
+  fail:
+    assert (PyErr_Occurred());
+    if (jobHandles != NULL) { pyvix_main_free(jobHandles); }
+    if (port != NULL) { CompletionPort_close(port); }
+    return FAILED;
+} /* Batch_run */
+
+static PyObject *Batch_collectResults(Job **jobs, PyObject *results,
+    Py_ssize_t nJobs
+  )
+{
+  /* Fills each slot of results (a list of nJobs entries) that's still NULL
+   * with the result of the corresponding Job or, if the Job failed, with the
+   * exception it raised.  Returns results. */
+  Py_ssize_t i;
+
+  for (i = 0; i < nJobs; i++) {
+    PyObject *res;
+    if (jobs[i] == NULL) { continue; }
+
+    res = Job_result(jobs[i], NO_DEADLINE);
+    if (res == NULL) { res = fetchRaisedException(); }
+    assert (PyList_GET_ITEM(results, i) == NULL);
+    PyList_SET_ITEM(results, i, res);
+  }
+
+  return results;
+} /* Batch_collectResults */
+
+static PyObject *Batch_vmRejection(Host *host, VM *vm) {
+  /* Returns NULL if vm, an entry of a batch that host runs across its VMs,
+   * can take part in it.  If it can't, its failure is reported in its slot
+   * of the results, without holding up the rest of the batch, so a new
+   * reference to the exception that goes there is returned instead (never
+   * raised). */
+  if (StatefulHandleWrapper_isOpen(vm) && vm->host == host) { return NULL; }
+
+  raiseNonNumericVIXError(VIXClientProgrammerError,
+      "The VM must be OPEN, and must have been opened via this Host."
+    );
+  return fetchRaisedException();
+} /* Batch_vmRejection */
+
+static status Batch_recordStep(Job **jobs, Py_ssize_t nJobs,
+    const JobDeadline *deadline
+  )
+{
+  /* Records the whole batch as a single step of its Deadline (if any), whose
+   * outcome is 'timeout' if the batch ran out of time, and otherwise 'ok'
+   * (the failures of individual jobs are reported in the batch's results). */
+  const char *outcome = "ok";
+  Py_ssize_t i;
+
+  for (i = 0; i < nJobs; i++) {
+    if (jobs[i] != NULL && jobs[i]->timedOut) {
+      outcome = "timeout";
+      break;
+    }
+  }
+  return JobDeadline_recordStep(deadline, outcome);
+} /* Batch_recordStep */
@@ -5,21 +5,296 @@
  * Available under the MIT license (see docs/license.txt for details).
  *****************************************************************************/
 
+/* Event rings and the records that spill out of them are allocated and freed
+ * by VIX's worker threads, hence the threadsafe series: */
+static PyVixSlab VixEventRing_slab;
+static PyVixSlab VixEventRecord_spillSlab;
+
+static void initSupport_callbackAccumulator(void) {
+  PyVixSlab_init(&VixEventRing_slab, "VixEventRing",
+      sizeof(VixEventRing), 4, true
+    );
+  PyVixSlab_init(&VixEventRecord_spillSlab, "VixEventRecord",
+      sizeof(VixEventRecord), 64, true
+    );
+} /* initSupport_callbackAccumulator */
+
+/******************************* VixStringArena ******************************/
+
+static void VixStringArena_init(VixStringArena *arena) {
+  arena->chars = NULL;
+  arena->nChars = arena->charsCapacity = 0;
+  arena->starts = NULL;
+  arena->nItems = arena->startsCapacity = 0;
+} /* VixStringArena_init */
+
+static void VixStringArena_clear(VixStringArena *arena) {
+  if (arena->chars != NULL) { pyvix_plain_free(arena->chars); }
+  if (arena->starts != NULL) { pyvix_plain_free(arena->starts); }
+  VixStringArena_init(arena);
+} /* VixStringArena_clear */
+
+static bool VixStringArena_append(VixStringArena *arena, const char *s) {
+  /* Copies s into the arena, growing it geometrically as needed.  Returns
+   * false if memory ran out (in which case the arena is unchanged).  The GIL
+   * need not be held. */
+  size_t size = strlen(s) + 1;
+
+  if (arena->nChars + size > arena->charsCapacity) {
+    size_t newCapacity = (arena->charsCapacity == 0
+        ? 4096 : arena->charsCapacity * 2
+      );
+    char *newChars;
+    while (newCapacity < arena->nChars + size) { newCapacity *= 2; }
+    newChars = pyvix_plain_realloc(arena->chars, newCapacity);
+    if (newChars == NULL) { return false; }
+    arena->chars = newChars;
+    arena->charsCapacity = newCapacity;
+  }
+  if (arena->nItems == arena->startsCapacity) {
+    Py_ssize_t newCapacity = (arena->startsCapacity == 0
+        ? 64 : arena->startsCapacity * 2
+      );
+    size_t *newStarts = pyvix_plain_realloc(arena->starts,
+        sizeof(size_t) * newCapacity
+      );
+    if (newStarts == NULL) { return false; }
+    arena->starts = newStarts;
+    arena->startsCapacity = newCapacity;
+  }
+
+  memcpy(arena->chars + arena->nChars, s, size);
+  arena->starts[arena->nItems++] = arena->nChars;
+  arena->nChars += size;
+
+  return true;
+} /* VixStringArena_append */
+
+static PyObject *VixStringArena_toList(VixStringArena *arena) {
+  /* Builds a list of the arena's strings in one pass.  The GIL must be
+   * held. */
+  Py_ssize_t i;
+  PyObject *list = PyList_New(arena->nItems);
+  if (list == NULL) { return NULL; }
+
+  for (i = 0; i < arena->nItems; i++) {
+    size_t start = arena->starts[i];
+    size_t end = (i + 1 < arena->nItems ? arena->starts[i + 1] : arena->nChars);
+    PyObject *pyStr = PyString_FromStringAndSize(arena->chars + start,
+        (Py_ssize_t) (end - start - 1)
+      );
+    if (pyStr == NULL) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, pyStr);
+  }
+
+  return list;
+} /* VixStringArena_toList */
+
+/******************************** VixEventRing *******************************/
+
+/* Ring positions are unsigned longs that are allowed to wrap; a slot's seq is
+ * compared with a position only via their (signed) difference. */
+#define VixEventRing_DIFF(seq, pos) ((long) ((unsigned long) (seq) - (pos)))
+
+static VixEventRing *VixEventRing_new(void) {
+  /* The GIL need not be held. */
+  unsigned long i;
+  VixEventRing *ring = pyvix_slab_locked_malloc(&VixEventRing_slab);
+  if (ring == NULL) { return NULL; }
+
+  for (i = 0; i < VIX_EVENT_RING_CAPACITY; i++) {
+    ring->slots[i].seq = (long) i;
+  }
+  ring->tail = 0;
+  ring->head = 0;
+
+  if (PyVixEvent_init(&ring->pushed) != SUCCEEDED) {
+    pyvix_slab_locked_free(&VixEventRing_slab, ring);
+    return NULL;
+  }
+  ring->signalOnPush = 0;
+
+  PyVixMutex_init(&ring->overflowLock);
+  ring->nOverflowed = 0;
+  ring->nLost = 0;
+  ring->overflowHead = ring->overflowTail = NULL;
+
+  PyVixMutex_init(&ring->consumerLock);
+  VixStringArena_init(&ring->collected);
+  ring->firstErr = VIX_OK;
+
+  return ring;
+} /* VixEventRing_new */
+
+static void VixEventRing_push(VixEventRing *ring, const VixEventRecord *rec) {
+  /* Called by any number of producers concurrently, without the GIL.  Never
+   * waits for the consumer. */
+  unsigned long pos = (unsigned long) PyVixAtomic_load(&ring->tail);
+  VixEventRingSlot *slot;
+  VixEventRecord *spilled;
+
+  for (;;) {
+    long dif;
+
+    slot = &ring->slots[pos & (VIX_EVENT_RING_CAPACITY - 1)];
+    dif = VixEventRing_DIFF(PyVixAtomic_load(&slot->seq), pos);
+    if (dif == 0) {
+      /* The slot is free; try to claim it: */
+      if (PyVixAtomic_compareAndSwap(&ring->tail, (long) pos,
+            (long) (pos + 1)
+          ))
+      {
+        slot->rec = *rec;
+        /* Publish the record to the consumer: */
+        PyVixAtomic_store(&slot->seq, (long) (pos + 1));
+        goto published;
+      }
+      pos = (unsigned long) PyVixAtomic_load(&ring->tail);
+    } else if (dif < 0) {
+      /* The ring is full: */
+      break;
+    } else {
+      /* Another producer claimed pos first: */
+      pos = (unsigned long) PyVixAtomic_load(&ring->tail);
+    }
+  }
+
+  spilled = pyvix_slab_locked_malloc(&VixEventRecord_spillSlab);
+  if (spilled == NULL) {
+    /* The consumer will report that events were lost: */
+    PyVixAtomic_increment(&ring->nLost);
+    if (rec->str != NULL) { pyvix_vix_buffer_free(rec->str); }
+    return;
+  }
+  *spilled = *rec;
+  spilled->next = NULL;
+
+  PyVixMutex_lock(&ring->overflowLock);
+  if (ring->overflowTail == NULL) {
+    ring->overflowHead = ring->overflowTail = spilled;
+  } else {
+    ring->overflowTail->next = spilled;
+    ring->overflowTail = spilled;
+  }
+  PyVixMutex_unlock(&ring->overflowLock);
+  PyVixAtomic_increment(&ring->nOverflowed);
+
+  published:
+    if (PyVixAtomic_load(&ring->signalOnPush)) {
+      PyVixEvent_signal(&ring->pushed);
+    }
+} /* VixEventRing_push */
+
+static int VixEventRing_pop(VixEventRing *ring, VixEventRecord *out, int n) {
+  /* Moves up to n records into out, returning the number moved.  Must only be
+   * called by the consumer (the holder of consumerLock, or the last owner of
+   * the ring). */
+  int nPopped = 0;
+
+  while (nPopped < n) {
+    VixEventRingSlot *slot =
+      &ring->slots[ring->head & (VIX_EVENT_RING_CAPACITY - 1)];
+    if (VixEventRing_DIFF(PyVixAtomic_load(&slot->seq), ring->head + 1) < 0) {
+      /* Either empty, or the producer that claimed this slot hasn't yet
+       * published it: */
+      break;
+    }
+    out[nPopped++] = slot->rec;
+    /* Hand the slot back to producers, one lap later: */
+    PyVixAtomic_store(&slot->seq,
+        (long) (ring->head + VIX_EVENT_RING_CAPACITY)
+      );
+    ring->head++;
+  }
+
+  if (nPopped < n && PyVixAtomic_load(&ring->nOverflowed) != 0) {
+    VixEventRecord *spilled = NULL;
+
+    PyVixMutex_lock(&ring->overflowLock);
+    while (nPopped < n && ring->overflowHead != NULL) {
+      spilled = ring->overflowHead;
+      ring->overflowHead = spilled->next;
+      if (ring->overflowHead == NULL) { ring->overflowTail = NULL; }
+
+      out[nPopped++] = *spilled;
+      pyvix_slab_locked_free(&VixEventRecord_spillSlab, spilled);
+      PyVixAtomic_decrement(&ring->nOverflowed);
+    }
+    PyVixMutex_unlock(&ring->overflowLock);
+  }
+
+  return nPopped;
+} /* VixEventRing_pop */
+
+static void VixEventRing_collectLocked(VixEventRing *ring) {
+  /* Moves every record that has been published so far into ring->collected.
+   * The caller must hold ring->consumerLock; the GIL need not be held. */
+  VixEventRecord batch[64];
+  int i, n;
+
+  while ((n = VixEventRing_pop(ring, batch, 64)) > 0) {
+    for (i = 0; i < n; i++) {
+      VixEventRecord *rec = &batch[i];
+
+      if (VIX_FAILED(rec->err)) {
+        if (ring->firstErr == VIX_OK) { ring->firstErr = rec->err; }
+      } else if (!VixStringArena_append(&ring->collected, rec->str)) {
+        PyVixAtomic_increment(&ring->nLost);
+      }
+
+      if (rec->str != NULL) { pyvix_vix_buffer_free(rec->str); }
+    }
+  }
+} /* VixEventRing_collectLocked */
+
+static void VixEventRing_collect(VixEventRing *ring) {
+  /* The GIL need not be held. */
+  PyVixMutex_lock(&ring->consumerLock);
+  VixEventRing_collectLocked(ring);
+  PyVixMutex_unlock(&ring->consumerLock);
+} /* VixEventRing_collect */
+
+static void VixEventRing_free(VixEventRing *ring) {
+  /* Discards any records that were never consumed.  The GIL need not be
+   * held, but no producer may still be using the ring. */
+  VixEventRing_collectLocked(ring);
+  VixStringArena_clear(&ring->collected);
+
+  PyVixMutex_destroy(&ring->consumerLock);
+  PyVixMutex_destroy(&ring->overflowLock);
+  PyVixEvent_destroy(&ring->pushed);
+  pyvix_slab_locked_free(&VixEventRing_slab, ring);
+} /* VixEventRing_free */
+
+/*************************** VixCallbackAccumulator **************************/
+
 static status VixCallbackAccumulator_ListInit(VixCallbackAccumulator *acc) {
   assert (acc != NULL);
 
+  acc->ring = NULL;
   acc->target = PyList_New(0);
   if (acc->target == NULL) { goto fail; }
 
+  acc->ring = VixEventRing_new();
+  if (acc->ring == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
   return SUCCEEDED;
   fail:
     assert (PyErr_Occurred());
+    Py_CLEAR(acc->target);
     return FAILED;
 } /* VixCallbackAccumulator_ListInit */
 
 static status VixCallbackAccumulator_TupleInit(VixCallbackAccumulator *acc, unsigned int items) {
   assert (acc != NULL);
 
+  acc->ring = NULL;
   acc->target = PyTuple_New(items);
   if (acc->target == NULL) { goto fail; }
 
@@ -34,43 +309,121 @@ static status VixCallbackAccumulator_clear(VixCallbackAccumulator *acc) {
   assert (acc != NULL);
 
   Py_CLEAR(acc->target);
+  if (acc->ring != NULL) {
+    VixEventRing_free(acc->ring);
+    acc->ring = NULL;
+  }
 
   return SUCCEEDED;
 } /* VixCallbackAccumulator_clear */
 
-static void VixCallback_accumulateStringList(VixHandle jobH,
-    VixEventType eventType, VixHandle eventInfo, void *clientData
+static PyObject *VixCallbackAccumulator_takeCollected(
+    VixCallbackAccumulator *acc
   )
 {
-  PyGILState_STATE gstate;
-  PyObject *pyStr = NULL;
-  /* Note:  clientData is typically a pointer to memory on another thread's
-   * stack, so it's imperative that we refrain from accessing it IN ANY WAY
-   * (even just to cast it to VixCallbackAccumulator *acc) until we're sure
-   * that the other thread is still waiting for this thread to finish. */
-  VixCallbackAccumulator *acc = NULL;
+  /* Returns a new list of the items that VIX's worker threads have reported
+   * since the previous call, or raises the first error that any of them
+   * encountered (errors are sticky).  The GIL must be held; it's never waited
+   * for by a holder of consumerLock, so taking that lock here is safe. */
+  VixEventRing *ring;
+  VixStringArena taken;
+  VixError err;
+  PyObject *list;
 
-  /* Ignore event types that don't indicate that an item has been found: */
-  if (eventType != VIX_EVENTTYPE_FIND_ITEM) { return; }
+  assert (acc != NULL);
+  assert (acc->ring != NULL);
+  ring = acc->ring;
 
-  ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  PyVixMutex_lock(&ring->consumerLock);
+  VixEventRing_collectLocked(ring);
+  taken = ring->collected;
+  VixStringArena_init(&ring->collected);
+  err = ring->firstErr;
+  PyVixMutex_unlock(&ring->consumerLock);
+
+  if (VIX_FAILED(err)) {
+    autoRaiseVIXError(err);
+    goto fail;
+  }
+  if (PyVixAtomic_load(&ring->nLost) != 0) {
+    raiseNonNumericVIXError(VIXInternalError,
+        "Some VIX events were lost for lack of memory."
+      );
+    goto fail;
+  }
+
+  list = VixStringArena_toList(&taken);
+  if (list == NULL) { goto fail; }
+
+  VixStringArena_clear(&taken);
+  return list;
+  fail:
+    assert (PyErr_Occurred());
+    VixStringArena_clear(&taken);
+    return NULL;
+} /* VixCallbackAccumulator_takeCollected */
+
+static status VixCallbackAccumulator_flush(VixCallbackAccumulator *acc) {
+  /* Appends the items reported so far to acc->target.  The GIL must be
+   * held. */
+  PyObject *items;
+  Py_ssize_t nTarget;
 
-  acc = (VixCallbackAccumulator *) clientData;
-  assert (acc != NULL);
   assert (acc->target != NULL);
   assert (PyList_CheckExact(acc->target));
 
-  assert (eventInfo != VIX_INVALID_HANDLE);
-  pyStr = pyf_extractProperty(eventInfo, VIX_PROPERTY_FOUND_ITEM_LOCATION);
-  if (pyStr == NULL) { goto fail; }
+  items = VixCallbackAccumulator_takeCollected(acc);
+  if (items == NULL) { goto fail; }
 
-  if (PyList_Append(acc->target, pyStr) != 0) { goto fail; }
+  nTarget = PyList_GET_SIZE(acc->target);
+  if (nTarget == 0) {
+    /* The usual case:  the whole result was collected at once. */
+    Py_DECREF(acc->target);
+    acc->target = items;
+  } else {
+    int setRes = PyList_SetSlice(acc->target, nTarget, nTarget, items);
+    Py_DECREF(items);
+    if (setRes != 0) { goto fail; }
+  }
 
-  goto cleanup;
+  return SUCCEEDED;
   fail:
     assert (PyErr_Occurred());
-    /* Fall through to cleanup: */
-  cleanup:
-    Py_XDECREF(pyStr);
-    LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+    return FAILED;
+} /* VixCallbackAccumulator_flush */
+
+static void VixCallback_accumulateStringList(VixHandle jobH,
+    VixEventType eventType, VixHandle eventInfo, void *clientData
+  )
+{
+  /* Runs on a VIX worker thread.  Rather than acquiring the GIL for every
+   * event (which would serialize VIX's threads behind whatever Python happens
+   * to be doing), it extracts the item's location as a C string and pushes it
+   * into the accumulator's ring, to be collected later (also without the GIL)
+   * into the ring's arena.
+   * The caller must guarantee that the accumulator outlives the job (for
+   * Jobs, VIX's reference to the JobCompletion does so). */
+  VixCallbackAccumulator *acc = (VixCallbackAccumulator *) clientData;
+  VixEventRecord rec;
+
+  /* Ignore event types that don't indicate that an item has been found: */
+  if (eventType != VIX_EVENTTYPE_FIND_ITEM) { return; }
+
+  assert (acc != NULL);
+  assert (acc->ring != NULL);
+  assert (eventInfo != VIX_INVALID_HANDLE);
+
+  rec.eventType = eventType;
+  rec.str = NULL;
+  rec.next = NULL;
+  rec.err = Vix_GetProperties(eventInfo,
+      VIX_PROPERTY_FOUND_ITEM_LOCATION, &rec.str,
+      VIX_PROPERTY_NONE
+    );
+  if (VIX_FAILED(rec.err) && rec.str != NULL) {
+    pyvix_vix_buffer_free(rec.str);
+    rec.str = NULL;
+  }
+
+  VixEventRing_push(acc->ring, &rec);
 } /* VixCallback_accumulateStringList */
@@ -0,0 +1,453 @@
+/******************************************************************************
+ * pyvix - Implementation of CompletionQueue Class
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* A CompletionQueue collects Jobs as they finish, so that a single thread can
+ * keep many jobs in flight without dedicating a thread to each:
+ *   - q.add(job) asks that job be posted to q once it completes;
+ *   - q.fileno() is a descriptor that's readable whenever q is nonempty, for
+ *     use with select/poll/epoll or any event loop;
+ *   - q.drain(max_n) removes and returns (up to max_n of) the finished Jobs.
+ *
+ * Posting happens on VIX's worker threads, without the GIL; see
+ * CompletionPort in _vixmodule.h. */
+
+#ifdef _WIN32
+  #include <io.h>
+  #include <fcntl.h>
+  #define pyvix_pipe(fds)   _pipe(fds, 256, _O_BINARY)
+  #define pyvix_read        _read
+  #define pyvix_write       _write
+  #define pyvix_close       _close
+#else
+  #include <unistd.h>
+  #define pyvix_pipe(fds)   pipe(fds)
+  #define pyvix_read        read
+  #define pyvix_write       write
+  #define pyvix_close       close
+#endif
+
+/* Every batch of jobs uses a CompletionPort of its own, and the last
+ * reference to a port may be dropped by one of VIX's threads: */
+static PyVixSlab CompletionPort_slab;
+
+static status initSupport_CompletionQueue(void) {
+  /* CompletionQueueType is a new-style class, so PyType_Ready must be called
+   * before its getters and setters will function. */
+  if (PyType_Ready(&CompletionQueueType) < 0) { goto fail; }
+
+  PyVixSlab_init(&CompletionPort_slab, "CompletionPort",
+      sizeof(CompletionPort), 16, true
+    );
+
+  return SUCCEEDED;
+  fail:
+    /* This function is indirectly called by the module loader, which makes no
+     * provision for error recovery. */
+    return FAILED;
+} /* initSupport_CompletionQueue */
+
+/*************************** CompletionPort **********************************/
+
+static CompletionPort *CompletionPort_new(void) {
+  /* The GIL need not be held. */
+  CompletionPort *port = pyvix_slab_locked_malloc(&CompletionPort_slab);
+  if (port == NULL) { return NULL; }
+
+  if (PyVixEvent_init(&port->nonEmpty) != SUCCEEDED) {
+    pyvix_slab_locked_free(&CompletionPort_slab, port);
+    return NULL;
+  }
+  if (pyvix_pipe(port->pipeFDs) != 0) {
+    PyVixEvent_destroy(&port->nonEmpty);
+    pyvix_slab_locked_free(&CompletionPort_slab, port);
+    return NULL;
+  }
+  PyVixMutex_init(&port->lock);
+
+  port->refCount = 1;
+  port->closed = false;
+  port->head = port->tail = NULL;
+  port->nPending = 0;
+  port->pipeSignalled = false;
+
+  return port;
+} /* CompletionPort_new */
+
+static void CompletionPort_addRef(CompletionPort *port) {
+  PyVixMutex_lock(&port->lock);
+  ++port->refCount;
+  PyVixMutex_unlock(&port->lock);
+} /* CompletionPort_addRef */
+
+static void CompletionPort_release(CompletionPort *port) {
+  /* The GIL need not be held.  Once the port has been closed, nothing is ever
+   * posted to it, so there are no pending jobs left to dispose of here. */
+  bool isLast;
+
+  PyVixMutex_lock(&port->lock);
+  isLast = (--port->refCount == 0);
+  PyVixMutex_unlock(&port->lock);
+  if (!isLast) { return; }
+
+  assert (port->closed);
+  assert (port->head == NULL);
+
+  pyvix_close(port->pipeFDs[0]);
+  pyvix_close(port->pipeFDs[1]);
+  PyVixEvent_destroy(&port->nonEmpty);
+  PyVixMutex_destroy(&port->lock);
+  pyvix_slab_locked_free(&CompletionPort_slab, port);
+} /* CompletionPort_release */
+
+static bool CompletionPort_post(CompletionPort *port, JobCompletion *jc) {
+  /* Appends jc (whose portJob the port thereby takes over) to the port's
+   * pending list.  Returns false if the port has been closed, in which case
+   * the caller retains responsibility for jc->portJob.  The GIL need not be
+   * held. */
+  PyVixMutex_lock(&port->lock);
+  if (port->closed) {
+    PyVixMutex_unlock(&port->lock);
+    return false;
+  }
+
+  jc->portNext = NULL;
+  if (port->tail == NULL) {
+    port->head = port->tail = jc;
+  } else {
+    port->tail->portNext = jc;
+    port->tail = jc;
+  }
+  ++port->nPending;
+
+  PyVixEvent_signal(&port->nonEmpty);
+  if (!port->pipeSignalled) {
+    /* A single byte suffices to make the read end readable; it's consumed
+     * when the port is drained empty. */
+    const char b = 0;
+    if (pyvix_write(port->pipeFDs[1], &b, 1) == 1) {
+      port->pipeSignalled = true;
+    }
+  }
+  PyVixMutex_unlock(&port->lock);
+
+  return true;
+} /* CompletionPort_post */
+
+static JobCompletion *CompletionPort_takeLocked(CompletionPort *port,
+    Py_ssize_t maxN
+  )
+{
+  /* Detaches (up to maxN, or all if maxN is negative) pending entries and
+   * returns them as a portNext-linked chain.  port->lock must be held. */
+  JobCompletion *first = port->head;
+  JobCompletion *last = NULL;
+  Py_ssize_t n = 0;
+
+  if (first == NULL) { return NULL; }
+
+  last = first;
+  for (n = 1; last->portNext != NULL && (maxN < 0 || n < maxN); n++) {
+    last = last->portNext;
+  }
+
+  port->head = last->portNext;
+  if (port->head == NULL) { port->tail = NULL; }
+  last->portNext = NULL;
+  port->nPending -= n;
+
+  if (port->head == NULL) {
+    PyVixEvent_reset(&port->nonEmpty);
+    if (port->pipeSignalled) {
+      char b;
+      if (pyvix_read(port->pipeFDs[0], &b, 1) == 1) {
+        port->pipeSignalled = false;
+      }
+    }
+  }
+
+  return first;
+} /* CompletionPort_takeLocked */
+
+static PyObject *CompletionPort_drain(CompletionPort *port, Py_ssize_t maxN,
+    long timeoutMillis
+  )
+{
+  /* Returns a list of up to maxN finished Jobs, waiting up to timeoutMillis
+   * (negative meaning "forever") for at least one if none is pending.  The
+   * GIL must be held; it's released during the wait. */
+  PyObject *jobs = NULL;
+  JobCompletion *chain;
+
+  PyVixMutex_lock(&port->lock);
+  if (port->head == NULL && timeoutMillis != 0) {
+    PyVixMutex_unlock(&port->lock);
+    LEAVE_PYTHON
+    PyVixEvent_wait(&port->nonEmpty, timeoutMillis);
+    ENTER_PYTHON
+    PyVixMutex_lock(&port->lock);
+  }
+  chain = CompletionPort_takeLocked(port, maxN);
+  PyVixMutex_unlock(&port->lock);
+
+  jobs = PyList_New(0);
+  if (jobs == NULL) { goto fail; }
+
+  while (chain != NULL) {
+    JobCompletion *jc = chain;
+    PyObject *job = jc->portJob;
+    int appendRes;
+
+    /* Unlink before dropping our reference to the Job, which owns jc: */
+    chain = jc->portNext;
+    jc->portNext = NULL;
+    jc->portJob = NULL;
+
+    appendRes = (jobs == NULL ? -1 : PyList_Append(jobs, job));
+    Py_DECREF(job);
+    if (appendRes != 0) { Py_CLEAR(jobs); }
+  }
+
+  if (jobs == NULL) { goto fail; }
+  return jobs;
+  fail:
+    assert (PyErr_Occurred());
+    /* Jobs already detached from the port can't be put back, but they've
+     * been released rather than leaked. */
+    while (chain != NULL) {
+      JobCompletion *jc = chain;
+      PyObject *job = jc->portJob;
+      chain = jc->portNext;
+      jc->portNext = NULL;
+      jc->portJob = NULL;
+      Py_DECREF(job);
+    }
+    return NULL;
+} /* CompletionPort_drain */
+
+static void CompletionPort_close(CompletionPort *port) {
+  /* Stops the port from accepting further posts, releases the jobs that are
+   * still pending, then drops the caller's reference.  The GIL must be
+   * held. */
+  JobCompletion *chain;
+
+  PyVixMutex_lock(&port->lock);
+  port->closed = true;
+  chain = CompletionPort_takeLocked(port, -1);
+  PyVixMutex_unlock(&port->lock);
+
+  while (chain != NULL) {
+    JobCompletion *jc = chain;
+    PyObject *job = jc->portJob;
+    chain = jc->portNext;
+    jc->portNext = NULL;
+    jc->portJob = NULL;
+    /* Ports used internally (by Batch_run) don't hold Job references: */
+    Py_XDECREF(job);
+  }
+
+  CompletionPort_release(port);
+} /* CompletionPort_close */
+
+/*************************** CompletionQueue *********************************/
+
+static PyObject *pyf_CompletionQueue_new(
+    PyTypeObject *subtype, PyObject *args, PyObject *kwargs
+  )
+{
+  CompletionQueue *self = (CompletionQueue *) subtype->tp_alloc(subtype, 0);
+  if (self == NULL) { goto fail; }
+
+  self->port = CompletionPort_new();
+  if (self->port == NULL) {
+    PyErr_SetFromErrno(PyExc_OSError);
+    goto fail;
+  }
+
+  return (PyObject *) self;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(self);
+    return NULL;
+} /* pyf_CompletionQueue_new */
+
+static void pyf_CompletionQueue___del__(CompletionQueue *self) {
+  if (self->port != NULL) {
+    CompletionPort_close(self->port);
+    self->port = NULL;
+  }
+
+  /* Release the CompletionQueue struct itself: */
+  self->ob_type->tp_free((PyObject *) self);
+} /* pyf_CompletionQueue___del__ */
+
+static status CompletionQueue_addJob(CompletionQueue *self, Job *job) {
+  /* Arranges for job to be posted to self upon completion (or posts it right
+   * away if it has already completed).  The GIL must be held. */
+  JobCompletion *jc = job->completion;
+  bool alreadyCompleted;
+
+  PyVixMutex_lock(&jc->lock);
+  if (jc->port != NULL || jc->portJob != NULL) {
+    PyVixMutex_unlock(&jc->lock);
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The Job has already been added to a CompletionQueue."
+      );
+    return FAILED;
+  }
+
+  Py_INCREF(job);
+  jc->portJob = (PyObject *) job;
+  alreadyCompleted = jc->completed;
+  if (!alreadyCompleted) {
+    /* JobCompletion_complete will post the job and release this
+     * reference: */
+    CompletionPort_addRef(self->port);
+    jc->port = self->port;
+  }
+  PyVixMutex_unlock(&jc->lock);
+
+  if (alreadyCompleted) {
+    /* self is alive, so its port can't have been closed: */
+    if (!CompletionPort_post(self->port, jc)) {
+      raiseNonNumericVIXError(VIXInternalError,
+          "CompletionQueue's port was closed while the queue was alive."
+        );
+      return FAILED;
+    }
+  }
+
+  return SUCCEEDED;
+} /* CompletionQueue_addJob */
+
+static PyObject *pyf_CompletionQueue_add(CompletionQueue *self,
+    PyObject *args
+  )
+{
+  Job *job;
+
+  if (!PyArg_ParseTuple(args, "O!", &JobType, &job)) { return NULL; }
+  if (CompletionQueue_addJob(self, job) != SUCCEEDED) { return NULL; }
+
+  Py_RETURN_NONE;
+} /* pyf_CompletionQueue_add */
+
+static PyObject *pyf_CompletionQueue_drain(CompletionQueue *self,
+    PyObject *args, PyObject *kwargs
+  )
+{
+  static char* kwarg_list[] = {"max_n", "timeout", NULL};
+  Py_ssize_t maxN = -1;
+  PyObject *pyTimeout = NULL;
+  long timeoutMillis = 0;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+       "|" Py_ssize_t_EXTRACTION_CODE "O", kwarg_list,
+       &maxN, &pyTimeout
+     ))
+  { return NULL; }
+
+  /* Unlike Job.wait, drain doesn't block unless asked to: */
+  if (pyTimeout != NULL) {
+    timeoutMillis = timeoutMillisFromPython(pyTimeout);
+    if (timeoutMillis == -2) { return NULL; }
+  }
+
+  return CompletionPort_drain(self->port, maxN, timeoutMillis);
+} /* pyf_CompletionQueue_drain */
+
+static PyObject *pyf_CompletionQueue_fileno(CompletionQueue *self) {
+  return PyInt_FromLong(self->port->pipeFDs[0]);
+} /* pyf_CompletionQueue_fileno */
+
+static PyObject *pyf_CompletionQueue_pending_get(CompletionQueue *self,
+    void *closure
+  )
+{
+  Py_ssize_t nPending;
+
+  PyVixMutex_lock(&self->port->lock);
+  nPending = self->port->nPending;
+  PyVixMutex_unlock(&self->port->lock);
+
+  return PyInt_FromSsize_t(nPending);
+} /* pyf_CompletionQueue_pending_get */
+
+static PyMethodDef CompletionQueue_methods[] = {
+    {"add",
+        (PyCFunction) pyf_CompletionQueue_add,
+        METH_VARARGS
+      },
+    {"drain",
+        (PyCFunction) pyf_CompletionQueue_drain,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"fileno",
+        (PyCFunction) pyf_CompletionQueue_fileno,
+        METH_NOARGS
+      },
+    {NULL}  /* sentinel */
+  };
+
+static PyGetSetDef CompletionQueue_getters_setters[] = {
+    {"pending",
+        (getter) pyf_CompletionQueue_pending_get,
+        NULL,
+        "The number of finished Jobs waiting to be drained."
+      },
+    {NULL}  /* sentinel */
+  };
+
+PyTypeObject CompletionQueueType = { /* new-style class */
+    PyObject_HEAD_INIT(NULL)
+    0,                                  /* ob_size */
+    "pyvix.vix.CompletionQueue",        /* tp_name */
+    sizeof(CompletionQueue),            /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) pyf_CompletionQueue___del__, /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+                                        /* tp_flags */
+    0,                                  /* tp_doc */
+    0,		                              /* tp_traverse */
+    0,		                              /* tp_clear */
+    0,		                              /* tp_richcompare */
+    0,		                              /* tp_weaklistoffset */
+
+    0,                    		          /* tp_iter */
+    0,		                              /* tp_iternext */
+
+    CompletionQueue_methods,            /* tp_methods */
+    NULL,                               /* tp_members */
+    CompletionQueue_getters_setters,    /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    pyf_CompletionQueue_new,            /* tp_new */
+    0,                                  /* tp_free */
+    0,                                  /* tp_is_gc */
+    0,                                  /* tp_bases */
+    0,                                  /* tp_mro */
+    0,                                  /* tp_cache */
+    0,                                  /* tp_subclasses */
+    0                                   /* tp_weaklist */
+  };
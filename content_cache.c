@@ -0,0 +1,752 @@
+/******************************************************************************
+ * pyvix - Per-VM Content Cache
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Each VM keeps a ContentCache:  a record of the SHA-256 digest of every file
+ * that a hashed copy (VM.copyFileFromHostToGuest with dedupe=True, or
+ * VM.syncToGuest) has put into the guest, keyed by guest path.  A hashed copy
+ * whose source matches what the record says the destination already holds is
+ * skipped.
+ *
+ * The record is kept honest by the operations that pyvix itself performs:
+ *   - any other copy into the guest, a pipeline's 'delete' step, and a packed
+ *     transfer forget the paths they touch as soon as they're submitted;
+ *   - a successful hashed copy records its digest once VIX reports on it;
+ *   - taking a snapshot saves a copy of the record under the snapshot's name,
+ *     and reverting to a snapshot replaces the record with the saved copy (or
+ *     with an empty record, if there is none);  removing a snapshot drops its
+ *     copy.  Snapshots have no identity other than their names, which VIX
+ *     doesn't require to be unique, so nothing is saved for an unnamed
+ *     snapshot, nor for a name that more than one snapshot has been taken
+ *     under.
+ * Changes made by the guest itself (or by programs run in it) are not seen,
+ * so VM.clearContentCache should be called after any of those that might
+ * touch synced files.  Paths are compared exactly as they were given.
+ *
+ * Updates that depend on a job's outcome ride on its JobCompletion, just as
+ * admission slots do (see JobCompletion_complete), so that they're applied by
+ * whichever thread learns of the outcome, without the GIL. */
+
+#define CONTENT_RECORD_INITIAL_BUCKETS 64
+#define CONTENT_HASH_BUFFER_SIZE (64 * 1024)
+
+/********************************* SHA-256 ***********************************/
+
+typedef struct {
+  uint32 state[8];
+  uint64 nBytes;
+  unsigned char block[64];
+  size_t blockLen;
+} Sha256;
+
+static const uint32 Sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void Sha256_init(Sha256 *h) {
+  h->state[0] = 0x6a09e667;
+  h->state[1] = 0xbb67ae85;
+  h->state[2] = 0x3c6ef372;
+  h->state[3] = 0xa54ff53a;
+  h->state[4] = 0x510e527f;
+  h->state[5] = 0x9b05688c;
+  h->state[6] = 0x1f83d9ab;
+  h->state[7] = 0x5be0cd19;
+  h->nBytes = 0;
+  h->blockLen = 0;
+} /* Sha256_init */
+
+static void Sha256_compress(Sha256 *h, const unsigned char *block) {
+  uint32 w[64];
+  uint32 a, b, c, d, e, f, g, x;
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = ((uint32) block[i * 4] << 24) | ((uint32) block[i * 4 + 1] << 16)
+      | ((uint32) block[i * 4 + 2] << 8) | (uint32) block[i * 4 + 3];
+  }
+  for (i = 16; i < 64; i++) {
+    const uint32 s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18)
+      ^ (w[i - 15] >> 3);
+    const uint32 s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19)
+      ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  a = h->state[0]; b = h->state[1]; c = h->state[2]; d = h->state[3];
+  e = h->state[4]; f = h->state[5]; g = h->state[6]; x = h->state[7];
+  for (i = 0; i < 64; i++) {
+    const uint32 t1 = x
+      + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25))
+      + ((e & f) ^ (~e & g)) + Sha256_k[i] + w[i];
+    const uint32 t2 =
+        (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22))
+      + ((a & b) ^ (a & c) ^ (b & c));
+    x = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  h->state[0] += a; h->state[1] += b; h->state[2] += c; h->state[3] += d;
+  h->state[4] += e; h->state[5] += f; h->state[6] += g; h->state[7] += x;
+} /* Sha256_compress */
+
+static void Sha256_update(Sha256 *h, const unsigned char *data, size_t len) {
+  h->nBytes += len;
+
+  if (h->blockLen > 0) {
+    const size_t n = (len < 64 - h->blockLen ? len : 64 - h->blockLen);
+    memcpy(h->block + h->blockLen, data, n);
+    h->blockLen += n;
+    data += n;
+    len -= n;
+    if (h->blockLen < 64) { return; }
+    Sha256_compress(h, h->block);
+    h->blockLen = 0;
+  }
+  for (; len >= 64; data += 64, len -= 64) {
+    Sha256_compress(h, data);
+  }
+  memcpy(h->block, data, len);
+  h->blockLen = len;
+} /* Sha256_update */
+
+static void Sha256_final(Sha256 *h, unsigned char *digest) {
+  const uint64 nBits = h->nBytes * 8;
+  int i;
+
+  h->block[h->blockLen++] = 0x80;
+  if (h->blockLen > 56) {
+    memset(h->block + h->blockLen, 0, 64 - h->blockLen);
+    Sha256_compress(h, h->block);
+    h->blockLen = 0;
+  }
+  memset(h->block + h->blockLen, 0, 56 - h->blockLen);
+  for (i = 0; i < 8; i++) {
+    h->block[56 + i] = (unsigned char) (nBits >> (56 - i * 8));
+  }
+  Sha256_compress(h, h->block);
+
+  for (i = 0; i < 8; i++) {
+    digest[i * 4]     = (unsigned char) (h->state[i] >> 24);
+    digest[i * 4 + 1] = (unsigned char) (h->state[i] >> 16);
+    digest[i * 4 + 2] = (unsigned char) (h->state[i] >> 8);
+    digest[i * 4 + 3] = (unsigned char) h->state[i];
+  }
+} /* Sha256_final */
+
+static bool ContentCache_hashFile(const char *path, unsigned char *digest,
+    int64 *bytes
+  )
+{
+  /* Computes the digest of the host file at path, and its size; returns false
+   * if the file couldn't be read.  The GIL need not be held (and shouldn't
+   * be, since the file may be large). */
+  Sha256 h;
+  unsigned char *buf;
+  size_t n;
+  bool ok;
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) { return false; }
+
+  buf = pyvix_plain_malloc(CONTENT_HASH_BUFFER_SIZE);
+  if (buf == NULL) {
+    fclose(f);
+    return false;
+  }
+
+  Sha256_init(&h);
+  while ((n = fread(buf, 1, CONTENT_HASH_BUFFER_SIZE, f)) > 0) {
+    Sha256_update(&h, buf, n);
+  }
+  ok = !ferror(f);
+  fclose(f);
+  pyvix_plain_free(buf);
+
+  if (ok) {
+    *bytes = (int64) h.nBytes;
+    Sha256_final(&h, digest);
+  }
+  return ok;
+} /* ContentCache_hashFile */
+
+/* A guest directory that a sync has created is recorded with this digest,
+ * which no file's content can have (in practice): */
+static const unsigned char ContentCache_directoryDigest[CONTENT_DIGEST_SIZE];
+
+/****************************** ContentRecord ********************************/
+
+static void ContentRecord_init(ContentRecord *r) {
+  r->buckets = NULL;
+  r->nBuckets = 0;
+  r->nEntries = 0;
+} /* ContentRecord_init */
+
+static size_t ContentRecord_hashPath(const char *guestPath) {
+  /* FNV-1a: */
+  uint32 hash = 2166136261U;
+  for (; *guestPath != '\0'; guestPath++) {
+    hash = (hash ^ (unsigned char) *guestPath) * 16777619U;
+  }
+  return (size_t) hash;
+} /* ContentRecord_hashPath */
+
+static ContentRecordEntry **ContentRecord_link(const ContentRecord *r,
+    const char *guestPath
+  )
+{
+  /* Returns the link that points to guestPath's entry, or else the null link
+   * at the end of its bucket.  r must have buckets. */
+  ContentRecordEntry **link =
+    &r->buckets[ContentRecord_hashPath(guestPath) & (r->nBuckets - 1)];
+  while (*link != NULL && strcmp((*link)->guestPath, guestPath) != 0) {
+    link = &(*link)->next;
+  }
+  return link;
+} /* ContentRecord_link */
+
+static bool ContentRecord_grow(ContentRecord *r) {
+  const size_t newNBuckets = (r->nBuckets == 0
+      ? CONTENT_RECORD_INITIAL_BUCKETS : r->nBuckets * 2
+    );
+  ContentRecordEntry **newBuckets = pyvix_plain_malloc(
+      sizeof(ContentRecordEntry *) * newNBuckets
+    );
+  size_t i;
+
+  if (newBuckets == NULL) { return false; }
+  memset(newBuckets, 0, sizeof(ContentRecordEntry *) * newNBuckets);
+  for (i = 0; i < r->nBuckets; i++) {
+    ContentRecordEntry *e = r->buckets[i];
+    while (e != NULL) {
+      ContentRecordEntry *next = e->next;
+      const size_t b = ContentRecord_hashPath(e->guestPath)
+        & (newNBuckets - 1);
+      e->next = newBuckets[b];
+      newBuckets[b] = e;
+      e = next;
+    }
+  }
+  if (r->buckets != NULL) { pyvix_plain_free(r->buckets); }
+  r->buckets = newBuckets;
+  r->nBuckets = newNBuckets;
+
+  return true;
+} /* ContentRecord_grow */
+
+static bool ContentRecord_lookup(const ContentRecord *r,
+    const char *guestPath, unsigned char *digest
+  )
+{
+  /* Copies the digest recorded for guestPath into digest, and returns
+   * whether there was one. */
+  ContentRecordEntry *e;
+
+  if (r->nEntries == 0) { return false; }
+  e = *ContentRecord_link(r, guestPath);
+  if (e == NULL) { return false; }
+  memcpy(digest, e->digest, CONTENT_DIGEST_SIZE);
+  return true;
+} /* ContentRecord_lookup */
+
+static bool ContentRecord_put(ContentRecord *r, const char *guestPath,
+    const unsigned char *digest
+  )
+{
+  /* Records that guestPath holds digest; returns false if memory ran out. */
+  ContentRecordEntry **link;
+  ContentRecordEntry *e;
+
+  if (r->nEntries >= r->nBuckets && !ContentRecord_grow(r)) { return false; }
+
+  link = ContentRecord_link(r, guestPath);
+  if (*link != NULL) {
+    memcpy((*link)->digest, digest, CONTENT_DIGEST_SIZE);
+    return true;
+  }
+
+  e = pyvix_plain_malloc(sizeof(ContentRecordEntry));
+  if (e == NULL) { return false; }
+  e->guestPath = pyvix_plain_malloc(strlen(guestPath) + 1);
+  if (e->guestPath == NULL) {
+    pyvix_plain_free(e);
+    return false;
+  }
+  strcpy(e->guestPath, guestPath);
+  memcpy(e->digest, digest, CONTENT_DIGEST_SIZE);
+  e->next = NULL;
+  *link = e;
+  r->nEntries++;
+
+  return true;
+} /* ContentRecord_put */
+
+static void ContentRecord_unlink(ContentRecord *r, ContentRecordEntry **link) {
+  ContentRecordEntry *e = *link;
+  *link = e->next;
+  pyvix_plain_free(e->guestPath);
+  pyvix_plain_free(e);
+  r->nEntries--;
+} /* ContentRecord_unlink */
+
+static void ContentRecord_remove(ContentRecord *r, const char *guestPath) {
+  ContentRecordEntry **link;
+
+  if (r->nEntries == 0) { return; }
+  link = ContentRecord_link(r, guestPath);
+  if (*link != NULL) { ContentRecord_unlink(r, link); }
+} /* ContentRecord_remove */
+
+static bool ContentRecord_isBeneath(const char *guestPath, const char *root,
+    size_t rootLen, char sep
+  )
+{
+  /* Returns whether guestPath is root itself or lies within it. */
+  if (strncmp(guestPath, root, rootLen) != 0) { return false; }
+  return (guestPath[rootLen] == '\0' || guestPath[rootLen] == sep
+      || (rootLen > 0 && root[rootLen - 1] == sep)
+    );
+} /* ContentRecord_isBeneath */
+
+static void ContentRecord_removeBeneath(ContentRecord *r, const char *root,
+    char sep
+  )
+{
+  /* Removes root, and everything within it, from r. */
+  const size_t rootLen = strlen(root);
+  size_t i;
+
+  for (i = 0; i < r->nBuckets && r->nEntries > 0; i++) {
+    ContentRecordEntry **link = &r->buckets[i];
+    while (*link != NULL) {
+      if (ContentRecord_isBeneath((*link)->guestPath, root, rootLen, sep)) {
+        ContentRecord_unlink(r, link);
+      } else {
+        link = &(*link)->next;
+      }
+    }
+  }
+} /* ContentRecord_removeBeneath */
+
+static void ContentRecord_clear(ContentRecord *r) {
+  size_t i;
+
+  for (i = 0; i < r->nBuckets; i++) {
+    while (r->buckets[i] != NULL) {
+      ContentRecord_unlink(r, &r->buckets[i]);
+    }
+  }
+  if (r->buckets != NULL) { pyvix_plain_free(r->buckets); }
+  ContentRecord_init(r);
+} /* ContentRecord_clear */
+
+static bool ContentRecord_copy(ContentRecord *dst, const ContentRecord *src) {
+  /* Fills dst, which must be empty, with src's entries; returns false (with
+   * dst left empty) if memory ran out. */
+  size_t i;
+
+  assert (dst->nEntries == 0);
+  for (i = 0; i < src->nBuckets; i++) {
+    const ContentRecordEntry *e;
+    for (e = src->buckets[i]; e != NULL; e = e->next) {
+      if (!ContentRecord_put(dst, e->guestPath, e->digest)) {
+        ContentRecord_clear(dst);
+        return false;
+      }
+    }
+  }
+  return true;
+} /* ContentRecord_copy */
+
+/******************************* ContentCache ********************************/
+
+static ContentCache *ContentCache_new(void) {
+  /* The GIL need not be held. */
+  ContentCache *cache = pyvix_plain_malloc(sizeof(ContentCache));
+  if (cache == NULL) { return NULL; }
+
+  PyVixMutex_init(&cache->lock);
+  cache->refCount = 1;
+  ContentRecord_init(&cache->current);
+  cache->snapshots = NULL;
+  cache->nHits = 0;
+  cache->nMisses = 0;
+  cache->bytesSkipped = 0;
+  cache->nReverts = 0;
+
+  return cache;
+} /* ContentCache_new */
+
+static void ContentCache_addRef(ContentCache *cache) {
+  PyVixMutex_lock(&cache->lock);
+  cache->refCount++;
+  PyVixMutex_unlock(&cache->lock);
+} /* ContentCache_addRef */
+
+static void ContentCache_clearSnapshotsLocked(ContentCache *cache) {
+  while (cache->snapshots != NULL) {
+    SnapshotContentRecord *s = cache->snapshots;
+    cache->snapshots = s->next;
+    ContentRecord_clear(&s->record);
+    pyvix_plain_free(s->snapshotName);
+    pyvix_plain_free(s);
+  }
+} /* ContentCache_clearSnapshotsLocked */
+
+static void ContentCache_release(ContentCache *cache) {
+  /* Drops one reference to cache, freeing it if that was the last.  The GIL
+   * need not be held. */
+  bool isLast;
+
+  PyVixMutex_lock(&cache->lock);
+  isLast = (--cache->refCount == 0);
+  PyVixMutex_unlock(&cache->lock);
+  if (!isLast) { return; }
+
+  ContentRecord_clear(&cache->current);
+  ContentCache_clearSnapshotsLocked(cache);
+  PyVixMutex_destroy(&cache->lock);
+  pyvix_plain_free(cache);
+} /* ContentCache_release */
+
+static SnapshotContentRecord **ContentCache_snapshotLinkLocked(
+    ContentCache *cache, const char *snapshotName
+  )
+{
+  /* Returns the link that points to the record saved for snapshotName, or
+   * else the null link at the end of the list. */
+  SnapshotContentRecord **link = &cache->snapshots;
+  while (*link != NULL && strcmp((*link)->snapshotName, snapshotName) != 0) {
+    link = &(*link)->next;
+  }
+  return link;
+} /* ContentCache_snapshotLinkLocked */
+
+static bool ContentCache_holds(ContentCache *cache, const char *guestPath,
+    const unsigned char *digest, int64 bytes
+  )
+{
+  /* Returns whether guestPath is known to hold digest already, counting the
+   * answer as a hit (of bytes) or a miss.  The GIL need not be held. */
+  unsigned char recorded[CONTENT_DIGEST_SIZE];
+  bool holds;
+
+  PyVixMutex_lock(&cache->lock);
+  holds = (ContentRecord_lookup(&cache->current, guestPath, recorded)
+      && memcmp(recorded, digest, CONTENT_DIGEST_SIZE) == 0
+    );
+  if (holds) {
+    cache->nHits++;
+    cache->bytesSkipped += bytes;
+  } else {
+    cache->nMisses++;
+  }
+  PyVixMutex_unlock(&cache->lock);
+
+  return holds;
+} /* ContentCache_holds */
+
+static void ContentCache_forget(ContentCache *cache, const char *guestPath) {
+  /* The GIL need not be held. */
+  PyVixMutex_lock(&cache->lock);
+  ContentRecord_remove(&cache->current, guestPath);
+  PyVixMutex_unlock(&cache->lock);
+} /* ContentCache_forget */
+
+static void ContentCache_forgetBeneath(ContentCache *cache,
+    const char *guestRoot, char guestSep
+  )
+{
+  /* Forgets guestRoot and everything within it.  The GIL need not be
+   * held. */
+  PyVixMutex_lock(&cache->lock);
+  ContentRecord_removeBeneath(&cache->current, guestRoot, guestSep);
+  PyVixMutex_unlock(&cache->lock);
+} /* ContentCache_forgetBeneath */
+
+static void ContentCache_clear(ContentCache *cache) {
+  /* Forgets everything, including the records saved for snapshots.  The GIL
+   * need not be held. */
+  PyVixMutex_lock(&cache->lock);
+  ContentRecord_clear(&cache->current);
+  ContentCache_clearSnapshotsLocked(cache);
+  PyVixMutex_unlock(&cache->lock);
+} /* ContentCache_clear */
+
+static void ContentCache_attach(ContentCache *cache, JobCompletion *jc,
+    ContentUpdateKind kind, const char *key, const unsigned char *digest
+  )
+{
+  /* Makes jc, which hasn't been passed to VIX yet, responsible for applying
+   * the update (kind, key, digest) to cache if the job succeeds.  If memory
+   * runs out, the update is silently dropped, which leaves the record no
+   * less accurate than forgetting would.  The GIL need not be held. */
+  assert (jc->contentCache == NULL);
+  jc->contentKey = pyvix_plain_malloc(strlen(key) + 1);
+  if (jc->contentKey == NULL) { return; }
+  strcpy(jc->contentKey, key);
+  jc->contentUpdate = kind;
+  if (digest != NULL) {
+    memcpy(jc->contentDigest, digest, CONTENT_DIGEST_SIZE);
+  }
+  ContentCache_addRef(cache);
+  jc->contentCache = cache;
+} /* ContentCache_attach */
+
+static void ContentCache_expectCopy(ContentCache *cache, JobCompletion *jc,
+    const char *guestPath, const unsigned char *digest
+  )
+{
+  /* To be called as the job of jc, which is about to copy a file to
+   * guestPath, is submitted.  The path is forgotten in the meantime; if
+   * digest isn't NULL, it's recorded once the copy has succeeded.  The GIL
+   * need not be held. */
+  ContentCache_forget(cache, guestPath);
+  if (digest != NULL) {
+    ContentCache_attach(cache, jc, CONTENT_UPDATE_STORED, guestPath, digest);
+  }
+} /* ContentCache_expectCopy */
+
+static char *ContentCache_snapshotName(VixHandle snapH) {
+  /* Returns (as a string allocated with pyvix_plain_malloc) the display name
+   * of the snapshot snapH, or NULL if it can't be had.  The GIL need not be
+   * held. */
+  char *vixName = NULL;
+  char *name;
+  VixError err = Vix_GetProperties(snapH,
+      VIX_PROPERTY_SNAPSHOT_DISPLAYNAME, &vixName,
+      VIX_PROPERTY_NONE
+    );
+  if (VIX_FAILED(err) || vixName == NULL) { return NULL; }
+
+  name = pyvix_plain_malloc(strlen(vixName) + 1);
+  if (name != NULL) { strcpy(name, vixName); }
+  Vix_FreeBuffer(vixName);
+  return name;
+} /* ContentCache_snapshotName */
+
+static void ContentCache_expectSnapshotOp(ContentCache *cache,
+    JobCompletion *jc, ContentUpdateKind kind, VixHandle snapH,
+    const char *snapshotName
+  )
+{
+  /* To be called as the job of jc, which is about to take, remove, or revert
+   * to a snapshot, is submitted.  The snapshot is identified by snapshotName,
+   * or failing that by snapH's display name.  A revert forgets everything in
+   * the meantime, as does one whose snapshot has no name to go by.  The GIL
+   * need not be held. */
+  char *name = NULL;
+
+  if (snapshotName == NULL && snapH != VIX_INVALID_HANDLE) {
+    name = ContentCache_snapshotName(snapH);
+    snapshotName = name;
+  }
+
+  if (kind == CONTENT_UPDATE_REVERTED) {
+    PyVixMutex_lock(&cache->lock);
+    ContentRecord_clear(&cache->current);
+    PyVixMutex_unlock(&cache->lock);
+  }
+  if (snapshotName != NULL) {
+    ContentCache_attach(cache, jc, kind, snapshotName, NULL);
+  }
+
+  if (name != NULL) { pyvix_plain_free(name); }
+} /* ContentCache_expectSnapshotOp */
+
+static void ContentCache_applyLocked(ContentCache *cache,
+    ContentUpdateKind kind, const char *key, const unsigned char *digest
+  )
+{
+  SnapshotContentRecord **link;
+
+  switch (kind) {
+    case CONTENT_UPDATE_STORED:
+      if (!ContentRecord_put(&cache->current, key, digest)) {
+        /* The copy's source must now be considered unknown: */
+        ContentRecord_remove(&cache->current, key);
+      }
+      break;
+
+    case CONTENT_UPDATE_SNAPSHOT_TAKEN: {
+      SnapshotContentRecord *s;
+      /* A revert to an unnamed snapshot finds no record, so forgets
+       * everything: */
+      if (*key == '\0') { break; }
+      link = ContentCache_snapshotLinkLocked(cache, key);
+      if (*link != NULL) {
+        /* Likewise a revert to either snapshot, since the name doesn't say
+         * which of them is meant: */
+        (*link)->ambiguous = true;
+        ContentRecord_clear(&(*link)->record);
+        break;
+      }
+
+      s = pyvix_plain_malloc(sizeof(SnapshotContentRecord));
+      if (s == NULL) { break; }
+      s->snapshotName = pyvix_plain_malloc(strlen(key) + 1);
+      if (s->snapshotName == NULL) {
+        pyvix_plain_free(s);
+        break;
+      }
+      strcpy(s->snapshotName, key);
+      s->ambiguous = false;
+      ContentRecord_init(&s->record);
+      s->next = cache->snapshots;
+      cache->snapshots = s;
+      /* An incomplete copy is left empty, which is merely pessimistic: */
+      ContentRecord_copy(&s->record, &cache->current);
+      break;
+    }
+
+    case CONTENT_UPDATE_SNAPSHOT_REMOVED:
+      link = ContentCache_snapshotLinkLocked(cache, key);
+      /* Of an ambiguous name's snapshots, another may remain: */
+      if (*link != NULL && !(*link)->ambiguous) {
+        SnapshotContentRecord *s = *link;
+        *link = s->next;
+        ContentRecord_clear(&s->record);
+        pyvix_plain_free(s->snapshotName);
+        pyvix_plain_free(s);
+      }
+      break;
+
+    case CONTENT_UPDATE_REVERTED:
+      cache->nReverts++;
+      ContentRecord_clear(&cache->current);
+      link = ContentCache_snapshotLinkLocked(cache, key);
+      if (*link != NULL) {
+        ContentRecord_copy(&cache->current, &(*link)->record);
+      }
+      break;
+  }
+} /* ContentCache_applyLocked */
+
+static void ContentCache_store(ContentCache *cache, const char *guestPath,
+    const unsigned char *digest
+  )
+{
+  /* Records that guestPath holds digest, as a job that has already succeeded
+   * left it.  The GIL need not be held. */
+  PyVixMutex_lock(&cache->lock);
+  ContentCache_applyLocked(cache, CONTENT_UPDATE_STORED, guestPath, digest);
+  PyVixMutex_unlock(&cache->lock);
+} /* ContentCache_store */
+
+static void ContentCache_jobFinished(JobCompletion *jc, ContentCache *cache,
+    bool succeeded
+  )
+{
+  /* Applies the update that rode on jc, which has just been detached from it,
+   * if the job succeeded; either way, disposes of the update and of jc's
+   * reference to cache.  The GIL need not be held. */
+  if (succeeded) {
+    PyVixMutex_lock(&cache->lock);
+    ContentCache_applyLocked(cache, jc->contentUpdate, jc->contentKey,
+        jc->contentDigest
+      );
+    PyVixMutex_unlock(&cache->lock);
+  } else if (jc->contentUpdate == CONTENT_UPDATE_STORED) {
+    /* A failed copy may have left anything behind: */
+    ContentCache_forget(cache, jc->contentKey);
+  }
+
+  jc->contentCache = NULL;
+  pyvix_plain_free(jc->contentKey);
+  jc->contentKey = NULL;
+  ContentCache_release(cache);
+} /* ContentCache_jobFinished */
+
+/******************************** Reporting **********************************/
+
+static PyObject *ContentCache_hexDigest(const unsigned char *digest) {
+  static const char hexDigits[] = "0123456789abcdef";
+  char hex[CONTENT_DIGEST_SIZE * 2];
+  int i;
+
+  for (i = 0; i < CONTENT_DIGEST_SIZE; i++) {
+    hex[i * 2] = hexDigits[digest[i] >> 4];
+    hex[i * 2 + 1] = hexDigits[digest[i] & 0xf];
+  }
+  return PyString_FromStringAndSize(hex, sizeof(hex));
+} /* ContentCache_hexDigest */
+
+static PyObject *ContentCache_contents(ContentCache *cache) {
+  /* Returns a dict that maps each guest path in the current record to the
+   * hex digest of its content (or to None, for a directory).  The GIL must
+   * be held. */
+  PyObject *contents = PyDict_New();
+  size_t i;
+
+  if (contents == NULL) { return NULL; }
+
+  /* Nothing here releases the GIL or calls back into pyvix, so the lock is
+   * held throughout: */
+  PyVixMutex_lock(&cache->lock);
+  for (i = 0; i < cache->current.nBuckets; i++) {
+    const ContentRecordEntry *e;
+    for (e = cache->current.buckets[i]; e != NULL; e = e->next) {
+      PyObject *digest;
+      int res;
+
+      if (memcmp(e->digest, ContentCache_directoryDigest,
+            CONTENT_DIGEST_SIZE
+          ) == 0
+         )
+      {
+        Py_INCREF(Py_None);
+        digest = Py_None;
+      } else {
+        digest = ContentCache_hexDigest(e->digest);
+        if (digest == NULL) { goto fail; }
+      }
+      res = PyDict_SetItemString(contents, e->guestPath, digest);
+      Py_DECREF(digest);
+      if (res != 0) { goto fail; }
+    }
+  }
+  PyVixMutex_unlock(&cache->lock);
+
+  return contents;
+  fail:
+    PyVixMutex_unlock(&cache->lock);
+    assert (PyErr_Occurred());
+    Py_DECREF(contents);
+    return NULL;
+} /* ContentCache_contents */
+
+static PyObject *ContentCache_stats(ContentCache *cache) {
+  /* The GIL must be held. */
+  unsigned long nEntries, nSnapshots = 0, nHits, nMisses, nReverts;
+  int64 bytesSkipped;
+  const SnapshotContentRecord *s;
+
+  PyVixMutex_lock(&cache->lock);
+  nEntries = (unsigned long) cache->current.nEntries;
+  for (s = cache->snapshots; s != NULL; s = s->next) { nSnapshots++; }
+  nHits = cache->nHits;
+  nMisses = cache->nMisses;
+  bytesSkipped = cache->bytesSkipped;
+  nReverts = cache->nReverts;
+  PyVixMutex_unlock(&cache->lock);
+
+  return Py_BuildValue("{s:k,s:k,s:k,s:k,s:L,s:k}",
+      "entries", nEntries,
+      "snapshots", nSnapshots,
+      "hits", nHits,
+      "misses", nMisses,
+      "bytesSkipped", (PY_LONG_LONG) bytesSkipped,
+      "reverts", nReverts
+    );
+} /* ContentCache_stats */
@@ -0,0 +1,339 @@
+/******************************************************************************
+ * pyvix - Implementation of Deadline Class
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* A Deadline spreads one time budget across a sequence of operations, such as
+ * revertToSnapshot, powerOn, waitForToolsInGuest, loginInGuest and so on.  It
+ * can either be passed to each method as its timeout argument, or entered as
+ * a context manager, which makes it the current Deadline of the entering
+ * thread:
+ *
+ *   with vix.Deadline(600) as d:
+ *       vm.revertToSnapshot(snap)
+ *       vm.powerOn()
+ *       ...
+ *   print d.steps
+ *
+ * Either way, each job takes whatever remains of the budget as its timeout
+ * (or its own timeout, if that's shorter), and an operation that's attempted
+ * once the budget has run out fails with VIXTimeoutError without being
+ * submitted at all.  Every operation records a (name, seconds, outcome) step
+ * in the Deadline, where outcome is one of 'ok', 'error', 'timeout',
+ * 'cancelled' or 'skipped'. */
+
+/* The key under which a thread's current Deadline is kept in its
+ * PyThreadState dict: */
+static PyObject *Deadline_threadKey = NULL;
+
+static status initSupport_Deadline(void) {
+  /* DeadlineType is a new-style class, so PyType_Ready must be called before
+   * its getters and setters will function. */
+  if (PyType_Ready(&DeadlineType) < 0) { goto fail; }
+
+  Deadline_threadKey = PyString_InternFromString("pyvix.vix.Deadline");
+  if (Deadline_threadKey == NULL) { goto fail; }
+
+  return SUCCEEDED;
+  fail:
+    /* This function is indirectly called by the module loader, which makes no
+     * provision for error recovery. */
+    return FAILED;
+} /* initSupport_Deadline */
+
+static Deadline *Deadline_current(void) {
+  /* Returns a borrowed reference to the calling thread's current Deadline, or
+   * NULL if it has none.  The GIL must be held. */
+  PyObject *threadDict = PyThreadState_GetDict();
+  PyObject *current;
+
+  if (threadDict == NULL) { return NULL; }
+  current = PyDict_GetItem(threadDict, Deadline_threadKey);
+  return (current != NULL && current != Py_None ? (Deadline *) current : NULL);
+} /* Deadline_current */
+
+static double Deadline_remaining(Deadline *self) {
+  const double remaining = self->expiresAt - PyVixClock_now();
+  return (remaining > 0 ? remaining : 0.0);
+} /* Deadline_remaining */
+
+static status Deadline_recordStep(Deadline *self, const char *name,
+    double seconds, const char *outcome
+  )
+{
+  PyObject *step = Py_BuildValue("(sds)", name, seconds, outcome);
+  if (step == NULL) { return FAILED; }
+
+  if (PyList_Append(self->steps, step) != 0) {
+    Py_DECREF(step);
+    return FAILED;
+  }
+  Py_DECREF(step);
+  return SUCCEEDED;
+} /* Deadline_recordStep */
+
+/****************************** JobDeadline **********************************/
+
+static status JobDeadline_fromPython(PyObject *pyTimeout, const char *opName,
+    JobDeadline *jd
+  )
+{
+  /* Determines the deadline of the operation opName from its timeout
+   * argument, which may be a number of seconds, None, or a Deadline; if it's
+   * not a Deadline, the thread's current Deadline (if any) applies too.
+   * Raises VIXTimeoutError (having recorded the operation as skipped) if that
+   * Deadline has already expired.  The GIL must be held. */
+  const double now = PyVixClock_now();
+
+  jd->at = NO_DEADLINE;
+  jd->budget = NULL;
+  jd->opName = opName;
+  jd->startedAt = now;
+
+  if (pyTimeout != NULL && PyObject_TypeCheck(pyTimeout, &DeadlineType)) {
+    jd->budget = (Deadline *) pyTimeout;
+  } else {
+    if (deadlineFromPython(pyTimeout, &jd->at) != SUCCEEDED) { return FAILED; }
+    jd->budget = Deadline_current();
+  }
+  if (jd->budget == NULL) { return SUCCEEDED; }
+
+  if (jd->budget->expiresAt <= now) {
+    if (Deadline_recordStep(jd->budget, opName, 0.0, "skipped")
+        != SUCCEEDED
+       )
+    { return FAILED; }
+    PyErr_Format(VIXTimeoutError,
+        "The deadline had already passed, so %s was not attempted.", opName
+      );
+    return FAILED;
+  }
+  if (jd->at == NO_DEADLINE || jd->budget->expiresAt < jd->at) {
+    jd->at = jd->budget->expiresAt;
+  }
+
+  return SUCCEEDED;
+} /* JobDeadline_fromPython */
+
+static status JobDeadline_recordStep(const JobDeadline *jd,
+    const char *outcome
+  )
+{
+  /* Records the operation, which has just finished, as a step of its
+   * Deadline (if any). */
+  if (jd->budget == NULL) { return SUCCEEDED; }
+  return Deadline_recordStep(jd->budget, jd->opName,
+      PyVixClock_now() - jd->startedAt, outcome
+    );
+} /* JobDeadline_recordStep */
+
+/******************************** Deadline ***********************************/
+
+static PyObject *pyf_Deadline_new(
+    PyTypeObject *subtype, PyObject *args, PyObject *kwargs
+  )
+{
+  static char* kwarg_list[] = {"timeout", NULL};
+  double timeout;
+  Deadline *self = NULL;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d", kwarg_list, &timeout)) {
+    goto fail;
+  }
+  if (checkTimeoutSeconds(timeout) != SUCCEEDED) { goto fail; }
+
+  self = (Deadline *) subtype->tp_alloc(subtype, 0);
+  if (self == NULL) { goto fail; }
+  self->previous = NULL;
+  self->steps = PyList_New(0);
+  if (self->steps == NULL) { goto fail; }
+  self->startedAt = PyVixClock_now();
+  self->expiresAt = self->startedAt + timeout;
+
+  return (PyObject *) self;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(self);
+    return NULL;
+} /* pyf_Deadline_new */
+
+static void pyf_Deadline___del__(Deadline *self) {
+  Py_CLEAR(self->steps);
+  Py_CLEAR(self->previous);
+
+  /* Release the Deadline struct itself: */
+  self->ob_type->tp_free((PyObject *) self);
+} /* pyf_Deadline___del__ */
+
+static PyObject *pyf_Deadline___enter__(Deadline *self) {
+  PyObject *threadDict = PyThreadState_GetDict();
+  Deadline *previous;
+
+  if (self->previous != NULL) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The Deadline has already been entered."
+      );
+    return NULL;
+  }
+  if (threadDict == NULL) {
+    raiseNonNumericVIXError(VIXInternalError,
+        "The thread has no state dict in which to install the Deadline."
+      );
+    return NULL;
+  }
+
+  previous = Deadline_current();
+  if (PyDict_SetItem(threadDict, Deadline_threadKey, (PyObject *) self) != 0) {
+    return NULL;
+  }
+  self->previous = (previous != NULL ? (PyObject *) previous : Py_None);
+  Py_INCREF(self->previous);
+
+  Py_INCREF(self);
+  return (PyObject *) self;
+} /* pyf_Deadline___enter__ */
+
+static PyObject *pyf_Deadline___exit__(Deadline *self, PyObject *args) {
+  PyObject *threadDict = PyThreadState_GetDict();
+  PyObject *previous = self->previous;
+
+  if (previous == NULL) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The Deadline has not been entered."
+      );
+    return NULL;
+  }
+  self->previous = NULL;
+
+  if (threadDict != NULL
+      && PyDict_SetItem(threadDict, Deadline_threadKey, previous) != 0
+     )
+  {
+    Py_DECREF(previous);
+    return NULL;
+  }
+  Py_DECREF(previous);
+
+  /* Exceptions raised within the with block propagate: */
+  Py_RETURN_FALSE;
+} /* pyf_Deadline___exit__ */
+
+static PyObject *pyf_Deadline_current(PyObject *cls) {
+  /* Returns the calling thread's current Deadline, or None. */
+  PyObject *current = (PyObject *) Deadline_current();
+  if (current == NULL) { current = Py_None; }
+
+  Py_INCREF(current);
+  return current;
+} /* pyf_Deadline_current */
+
+static PyObject *pyf_Deadline_remaining_get(Deadline *self, void *closure) {
+  return PyFloat_FromDouble(Deadline_remaining(self));
+} /* pyf_Deadline_remaining_get */
+
+static PyObject *pyf_Deadline_elapsed_get(Deadline *self, void *closure) {
+  return PyFloat_FromDouble(PyVixClock_now() - self->startedAt);
+} /* pyf_Deadline_elapsed_get */
+
+static PyObject *pyf_Deadline_expired_get(Deadline *self, void *closure) {
+  return PyBool_FromLong(self->expiresAt <= PyVixClock_now());
+} /* pyf_Deadline_expired_get */
+
+static PyObject *pyf_Deadline_steps_get(Deadline *self, void *closure) {
+  /* A copy, so that the caller can't tamper with the record: */
+  return PyList_GetSlice(self->steps, 0, PyList_GET_SIZE(self->steps));
+} /* pyf_Deadline_steps_get */
+
+static PyMethodDef Deadline_methods[] = {
+    {"__enter__",
+        (PyCFunction) pyf_Deadline___enter__,
+        METH_NOARGS
+      },
+    {"__exit__",
+        (PyCFunction) pyf_Deadline___exit__,
+        METH_VARARGS
+      },
+    {"current",
+        (PyCFunction) pyf_Deadline_current,
+        METH_NOARGS | METH_STATIC
+      },
+    {NULL}  /* sentinel */
+  };
+
+static PyGetSetDef Deadline_getters_setters[] = {
+    {"remaining",
+        (getter) pyf_Deadline_remaining_get,
+        NULL,
+        "The number of seconds left before the Deadline expires (never less"
+        " than 0)."
+      },
+    {"elapsed",
+        (getter) pyf_Deadline_elapsed_get,
+        NULL,
+        "The number of seconds since the Deadline was created."
+      },
+    {"expired",
+        (getter) pyf_Deadline_expired_get,
+        NULL,
+        "Whether the Deadline has expired."
+      },
+    {"steps",
+        (getter) pyf_Deadline_steps_get,
+        NULL,
+        "A list of (name, seconds, outcome) tuples, one per operation that"
+        " drew upon the Deadline, in the order in which they finished."
+      },
+    {NULL}  /* sentinel */
+  };
+
+PyTypeObject DeadlineType = { /* new-style class */
+    PyObject_HEAD_INIT(NULL)
+    0,                                  /* ob_size */
+    "pyvix.vix.Deadline",               /* tp_name */
+    sizeof(Deadline),                   /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) pyf_Deadline___del__,  /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    0,                                  /* tp_doc */
+    0,		                              /* tp_traverse */
+    0,		                              /* tp_clear */
+    0,		                              /* tp_richcompare */
+    0,		                              /* tp_weaklistoffset */
+
+    0,                    		          /* tp_iter */
+    0,		                              /* tp_iternext */
+
+    Deadline_methods,                   /* tp_methods */
+    NULL,                               /* tp_members */
+    Deadline_getters_setters,           /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    pyf_Deadline_new,                   /* tp_new */
+    0,                                  /* tp_free */
+    0,                                  /* tp_is_gc */
+    0,                                  /* tp_bases */
+    0,                                  /* tp_mro */
+    0,                                  /* tp_cache */
+    0,                                  /* tp_subclasses */
+    0                                   /* tp_weaklist */
+  };
@@ -20,6 +20,9 @@ static PyObject *VIXException             = NULL;
 static PyObject *VIXInternalError         = NULL;
 static PyObject *VIXSecurityException     = NULL;
 static PyObject *VIXClientProgrammerError = NULL;
+/* VIXTimeoutError applies when an operation didn't complete within the
+ * timeout it was given: */
+static PyObject *VIXTimeoutError          = NULL;
 
 static status initSupport_errorHandling(PyObject *vixModule) {
   #define DEFINE_EXC(targetVar, superType) \
@@ -32,6 +35,7 @@ static status initSupport_errorHandling(PyObject *vixModule) {
   DEFINE_EXC(VIXInternalError,         VIXException);
   DEFINE_EXC(VIXSecurityException,     VIXException);
   DEFINE_EXC(VIXClientProgrammerError, VIXException);
+  DEFINE_EXC(VIXTimeoutError,          VIXException);
 
   return SUCCEEDED;
   fail:
@@ -77,6 +81,10 @@ static status autoRaiseVIXError(VixError err) {
       excType = VIXSecurityException;
       break;
 
+    case VIX_E_TIMEOUT_WAITING_FOR_TOOLS:
+      excType = VIXTimeoutError;
+      break;
+
     default:
       excType = VIXException;
       break;
@@ -86,6 +94,25 @@ static status autoRaiseVIXError(VixError err) {
   return raiseVIXError(err, excType, NULL);
 } /* raiseGenericVIXError */
 
+static PyObject *fetchRaisedException(void) {
+  /* Clears the current exception and returns (a new reference to) its
+   * normalized value, so that it can be reported as data rather than raised;
+   * e.g., as one entry of the per-item results of a batch operation. */
+  PyObject *excType, *excValue, *excTraceback;
+
+  assert (PyErr_Occurred());
+  PyErr_Fetch(&excType, &excValue, &excTraceback);
+  PyErr_NormalizeException(&excType, &excValue, &excTraceback);
+  Py_XDECREF(excType);
+  Py_XDECREF(excTraceback);
+
+  if (excValue == NULL) {
+    Py_INCREF(Py_None);
+    excValue = Py_None;
+  }
+  return excValue;
+} /* fetchRaisedException */
+
 #define SUPPRESS_EXCEPTION \
   suppressPythonExceptionIfAny(__FILE__, __LINE__)
 
@@ -22,6 +22,76 @@ static status initSupport_Host(void) {
 #define Host_changeState(host, newState) \
   StatefulHandleWrapper_changeState((StatefulHandleWrapper *) (host), newState)
 
+static VM *Host_findOpenVM(Host *self, PyObject *pyVMXPath) {
+  /* Returns a borrowed reference to the open VM that self->vmsByPath holds
+   * for pyVMXPath, or NULL (without an exception) if there's none. */
+  PyObject *ref = PyDict_GetItem(self->vmsByPath, pyVMXPath);
+  VM *vm;
+
+  if (ref == NULL) { return NULL; }
+  vm = (VM *) PyWeakref_GET_OBJECT(ref);
+  if ((PyObject *) vm == Py_None || !VM_isOpen(vm)) { return NULL; }
+
+  return vm;
+} /* Host_findOpenVM */
+
+static status Host_indexVM(Host *self, VM *vm) {
+  /* Enters vm, which is being opened via self, in self->vmsByPath, unless
+   * another VM that's still open already represents the same vmxPath (as can
+   * happen if the VM constructor is invoked directly). */
+  status res = FAILED;
+  PyObject *pyVMXPath = NULL;
+  PyObject *ref = NULL;
+
+  pyVMXPath = PyString_FromString(vm->vmxPath);
+  if (pyVMXPath == NULL) { goto fail; }
+  if (Host_findOpenVM(self, pyVMXPath) != NULL) {
+    res = SUCCEEDED;
+    goto cleanup;
+  }
+
+  ref = PyWeakref_NewRef((PyObject *) vm, NULL);
+  if (ref == NULL) { goto fail; }
+  if (PyDict_SetItem(self->vmsByPath, pyVMXPath, ref) != 0) { goto fail; }
+
+  res = SUCCEEDED;
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    assert (res == FAILED);
+    /* Fall through to cleanup: */
+  cleanup:
+    Py_XDECREF(ref);
+    Py_XDECREF(pyVMXPath);
+    return res;
+} /* Host_indexVM */
+
+static void Host_unindexVM(Host *self, VM *vm) {
+  /* Removes vm from self->vmsByPath, if it's there.  Never raises, since it's
+   * called while vm is being closed or deallocated. */
+  PyObject *pyVMXPath;
+  PyObject *ref;
+
+  if (self->vmsByPath == NULL || vm->vmxPath == NULL) { return; }
+
+  pyVMXPath = PyString_FromString(vm->vmxPath);
+  if (pyVMXPath == NULL) { SUPPRESS_EXCEPTION; return; }
+
+  ref = PyDict_GetItem(self->vmsByPath, pyVMXPath);
+  if (ref != NULL) {
+    /* If vm is being deallocated, its weak references have already been
+     * cleared, so the entry refers to None rather than to vm: */
+    PyObject *referent = PyWeakref_GET_OBJECT(ref);
+    if (referent == (PyObject *) vm || referent == Py_None) {
+      if (PyDict_DelItem(self->vmsByPath, pyVMXPath) != 0) {
+        SUPPRESS_EXCEPTION;
+      }
+    }
+  }
+
+  Py_DECREF(pyVMXPath);
+} /* Host_unindexVM */
+
 static PyObject *pyf_Host_new(
     PyTypeObject *subtype, PyObject *args, PyObject *kwargs
   )
@@ -30,23 +100,34 @@ static PyObject *pyf_Host_new(
   if (self == NULL) { goto fail; }
 
   /* Initialize Host-specific fields: */
-  self->openVMs = NULL;
+  TRACKER_INIT(&self->openVMs);
+  self->watcher = NULL;
+  self->poolActive = 0;
+  self->poolLimit = -1;
+  self->vmsByPath = PyDict_New();
+  if (self->vmsByPath == NULL) { goto fail; }
+  self->admission = AdmissionGate_new();
+  if (self->admission == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
 
   return (PyObject *) self;
   fail:
     assert (PyErr_Occurred());
-    assert (self == NULL);
+    Py_XDECREF(self);
     return NULL;
 } /* pyf_Host_new */
 
 static status Host_init(Host *self, PyObject *args, PyObject *kwargs) {
   status res = FAILED;
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
+  Job *job = NULL;
+  PyObject *pyHandle = NULL;
 
   static char* kwarg_list[] = {
       "hostType", "hostName", "hostPort", "username", "password", "options",
-      NULL
+      "timeout", NULL
     };
   //VixServiceProvider hostType = VIX_SERVICEPROVIDER_VMWARE_SERVER;
   VixServiceProvider hostType = VIX_SERVICEPROVIDER_VMWARE_WORKSTATION;
@@ -55,26 +136,39 @@ static status Host_init(Host *self, PyObject *args, PyObject *kwargs) {
   char *username = NULL;
   char *password = NULL;
   VixHostOptions options = 0;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|isissi", kwarg_list,
-       &hostType, &hostName, &hostPort, &username, &password, &options
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|isissiO", kwarg_list,
+       &hostType, &hostName, &hostPort, &username, &password, &options,
+       &pyTimeout
      ))
   { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "Host", &deadline) != SUCCEEDED) {
+    goto fail;
+  }
 
   assert (self->handle == VIX_INVALID_HANDLE);
+  /* Like every other job, the connection is waited for via a Job, so that it
+   * can't outlast its timeout however long VIX takes to give up on a hung
+   * server: */
+  job = Job_create((PyObject *) self, JOB_RESULT_HANDLE);
+  if (job == NULL) { goto fail; }
+
   LEAVE_PYTHON
   jobH = VixHost_Connect(VIX_API_VERSION,
       hostType, hostName, hostPort,
       username, password, options,
 
       VIX_INVALID_HANDLE, /* propertyListHandle */
-      NULL, NULL /* callbackProc, clientData */
-    );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_JOB_RESULT_HANDLE, &self->handle,
-      VIX_PROPERTY_NONE
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
+
+  pyHandle = Job_issued(job, jobH, false, &deadline);
+  if (pyHandle == NULL) { goto fail; }
+  self->handle = (VixHandle) PyInt_AS_LONG(pyHandle);
 
   assert (self->state == STATE_CREATED);
   if (Host_changeState(self, STATE_OPEN) != SUCCEEDED) { goto fail; }
@@ -86,18 +180,26 @@ static status Host_init(Host *self, PyObject *args, PyObject *kwargs) {
     assert (res == FAILED);
     /* Fall through to cleanup: */
   cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
+    Py_XDECREF(pyHandle);
     return res;
 } /* Host_init */
 
 static status Host_close(Host *self) {
-  if (self->openVMs != NULL) {
+  /* The watcher mustn't poll VMs that are being closed: */
+  if (self->watcher != NULL) {
+    PowerStateWatcher_stop(self->watcher);
+    Py_CLEAR(self->watcher);
+  }
+
+  if (!TRACKER_IS_EMPTY(&self->openVMs)) {
     if (VMTracker_release(&self->openVMs) == SUCCEEDED) {
-      assert (self->openVMs == NULL);
+      assert (TRACKER_IS_EMPTY(&self->openVMs));
     } else {
       goto fail;
     }
   }
+  /* Every VM in the index was in openVMs, and has now been closed: */
+  PyDict_Clear(self->vmsByPath);
 
   if (self->state == STATE_OPEN && self->handle != VIX_INVALID_HANDLE) {
     LEAVE_PYTHON
@@ -131,6 +233,28 @@ static PyObject *pyf_Host_closed_get(Host *self, void *closure) {
   return PyBool_FromLong(!Host_isOpen(self));
 } /* pyf_Host_closed_get */
 
+static PyObject *pyf_Host_openVMsByPath_get(Host *self, void *closure) {
+  /* Returns a new dict that maps the vmxPath of each VM opened via self to
+   * the VM itself. */
+  PyObject *byPath = PyDict_New();
+  PyObject *pyVMXPath;
+  PyObject *ref;
+  Py_ssize_t pos = 0;
+
+  if (byPath == NULL) { goto fail; }
+  while (PyDict_Next(self->vmsByPath, &pos, &pyVMXPath, &ref)) {
+    VM *vm = Host_findOpenVM(self, pyVMXPath);
+    if (vm == NULL) { continue; }
+    if (PyDict_SetItem(byPath, pyVMXPath, (PyObject *) vm) != 0) { goto fail; }
+  }
+
+  return byPath;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(byPath);
+    return NULL;
+} /* pyf_Host_openVMsByPath_get */
+
 static status Host_delete(Host *self, bool allowedToRaise) {
   if (self->state == STATE_OPEN) {
     if (Host_close(self) != SUCCEEDED) {
@@ -139,7 +263,7 @@ static status Host_delete(Host *self, bool allowedToRaise) {
   }
 
   /* Should've already been cleared by Host_close: */
-  assert (self->openVMs == NULL);
+  assert (TRACKER_IS_EMPTY(&self->openVMs));
 
   return SUCCEEDED;
   fail:
@@ -149,96 +273,1260 @@ static status Host_delete(Host *self, bool allowedToRaise) {
 
 static void pyf_Host___del__(Host *self) {
   Host_delete(self, false);
+  Py_CLEAR(self->vmsByPath);
+  /* Jobs still in flight keep the gate alive until VIX reports on them: */
+  if (self->admission != NULL) {
+    AdmissionGate_release(self->admission);
+    self->admission = NULL;
+  }
+  /* Should've already been stopped and cleared by Host_close: */
+  assert (self->watcher == NULL);
 
   /* Release the Host struct itself: */
   self->ob_type->tp_free((PyObject *) self);
 } /* pyf_Host___del__ */
 
-static PyObject *pyf_Host_findRunningVMPaths(Host *self) {
+static PyObject *Host_findRunningVMs(Host *self, bool async,
+    const JobDeadline *deadline
+  )
+{
+  /* Submits a VIX_FIND_RUNNING_VMS job.  The job accumulates the paths it
+   * finds (without the GIL), and they become its result. */
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  VixCallbackAccumulator acc;
-  PyObject *res = NULL;
-
-  HOST_REQUIRE_OPEN(self);
-
-  if (VixCallbackAccumulator_ListInit(&acc) != SUCCEEDED) { goto fail; }
+  Job *job = Job_create((PyObject *) self, JOB_RESULT_STRING_LIST);
+  if (job == NULL) { return NULL; }
 
   LEAVE_PYTHON
   jobH = VixHost_FindItems(self->handle, VIX_FIND_RUNNING_VMS,
       VIX_INVALID_HANDLE, NO_TIMEOUT,
-      VixCallback_accumulateStringList, &acc
+      Job_vixCallback, Job_CLIENT_DATA(job)
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  res = acc.target;
-  acc.target = NULL;
-  goto cleanup;
+  return Job_issued(job, jobH, async, deadline);
+} /* Host_findRunningVMs */
+
+static PyObject *pyf_Host_findRunningVMPaths(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  static char* kwarg_list[] = {"async_", "timeout", NULL};
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iO", kwarg_list,
+       &async, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "findRunningVMPaths", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  return Host_findRunningVMs(self, (bool) async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (res == NULL);
-    VixCallbackAccumulator_clear(&acc);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return res;
+    return NULL;
 } /* pyf_Host_findRunningVMPaths */
 
+static PyObject *pyf_Host_iterRunningVMPaths(Host *self) {
+  /* Like findRunningVMPaths, but yields each path as soon as VIX reports
+   * it. */
+  PyObject *job;
+
+  HOST_REQUIRE_OPEN(self);
+
+  job = Host_findRunningVMs(self, true, NULL);
+  if (job == NULL) { goto fail; }
+
+  return JobItemIterator_create((Job *) job);
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_Host_iterRunningVMPaths */
+
 static PyObject *pyf_Host_registerOrUnregisterVM(Host *self, PyObject *args,
-    bool shouldRegister
+    PyObject *kwargs, bool shouldRegister
   )
 {
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *res = NULL;
+  Job *job = NULL;
 
+  static char* kwarg_list[] = {"vmxPath", "async_", "timeout", NULL};
   char *vmxPath;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
 
   HOST_REQUIRE_OPEN(self);
-  if (!PyArg_ParseTuple(args, "s", &vmxPath)) { return NULL; }
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|iO", kwarg_list,
+       &vmxPath, &async, &pyTimeout
+     ))
+  { return NULL; }
+  if (JobDeadline_fromPython(pyTimeout,
+        (shouldRegister ? "registerVM" : "unregisterVM"), &deadline
+      ) != SUCCEEDED
+     )
+  { return NULL; }
+
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { return NULL; }
 
   LEAVE_PYTHON
   if (shouldRegister) {
-    jobH = VixHost_RegisterVM(self->handle, vmxPath, NULL, NULL);
+    jobH = VixHost_RegisterVM(self->handle, vmxPath,
+        Job_vixCallback, Job_CLIENT_DATA(job)
+      );
   } else {
-    jobH = VixHost_UnregisterVM(self->handle, vmxPath, NULL, NULL);
+    jobH = VixHost_UnregisterVM(self->handle, vmxPath,
+        Job_vixCallback, Job_CLIENT_DATA(job)
+      );
   }
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  res = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
-  fail:
-    assert (PyErr_Occurred());
-    assert (res == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return res;
+  return Job_issued(job, jobH, async, &deadline);
 } /* pyf_Host_registerVM */
 
-static PyObject *pyf_Host_registerVM(Host *self, PyObject *args) {
-  return pyf_Host_registerOrUnregisterVM(self, args, true);
+static PyObject *pyf_Host_registerVM(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return pyf_Host_registerOrUnregisterVM(self, args, kwargs, true);
 } /* pyf_Host_registerVM */
 
-static PyObject *pyf_Host_unregisterVM(Host *self, PyObject *args) {
-  return pyf_Host_registerOrUnregisterVM(self, args, false);
+static PyObject *pyf_Host_unregisterVM(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return pyf_Host_registerOrUnregisterVM(self, args, kwargs, false);
 } /* pyf_Host_registerVM */
+static PyObject *pyf_Host_openVM(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Returns the VM at the given vmxPath, reusing the VM object that was
+   * already opened via self for the very same path if it's still open.
+   * (Invoking the VM constructor directly always opens a distinct VM.) */
+  static char* kwarg_list[] = {"vmxPath", "timeout", NULL};
+  PyObject *pyVMXPath;
+  PyObject *pyTimeout = Py_None;
+  VM *vm;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|O", kwarg_list,
+       &PyString_Type, &pyVMXPath, &pyTimeout
+     ))
+  { return NULL; }
+
+  vm = Host_findOpenVM(self, pyVMXPath);
+  if (vm != NULL) {
+    Py_INCREF(vm);
+    return (PyObject *) vm;
+  }
 
-static PyObject *pyf_Host_openVM(Host *self, PyObject *args) {
+  return PyObject_CallFunction((PyObject *) &VMType, "OOO", self, pyVMXPath,
+      pyTimeout
+    );
+} /* pyf_Host_openVM */
+
+static PyObject *pyf_Host_getOpenVM(Host *self, PyObject *args) {
+  /* Returns the open VM that was opened via self for the given vmxPath, or
+   * None if there's none. */
   PyObject *pyVMXPath;
+  VM *vm;
 
   HOST_REQUIRE_OPEN(self);
   if (!PyArg_ParseTuple(args, "O!", &PyString_Type, &pyVMXPath)) {
     return NULL;
   }
 
-  return PyObject_CallFunction((PyObject *) &VMType, "OO", self, pyVMXPath);
-} /* pyf_Host_openVM */
+  vm = Host_findOpenVM(self, pyVMXPath);
+  if (vm == NULL) { Py_RETURN_NONE; }
+  Py_INCREF(vm);
+  return (PyObject *) vm;
+} /* pyf_Host_getOpenVM */
+
+typedef struct {
+  VixHandle hostH;
+  PyObject *pathSeq;
+} HostOpenVMBatch;
+
+static VixHandle Host_submitOpenVMInBatch(void *context, Py_ssize_t i,
+    void *clientData
+  )
+{
+  /* Reading the borrowed path strings without the GIL is safe, because
+   * Host_openVMs holds a reference to pathSeq throughout the batch and
+   * strings are immutable. */
+  HostOpenVMBatch *batch = (HostOpenVMBatch *) context;
+  return VixVM_Open(batch->hostH,
+      PyString_AS_STRING(PySequence_Fast_GET_ITEM(batch->pathSeq, i)),
+      Job_vixCallback, clientData
+    );
+} /* Host_submitOpenVMInBatch */
+
+static PyObject *pyf_Host_openVMs(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Opens the VM at each of the vmxPaths in the sequence paths, with at most
+   * max_parallel VixVM_Open jobs in flight at once, and returns a list with
+   * one entry per path:  the opened VM, or the exception raised when opening
+   * it failed.  The opened VMs are entered in self's open VM tracker as the
+   * results are collected.  As with openVM, a path whose VM is already open
+   * yields that VM, and a path listed more than once is opened only once.
+   * If the whole batch takes longer than timeout, the paths that weren't
+   * opened in time get VIXTimeoutErrors. */
+  static char* kwarg_list[] = {"paths", "max_parallel", "timeout", NULL};
+  PyObject *paths;
+  int maxParallel = DEFAULT_MAX_PARALLEL_JOBS;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  PyObject *results = NULL;
+  /* Maps each path to the index of its first occurrence in paths: */
+  PyObject *firstIndexByPath = NULL;
+  Py_ssize_t *firstIndex = NULL;
+  Job **jobs = NULL;
+  HostOpenVMBatch batch;
+  Py_ssize_t nPaths = 0;
+  Py_ssize_t i;
+
+  batch.hostH = VIX_INVALID_HANDLE;
+  batch.pathSeq = NULL;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iO", kwarg_list,
+       &paths, &maxParallel, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "openVMs", &deadline) != SUCCEEDED) {
+    goto fail;
+  }
+
+  /* Hold a reference to the handle in case the Host is closed by another
+   * thread while the GIL is released: */
+  batch.hostH = self->handle;
+  Vix_AddRefHandle(batch.hostH);
+  batch.pathSeq = PySequence_Fast(paths, "paths must be a sequence of str.");
+  if (batch.pathSeq == NULL) { goto fail; }
+  nPaths = PySequence_Fast_GET_SIZE(batch.pathSeq);
+
+  results = PyList_New(nPaths);
+  if (results == NULL) { goto fail; }
+  firstIndexByPath = PyDict_New();
+  if (firstIndexByPath == NULL) { goto fail; }
+  jobs = pyvix_main_malloc(sizeof(Job *) * (nPaths > 0 ? nPaths : 1));
+  firstIndex = pyvix_main_malloc(
+      sizeof(Py_ssize_t) * (nPaths > 0 ? nPaths : 1)
+    );
+  if (jobs == NULL || firstIndex == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  for (i = 0; i < nPaths; i++) { jobs[i] = NULL; }
+  for (i = 0; i < nPaths; i++) {
+    PyObject *pyVMXPath = PySequence_Fast_GET_ITEM(batch.pathSeq, i);
+    PyObject *pyFirstIndex;
+    VM *vm;
+
+    if (!PyString_Check(pyVMXPath)) {
+      PyErr_SetString(PyExc_TypeError, "paths must be a sequence of str.");
+      goto fail;
+    }
+
+    pyFirstIndex = PyDict_GetItem(firstIndexByPath, pyVMXPath);
+    if (pyFirstIndex != NULL) {
+      /* The slot is filled from that of the first occurrence below: */
+      firstIndex[i] = PyInt_AS_LONG(pyFirstIndex);
+      continue;
+    }
+    firstIndex[i] = i;
+    pyFirstIndex = PyInt_FromSsize_t(i);
+    if (pyFirstIndex == NULL) { goto fail; }
+    if (PyDict_SetItem(firstIndexByPath, pyVMXPath, pyFirstIndex) != 0) {
+      Py_DECREF(pyFirstIndex);
+      goto fail;
+    }
+    Py_DECREF(pyFirstIndex);
+
+    vm = Host_findOpenVM(self, pyVMXPath);
+    if (vm != NULL) {
+      Py_INCREF(vm);
+      PyList_SET_ITEM(results, i, (PyObject *) vm);
+      continue;
+    }
+
+    jobs[i] = Job_create((PyObject *) self, JOB_RESULT_VM);
+    if (jobs[i] == NULL) { goto fail; }
+    Py_INCREF(pyVMXPath);
+    jobs[i]->resultArg = pyVMXPath;
+  }
+
+  /* Opening a VM is a Host operation, which no AdmissionGate limits: */
+  if (Batch_run(jobs, nPaths, maxParallel, deadline.at, NULL, 0,
+        Host_submitOpenVMInBatch, &batch
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  Batch_collectResults(jobs, results, nPaths);
+  if (Batch_recordStep(jobs, nPaths, &deadline) != SUCCEEDED) { goto fail; }
+
+  for (i = 0; i < nPaths; i++) {
+    if (firstIndex[i] != i) {
+      PyObject *res = PyList_GET_ITEM(results, firstIndex[i]);
+      Py_INCREF(res);
+      PyList_SET_ITEM(results, i, res);
+    }
+  }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(results);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (jobs != NULL) {
+      for (i = 0; i < nPaths; i++) { Py_XDECREF(jobs[i]); }
+      pyvix_main_free(jobs);
+    }
+    if (firstIndex != NULL) { pyvix_main_free(firstIndex); }
+    Py_XDECREF(firstIndexByPath);
+    Py_XDECREF(batch.pathSeq);
+    if (batch.hostH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(batch.hostH); }
+    return results;
+} /* pyf_Host_openVMs */
+
+typedef struct {
+  VixHandle *vmHandles;
+  VMPowerOp op;
+  int powerOnOptions;
+} HostPowerOpBatch;
+
+static VixHandle Host_submitPowerOpInBatch(void *context, Py_ssize_t i,
+    void *clientData
+  )
+{
+  HostPowerOpBatch *batch = (HostPowerOpBatch *) context;
+  return VM_submitPowerOp(batch->vmHandles[i], batch->op,
+      batch->powerOnOptions, clientData
+    );
+} /* Host_submitPowerOpInBatch */
+
+static PyObject *Host_powerOpMany(Host *self, PyObject *args,
+    PyObject *kwargs, VMPowerOp op, const char *opName
+  )
+{
+  /* Applies op to every VM in the sequence vms, with at most max_parallel
+   * jobs in flight at once, and returns a list with one entry per VM:  None
+   * if the operation succeeded, otherwise the exception it raised (a
+   * VIXTimeoutError if the whole batch took longer than timeout). */
+  static char* kwarg_list[] = {"vms", "options", "max_parallel", "timeout",
+      NULL
+    };
+  PyObject *vms;
+  int options = VIX_VMPOWEROP_NORMAL;
+  int maxParallel = DEFAULT_MAX_PARALLEL_JOBS;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  PyObject *vmSeq = NULL;
+  PyObject *results = NULL;
+  Job **jobs = NULL;
+  HostPowerOpBatch batch;
+  Py_ssize_t nVMs = 0;
+  Py_ssize_t i;
+
+  batch.vmHandles = NULL;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iiO", kwarg_list,
+       &vms, &options, &maxParallel, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, opName, &deadline) != SUCCEEDED) {
+    goto fail;
+  }
+
+  vmSeq = PySequence_Fast(vms, "vms must be a sequence of VMs.");
+  if (vmSeq == NULL) { goto fail; }
+  nVMs = PySequence_Fast_GET_SIZE(vmSeq);
+
+  results = PyList_New(nVMs);
+  if (results == NULL) { goto fail; }
+  jobs = pyvix_main_malloc(sizeof(Job *) * (nVMs > 0 ? nVMs : 1));
+  batch.vmHandles = pyvix_main_malloc(
+      sizeof(VixHandle) * (nVMs > 0 ? nVMs : 1)
+    );
+  if (jobs == NULL || batch.vmHandles == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  batch.op = op;
+  batch.powerOnOptions = VM_normalizePowerOnOptions(options);
+
+  for (i = 0; i < nVMs; i++) {
+    jobs[i] = NULL;
+    batch.vmHandles[i] = VIX_INVALID_HANDLE;
+  }
+  for (i = 0; i < nVMs; i++) {
+    VM *vm = (VM *) PySequence_Fast_GET_ITEM(vmSeq, i);
+    PyObject *rejection;
+
+    if (!PyObject_TypeCheck(vm, &VMType)) {
+      PyErr_SetString(PyExc_TypeError, "vms must be a sequence of VMs.");
+      goto fail;
+    }
+    rejection = Batch_vmRejection(self, vm);
+    if (rejection != NULL) {
+      PyList_SET_ITEM(results, i, rejection);
+      continue;
+    }
+
+    jobs[i] = VM_createStateChangingJob(vm, JOB_RESULT_NONE);
+    if (jobs[i] == NULL) { goto fail; }
+    /* Hold a reference to the handle in case the VM is closed by another
+     * thread while the GIL is released: */
+    batch.vmHandles[i] = vm->handle;
+    Vix_AddRefHandle(batch.vmHandles[i]);
+  }
+
+  if (Batch_run(jobs, nVMs, maxParallel, deadline.at, self->admission,
+        ADMISSION_POWER, Host_submitPowerOpInBatch, &batch
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  Batch_collectResults(jobs, results, nVMs);
+  if (Batch_recordStep(jobs, nVMs, &deadline) != SUCCEEDED) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(results);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (jobs != NULL) {
+      for (i = 0; i < nVMs; i++) { Py_XDECREF(jobs[i]); }
+      pyvix_main_free(jobs);
+    }
+    if (batch.vmHandles != NULL) {
+      for (i = 0; i < nVMs; i++) {
+        if (batch.vmHandles[i] != VIX_INVALID_HANDLE) {
+          Vix_ReleaseHandle(batch.vmHandles[i]);
+        }
+      }
+      pyvix_main_free(batch.vmHandles);
+    }
+    Py_XDECREF(vmSeq);
+    return results;
+} /* Host_powerOpMany */
+
+static PyObject *pyf_Host_powerOnMany(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return Host_powerOpMany(self, args, kwargs, VM_POWER_ON, "powerOnMany");
+} /* pyf_Host_powerOnMany */
+
+static PyObject *pyf_Host_powerOffMany(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return Host_powerOpMany(self, args, kwargs, VM_POWER_OFF, "powerOffMany");
+} /* pyf_Host_powerOffMany */
+
+static PyObject *pyf_Host_resetMany(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return Host_powerOpMany(self, args, kwargs, VM_RESET, "resetMany");
+} /* pyf_Host_resetMany */
+
+static PyObject *pyf_Host_suspendMany(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return Host_powerOpMany(self, args, kwargs, VM_SUSPEND, "suspendMany");
+} /* pyf_Host_suspendMany */
+
+typedef struct {
+  VixHandle *vmHandles;
+  ContentCache **contentCaches;
+  /* When each job was submitted, from which its latency is measured: */
+  double *submittedAt;
+  const char *stagedPath;
+  const char *dest;
+  const unsigned char *digest;
+} HostBroadcastBatch;
+
+static VixHandle Host_submitBroadcastCopy(void *context, Py_ssize_t i,
+    void *clientData
+  )
+{
+  HostBroadcastBatch *batch = (HostBroadcastBatch *) context;
+  batch->submittedAt[i] = PyVixClock_now();
+  ContentCache_expectCopy(batch->contentCaches[i],
+      (JobCompletion *) clientData, batch->dest, batch->digest
+    );
+  return VixVM_CopyFileFromHostToGuest(batch->vmHandles[i],
+      batch->stagedPath, batch->dest,
+      0, /* options:  Must be 0 in current release. */
+      /* propertyList:  Must be VIX_INVALID_HANDLE in current release: */
+      VIX_INVALID_HANDLE,
+      Job_vixCallback, clientData
+    );
+} /* Host_submitBroadcastCopy */
+
+static PyObject *pyf_Host_broadcastFile(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Copies the host file src to dest within every VM in the sequence vms,
+   * with at most max_parallel copies in flight at once, and returns a list
+   * with one (vm, seconds, outcome, error) tuple per VM, like the entries of
+   * a copyTreeToGuest manifest.  src is read only once, into a StagedFile
+   * (see staging.c) from which all of the copies are made, so it doesn't
+   * matter if src changes meanwhile.  With dedupe, a VM whose ContentCache
+   * says it already holds src's content at dest is skipped, as "unchanged";
+   * either way, each VM's ContentCache records what was copied. */
+  static char* kwarg_list[] = {"vms", "src", "dest", "max_parallel",
+      "timeout", "dedupe", NULL
+    };
+  PyObject *vms;
+  char *src;
+  char *dest;
+  int maxParallel = DEFAULT_MAX_PARALLEL_JOBS;
+  PyObject *pyTimeout = NULL;
+  int dedupe = false;
+  JobDeadline deadline;
+
+  PyObject *vmSeq = NULL;
+  PyObject *results = NULL;
+  Job **jobs = NULL;
+  HostBroadcastBatch batch;
+  StagedFile *sf = NULL;
+  unsigned char digest[CONTENT_DIGEST_SIZE];
+  int64 bytes = 0;
+  VixError err = VIX_OK;
+  Py_ssize_t nVMs = 0;
+  Py_ssize_t i;
+
+  batch.vmHandles = NULL;
+  batch.contentCaches = NULL;
+  batch.submittedAt = NULL;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oss|iOi", kwarg_list,
+       &vms, &src, &dest, &maxParallel, &pyTimeout, &dedupe
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "broadcastFile", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  vmSeq = PySequence_Fast(vms, "vms must be a sequence of VMs.");
+  if (vmSeq == NULL) { goto fail; }
+  nVMs = PySequence_Fast_GET_SIZE(vmSeq);
+
+  LEAVE_PYTHON
+  sf = StagedFile_create(true);
+  if (sf == NULL) {
+    err = VIX_E_OUT_OF_MEMORY;
+  } else {
+    err = StagedFile_fill(sf, src, digest, &bytes);
+  }
+  ENTER_PYTHON
+  if (VIX_FAILED(err)) {
+    autoRaiseVIXError(err);
+    goto fail;
+  }
+
+  results = PyList_New(nVMs);
+  if (results == NULL) { goto fail; }
+  jobs = pyvix_main_malloc(sizeof(Job *) * (nVMs > 0 ? nVMs : 1));
+  batch.vmHandles = pyvix_main_malloc(
+      sizeof(VixHandle) * (nVMs > 0 ? nVMs : 1)
+    );
+  batch.contentCaches = pyvix_main_malloc(
+      sizeof(ContentCache *) * (nVMs > 0 ? nVMs : 1)
+    );
+  batch.submittedAt = pyvix_main_malloc(
+      sizeof(double) * (nVMs > 0 ? nVMs : 1)
+    );
+  if (jobs == NULL || batch.vmHandles == NULL || batch.contentCaches == NULL
+      || batch.submittedAt == NULL
+     )
+  {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  batch.stagedPath = sf->path;
+  batch.dest = dest;
+  batch.digest = digest;
+
+  for (i = 0; i < nVMs; i++) {
+    jobs[i] = NULL;
+    batch.vmHandles[i] = VIX_INVALID_HANDLE;
+    batch.submittedAt[i] = 0.0;
+  }
+  for (i = 0; i < nVMs; i++) {
+    VM *vm = (VM *) PySequence_Fast_GET_ITEM(vmSeq, i);
+    PyObject *entry;
+    PyObject *rejection;
+
+    if (!PyObject_TypeCheck(vm, &VMType)) {
+      PyErr_SetString(PyExc_TypeError, "vms must be a sequence of VMs.");
+      goto fail;
+    }
+    rejection = Batch_vmRejection(self, vm);
+    if (rejection != NULL) {
+      entry = Py_BuildValue("(OdsN)", vm, 0.0,
+          Pipeline_outcomeNames[PIPELINE_STEP_ERROR], rejection
+        );
+      if (entry == NULL) { goto fail; }
+      PyList_SET_ITEM(results, i, entry);
+      continue;
+    }
+    if (dedupe
+        && ContentCache_holds(vm->contentCache, dest, digest, bytes)
+       )
+    {
+      entry = Py_BuildValue("(OdsO)", vm, 0.0,
+          Pipeline_outcomeNames[PIPELINE_STEP_UNCHANGED], Py_None
+        );
+      if (entry == NULL) { goto fail; }
+      PyList_SET_ITEM(results, i, entry);
+      continue;
+    }
+
+    jobs[i] = Job_create((PyObject *) vm, JOB_RESULT_NONE);
+    if (jobs[i] == NULL) { goto fail; }
+    /* Each copy holds a reference to the StagedFile until VIX has read it: */
+    StagedFile_addRef(sf);
+    StagedFile_attach(sf, jobs[i]->completion);
+    /* Hold a reference to the handle in case the VM is closed by another
+     * thread while the GIL is released: */
+    batch.vmHandles[i] = vm->handle;
+    Vix_AddRefHandle(batch.vmHandles[i]);
+    batch.contentCaches[i] = vm->contentCache;
+  }
+
+  if (Batch_run(jobs, nVMs, maxParallel, deadline.at, self->admission,
+        ADMISSION_GUEST_IO, Host_submitBroadcastCopy, &batch
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  for (i = 0; i < nVMs; i++) {
+    PyObject *res;
+    PyObject *entry;
+    double completedAt;
+    PipelineStepOutcome outcome;
+    if (jobs[i] == NULL) { continue; }
+
+    PyVixMutex_lock(&jobs[i]->completion->lock);
+    completedAt = jobs[i]->completion->completedAt;
+    PyVixMutex_unlock(&jobs[i]->completion->lock);
+
+    res = Job_result(jobs[i], NO_DEADLINE);
+    if (res != NULL) {
+      outcome = PIPELINE_STEP_OK;
+    } else {
+      outcome = (jobs[i]->timedOut
+          ? PIPELINE_STEP_TIMEOUT : PIPELINE_STEP_ERROR
+        );
+      res = fetchRaisedException();
+    }
+    /* A copy that was never submitted took no time, and a cancelled one took
+     * until it was cancelled: */
+    entry = Py_BuildValue("(OdsN)", PySequence_Fast_GET_ITEM(vmSeq, i),
+        (batch.submittedAt[i] == 0.0 ? 0.0
+          : completedAt - batch.submittedAt[i]
+        ),
+        Pipeline_outcomeNames[outcome], res
+      );
+    if (entry == NULL) { goto fail; }
+    PyList_SET_ITEM(results, i, entry);
+  }
+  if (Batch_recordStep(jobs, nVMs, &deadline) != SUCCEEDED) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(results);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (jobs != NULL) {
+      for (i = 0; i < nVMs; i++) { Py_XDECREF(jobs[i]); }
+      pyvix_main_free(jobs);
+    }
+    if (batch.vmHandles != NULL) {
+      for (i = 0; i < nVMs; i++) {
+        if (batch.vmHandles[i] != VIX_INVALID_HANDLE) {
+          Vix_ReleaseHandle(batch.vmHandles[i]);
+        }
+      }
+      pyvix_main_free(batch.vmHandles);
+    }
+    if (batch.contentCaches != NULL) {
+      pyvix_main_free(batch.contentCaches);
+    }
+    if (batch.submittedAt != NULL) { pyvix_main_free(batch.submittedAt); }
+    /* The copies that are still in VIX's hands keep the file alive: */
+    if (sf != NULL) { StagedFile_release(sf); }
+    Py_XDECREF(vmSeq);
+    return results;
+} /* pyf_Host_broadcastFile */
+
+static PyObject *pyf_Host_runPipelines(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Runs the same pipeline (see pipeline.c) on every VM in the sequence vms,
+   * with at most max_parallel VMs' pipelines in progress at once, and returns
+   * a list with one entry per VM:  the list of (name, seconds, outcome, value)
+   * tuples that VM.runPipeline would have returned, or the exception raised
+   * if the VM couldn't take part.  The whole batch is recorded as a single
+   * step of the Deadline (if any) on which it draws.  If async_ is true, the
+   * batch is run by the worker pool instead, and a Job whose result is that
+   * list is returned. */
+  static char* kwarg_list[] = {"vms", "steps", "max_parallel", "async_",
+      "timeout", NULL
+    };
+  PyObject *vms;
+  PyObject *pySteps;
+  int maxParallel = DEFAULT_MAX_PARALLEL_JOBS;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  PyObject *vmSeq = NULL;
+  PyObject *stepTuples = NULL;
+  PipelineStep *steps = NULL;
+  PipelineStepResult *stepResults = NULL;
+  VM **runVMs = NULL;
+  PyObject *results = NULL;
+  Py_ssize_t nVMs = 0;
+  Py_ssize_t nSteps = 0;
+  Py_ssize_t i;
+  bool timedOut;
+  PyObject *job;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|iiO", kwarg_list,
+       &vms, &pySteps, &maxParallel, &async, &pyTimeout
+     ))
+  { goto fail; }
+
+  vmSeq = PySequence_Fast(vms, "vms must be a sequence of VMs.");
+  if (vmSeq == NULL) { goto fail; }
+  nVMs = PySequence_Fast_GET_SIZE(vmSeq);
+  steps = Pipeline_parseSteps(pySteps, &stepTuples, &nSteps);
+  if (steps == NULL) { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "runPipelines", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  results = PyList_New(nVMs);
+  if (results == NULL) { goto fail; }
+  runVMs = pyvix_main_malloc(sizeof(VM *) * (nVMs > 0 ? nVMs : 1));
+  stepResults = pyvix_main_malloc(sizeof(PipelineStepResult)
+      * (nVMs * nSteps > 0 ? nVMs * nSteps : 1)
+    );
+  if (runVMs == NULL || stepResults == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  for (i = 0; i < nVMs; i++) {
+    VM *vm = (VM *) PySequence_Fast_GET_ITEM(vmSeq, i);
+    PyObject *rejection;
+    runVMs[i] = NULL;
+
+    if (!PyObject_TypeCheck(vm, &VMType)) {
+      PyErr_SetString(PyExc_TypeError, "vms must be a sequence of VMs.");
+      goto fail;
+    }
+    rejection = Batch_vmRejection(self, vm);
+    if (rejection != NULL) {
+      PyList_SET_ITEM(results, i, rejection);
+      continue;
+    }
+    runVMs[i] = vm;
+  }
+
+  if (async) {
+    job = Pipeline_dispatch((PyObject *) self, self, runVMs, nVMs, stepTuples,
+        steps, nSteps, maxParallel, &deadline, results
+      );
+    if (job == NULL) { goto fail; }
+    Py_DECREF(results);
+    results = job;
+    goto cleanup;
+  }
+
+  if (Pipeline_execute(runVMs, nVMs, steps, nSteps, maxParallel, deadline.at,
+        stepResults
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  if (Pipeline_fillBatchResults(results, steps, stepResults, nVMs, nSteps,
+        &timedOut
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  if (JobDeadline_recordStep(&deadline, (timedOut ? "timeout" : "ok"))
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(results);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (stepResults != NULL) { pyvix_main_free(stepResults); }
+    if (runVMs != NULL) { pyvix_main_free(runVMs); }
+    if (steps != NULL) { pyvix_main_free(steps); }
+    Py_XDECREF(stepTuples);
+    Py_XDECREF(vmSeq);
+    return results;
+} /* pyf_Host_runPipelines */
+
+/* Host.propertyTable builds each numeric column as an array.array of this
+ * typecode: */
+#define PROPERTY_TABLE_INT_TYPECODE "i"
+#if SIZEOF_LONG >= 8
+  #define PROPERTY_TABLE_INT64_TYPECODE "l"
+  typedef long PropertyTableInt64;
+#else
+  #define PROPERTY_TABLE_INT64_TYPECODE "d"
+  typedef double PropertyTableInt64;
+#endif
+
+static PyObject *Host_buildPropertyColumn(PyObject *arrayType,
+    VixPropertyType propType, const PropertyValue *vals, Py_ssize_t stride,
+    Py_ssize_t nRows, const VixError *rowErrs
+  )
+{
+  /* Builds the column of one property from vals[0], vals[stride], ...:  a
+   * list of strings (None for failed rows) for a string property, otherwise
+   * an array.array (in which failed rows hold 0). */
+  PyObject *col = NULL;
+  PyObject *pyBytes = NULL;
+  Py_ssize_t i;
+
+  if (propType == VIX_PROPERTYTYPE_STRING) {
+    col = PyList_New(nRows);
+    if (col == NULL) { goto fail; }
+    for (i = 0; i < nRows; i++) {
+      PyObject *pyStr;
+      if (VIX_FAILED(rowErrs[i])) {
+        pyStr = Py_None;
+        Py_INCREF(pyStr);
+      } else {
+        assert (vals[i * stride].s != NULL);
+        pyStr = PyString_FromString(vals[i * stride].s);
+        if (pyStr == NULL) { goto fail; }
+      }
+      PyList_SET_ITEM(col, i, pyStr);
+    }
+  } else if (propType == VIX_PROPERTYTYPE_INT64) {
+    PropertyTableInt64 *buf;
+    pyBytes = PyString_FromStringAndSize(NULL,
+        sizeof(PropertyTableInt64) * nRows
+      );
+    if (pyBytes == NULL) { goto fail; }
+    buf = (PropertyTableInt64 *) PyString_AS_STRING(pyBytes);
+    for (i = 0; i < nRows; i++) {
+      buf[i] = (VIX_FAILED(rowErrs[i])
+          ? 0 : (PropertyTableInt64) vals[i * stride].i64
+        );
+    }
+    col = PyObject_CallFunction(arrayType, "sO",
+        PROPERTY_TABLE_INT64_TYPECODE, pyBytes
+      );
+    if (col == NULL) { goto fail; }
+  } else {
+    int *buf;
+    assert (propType == VIX_PROPERTYTYPE_INTEGER
+        || propType == VIX_PROPERTYTYPE_BOOL
+      );
+    pyBytes = PyString_FromStringAndSize(NULL, sizeof(int) * nRows);
+    if (pyBytes == NULL) { goto fail; }
+    buf = (int *) PyString_AS_STRING(pyBytes);
+    for (i = 0; i < nRows; i++) {
+      buf[i] = (VIX_FAILED(rowErrs[i]) ? 0 : vals[i * stride].i);
+    }
+    col = PyObject_CallFunction(arrayType, "sO",
+        PROPERTY_TABLE_INT_TYPECODE, pyBytes
+      );
+    if (col == NULL) { goto fail; }
+  }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(col);
+    /* Fall through to cleanup: */
+  cleanup:
+    Py_XDECREF(pyBytes);
+    return col;
+} /* Host_buildPropertyColumn */
+
+static PyObject *pyf_Host_propertyTable(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Fetches the properties props of every VM in vms, with the GIL released
+   * throughout the VIX calls, and returns the results by column:  a dict
+   * that maps each property ID to its column (see Host_buildPropertyColumn),
+   * 'vmxPath' to a list of the VMs' paths, and 'errors' to a list that holds
+   * None for each VM whose properties were fetched, and the exception that
+   * prevented it otherwise. */
+  static char* kwarg_list[] = {"vms", "props", NULL};
+  PyObject *vms;
+  PyObject *props;
+
+  PyObject *vmSeq = NULL;
+  PyObject *propSeq = NULL;
+  PyObject *arrayModule = NULL;
+  PyObject *arrayType = NULL;
+  PyObject *table = NULL;
+  PyObject *paths = NULL;
+  PyObject *errors = NULL;
+  VixPropertyID *propIDs = NULL;
+  VixPropertyType *types = NULL;
+  VixHandle *vmHandles = NULL;
+  VixError *rowErrs = NULL;
+  PropertyValue *vals = NULL;
+  VixHandle typeH = VIX_INVALID_HANDLE;
+  VixError err = VIX_OK;
+  Py_ssize_t nVMs = 0;
+  Py_ssize_t nProps = 0;
+  Py_ssize_t i, j;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", kwarg_list,
+       &vms, &props
+     ))
+  { goto fail; }
+
+  vmSeq = PySequence_Fast(vms, "vms must be a sequence of VMs.");
+  if (vmSeq == NULL) { goto fail; }
+  nVMs = PySequence_Fast_GET_SIZE(vmSeq);
+  propSeq = PySequence_Fast(props, "props must be a sequence of property IDs.");
+  if (propSeq == NULL) { goto fail; }
+  nProps = PySequence_Fast_GET_SIZE(propSeq);
+
+  arrayModule = PyImport_ImportModule("array");
+  if (arrayModule == NULL) { goto fail; }
+  arrayType = PyObject_GetAttrString(arrayModule, "array");
+  if (arrayType == NULL) { goto fail; }
+
+  propIDs = pyvix_main_malloc(
+      sizeof(VixPropertyID) * (nProps > 0 ? nProps : 1)
+    );
+  types = pyvix_main_malloc(
+      sizeof(VixPropertyType) * (nProps > 0 ? nProps : 1)
+    );
+  vmHandles = pyvix_main_malloc(sizeof(VixHandle) * (nVMs > 0 ? nVMs : 1));
+  rowErrs = pyvix_main_malloc(sizeof(VixError) * (nVMs > 0 ? nVMs : 1));
+  vals = pyvix_main_malloc(sizeof(PropertyValue)
+      * (nVMs * nProps > 0 ? nVMs * nProps : 1)
+    );
+  if (propIDs == NULL || types == NULL || vmHandles == NULL || rowErrs == NULL
+      || vals == NULL
+     )
+  {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  for (j = 0; j < nProps; j++) {
+    const long intPropID = PyInt_AsLong(PySequence_Fast_GET_ITEM(propSeq, j));
+    if (PyErr_Occurred()) { goto fail; }
+    propIDs[j] = (VixPropertyID) intPropID;
+    types[j] = VIX_PROPERTYTYPE_ANY;
+  }
+  for (i = 0; i < nVMs; i++) {
+    vmHandles[i] = VIX_INVALID_HANDLE;
+    rowErrs[i] = VIX_OK;
+  }
+  for (i = 0; i < nVMs * nProps; i++) { vals[i].s = NULL; }
+
+  paths = PyList_New(nVMs);
+  if (paths == NULL) { goto fail; }
+  errors = PyList_New(nVMs);
+  if (errors == NULL) { goto fail; }
+  for (i = 0; i < nVMs; i++) {
+    VM *vm = (VM *) PySequence_Fast_GET_ITEM(vmSeq, i);
+    PyObject *pyPath;
+    PyObject *rejection;
+
+    if (!PyObject_TypeCheck(vm, &VMType)) {
+      PyErr_SetString(PyExc_TypeError, "vms must be a sequence of VMs.");
+      goto fail;
+    }
+    if (vm->vmxPath != NULL) {
+      pyPath = PyString_FromString(vm->vmxPath);
+      if (pyPath == NULL) { goto fail; }
+    } else {
+      pyPath = Py_None;
+      Py_INCREF(pyPath);
+    }
+    PyList_SET_ITEM(paths, i, pyPath);
+
+    rejection = Batch_vmRejection(self, vm);
+    if (rejection != NULL) {
+      PyList_SET_ITEM(errors, i, rejection);
+      rowErrs[i] = VIX_E_FAIL;
+      continue;
+    }
+    Py_INCREF(Py_None);
+    PyList_SET_ITEM(errors, i, Py_None);
+    /* Hold a reference to the handle in case the VM is closed by another
+     * thread while the GIL is released: */
+    vmHandles[i] = vm->handle;
+    Vix_AddRefHandle(vmHandles[i]);
+    if (typeH == VIX_INVALID_HANDLE) { typeH = vmHandles[i]; }
+  }
+
+  /* The types are looked up on a single VM, since they don't vary: */
+  if (typeH != VIX_INVALID_HANDLE) {
+    LEAVE_PYTHON
+    for (j = 0; j < nProps && !VIX_FAILED(err); j++) {
+      err = PropertyTypeCache_lookup(typeH, propIDs[j], &types[j]);
+    }
+    ENTER_PYTHON
+    CHECK_VIX_ERROR(err);
+  }
+  for (j = 0; j < nProps; j++) {
+    switch (types[j]) {
+      case VIX_PROPERTYTYPE_STRING:
+      case VIX_PROPERTYTYPE_INTEGER:
+      case VIX_PROPERTYTYPE_INT64:
+      case VIX_PROPERTYTYPE_BOOL:
+        break;
+      case VIX_PROPERTYTYPE_ANY:
+        /* No VM was available to look the type up on, so every row has
+         * failed; the column's type hardly matters: */
+        if (typeH == VIX_INVALID_HANDLE) {
+          types[j] = VIX_PROPERTYTYPE_INTEGER;
+          break;
+        }
+        /* Fall through: */
+      default:
+        raiseNonNumericVIXError(VIXInternalError,
+            "Unable to extract this property type."
+          );
+        goto fail;
+    }
+  }
+
+  LEAVE_PYTHON
+  for (i = 0; i < nVMs; i++) {
+    if (vmHandles[i] == VIX_INVALID_HANDLE) { continue; }
+    for (j = 0; j < nProps && !VIX_FAILED(rowErrs[i]);
+         j += PROPERTY_BATCH_SIZE
+        )
+    {
+      rowErrs[i] = fetchPropertyBatch(vmHandles[i], propIDs + j,
+          vals + i * nProps + j,
+          (nProps - j < PROPERTY_BATCH_SIZE ? nProps - j : PROPERTY_BATCH_SIZE)
+        );
+    }
+  }
+  ENTER_PYTHON
+
+  for (i = 0; i < nVMs; i++) {
+    if (vmHandles[i] == VIX_INVALID_HANDLE || !VIX_FAILED(rowErrs[i])) {
+      continue;
+    }
+    autoRaiseVIXError(rowErrs[i]);
+    Py_DECREF(PyList_GET_ITEM(errors, i));
+    PyList_SET_ITEM(errors, i, fetchRaisedException());
+  }
+
+  table = PyDict_New();
+  if (table == NULL) { goto fail; }
+  for (j = 0; j < nProps; j++) {
+    PyObject *col = Host_buildPropertyColumn(arrayType, types[j], vals + j,
+        nProps, nVMs, rowErrs
+      );
+    if (col == NULL) { goto fail; }
+    if (PyDict_SetItem(table, PySequence_Fast_GET_ITEM(propSeq, j), col) != 0) {
+      Py_DECREF(col);
+      goto fail;
+    }
+    Py_DECREF(col);
+  }
+  if (PyDict_SetItemString(table, "vmxPath", paths) != 0) { goto fail; }
+  if (PyDict_SetItemString(table, "errors", errors) != 0) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(table);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (vals != NULL && types != NULL) {
+      for (i = 0; i < nVMs; i++) {
+        for (j = 0; j < nProps; j++) {
+          if (types[j] == VIX_PROPERTYTYPE_STRING
+              && vals[i * nProps + j].s != NULL
+             )
+          { pyvix_vix_buffer_free(vals[i * nProps + j].s); }
+        }
+      }
+    }
+    if (vmHandles != NULL) {
+      for (i = 0; i < nVMs; i++) {
+        if (vmHandles[i] != VIX_INVALID_HANDLE) {
+          Vix_ReleaseHandle(vmHandles[i]);
+        }
+      }
+      pyvix_main_free(vmHandles);
+    }
+    if (vals != NULL) { pyvix_main_free(vals); }
+    if (rowErrs != NULL) { pyvix_main_free(rowErrs); }
+    if (types != NULL) { pyvix_main_free(types); }
+    if (propIDs != NULL) { pyvix_main_free(propIDs); }
+    Py_XDECREF(errors);
+    Py_XDECREF(paths);
+    Py_XDECREF(arrayType);
+    Py_XDECREF(arrayModule);
+    Py_XDECREF(propSeq);
+    Py_XDECREF(vmSeq);
+    return table;
+} /* pyf_Host_propertyTable */
+
+static PyObject *pyf_Host_watchPowerState(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  static char* kwarg_list[] = {"callback", "interval", NULL};
+  PyObject *callback;
+  double interval = 1.0;
+
+  HOST_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|d", kwarg_list,
+       &callback, &interval
+     ))
+  { goto fail; }
+
+  if (self->watcher != NULL) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "This Host's power states are already being watched."
+      );
+    goto fail;
+  }
+
+  self->watcher = PowerStateWatcher_start(self, callback, interval);
+  if (self->watcher == NULL) { goto fail; }
+
+  Py_INCREF(self->watcher);
+  return (PyObject *) self->watcher;
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_Host_watchPowerState */
+
+static PyObject *pyf_Host_powerStateWatcher_get(Host *self, void *closure) {
+  PyObject *watcher = (self->watcher != NULL
+      ? (PyObject *) self->watcher : Py_None
+    );
+  Py_INCREF(watcher);
+  return watcher;
+} /* pyf_Host_powerStateWatcher_get */
+
+static PyObject *pyf_Host_workerLimit_get(Host *self, void *closure) {
+  const int limit = WorkerPool_hostLimit(self);
+  if (limit < 0) { Py_RETURN_NONE; }
+  return PyInt_FromLong(limit);
+} /* pyf_Host_workerLimit_get */
+
+static int pyf_Host_workerLimit_set(Host *self, PyObject *value,
+    void *closure
+  )
+{
+  long limit = -1;
+
+  if (value == NULL) {
+    PyErr_SetString(PyExc_TypeError, "Can't delete workerLimit.");
+    return -1;
+  }
+  /* None defers to the pool's per_host_limit: */
+  if (value != Py_None) {
+    limit = PyInt_AsLong(value);
+    if (PyErr_Occurred()) { return -1; }
+    if (limit < 0 || limit > INT_MAX) {
+      raiseNonNumericVIXError(VIXClientProgrammerError,
+          "workerLimit must be None or a non-negative int."
+        );
+      return -1;
+    }
+  }
+
+  WorkerPool_setHostLimit(self, (int) limit);
+  return 0;
+} /* pyf_Host_workerLimit_set */
+
+static PyObject *pyf_Host_setAdmissionLimits(Host *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Changes the limit on the number of operations of each class given
+   * (power, snapshot or guest_io) that may be in flight on this Host at once;
+   * 0 lifts the limit.  Operations beyond a limit wait their turn. */
+  static char* kwarg_list[] = {"power", "snapshot", "guest_io", NULL};
+  PyObject *pyLimits[N_ADMISSION_CLASSES] = {NULL, NULL, NULL};
+  long limits[N_ADMISSION_CLASSES];
+  int i;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOO", kwarg_list,
+       &pyLimits[ADMISSION_POWER], &pyLimits[ADMISSION_SNAPSHOT],
+       &pyLimits[ADMISSION_GUEST_IO]
+     ))
+  { goto fail; }
+
+  /* Every limit is validated before any is changed: */
+  for (i = 0; i < N_ADMISSION_CLASSES; i++) {
+    if (pyLimits[i] == NULL) { continue; }
+    limits[i] = PyInt_AsLong(pyLimits[i]);
+    if (PyErr_Occurred()) { goto fail; }
+    if (limits[i] < 0 || limits[i] > INT_MAX) {
+      raiseNonNumericVIXError(VIXClientProgrammerError,
+          "Admission limits must be non-negative ints."
+        );
+      goto fail;
+    }
+  }
+  for (i = 0; i < N_ADMISSION_CLASSES; i++) {
+    if (pyLimits[i] == NULL) { continue; }
+    AdmissionGate_setLimit(self->admission, (AdmissionClass) i,
+        (int) limits[i]
+      );
+  }
+
+  Py_RETURN_NONE;
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_Host_setAdmissionLimits */
+
+static PyObject *pyf_Host_admissionStats(Host *self) {
+  /* Returns a dict that maps each class of operation to a dict of its limit,
+   * the number of its operations in flight and waiting, and how many have
+   * been admitted, had to wait (for how long in total and at most), or gave
+   * up waiting. */
+  return AdmissionGate_stats(self->admission);
+} /* pyf_Host_admissionStats */
 
 static PyMethodDef Host_methods[] = {
     {"close",
@@ -247,20 +1535,76 @@ static PyMethodDef Host_methods[] = {
       },
     {"findRunningVMPaths",
         (PyCFunction) pyf_Host_findRunningVMPaths,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"iterRunningVMPaths",
+        (PyCFunction) pyf_Host_iterRunningVMPaths,
         METH_NOARGS
       },
     {"registerVM",
         (PyCFunction) pyf_Host_registerVM,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"unregisterVM",
         (PyCFunction) pyf_Host_unregisterVM,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"openVM",
         (PyCFunction) pyf_Host_openVM,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"openVMs",
+        (PyCFunction) pyf_Host_openVMs,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"getOpenVM",
+        (PyCFunction) pyf_Host_getOpenVM,
         METH_VARARGS
       },
+    {"powerOnMany",
+        (PyCFunction) pyf_Host_powerOnMany,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"powerOffMany",
+        (PyCFunction) pyf_Host_powerOffMany,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"resetMany",
+        (PyCFunction) pyf_Host_resetMany,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"suspendMany",
+        (PyCFunction) pyf_Host_suspendMany,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"broadcastFile",
+        (PyCFunction) pyf_Host_broadcastFile,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"runPipelines",
+        (PyCFunction) pyf_Host_runPipelines,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"propertyTable",
+        (PyCFunction) pyf_Host_propertyTable,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"watchPowerState",
+        (PyCFunction) pyf_Host_watchPowerState,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"setAdmissionLimits",
+        (PyCFunction) pyf_Host_setAdmissionLimits,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"admissionStats",
+        (PyCFunction) pyf_Host_admissionStats,
+        METH_NOARGS
+      },
+    {"getProperties",
+        (PyCFunction) pyf_StatefulHandleWrapper_getProperties,
+        METH_O
+      },
     {NULL}  /* sentinel */
   };
 
@@ -270,6 +1614,23 @@ static PyGetSetDef Host_getters_setters[] = {
       NULL,
       "True if the connection to the Host is *known* to be closed."
     },
+    {"openVMsByPath",
+      (getter) pyf_Host_openVMsByPath_get,
+      NULL,
+      "A dict that maps the vmxPath of each open VM opened via this Host to"
+      " the VM."
+    },
+    {"powerStateWatcher",
+      (getter) pyf_Host_powerStateWatcher_get,
+      NULL,
+      "The running PowerStateWatcher started by watchPowerState, or None."
+    },
+    {"workerLimit",
+      (getter) pyf_Host_workerLimit_get,
+      (setter) pyf_Host_workerLimit_set,
+      "The most worker pool threads that may run this Host's tasks at once (0"
+      " for no limit), or None to follow the pool's per_host_limit."
+    },
     {NULL}  /* sentinel */
   };
 
@@ -0,0 +1,136 @@
+/******************************************************************************
+ * pyvix - Intrusive Doubly-Linked Tracker Type
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+#ifndef INTRUSIVE_TRACKER_H
+#define INTRUSIVE_TRACKER_H
+
+/* A tracker records the open objects (e.g., the VMs of a Host) that must be
+ * closed when their container is.  Rather than allocating a separate node per
+ * object and searching the list for that node upon removal (as pyvix's former
+ * LIFO linked lists did), a tracker links the objects themselves together
+ * through the TRACKER_LINKS field that each of them embeds.  Adding and
+ * removing an object are therefore O(1), and never allocate.
+ *
+ * The GIL must be held during method calls to a tracker, because _release
+ * calls the contained type's _untrack function, and _remove may raise. */
+
+#define DEFINE_TRACKER_TYPES(ContainedType) \
+  typedef struct _ ## ContainedType ## Tracker { \
+    struct _ ## ContainedType *head; \
+    Py_ssize_t count; \
+  } ContainedType ## Tracker;
+
+/* To be embedded in the struct of the ContainedType: */
+#define TRACKER_LINKS(ContainedType) \
+  struct { \
+    struct _ ## ContainedType *prev; \
+    struct _ ## ContainedType *next; \
+    /* The tracker that the object is in, if any: */ \
+    struct _ ## ContainedType ## Tracker *tracker; \
+  } trackerLinks;
+
+#define TRACKER_INIT(trackerPtr) \
+  ((trackerPtr)->head = NULL, (trackerPtr)->count = 0)
+
+#define TRACKER_LINKS_INIT(cont) \
+  ((cont)->trackerLinks.prev = NULL, \
+   (cont)->trackerLinks.next = NULL, \
+   (cont)->trackerLinks.tracker = NULL)
+
+#define TRACKER_IS_EMPTY(trackerPtr) ((trackerPtr)->head == NULL)
+
+#define TRACKER_DEFINE_UNLINK(ContainedType) \
+  static void ContainedType ## Tracker_unlink( \
+      ContainedType ## Tracker *tracker, ContainedType *cont \
+    ) \
+  { \
+    ContainedType *prev = cont->trackerLinks.prev; \
+    ContainedType *next = cont->trackerLinks.next; \
+    \
+    assert (cont->trackerLinks.tracker == tracker); \
+    if (prev != NULL) { \
+      prev->trackerLinks.next = next; \
+    } else { \
+      assert (tracker->head == cont); \
+      tracker->head = next; \
+    } \
+    if (next != NULL) { next->trackerLinks.prev = prev; } \
+    \
+    TRACKER_LINKS_INIT(cont); \
+    tracker->count--; \
+  }
+
+#define TRACKER_DEFINE_ADD(ContainedType) \
+  static status ContainedType ## Tracker_add( \
+      ContainedType ## Tracker *tracker, ContainedType *cont \
+    ) \
+  { \
+    /* New objects go at the head, so that _release closes the most recently \
+     * opened objects first, as the LIFO lists did. */ \
+    assert (tracker != NULL); \
+    assert (cont->trackerLinks.tracker == NULL); \
+    \
+    cont->trackerLinks.prev = NULL; \
+    cont->trackerLinks.next = tracker->head; \
+    if (tracker->head != NULL) { tracker->head->trackerLinks.prev = cont; } \
+    tracker->head = cont; \
+    cont->trackerLinks.tracker = tracker; \
+    tracker->count++; \
+    \
+    return SUCCEEDED; \
+  }
+
+#define TRACKER_DEFINE_REMOVE(ContainedType) \
+  static status ContainedType ## Tracker_remove( \
+      ContainedType ## Tracker *tracker, ContainedType *cont, \
+      bool object_if_missing \
+    ) \
+  { \
+    if (cont->trackerLinks.tracker != tracker) { \
+      if (!object_if_missing) { \
+        return SUCCEEDED; \
+      } else { \
+        raiseNonNumericVIXError(VIXInternalError, \
+            # ContainedType "Tracker_remove: object was not in tracker" \
+          ); \
+        return FAILED; \
+      } \
+    } \
+    \
+    ContainedType ## Tracker_unlink(tracker, cont); \
+    return SUCCEEDED; \
+  }
+
+#define TRACKER_DEFINE_RELEASE(ContainedType) \
+  static status ContainedType ## Tracker_release( \
+      ContainedType ## Tracker *tracker \
+    ) \
+  { \
+    assert (tracker != NULL); \
+    \
+    while (tracker->head != NULL) { \
+      ContainedType *cont = tracker->head; \
+      \
+      /* Unlink cont before directing it to untrack itself, so that it \
+       * doesn't try to unlink itself upon closure. */ \
+      ContainedType ## Tracker_unlink(tracker, cont); \
+      if (ContainedType ## _untrack(cont, true) != SUCCEEDED) { \
+        /* Put cont back, so that the rest of the tracker isn't lost: */ \
+        ContainedType ## Tracker_add(tracker, cont); \
+        return FAILED; \
+      } \
+    } \
+    \
+    assert (tracker->count == 0); \
+    return SUCCEEDED; \
+  }
+
+#define TRACKER_DEFINE_BASIC_METHODS(ContainedType) \
+  TRACKER_DEFINE_UNLINK(ContainedType) \
+  TRACKER_DEFINE_ADD(ContainedType) \
+  TRACKER_DEFINE_REMOVE(ContainedType) \
+  TRACKER_DEFINE_RELEASE(ContainedType)
+
+#endif /* not def INTRUSIVE_TRACKER_H */
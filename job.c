@@ -0,0 +1,1052 @@
+/******************************************************************************
+ * pyvix - Implementation of Job Class
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* A Job represents a VIX job that has been submitted, but whose completion is
+ * reported asynchronously:  instead of blocking a thread in VixJob_Wait, pyvix
+ * registers Job_vixCallback as the job's callbackProc, and that callback
+ * records the outcome in the Job's JobCompletion.
+ *
+ * The synchronous methods of VM and Host use the same machinery; they simply
+ * wait for the Job to complete before returning its result.
+ *
+ * A Job can also be completed locally, by cancelling it, in which case it
+ * fails with VIX_E_CANCELLED.  VIX offers no way to stop a job that it's
+ * working on, so VIX's own report on a cancelled job is discarded whenever it
+ * arrives; until then, VIX's reference keeps the JobCompletion (and the job
+ * handle) alive.  A job issued with a timeout is cancelled in this way once
+ * its deadline has passed, and then raises VIXTimeoutError. */
+
+#define Job_changeState(job, newState) \
+  StatefulHandleWrapper_changeState((StatefulHandleWrapper *) (job), newState)
+
+/* Defined in snapshot.c and vm.c: */
+static PyObject *Snapshot_createFromHandle(VM *vm, VixHandle snapH);
+static PyObject *VM_createFromHandle(Host *host, PyObject *pyVMXPath,
+    VixHandle vmH
+  );
+/* Defined in admission.c: */
+static void AdmissionGate_leave(AdmissionGate *gate, AdmissionClass cls);
+static void AdmissionGate_release(AdmissionGate *gate);
+/* Defined in content_cache.c: */
+static void ContentCache_jobFinished(JobCompletion *jc, ContentCache *cache,
+    bool succeeded
+  );
+/* Defined in staging.c: */
+static void StagedFile_release(StagedFile *sf);
+static PyObject *StagedFile_readAll(StagedFile *sf);
+
+/* JobCompletions are released by whichever thread drops the last reference,
+ * often one of VIX's, hence the threadsafe series: */
+static PyVixSlab JobCompletion_slab;
+
+static status initSupport_Job(void) {
+  /* JobType is a new-style class, so PyType_Ready must be called before its
+   * getters and setters will function. */
+  if (PyType_Ready(&JobType) < 0) { goto fail; }
+  if (PyType_Ready(&JobItemIteratorType) < 0) { goto fail; }
+
+  PyVixSlab_init(&JobCompletion_slab, "JobCompletion",
+      sizeof(JobCompletion), 64, true
+    );
+
+  return SUCCEEDED;
+  fail:
+    /* This function is indirectly called by the module loader, which makes no
+     * provision for error recovery. */
+    return FAILED;
+} /* initSupport_Job */
+
+/*************************** JobCompletion ***********************************/
+
+static JobCompletion *JobCompletion_new(bool wantsResultHandle) {
+  /* The GIL need not be held. */
+  JobCompletion *jc = pyvix_slab_locked_malloc(&JobCompletion_slab);
+  if (jc == NULL) { return NULL; }
+
+  if (PyVixEvent_init(&jc->finished) != SUCCEEDED) {
+    pyvix_slab_locked_free(&JobCompletion_slab, jc);
+    return NULL;
+  }
+  PyVixMutex_init(&jc->lock);
+
+  /* One reference for the Job object, one for VIX: */
+  jc->refCount = 2;
+
+  jc->completed = false;
+  jc->vixFinished = false;
+  jc->jobH = VIX_INVALID_HANDLE;
+  jc->err = VIX_OK;
+  jc->wantsResultHandle = wantsResultHandle;
+  jc->resultH = VIX_INVALID_HANDLE;
+  jc->completedAt = 0.0;
+  jc->admission = NULL;
+  jc->contentCache = NULL;
+  jc->contentKey = NULL;
+  jc->staged = NULL;
+
+  jc->port = NULL;
+  jc->portNext = NULL;
+
+  jc->acc.target = NULL;
+  jc->acc.ring = NULL;
+  jc->doneCallbacks = NULL;
+  jc->portJob = NULL;
+  jc->taskResult = NULL;
+
+  return jc;
+} /* JobCompletion_new */
+
+static void JobCompletion_runCallbacks(PyObject *callbacks) {
+  /* The GIL must be held.  callbacks is a list of (callable, args) tuples. */
+  Py_ssize_t i;
+
+  assert (PyList_CheckExact(callbacks));
+  for (i = 0; i < PyList_GET_SIZE(callbacks); i++) {
+    PyObject *entry = PyList_GET_ITEM(callbacks, i);
+    PyObject *cbRes = PyObject_CallObject(
+        PyTuple_GET_ITEM(entry, 0), PyTuple_GET_ITEM(entry, 1)
+      );
+    /* There's nobody to report a callback's exception to: */
+    if (cbRes == NULL) {
+      SUPPRESS_EXCEPTION;
+    } else {
+      Py_DECREF(cbRes);
+    }
+  }
+} /* JobCompletion_runCallbacks */
+
+static bool JobCompletion_complete(JobCompletion *jc, VixHandle jobH,
+    VixError err, bool reportedByVIX
+  )
+{
+  /* Records the outcome of the job, wakes any waiters, and posts the job to
+   * its CompletionPort (if any).  Only the first outcome recorded counts; the
+   * return value indicates whether it was this one.  The GIL need not be
+   * held; it's acquired only if there are done-callbacks to run. */
+  VixHandle resultH = VIX_INVALID_HANDLE;
+  PyObject *callbacks;
+  CompletionPort *port;
+  PyObject *orphanedJob = NULL;
+  AdmissionGate *admission = NULL;
+  ContentCache *contentCache = NULL;
+  StagedFile *discarded = NULL;
+  /* Whether the job did its work in the guest, judged before err can be
+   * overwritten below: */
+  const bool succeeded = !VIX_FAILED(err);
+
+  if (jobH != VIX_INVALID_HANDLE && !VIX_FAILED(err) && jc->wantsResultHandle) {
+    err = Vix_GetProperties(jobH,
+        VIX_PROPERTY_JOB_RESULT_HANDLE, &resultH,
+        VIX_PROPERTY_NONE
+      );
+  }
+
+  PyVixMutex_lock(&jc->lock);
+  if (jc->jobH == VIX_INVALID_HANDLE) { jc->jobH = jobH; }
+  if (reportedByVIX) {
+    jc->vixFinished = true;
+    /* VIX is done with the job, so its admission slot can be given back: */
+    admission = jc->admission;
+    jc->admission = NULL;
+    /* Likewise, what it did to the guest's files is now known: */
+    contentCache = jc->contentCache;
+    jc->contentCache = NULL;
+    /* ...and the file it copied from is no longer needed: */
+    if (jc->staged != NULL && jc->staged->discardWhenDone) {
+      discarded = jc->staged;
+      jc->staged = NULL;
+    }
+  }
+  if (jc->completed) {
+    /* The job was cancelled before VIX reported on it: */
+    PyVixMutex_unlock(&jc->lock);
+    if (admission != NULL) {
+      AdmissionGate_leave(admission, jc->admissionClass);
+      AdmissionGate_release(admission);
+    }
+    if (contentCache != NULL) {
+      ContentCache_jobFinished(jc, contentCache, succeeded);
+    }
+    if (discarded != NULL) { StagedFile_release(discarded); }
+    if (resultH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(resultH); }
+    return false;
+  }
+  jc->err = err;
+  jc->resultH = resultH;
+  jc->completedAt = PyVixClock_now();
+  jc->completed = true;
+  callbacks = jc->doneCallbacks;
+  jc->doneCallbacks = NULL;
+  port = jc->port;
+  jc->port = NULL;
+  PyVixMutex_unlock(&jc->lock);
+
+  if (admission != NULL) {
+    AdmissionGate_leave(admission, jc->admissionClass);
+    AdmissionGate_release(admission);
+  }
+  /* Updated before anyone is woken, so that a copy that follows this one
+   * sees its effect: */
+  if (contentCache != NULL) {
+    ContentCache_jobFinished(jc, contentCache, succeeded);
+  }
+  if (discarded != NULL) { StagedFile_release(discarded); }
+
+  PyVixEvent_signal(&jc->finished);
+  /* Wake anyone streaming the job's items, so they notice it has finished: */
+  if (jc->acc.ring != NULL) { PyVixEvent_signal(&jc->acc.ring->pushed); }
+
+  if (port != NULL) {
+    /* If the CompletionQueue has gone away in the meantime, the reference to
+     * the Job that was meant for it must be dropped here instead: */
+    if (!CompletionPort_post(port, jc)) {
+      orphanedJob = jc->portJob;
+      jc->portJob = NULL;
+    }
+    CompletionPort_release(port);
+  }
+
+  if (callbacks != NULL || orphanedJob != NULL) {
+    PyGILState_STATE gstate;
+    ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+    if (callbacks != NULL) {
+      JobCompletion_runCallbacks(callbacks);
+      Py_DECREF(callbacks);
+    }
+    /* This may well deallocate the Job, but VIX's reference still keeps jc
+     * itself alive: */
+    Py_XDECREF(orphanedJob);
+    LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  }
+
+  return true;
+} /* JobCompletion_complete */
+
+static bool JobCompletion_cancel(JobCompletion *jc) {
+  /* Completes the job locally with VIX_E_CANCELLED, unless it has already
+   * completed; returns whether it hadn't.  The GIL need not be held. */
+  return JobCompletion_complete(jc, VIX_INVALID_HANDLE, VIX_E_CANCELLED,
+      false
+    );
+} /* JobCompletion_cancel */
+
+static void JobCompletion_release(JobCompletion *jc) {
+  /* Drops one reference to jc, freeing it if that was the last.  The GIL may
+   * or may not be held by the calling thread. */
+  bool isLast;
+
+  PyVixMutex_lock(&jc->lock);
+  isLast = (--jc->refCount == 0);
+  PyVixMutex_unlock(&jc->lock);
+  if (!isLast) { return; }
+
+  /* A pending post would hold a reference to the Job, which in turn holds a
+   * reference to jc: */
+  assert (jc->portJob == NULL);
+  if (jc->port != NULL) { CompletionPort_release(jc->port); }
+  /* Set only if the job was admitted but never passed to VIX: */
+  if (jc->admission != NULL) {
+    AdmissionGate_leave(jc->admission, jc->admissionClass);
+    AdmissionGate_release(jc->admission);
+  }
+  /* Likewise, set only if the job never reached VIX: */
+  if (jc->contentCache != NULL) {
+    ContentCache_jobFinished(jc, jc->contentCache, false);
+  }
+  if (jc->staged != NULL) { StagedFile_release(jc->staged); }
+
+  /* The event ring holds no Python objects, so it's freed without the GIL: */
+  if (jc->acc.ring != NULL) {
+    VixEventRing_free(jc->acc.ring);
+    jc->acc.ring = NULL;
+  }
+
+  if (jc->acc.target != NULL || jc->doneCallbacks != NULL
+      || jc->taskResult != NULL
+     )
+  {
+    /* PyGILState_Ensure is safe even if this thread already holds the GIL. */
+    PyGILState_STATE gstate;
+    ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+    VixCallbackAccumulator_clear(&jc->acc);
+    Py_CLEAR(jc->doneCallbacks);
+    Py_CLEAR(jc->taskResult);
+    LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  }
+
+  if (jc->resultH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jc->resultH); }
+  if (jc->jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jc->jobH); }
+
+  PyVixEvent_destroy(&jc->finished);
+  PyVixMutex_destroy(&jc->lock);
+  pyvix_slab_locked_free(&JobCompletion_slab, jc);
+} /* JobCompletion_release */
+
+static void Job_vixCallback(VixHandle jobH, VixEventType eventType,
+    VixHandle eventInfo, void *clientData
+  )
+{
+  /* This is the callbackProc of every VIX job pyvix submits.  It runs on a
+   * VIX worker thread, without the GIL. */
+  JobCompletion *jc = (JobCompletion *) clientData;
+  assert (jc != NULL);
+
+  switch (eventType) {
+    case VIX_EVENTTYPE_FIND_ITEM:
+      /* VIX's reference keeps jc alive until the job completes, and
+       * jc->acc.ring doesn't change while the job is in flight. */
+      if (jc->acc.ring != NULL) {
+        VixCallback_accumulateStringList(jobH, eventType, eventInfo,
+            &jc->acc
+          );
+      }
+      break;
+
+    case VIX_EVENTTYPE_JOB_COMPLETED: {
+      VixError err = VIX_OK;
+      VixError propErr = Vix_GetProperties(jobH,
+          VIX_PROPERTY_JOB_RESULT_ERROR_CODE, &err,
+          VIX_PROPERTY_NONE
+        );
+      /* Gather the items found into a C-side arena while we're still off the
+       * GIL, so that the Python list can be built in a single pass: */
+      if (jc->acc.ring != NULL) { VixEventRing_collect(jc->acc.ring); }
+      JobCompletion_complete(jc, jobH, (VIX_FAILED(propErr) ? propErr : err),
+          true
+        );
+      /* VIX won't report on this job again, so drop its reference: */
+      JobCompletion_release(jc);
+      break;
+    }
+
+    default:
+      break;
+  }
+} /* Job_vixCallback */
+
+/******************************** Job ****************************************/
+
+/* Job_CLIENT_DATA yields the clientData to be passed to a VIX job function
+ * alongside Job_vixCallback. */
+#define Job_CLIENT_DATA(job) ((void *) (job)->completion)
+
+static Job *Job_create(PyObject *owner, JobResultKind resultKind) {
+  /* Creates a Job in STATE_CREATED, ready to be passed (via Job_vixCallback
+   * and Job_CLIENT_DATA) to a VIX job function.  The GIL must be held. */
+  Job *self = (Job *) StatefulHandleWrapper_new(&JobType);
+  if (self == NULL) { goto fail; }
+
+  assert (owner != NULL);
+  Py_INCREF(owner);
+  self->owner = owner;
+  self->resultKind = resultKind;
+  self->resultArg = NULL;
+  self->result = NULL;
+  self->deadline = NO_DEADLINE;
+  self->timedOut = false;
+  self->budget = NULL;
+  self->opName = NULL;
+  self->startedAt = 0.0;
+
+  self->completion = JobCompletion_new(
+      resultKind == JOB_RESULT_SNAPSHOT || resultKind == JOB_RESULT_VM
+      || resultKind == JOB_RESULT_HANDLE
+    );
+  if (self->completion == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  if (resultKind == JOB_RESULT_STRING_LIST) {
+    if (VixCallbackAccumulator_ListInit(&self->completion->acc)
+        != SUCCEEDED
+       )
+    { goto fail; }
+  }
+
+  return self;
+  fail:
+    assert (PyErr_Occurred());
+    if (self != NULL && self->completion != NULL) {
+      /* VIX never saw this JobCompletion, so release its reference too: */
+      JobCompletion_release(self->completion);
+    }
+    Py_XDECREF(self);
+    return NULL;
+} /* Job_create */
+
+static bool Job_waitForCompletion(Job *self, long timeoutMillis) {
+  /* The GIL must be held; it's released during the wait. */
+  bool completed;
+  JobCompletion *jc = self->completion;
+
+  LEAVE_PYTHON
+  completed = PyVixEvent_wait(&jc->finished, timeoutMillis);
+  ENTER_PYTHON
+
+  return completed;
+} /* Job_waitForCompletion */
+
+static bool Job_awaitBefore(Job *self, double waitDeadline) {
+  /* Waits for the job to complete, but only until waitDeadline or the job's
+   * own deadline, whichever comes first.  If the job's own deadline passes,
+   * the job is cancelled, which completes it.  Returns whether the job has
+   * completed.  The GIL must be held; it's released during the wait. */
+  const bool ownDeadlineFirst = (self->deadline != NO_DEADLINE
+      && (waitDeadline == NO_DEADLINE || self->deadline <= waitDeadline)
+    );
+
+  if (Job_waitForCompletion(self, millisUntilDeadline(
+          ownDeadlineFirst ? self->deadline : waitDeadline
+        )))
+  { return true; }
+  if (!ownDeadlineFirst) { return false; }
+
+  /* If the job completed of its own accord at the last moment, its outcome
+   * stands: */
+  if (JobCompletion_cancel(self->completion)) { self->timedOut = true; }
+  return true;
+} /* Job_awaitBefore */
+
+static PyObject *Job_buildResult(Job *self) {
+  /* Converts the outcome of a successfully completed job into a Python
+   * object, according to self->resultKind. */
+  JobCompletion *jc = self->completion;
+
+  switch (self->resultKind) {
+    case JOB_RESULT_NONE:
+      Py_RETURN_NONE;
+
+    case JOB_RESULT_SNAPSHOT: {
+      PyObject *pySnap;
+      assert (jc->resultH != VIX_INVALID_HANDLE);
+      pySnap = Snapshot_createFromHandle((VM *) self->owner, jc->resultH);
+      /* If the creation of pySnap succeeded, the Snapshot instance now owns
+       * the handle; if the creation failed, jc still owns it and will
+       * release it. */
+      if (pySnap != NULL) { jc->resultH = VIX_INVALID_HANDLE; }
+      return pySnap;
+    }
+
+    case JOB_RESULT_STRING_LIST: {
+      PyObject *list;
+      /* Collect whatever the VIX threads have pushed into the ring: */
+      if (VixCallbackAccumulator_flush(&jc->acc) != SUCCEEDED) { return NULL; }
+      list = jc->acc.target;
+      assert (list != NULL);
+      jc->acc.target = NULL;
+      return list;
+    }
+
+    case JOB_RESULT_TOOLS_STATE: {
+      VM *vm = (VM *) self->owner;
+      VixToolsState toolsState = VIX_TOOLSSTATE_UNKNOWN;
+      VixError err;
+
+      SHW_REQUIRE_OPEN((StatefulHandleWrapper *) vm);
+      LEAVE_PYTHON
+      err = Vix_GetProperties(vm->handle, VIX_PROPERTY_VM_TOOLS_STATE,
+          &toolsState, VIX_PROPERTY_NONE
+        );
+      ENTER_PYTHON
+      CHECK_VIX_ERROR_AND(err, return NULL);
+
+      /* If the VM's "tools state" is still undefined even after the job
+       * completed, then the wait timed out. */
+      return PyBool_FromLong(toolsState != VIX_TOOLSSTATE_UNKNOWN);
+    }
+
+    case JOB_RESULT_VM: {
+      PyObject *pyVM;
+      assert (jc->resultH != VIX_INVALID_HANDLE);
+      assert (self->resultArg != NULL);
+      /* The Host might have been closed while the job was in flight: */
+      SHW_REQUIRE_OPEN((StatefulHandleWrapper *) self->owner);
+      pyVM = VM_createFromHandle((Host *) self->owner, self->resultArg,
+          jc->resultH
+        );
+      /* As with JOB_RESULT_SNAPSHOT, the handle changes hands only if the
+       * creation of pyVM succeeded: */
+      if (pyVM != NULL) { jc->resultH = VIX_INVALID_HANDLE; }
+      return pyVM;
+    }
+
+    case JOB_RESULT_HANDLE: {
+      PyObject *pyHandle;
+      assert (jc->resultH != VIX_INVALID_HANDLE);
+      pyHandle = PyInt_FromLong((long) jc->resultH);
+      /* The handle now belongs to whoever converts pyHandle back: */
+      if (pyHandle != NULL) { jc->resultH = VIX_INVALID_HANDLE; }
+      return pyHandle;
+    }
+
+    case JOB_RESULT_TASK: {
+      PyObject *taskResult = jc->taskResult;
+      assert (taskResult != NULL);
+      jc->taskResult = NULL;
+      return taskResult;
+    }
+
+    case JOB_RESULT_STAGED: {
+      /* The contents that VIX copied into the staged file; VIX has finished
+       * with it, since the job completed successfully: */
+      PyObject *contents;
+      assert (jc->staged != NULL);
+      contents = StagedFile_readAll(jc->staged);
+      if (contents != NULL) {
+        StagedFile_release(jc->staged);
+        jc->staged = NULL;
+      }
+      return contents;
+    }
+  }
+
+  raiseNonNumericVIXError(VIXInternalError, "Unknown JobResultKind.");
+  return NULL;
+} /* Job_buildResult */
+
+static status Job_recordStep(Job *self, VixError err) {
+  /* Records the completed job as a step of the Deadline on whose budget it
+   * drew, which it then forgets, so that the step is recorded only once. */
+  status res;
+  const char *outcome = (self->timedOut ? "timeout"
+      : err == VIX_E_CANCELLED ? "cancelled"
+      : VIX_FAILED(err) ? "error"
+      : "ok"
+    );
+
+  assert (self->budget != NULL);
+  res = Deadline_recordStep(self->budget, self->opName,
+      self->completion->completedAt - self->startedAt, outcome
+    );
+  Py_CLEAR(self->budget);
+  return res;
+} /* Job_recordStep */
+
+static PyObject *Job_result(Job *self, double waitDeadline) {
+  /* Waits for the job to complete (see Job_awaitBefore), then either raises
+   * the VIX error that it reported or returns its result.  Raises
+   * VIXTimeoutError if the job didn't complete in time.  The GIL must be
+   * held. */
+  VixError err;
+
+  if (!Job_awaitBefore(self, waitDeadline)) {
+    raiseNonNumericVIXError(VIXTimeoutError,
+        "The job did not complete within the timeout."
+      );
+    goto fail;
+  }
+
+  PyVixMutex_lock(&self->completion->lock);
+  err = self->completion->err;
+  PyVixMutex_unlock(&self->completion->lock);
+  if (self->budget != NULL) {
+    if (Job_recordStep(self, err) != SUCCEEDED) { goto fail; }
+  }
+  if (self->timedOut) {
+    assert (err == VIX_E_CANCELLED);
+    raiseNonNumericVIXError(VIXTimeoutError,
+        "The job did not complete within its timeout, and was cancelled."
+      );
+    goto fail;
+  }
+  CHECK_VIX_ERROR(err);
+
+  if (self->result == NULL) {
+    self->result = Job_buildResult(self);
+    if (self->result == NULL) { goto fail; }
+  }
+
+  Py_INCREF(self->result);
+  return self->result;
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* Job_result */
+
+static void JobCompletion_issued(JobCompletion *jc, VixHandle jobH) {
+  /* To be called as soon as the VIX job function to which jc was passed has
+   * returned jobH.  The GIL need not be held. */
+  if (jobH == VIX_INVALID_HANDLE) {
+    /* VIX refused the job outright, so it will never invoke the callback: */
+    JobCompletion_complete(jc, VIX_INVALID_HANDLE, VIX_E_FAIL, true);
+    JobCompletion_release(jc);
+  } else {
+    PyVixMutex_lock(&jc->lock);
+    jc->jobH = jobH;
+    PyVixMutex_unlock(&jc->lock);
+  }
+} /* JobCompletion_issued */
+
+static status Job_markIssued(Job *self, VixHandle jobH) {
+  /* The Python-side counterpart of JobCompletion_issued, which must already
+   * have been called.  The GIL must be held. */
+  assert (self->handle == VIX_INVALID_HANDLE);
+  self->handle = jobH;
+
+  assert (self->state == STATE_CREATED);
+  return Job_changeState(self, STATE_OPEN);
+} /* Job_markIssued */
+
+static PyObject *Job_launched(Job *self, VixHandle jobH, bool async,
+    const JobDeadline *deadline
+  )
+{
+  /* The common tail of Job_issued and Job_dispatched.  Steals the caller's
+   * reference to self.  If async is true, returns self; otherwise, waits for
+   * the job and returns its result.  Either way, the job is cancelled if it
+   * hasn't completed by its deadline (deadline may be NULL for none); an
+   * async job's deadline is enforced whenever it's waited upon. */
+  PyObject *res = NULL;
+
+  if (deadline != NULL) {
+    self->deadline = deadline->at;
+    if (deadline->budget != NULL) {
+      Py_INCREF(deadline->budget);
+      self->budget = deadline->budget;
+      self->opName = deadline->opName;
+      self->startedAt = deadline->startedAt;
+    }
+  }
+  if (Job_markIssued(self, jobH) != SUCCEEDED) { goto fail; }
+
+  if (async) { return (PyObject *) self; }
+
+  res = Job_result(self, NO_DEADLINE);
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    assert (res == NULL);
+    /* Fall through to cleanup: */
+  cleanup:
+    Py_DECREF(self);
+    return res;
+} /* Job_launched */
+
+static PyObject *Job_issued(Job *self, VixHandle jobH, bool async,
+    const JobDeadline *deadline
+  )
+{
+  /* To be called (with the GIL held) immediately after the VIX job function
+   * to which self was passed has returned jobH; see Job_launched. */
+  JobCompletion_issued(self->completion, jobH);
+  return Job_launched(self, jobH, async, deadline);
+} /* Job_issued */
+
+static PyObject *Job_dispatched(Job *self, bool async,
+    const JobDeadline *deadline
+  )
+{
+  /* To be called (with the GIL held) once a WorkerTask that will complete
+   * self has been queued in the worker pool; see Job_launched.  Such a Job has
+   * no VIX job handle of its own. */
+  return Job_launched(self, VIX_INVALID_HANDLE, async, deadline);
+} /* Job_dispatched */
+
+static PyObject *Job_satisfied(Job *self, bool async,
+    const JobDeadline *deadline
+  )
+{
+  /* To be called (with the GIL held) instead of submitting self to VIX, once
+   * it's clear that the job's work has already been done (see
+   * content_cache.c); self completes successfully at once.  See
+   * Job_launched. */
+  JobCompletion_complete(self->completion, VIX_INVALID_HANDLE, VIX_OK, true);
+  /* VIX will never hold its reference: */
+  JobCompletion_release(self->completion);
+  return Job_launched(self, VIX_INVALID_HANDLE, async, deadline);
+} /* Job_satisfied */
+
+static status Job_addDoneCallback(Job *self, PyObject *callable,
+    PyObject *args
+  )
+{
+  /* Arranges for callable(*args) to be called once the job completes, or
+   * calls it immediately if the job has already completed.  The GIL must be
+   * held. */
+  JobCompletion *jc = self->completion;
+  PyObject *entry = NULL;
+  PyObject *newList = NULL;
+  bool alreadyCompleted;
+  bool needsList;
+  int appended = 0;
+
+  entry = PyTuple_Pack(2, callable, args);
+  if (entry == NULL) { goto fail; }
+
+  /* Allocating a Python object can trigger a collection, which can run
+   * arbitrary code (including code that waits on this job), so the list is
+   * created before jc->lock is taken; under the lock, it's merely installed
+   * or appended to: */
+  PyVixMutex_lock(&jc->lock);
+  needsList = (!jc->completed && jc->doneCallbacks == NULL);
+  PyVixMutex_unlock(&jc->lock);
+  if (needsList) {
+    newList = PyList_New(0);
+    if (newList == NULL) { goto fail; }
+  }
+
+  PyVixMutex_lock(&jc->lock);
+  alreadyCompleted = jc->completed;
+  if (!alreadyCompleted) {
+    /* Only completion clears doneCallbacks, so if it was set before, it
+     * still is: */
+    if (jc->doneCallbacks == NULL) {
+      assert (newList != NULL);
+      jc->doneCallbacks = newList;
+      newList = NULL;
+    }
+    appended = PyList_Append(jc->doneCallbacks, entry);
+  }
+  PyVixMutex_unlock(&jc->lock);
+  Py_XDECREF(newList);
+  if (appended != 0) { goto fail; }
+
+  if (alreadyCompleted) {
+    PyObject *cbRes = PyObject_CallObject(callable, args);
+    if (cbRes == NULL) { goto fail; }
+    Py_DECREF(cbRes);
+  }
+
+  Py_DECREF(entry);
+  return SUCCEEDED;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(entry);
+    return FAILED;
+} /* Job_addDoneCallback */
+
+static PyObject *pyf_Job_done(Job *self) {
+  bool completed;
+
+  PyVixMutex_lock(&self->completion->lock);
+  completed = self->completion->completed;
+  PyVixMutex_unlock(&self->completion->lock);
+
+  return PyBool_FromLong(completed);
+} /* pyf_Job_done */
+
+static PyObject *pyf_Job_wait(Job *self, PyObject *args, PyObject *kwargs) {
+  static char* kwarg_list[] = {"timeout", NULL};
+  PyObject *pyTimeout = NULL;
+  double waitDeadline;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwarg_list,
+       &pyTimeout
+     ))
+  { return NULL; }
+  if (deadlineFromPython(pyTimeout, &waitDeadline) != SUCCEEDED) {
+    return NULL;
+  }
+
+  return PyBool_FromLong(Job_awaitBefore(self, waitDeadline));
+} /* pyf_Job_wait */
+
+static PyObject *pyf_Job_result(Job *self, PyObject *args, PyObject *kwargs) {
+  /* Unlike a timeout that the job was issued with, the timeout given here
+   * only limits this wait; the job isn't cancelled if it expires. */
+  static char* kwarg_list[] = {"timeout", NULL};
+  PyObject *pyTimeout = NULL;
+  double waitDeadline;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", kwarg_list,
+       &pyTimeout
+     ))
+  { return NULL; }
+  if (deadlineFromPython(pyTimeout, &waitDeadline) != SUCCEEDED) {
+    return NULL;
+  }
+
+  return Job_result(self, waitDeadline);
+} /* pyf_Job_result */
+
+static PyObject *pyf_Job_cancel(Job *self) {
+  /* Returns False if the job had already completed. */
+  return PyBool_FromLong(JobCompletion_cancel(self->completion));
+} /* pyf_Job_cancel */
+
+static PyObject *pyf_Job_cancelled(Job *self) {
+  bool cancelled;
+
+  PyVixMutex_lock(&self->completion->lock);
+  cancelled = (self->completion->completed
+      && self->completion->err == VIX_E_CANCELLED
+    );
+  PyVixMutex_unlock(&self->completion->lock);
+
+  return PyBool_FromLong(cancelled);
+} /* pyf_Job_cancelled */
+
+static PyObject *pyf_Job_add_done_callback(Job *self, PyObject *args) {
+  PyObject *callable;
+  PyObject *cbArgs = NULL;
+
+  if (!PyArg_ParseTuple(args, "O", &callable)) { goto fail; }
+  if (!PyCallable_Check(callable)) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The done-callback must be callable."
+      );
+    goto fail;
+  }
+
+  /* As with concurrent futures, the callback receives the Job itself: */
+  cbArgs = PyTuple_Pack(1, (PyObject *) self);
+  if (cbArgs == NULL) { goto fail; }
+  if (Job_addDoneCallback(self, callable, cbArgs) != SUCCEEDED) { goto fail; }
+
+  Py_DECREF(cbArgs);
+  Py_RETURN_NONE;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(cbArgs);
+    return NULL;
+} /* pyf_Job_add_done_callback */
+
+static PyObject *pyf_Job_owner_get(Job *self, void *closure) {
+  Py_INCREF(self->owner);
+  return self->owner;
+} /* pyf_Job_owner_get */
+
+static void pyf_Job___del__(Job *self) {
+  Py_CLEAR(self->owner);
+  Py_CLEAR(self->resultArg);
+  Py_CLEAR(self->result);
+  Py_CLEAR(self->budget);
+  if (self->completion != NULL) {
+    JobCompletion_release(self->completion);
+    self->completion = NULL;
+  }
+
+  /* Release the Job struct itself: */
+  self->ob_type->tp_free((PyObject *) self);
+} /* pyf_Job___del__ */
+
+static PyMethodDef Job_methods[] = {
+    {"done",
+        (PyCFunction) pyf_Job_done,
+        METH_NOARGS
+      },
+    {"wait",
+        (PyCFunction) pyf_Job_wait,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"result",
+        (PyCFunction) pyf_Job_result,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"cancel",
+        (PyCFunction) pyf_Job_cancel,
+        METH_NOARGS
+      },
+    {"cancelled",
+        (PyCFunction) pyf_Job_cancelled,
+        METH_NOARGS
+      },
+    {"add_done_callback",
+        (PyCFunction) pyf_Job_add_done_callback,
+        METH_VARARGS
+      },
+    {"getProperties",
+        (PyCFunction) pyf_StatefulHandleWrapper_getProperties,
+        METH_O
+      },
+    {NULL}  /* sentinel */
+  };
+
+static PyGetSetDef Job_getters_setters[] = {
+    {"owner",
+        (getter) pyf_Job_owner_get,
+        NULL,
+        "The Host or VM that issued this Job."
+      },
+    {NULL}  /* sentinel */
+  };
+
+PyTypeObject JobType = { /* new-style class */
+    PyObject_HEAD_INIT(NULL)
+    0,                                  /* ob_size */
+    "pyvix.vix.Job",                    /* tp_name */
+    sizeof(Job),                        /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) pyf_Job___del__,       /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    &StatefulHandleWrapper_as_mapping,  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    0,                                  /* tp_doc */
+    0,		                              /* tp_traverse */
+    0,		                              /* tp_clear */
+    0,		                              /* tp_richcompare */
+    0,		                              /* tp_weaklistoffset */
+
+    0,                    		          /* tp_iter */
+    0,		                              /* tp_iternext */
+
+    Job_methods,                        /* tp_methods */
+    NULL,                               /* tp_members */
+    Job_getters_setters,                /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+
+    /* Jobs are only created by pyvix itself, so there's neither a tp_init
+     * nor a tp_new: */
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    0,                                  /* tp_new */
+    0,                                  /* tp_free */
+    0,                                  /* tp_is_gc */
+    0,                                  /* tp_bases */
+    0,                                  /* tp_mro */
+    0,                                  /* tp_cache */
+    0,                                  /* tp_subclasses */
+    0                                   /* tp_weaklist */
+  };
+
+/*************************** JobItemIterator *********************************/
+
+static PyObject *JobItemIterator_create(Job *job) {
+  /* Wraps a JOB_RESULT_STRING_LIST job (which the iterator then consumes, so
+   * the job mustn't be exposed elsewhere) in an iterator that yields the
+   * job's items as VIX reports them.  Steals the caller's reference to job.
+   * The GIL must be held. */
+  JobItemIterator *self = NULL;
+
+  assert (job->resultKind == JOB_RESULT_STRING_LIST);
+  assert (job->completion->acc.ring != NULL);
+
+  self = PyObject_New(JobItemIterator, &JobItemIteratorType);
+  if (self == NULL) { goto fail; }
+  self->job = job;
+  self->pending = NULL;
+  self->nConsumed = 0;
+
+  PyVixAtomic_store(&job->completion->acc.ring->signalOnPush, 1);
+
+  return (PyObject *) self;
+  fail:
+    assert (PyErr_Occurred());
+    Py_DECREF(job);
+    return NULL;
+} /* JobItemIterator_create */
+
+static PyObject *pyf_JobItemIterator_next(JobItemIterator *self) {
+  JobCompletion *jc = self->job->completion;
+  VixEventRing *ring = jc->acc.ring;
+
+  for (;;) {
+    bool completed;
+    VixError err;
+
+    if (self->pending != NULL) {
+      if (self->nConsumed < PyList_GET_SIZE(self->pending)) {
+        PyObject *item = PyList_GET_ITEM(self->pending, self->nConsumed++);
+        Py_INCREF(item);
+        return item;
+      }
+      Py_CLEAR(self->pending);
+    }
+
+    /* Reset before looking, so that a push (or the completion) that comes
+     * after the look is sure to interrupt the wait below: */
+    PyVixEvent_reset(&ring->pushed);
+    PyVixMutex_lock(&jc->lock);
+    completed = jc->completed;
+    err = jc->err;
+    PyVixMutex_unlock(&jc->lock);
+
+    self->pending = VixCallbackAccumulator_takeCollected(&jc->acc);
+    if (self->pending == NULL) { return NULL; }
+    self->nConsumed = 0;
+    if (PyList_GET_SIZE(self->pending) > 0) { continue; }
+
+    if (completed) {
+      /* Every item was pushed before the job completed, so there are no
+       * more to come. */
+      CHECK_VIX_ERROR(err);
+      /* Returning NULL without an exception signals StopIteration: */
+      return NULL;
+    }
+
+    LEAVE_PYTHON
+    PyVixEvent_wait(&ring->pushed, -1);
+    ENTER_PYTHON
+  }
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_JobItemIterator_next */
+
+static void pyf_JobItemIterator___del__(JobItemIterator *self) {
+  Py_CLEAR(self->pending);
+  Py_CLEAR(self->job);
+
+  PyObject_Del(self);
+} /* pyf_JobItemIterator___del__ */
+
+PyTypeObject JobItemIteratorType = { /* new-style class */
+    PyObject_HEAD_INIT(NULL)
+    0,                                  /* ob_size */
+    "pyvix.vix.JobItemIterator",        /* tp_name */
+    sizeof(JobItemIterator),            /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) pyf_JobItemIterator___del__, /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    0,                                  /* tp_doc */
+    0,		                              /* tp_traverse */
+    0,		                              /* tp_clear */
+    0,		                              /* tp_richcompare */
+    0,		                              /* tp_weaklistoffset */
+
+    PyObject_SelfIter,                  /* tp_iter */
+    (iternextfunc) pyf_JobItemIterator_next, /* tp_iternext */
+
+    0,                                  /* tp_methods */
+    NULL,                               /* tp_members */
+    0,                                  /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    0,                                  /* tp_new */
+    0,                                  /* tp_free */
+    0,                                  /* tp_is_gc */
+    0,                                  /* tp_bases */
+    0,                                  /* tp_mro */
+    0,                                  /* tp_cache */
+    0,                                  /* tp_subclasses */
+    0                                   /* tp_weaklist */
+  };
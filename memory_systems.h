@@ -44,4 +44,132 @@
  * offers a free function freed with Vix_FreeBuffer. */
 #define pyvix_vix_buffer_free       Vix_FreeBuffer
 
+/***************************     SLAB      ***********************************/
+
+/* A PyVixSlab recycles fixed-size objects of a single kind (JobCompletions,
+ * say) through a free list, rather than returning each freed object to the
+ * underlying allocator only to request another one moments later.  Objects
+ * are carved from chunks of objectsPerChunk objects, which are obtained via
+ * pyvix_plain_malloc and retained for the life of the process.
+ *
+ * There are two series, and a given slab must only ever be used with one:
+ *   - pyvix_slab_* must only be called when the GIL is held (which is what
+ *     protects the slab), just like pyvix_main_*.
+ *   - pyvix_slab_locked_* serialize on the slab's own mutex, so (like
+ *     pyvix_plain_*) they're threadsafe, and may be called from VIX's worker
+ *     threads.
+ *
+ * Each slab counts the objects it has carved from its chunks (nAllocated),
+ * the ones currently handed out (nLive), and the ones on its free list
+ * (nFree); nAllocated == nLive + nFree.  Every initialized slab is entered in
+ * a process-wide registry so that the counters can be inspected from Python
+ * (see pyf_slabStats). */
+
+typedef struct _PyVixSlab {
+  const char *name;
+  size_t objectSize;
+  Py_ssize_t objectsPerChunk;
+  bool threadsafe;
+  PyVixMutex lock;
+
+  /* Freed objects, linked through their first word: */
+  void *freeList;
+  /* The chunks, linked through their first word: */
+  void *chunks;
+
+  Py_ssize_t nAllocated;
+  Py_ssize_t nLive;
+  Py_ssize_t nFree;
+
+  struct _PyVixSlab *nextInRegistry;
+} PyVixSlab;
+
+/* Each chunk begins with a header that links it to the next, padded so that
+ * the objects that follow it are suitably aligned for any type: */
+#define PYVIX_SLAB_ALIGNMENT        16
+#define PYVIX_SLAB_ROUND_UP(n) \
+  (((n) + PYVIX_SLAB_ALIGNMENT - 1) & ~((size_t) PYVIX_SLAB_ALIGNMENT - 1))
+
+static PyVixSlab *pyvix_slabRegistry = NULL;
+
+static void PyVixSlab_init(PyVixSlab *slab, const char *name,
+    size_t objectSize, Py_ssize_t objectsPerChunk, bool threadsafe
+  )
+{
+  /* To be called once per slab, during module initialization (with the GIL
+   * held). */
+  slab->name = name;
+  slab->objectSize = PYVIX_SLAB_ROUND_UP(
+      objectSize > sizeof(void *) ? objectSize : sizeof(void *)
+    );
+  slab->objectsPerChunk = objectsPerChunk;
+  slab->threadsafe = threadsafe;
+  PyVixMutex_init(&slab->lock);
+  slab->freeList = NULL;
+  slab->chunks = NULL;
+  slab->nAllocated = slab->nLive = slab->nFree = 0;
+
+  slab->nextInRegistry = pyvix_slabRegistry;
+  pyvix_slabRegistry = slab;
+} /* PyVixSlab_init */
+
+static void *PyVixSlab_allocUnlocked(PyVixSlab *slab) {
+  void *obj;
+
+  if (slab->freeList == NULL) {
+    /* Carve a fresh chunk into objects, all of which go on the free list: */
+    char *chunk = pyvix_plain_malloc(
+        PYVIX_SLAB_ALIGNMENT + slab->objectSize * slab->objectsPerChunk
+      );
+    Py_ssize_t i;
+
+    if (chunk == NULL) { return NULL; }
+    *((void **) chunk) = slab->chunks;
+    slab->chunks = chunk;
+
+    for (i = slab->objectsPerChunk - 1; i >= 0; i--) {
+      void *fresh = chunk + PYVIX_SLAB_ALIGNMENT + slab->objectSize * i;
+      *((void **) fresh) = slab->freeList;
+      slab->freeList = fresh;
+    }
+    slab->nAllocated += slab->objectsPerChunk;
+    slab->nFree += slab->objectsPerChunk;
+  }
+
+  obj = slab->freeList;
+  slab->freeList = *((void **) obj);
+  slab->nFree--;
+  slab->nLive++;
+  return obj;
+} /* PyVixSlab_allocUnlocked */
+
+static void PyVixSlab_freeUnlocked(PyVixSlab *slab, void *obj) {
+  *((void **) obj) = slab->freeList;
+  slab->freeList = obj;
+  slab->nLive--;
+  slab->nFree++;
+} /* PyVixSlab_freeUnlocked */
+
+static void *PyVixSlab_allocLocked(PyVixSlab *slab) {
+  void *obj;
+  assert (slab->threadsafe);
+  PyVixMutex_lock(&slab->lock);
+  obj = PyVixSlab_allocUnlocked(slab);
+  PyVixMutex_unlock(&slab->lock);
+  return obj;
+} /* PyVixSlab_allocLocked */
+
+static void PyVixSlab_freeLocked(PyVixSlab *slab, void *obj) {
+  assert (slab->threadsafe);
+  PyVixMutex_lock(&slab->lock);
+  PyVixSlab_freeUnlocked(slab, obj);
+  PyVixMutex_unlock(&slab->lock);
+} /* PyVixSlab_freeLocked */
+
+#define pyvix_slab_malloc(slab)           PyVixSlab_allocUnlocked(slab)
+#define pyvix_slab_free(slab, obj)        PyVixSlab_freeUnlocked(slab, obj)
+
+#define pyvix_slab_locked_malloc(slab)    PyVixSlab_allocLocked(slab)
+#define pyvix_slab_locked_free(slab, obj) PyVixSlab_freeLocked(slab, obj)
+
 #endif /* MEMORY_SYSTEMS_H */
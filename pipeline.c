@@ -0,0 +1,1037 @@
+/******************************************************************************
+ * pyvix - Pipelines of VIX Jobs
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* A pipeline is a sequence of steps, such as
+ *
+ *   [('revert', 'clean'), ('powerOn',), ('waitForTools', 300),
+ *    ('login', 'user', 'secret'), ('copyIn', 'setup.sh', '/tmp/setup.sh'),
+ *    ('run', '/bin/sh', '/tmp/setup.sh')]
+ *
+ * that's applied to one VM (VM.runPipeline) or to many (Host.runPipelines).
+ * Pipeline_execute submits each step as soon as the previous one has
+ * finished, entirely without the GIL:  a single thread drives every VM's run
+ * through its steps as their jobs are posted to a private CompletionPort, and
+ * keeps at most maxParallel runs going at once.  A run stops at the first step
+ * that fails; the rest of its steps are skipped.  If the pipeline's deadline
+ * passes, the steps in flight are cancelled, and those not yet submitted are
+ * skipped.
+ *
+ * The result of a run is a list with one (name, seconds, outcome, value) tuple
+ * per step, where outcome is one of 'ok', 'error', 'timeout' or 'skipped', and
+ * value is the exception that the step would have raised if it failed, the
+ * boolean that waitForToolsInGuest would have returned for a waitForTools
+ * step, and otherwise None.  The failure of a step is never raised. */
+
+/* Defined in vm.c: */
+static VixHandle VM_submitPowerOp(VixHandle vmH, VMPowerOp op,
+    int powerOnOptions, void *clientData
+  );
+static int VM_normalizePowerOnOptions(int options);
+
+typedef struct {
+  const char *name;
+  PipelineStepKind kind;
+  bool changesState;
+} PipelineStepKindInfo;
+
+static const PipelineStepKindInfo Pipeline_stepKinds[] = {
+    {"revert",       PIPELINE_REVERT,         true},
+    {"powerOn",      PIPELINE_POWER_ON,       true},
+    {"powerOff",     PIPELINE_POWER_OFF,      true},
+    {"reset",        PIPELINE_RESET,          true},
+    {"suspend",      PIPELINE_SUSPEND,        true},
+    {"waitForTools", PIPELINE_WAIT_FOR_TOOLS, true},
+    {"login",        PIPELINE_LOGIN,          false},
+    {"copyIn",       PIPELINE_COPY_IN,        false},
+    {"copyOut",      PIPELINE_COPY_OUT,       false},
+    {"run",          PIPELINE_RUN,            false},
+    {"delete",       PIPELINE_DELETE,         false},
+    {NULL}  /* sentinel */
+  };
+
+/* Indexed by PipelineStepOutcome; the same words that Deadline.steps uses: */
+static const char *Pipeline_outcomeNames[] = {
+    "skipped", "ok", "error", "timeout", "unchanged"
+  };
+
+/**************************** Parsing Steps **********************************/
+
+static status Pipeline_parseStep(PyObject *stepTuple, PipelineStep *step) {
+  /* Parses stepTuple, which is an operation name followed by that operation's
+   * arguments, into step.  The GIL must be held. */
+  const PipelineStepKindInfo *info;
+  const char *name;
+  PyObject *args = NULL;
+  PyObject *snapArg = NULL;
+  int parsed = false;
+
+  if (!PyTuple_Check(stepTuple) || PyTuple_GET_SIZE(stepTuple) < 1
+      || !PyString_Check(PyTuple_GET_ITEM(stepTuple, 0))
+     )
+  {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "Each step must be a tuple that starts with the name of an operation."
+      );
+    goto fail;
+  }
+  name = PyString_AS_STRING(PyTuple_GET_ITEM(stepTuple, 0));
+  for (info = Pipeline_stepKinds; info->name != NULL; info++) {
+    if (strcmp(info->name, name) == 0) { break; }
+  }
+  if (info->name == NULL) {
+    PyErr_Format(VIXClientProgrammerError, "Unknown pipeline step '%s'.",
+        name
+      );
+    goto fail;
+  }
+
+  step->kind = info->kind;
+  step->name = info->name;
+  step->changesState = info->changesState;
+  step->arg1 = NULL;
+  step->arg2 = NULL;
+  step->intArg = 0;
+  step->snapH = VIX_INVALID_HANDLE;
+
+  args = PyTuple_GetSlice(stepTuple, 1, PyTuple_GET_SIZE(stepTuple));
+  if (args == NULL) { goto fail; }
+
+  switch (step->kind) {
+    case PIPELINE_REVERT:
+      parsed = PyArg_ParseTuple(args, "|O:revert", &snapArg);
+      if (!parsed) { break; }
+      if (snapArg == NULL || snapArg == Py_None) {
+        /* Revert to the current snapshot. */
+      } else if (PyObject_TypeCheck(snapArg, &SnapshotType)) {
+        /* Borrowed from the Snapshot until Pipeline_start takes a reference
+         * of its own: */
+        step->snapH = ((Snapshot *) snapArg)->handle;
+      } else if (PyString_Check(snapArg)) {
+        step->arg1 = PyString_AS_STRING(snapArg);
+      } else {
+        PyErr_SetString(PyExc_TypeError,
+            "revert takes a Snapshot, the name of a snapshot, or nothing."
+          );
+        parsed = false;
+      }
+      break;
+
+    case PIPELINE_POWER_ON:
+      parsed = PyArg_ParseTuple(args, "|i:powerOn", &step->intArg);
+      step->intArg = VM_normalizePowerOnOptions(step->intArg);
+      break;
+    case PIPELINE_POWER_OFF:
+      parsed = PyArg_ParseTuple(args, ":powerOff");
+      break;
+    case PIPELINE_RESET:
+      parsed = PyArg_ParseTuple(args, ":reset");
+      break;
+    case PIPELINE_SUSPEND:
+      parsed = PyArg_ParseTuple(args, ":suspend");
+      break;
+
+    case PIPELINE_WAIT_FOR_TOOLS:
+      step->intArg = NO_TIMEOUT;
+      parsed = PyArg_ParseTuple(args, "|i:waitForTools", &step->intArg);
+      break;
+
+    case PIPELINE_LOGIN:
+      parsed = PyArg_ParseTuple(args, "ss|i:login",
+          &step->arg1, &step->arg2, &step->intArg
+        );
+      break;
+    case PIPELINE_COPY_IN:
+      parsed = PyArg_ParseTuple(args, "ss:copyIn", &step->arg1, &step->arg2);
+      break;
+    case PIPELINE_COPY_OUT:
+      parsed = PyArg_ParseTuple(args, "ss:copyOut", &step->arg1, &step->arg2);
+      break;
+    case PIPELINE_RUN:
+      step->arg2 = "";
+      parsed = PyArg_ParseTuple(args, "s|si:run",
+          &step->arg1, &step->arg2, &step->intArg
+        );
+      break;
+    case PIPELINE_DELETE:
+      parsed = PyArg_ParseTuple(args, "s:delete", &step->arg1);
+      break;
+  }
+  if (!parsed) { goto fail; }
+
+  Py_DECREF(args);
+  return SUCCEEDED;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(args);
+    return FAILED;
+} /* Pipeline_parseStep */
+
+static PipelineStep *Pipeline_parseSteps(PyObject *pySteps,
+    PyObject **stepTuples, Py_ssize_t *nSteps
+  )
+{
+  /* Parses the sequence of step tuples pySteps into an array of PipelineSteps
+   * (freed with pyvix_main_free), whose strings are borrowed from
+   * *stepTuples, a new reference that the caller must keep until it's done
+   * with the array.  The GIL must be held. */
+  PipelineStep *steps = NULL;
+  Py_ssize_t i;
+
+  *stepTuples = PySequence_Tuple(pySteps);
+  if (*stepTuples == NULL) { goto fail; }
+  *nSteps = PyTuple_GET_SIZE(*stepTuples);
+
+  steps = pyvix_main_malloc(
+      sizeof(PipelineStep) * (*nSteps > 0 ? *nSteps : 1)
+    );
+  if (steps == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  for (i = 0; i < *nSteps; i++) {
+    if (Pipeline_parseStep(PyTuple_GET_ITEM(*stepTuples, i), &steps[i])
+        != SUCCEEDED
+       )
+    { goto fail; }
+  }
+
+  return steps;
+  fail:
+    assert (PyErr_Occurred());
+    if (steps != NULL) { pyvix_main_free(steps); }
+    Py_CLEAR(*stepTuples);
+    return NULL;
+} /* Pipeline_parseSteps */
+
+/***************************** Driving Runs **********************************/
+
+static AdmissionClass Pipeline_admissionClass(PipelineStepKind kind) {
+  switch (kind) {
+    case PIPELINE_REVERT:
+      return ADMISSION_SNAPSHOT;
+    case PIPELINE_LOGIN:
+    case PIPELINE_COPY_IN:
+    case PIPELINE_COPY_OUT:
+    case PIPELINE_RUN:
+    case PIPELINE_DELETE:
+      return ADMISSION_GUEST_IO;
+    default:
+      return ADMISSION_POWER;
+  }
+} /* Pipeline_admissionClass */
+
+static bool Pipeline_submitStep(PipelineRun *run, const PipelineStep *steps,
+    double deadline
+  )
+{
+  /* Submits the next step of run, once the VM's Host has admitted it, and
+   * returns whether the step is now in flight.  If so, its JobCompletion is
+   * eventually posted to the pipeline's port, whatever happens; if not, the
+   * Host stayed saturated until deadline (or the wait for it failed), and
+   * the step has been recorded as having timed out (or failed).  The GIL
+   * need not be held. */
+  const PipelineStep *step = &steps[run->nSubmitted];
+  JobCompletion *jc = run->jcs[run->nSubmitted];
+  void *clientData = (void *) jc;
+  VixHandle jobH = VIX_INVALID_HANDLE;
+  VixError err = VIX_OK;
+  const AdmissionClass admissionClass = Pipeline_admissionClass(step->kind);
+
+  run->nSubmitted++;
+  run->stepStartedAt = PyVixClock_now();
+  run->toolsDeadline = NO_DEADLINE;
+
+  err = AdmissionGate_enter(run->admission, admissionClass, deadline);
+  if (VIX_FAILED(err)) {
+    PipelineStepResult *res = &run->results[run->nSubmitted - 1];
+    res->outcome = (err == VIX_E_CANCELLED ? PIPELINE_STEP_TIMEOUT
+        : PIPELINE_STEP_ERROR
+      );
+    res->err = err;
+    res->seconds = PyVixClock_now() - run->stepStartedAt;
+    /* VIX will never see the job, so it's finished with as VIX would have
+     * (the port ignores it, since the run is no longer in flight): */
+    run->inFlight = false;
+    JobCompletion_complete(jc, VIX_INVALID_HANDLE, err, true);
+    JobCompletion_release(jc);
+    return false;
+  }
+  AdmissionGate_attach(run->admission, admissionClass, jc);
+
+  switch (step->kind) {
+    case PIPELINE_REVERT: {
+      VixHandle snapH = step->snapH;
+      if (snapH == VIX_INVALID_HANDLE) {
+        err = (step->arg1 != NULL
+            ? VixVM_GetNamedSnapshot(run->vmH, step->arg1, &snapH)
+            : VixVM_GetCurrentSnapshot(run->vmH, &snapH)
+          );
+        if (VIX_FAILED(err)) { break; }
+        /* Released once the step has finished: */
+        run->snapH = snapH;
+      }
+      ContentCache_expectSnapshotOp(run->contentCache, jc,
+          CONTENT_UPDATE_REVERTED, snapH, step->arg1
+        );
+      jobH = VixVM_RevertToSnapshot(run->vmH, snapH,
+          0, /* options */
+          /* propertyListHandle:  Must be VIX_INVALID_HANDLE in current
+           * release: */
+          VIX_INVALID_HANDLE,
+          Job_vixCallback, clientData
+        );
+      break;
+    }
+
+    case PIPELINE_POWER_ON:
+      jobH = VM_submitPowerOp(run->vmH, VM_POWER_ON, step->intArg,
+          clientData
+        );
+      break;
+    case PIPELINE_POWER_OFF:
+      jobH = VM_submitPowerOp(run->vmH, VM_POWER_OFF, 0, clientData);
+      break;
+    case PIPELINE_RESET:
+      jobH = VM_submitPowerOp(run->vmH, VM_RESET, 0, clientData);
+      break;
+    case PIPELINE_SUSPEND:
+      jobH = VM_submitPowerOp(run->vmH, VM_SUSPEND, 0, clientData);
+      break;
+
+    case PIPELINE_WAIT_FOR_TOOLS:
+      /* As in VM.waitForToolsInGuest, timeoutSecs is also enforced here,
+       * unless the pipeline's deadline comes first: */
+      if (step->intArg > 0
+          && (deadline == NO_DEADLINE
+              || run->stepStartedAt + step->intArg < deadline
+             )
+         )
+      { run->toolsDeadline = run->stepStartedAt + step->intArg; }
+      jobH = VixVM_WaitForToolsInGuest(run->vmH, step->intArg,
+          Job_vixCallback, clientData
+        );
+      break;
+
+    case PIPELINE_LOGIN:
+      jobH = VixVM_LoginInGuest(run->vmH, step->arg1, step->arg2,
+          step->intArg, Job_vixCallback, clientData
+        );
+      break;
+    case PIPELINE_COPY_IN:
+      ContentCache_expectCopy(run->contentCache, jc, step->arg2, NULL);
+      jobH = VixVM_CopyFileFromHostToGuest(run->vmH, step->arg1, step->arg2,
+          0, /* options:  Must be 0 in current release. */
+          VIX_INVALID_HANDLE, Job_vixCallback, clientData
+        );
+      break;
+    case PIPELINE_COPY_OUT:
+      jobH = VixVM_CopyFileFromGuestToHost(run->vmH, step->arg1, step->arg2,
+          0, /* options:  Must be 0 in current release. */
+          VIX_INVALID_HANDLE, Job_vixCallback, clientData
+        );
+      break;
+    case PIPELINE_RUN:
+      jobH = VixVM_RunProgramInGuest(run->vmH, step->arg1, step->arg2,
+          step->intArg, VIX_INVALID_HANDLE, Job_vixCallback, clientData
+        );
+      break;
+    case PIPELINE_DELETE:
+      ContentCache_forget(run->contentCache, step->arg1);
+      jobH = VixVM_DeleteFileInGuest(run->vmH, step->arg1, Job_vixCallback,
+          clientData
+        );
+      break;
+  }
+
+  if (VIX_FAILED(err)) {
+    /* The step failed before a job could even be submitted, so its failure
+     * is reported just as VIX would have: */
+    JobCompletion_complete(jc, VIX_INVALID_HANDLE, err, true);
+    JobCompletion_release(jc);
+  } else {
+    JobCompletion_issued(jc, jobH);
+  }
+  return true;
+} /* Pipeline_submitStep */
+
+static void Pipeline_stepFinished(PipelineRun *run, const PipelineStep *steps) {
+  /* Records the outcome of run's step in flight, whose job has completed.
+   * The GIL need not be held. */
+  const Py_ssize_t i = run->nSubmitted - 1;
+  JobCompletion *jc = run->jcs[i];
+  PipelineStepResult *res = &run->results[i];
+  double completedAt;
+  VixHandle jobH;
+
+  PyVixMutex_lock(&jc->lock);
+  assert (jc->completed);
+  res->err = jc->err;
+  jobH = jc->jobH;
+  completedAt = jc->completedAt;
+  PyVixMutex_unlock(&jc->lock);
+
+  res->seconds = completedAt - run->stepStartedAt;
+  res->outcome = (VIX_FAILED(res->err) ? PIPELINE_STEP_ERROR
+      : PIPELINE_STEP_OK
+    );
+  if (res->outcome == PIPELINE_STEP_OK
+      && steps[i].kind == PIPELINE_WAIT_FOR_TOOLS
+     )
+  {
+    /* As in Job_result, the tools state is undefined if the wait timed
+     * out: */
+    VixToolsState toolsState = VIX_TOOLSSTATE_UNKNOWN;
+    if (!VIX_FAILED(Vix_GetProperties(run->vmH, VIX_PROPERTY_VM_TOOLS_STATE,
+            &toolsState, VIX_PROPERTY_NONE
+          ))
+       )
+    { res->toolsRunning = (toolsState != VIX_TOOLSSTATE_UNKNOWN); }
+  } else if (res->outcome == PIPELINE_STEP_OK
+      && steps[i].kind == PIPELINE_RUN
+     )
+  {
+    int exitCode = 0;
+    if (!VIX_FAILED(Vix_GetProperties(jobH,
+            VIX_PROPERTY_JOB_RESULT_GUEST_PROGRAM_EXIT_CODE, &exitCode,
+            VIX_PROPERTY_NONE
+          ))
+       )
+    { res->exitCode = exitCode; }
+  }
+
+  if (run->snapH != VIX_INVALID_HANDLE) {
+    Vix_ReleaseHandle(run->snapH);
+    run->snapH = VIX_INVALID_HANDLE;
+  }
+} /* Pipeline_stepFinished */
+
+static PipelineRun *Pipeline_findRun(PipelineRun *runs, Py_ssize_t nRuns,
+    JobCompletion *jc
+  )
+{
+  /* Returns the run whose step in flight is jc's, or NULL if none is (as for
+   * a step cancelled by Pipeline_expire). */
+  Py_ssize_t i;
+
+  for (i = 0; i < nRuns; i++) {
+    if (runs[i].inFlight && runs[i].jcs[runs[i].nSubmitted - 1] == jc) {
+      return &runs[i];
+    }
+  }
+  return NULL;
+} /* Pipeline_findRun */
+
+static void Pipeline_expire(PipelineRun *runs, Py_ssize_t nRuns,
+    const PipelineStep *steps
+  )
+{
+  /* Cancels the steps in flight once the pipeline's deadline has passed.  The
+   * GIL need not be held. */
+  Py_ssize_t i;
+
+  for (i = 0; i < nRuns; i++) {
+    PipelineRun *run = &runs[i];
+    if (!run->inFlight) { continue; }
+
+    if (JobCompletion_cancel(run->jcs[run->nSubmitted - 1])) {
+      PipelineStepResult *res = &run->results[run->nSubmitted - 1];
+      res->outcome = PIPELINE_STEP_TIMEOUT;
+      res->err = VIX_E_CANCELLED;
+      res->seconds = PyVixClock_now() - run->stepStartedAt;
+      if (run->snapH != VIX_INVALID_HANDLE) {
+        Vix_ReleaseHandle(run->snapH);
+        run->snapH = VIX_INVALID_HANDLE;
+      }
+    } else {
+      /* The step finished just in time: */
+      Pipeline_stepFinished(run, steps);
+    }
+    run->inFlight = false;
+  }
+} /* Pipeline_expire */
+
+/* How often (in milliseconds) a pipeline that has an owner checks whether
+ * the owner has been cancelled, while it waits for its steps: */
+#define PIPELINE_CANCEL_POLL_MILLIS 100
+
+static bool Pipeline_ownerCancelled(const PipelineExecution *exec) {
+  bool cancelled;
+  if (exec->owner == NULL) { return false; }
+
+  PyVixMutex_lock(&exec->owner->lock);
+  cancelled = exec->owner->completed;
+  PyVixMutex_unlock(&exec->owner->lock);
+  return cancelled;
+} /* Pipeline_ownerCancelled */
+
+static bool Pipeline_advance(PipelineExecution *exec, PipelineRun *run) {
+  /* Submits run's next step, now that the last has finished, if there is
+   * one and the last succeeded; returns whether run is still in flight.  The
+   * GIL need not be held. */
+  if (run->results[run->nSubmitted - 1].outcome == PIPELINE_STEP_OK
+      && run->nSubmitted < exec->nSteps
+     )
+  { return Pipeline_submitStep(run, exec->steps, exec->deadline); }
+
+  run->inFlight = false;
+  return false;
+} /* Pipeline_advance */
+
+static double Pipeline_nextDeadline(const PipelineExecution *exec) {
+  /* Returns the earliest of the pipeline's deadline and those of the
+   * waitForTools steps in flight, or NO_DEADLINE if there are none. */
+  double next = exec->deadline;
+  Py_ssize_t i;
+
+  for (i = 0; i < exec->nRuns; i++) {
+    const PipelineRun *run = &exec->runs[i];
+    if (run->inFlight && run->toolsDeadline != NO_DEADLINE
+        && (next == NO_DEADLINE || run->toolsDeadline < next)
+       )
+    { next = run->toolsDeadline; }
+  }
+  return next;
+} /* Pipeline_nextDeadline */
+
+static Py_ssize_t Pipeline_endToolsWaits(PipelineExecution *exec) {
+  /* Cancels each waitForTools step whose timeoutSecs have run out, which
+   * (just as when VIX gives up by itself) finds the tools not running, and
+   * moves its run on; returns the number of runs that are no longer in
+   * flight as a result.  The GIL need not be held. */
+  Py_ssize_t i;
+  Py_ssize_t nStopped = 0;
+
+  for (i = 0; i < exec->nRuns; i++) {
+    PipelineRun *run = &exec->runs[i];
+    PipelineStepResult *res;
+    if (!run->inFlight || run->toolsDeadline == NO_DEADLINE
+        || !Batch_deadlinePassed(run->toolsDeadline)
+       )
+    { continue; }
+
+    run->toolsDeadline = NO_DEADLINE;
+    /* Otherwise, the step finished just in time, and its JobCompletion is on
+     * its way through the port: */
+    if (!JobCompletion_cancel(run->jcs[run->nSubmitted - 1])) { continue; }
+
+    res = &run->results[run->nSubmitted - 1];
+    res->outcome = PIPELINE_STEP_OK;
+    res->err = VIX_OK;
+    res->toolsRunning = false;
+    res->seconds = PyVixClock_now() - run->stepStartedAt;
+    if (!Pipeline_advance(exec, run)) { nStopped++; }
+  }
+  return nStopped;
+} /* Pipeline_endToolsWaits */
+
+static void Pipeline_drive(PipelineExecution *exec) {
+  /* Drives every run through its steps, until all of them have stopped, the
+   * pipeline's deadline has passed, or its owner has been cancelled.  The GIL
+   * need not be held. */
+  PipelineRun *runs = exec->runs;
+  const PipelineStep *steps = exec->steps;
+  CompletionPort *port = exec->port;
+  Py_ssize_t nextRun = 0;
+  Py_ssize_t nActive = 0;
+  long waitMillis;
+
+  for (;;) {
+    JobCompletion *chain;
+
+    while (nActive < exec->maxParallel && nextRun < exec->nRuns) {
+      PipelineRun *run = &runs[nextRun++];
+      if (run->vmH == VIX_INVALID_HANDLE || exec->nSteps == 0) { continue; }
+
+      run->inFlight = true;
+      if (Pipeline_submitStep(run, steps, exec->deadline)) { nActive++; }
+    }
+    nActive -= Pipeline_endToolsWaits(exec);
+    if (nActive == 0) { break; }
+
+    waitMillis = millisUntilDeadline(Pipeline_nextDeadline(exec));
+    if (exec->owner != NULL
+        && (waitMillis < 0 || waitMillis > PIPELINE_CANCEL_POLL_MILLIS)
+       )
+    { waitMillis = PIPELINE_CANCEL_POLL_MILLIS; }
+
+    if (!PyVixEvent_wait(&port->nonEmpty, waitMillis)) {
+      if (Batch_deadlinePassed(exec->deadline)
+          || Pipeline_ownerCancelled(exec)
+         )
+      {
+        Pipeline_expire(runs, exec->nRuns, steps);
+        break;
+      }
+      continue;
+    }
+
+    PyVixMutex_lock(&port->lock);
+    chain = CompletionPort_takeLocked(port, -1);
+    PyVixMutex_unlock(&port->lock);
+
+    while (chain != NULL) {
+      JobCompletion *jc = chain;
+      PipelineRun *run;
+      chain = jc->portNext;
+      jc->portNext = NULL;
+
+      run = Pipeline_findRun(runs, exec->nRuns, jc);
+      if (run == NULL) { continue; }
+
+      Pipeline_stepFinished(run, steps);
+      if (!Pipeline_advance(exec, run)) { nActive--; }
+    }
+
+    if (Pipeline_ownerCancelled(exec)) {
+      /* Nobody wants the results any more: */
+      Pipeline_expire(runs, exec->nRuns, steps);
+      break;
+    }
+  }
+} /* Pipeline_drive */
+
+static status Pipeline_start(PipelineExecution *exec, VM **vms,
+    Py_ssize_t nRuns, const PipelineStep *steps, Py_ssize_t nSteps,
+    int maxParallel, double deadline, PipelineStepResult *results
+  )
+{
+  /* Prepares exec to run the pipeline steps[0:nSteps] on each of the VMs in
+   * vms[0:nRuns] (skipping NULL entries), with at most maxParallel of them in
+   * progress at once, filling results, an array of nRuns * nSteps entries,
+   * with the outcome of each VM's steps.  Whether or not this succeeds,
+   * Pipeline_stop must be called once the pipeline is finished with.  The GIL
+   * must be held. */
+  Py_ssize_t i, j;
+
+  exec->steps = steps;
+  exec->nSteps = nSteps;
+  exec->runs = NULL;
+  exec->nRuns = nRuns;
+  exec->jcs = NULL;
+  exec->maxParallel = maxParallel;
+  exec->deadline = deadline;
+  exec->port = NULL;
+  exec->owner = NULL;
+
+  if (maxParallel < 1) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "max_parallel must be at least 1."
+      );
+    goto fail;
+  }
+
+  for (i = 0; i < nRuns * nSteps; i++) {
+    results[i].outcome = PIPELINE_STEP_SKIPPED;
+    results[i].seconds = 0.0;
+    results[i].err = VIX_OK;
+    results[i].toolsRunning = false;
+    results[i].exitCode = 0;
+  }
+
+  exec->port = CompletionPort_new();
+  if (exec->port == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  exec->runs = pyvix_main_malloc(
+      sizeof(PipelineRun) * (nRuns > 0 ? nRuns : 1)
+    );
+  if (exec->runs == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  /* Allocated last, since its presence tells Pipeline_stop that runs is set
+   * up: */
+  exec->jcs = pyvix_main_malloc(sizeof(JobCompletion *)
+      * (nRuns * nSteps > 0 ? nRuns * nSteps : 1)
+    );
+  if (exec->jcs == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  for (i = 0; i < nRuns * nSteps; i++) { exec->jcs[i] = NULL; }
+
+  /* The pipeline runs without the GIL, during which the VMs (and a revert
+   * step's Snapshot) may be closed, releasing their handles; so it holds
+   * references of its own, which Pipeline_stop releases: */
+  for (j = 0; j < nSteps; j++) {
+    if (steps[j].snapH != VIX_INVALID_HANDLE) {
+      Vix_AddRefHandle(steps[j].snapH);
+    }
+  }
+  for (i = 0; i < nRuns; i++) {
+    PipelineRun *run = &exec->runs[i];
+    run->vmH = (vms[i] != NULL ? vms[i]->handle : VIX_INVALID_HANDLE);
+    if (run->vmH != VIX_INVALID_HANDLE) { Vix_AddRefHandle(run->vmH); }
+    run->jcs = &exec->jcs[i * nSteps];
+    run->results = &results[i * nSteps];
+    run->nSubmitted = 0;
+    run->inFlight = false;
+    run->stepStartedAt = 0.0;
+    run->toolsDeadline = NO_DEADLINE;
+    run->snapH = VIX_INVALID_HANDLE;
+    run->admission = NULL;
+    run->contentCache = NULL;
+    if (vms[i] != NULL) {
+      run->admission = vms[i]->host->admission;
+      AdmissionGate_addRef(run->admission);
+      run->contentCache = vms[i]->contentCache;
+      ContentCache_addRef(run->contentCache);
+    }
+  }
+
+  /* Every step's JobCompletion is created up front, so that nothing needs
+   * the GIL once the pipeline is under way; that also leaves each VM's
+   * property cache bypassed until all of the VM's state-changing steps have
+   * finished (or been skipped). */
+  for (i = 0; i < nRuns; i++) {
+    if (vms[i] == NULL) { continue; }
+
+    for (j = 0; j < nSteps; j++) {
+      JobCompletion *jc;
+
+      if (steps[j].changesState
+          && VMPropertyCache_reserve(&vms[i]->propCache) != SUCCEEDED
+         )
+      { goto fail; }
+      jc = JobCompletion_new(false);
+      if (jc == NULL) {
+        PyErr_NoMemory();
+        goto fail;
+      }
+      exec->runs[i].jcs[j] = jc;
+
+      /* As in Batch_run, no Python object represents the job in the
+       * port: */
+      CompletionPort_addRef(exec->port);
+      jc->port = exec->port;
+      if (steps[j].changesState) {
+        VMPropertyCache_noteStateChange(&vms[i]->propCache, jc);
+      }
+    }
+  }
+
+  return SUCCEEDED;
+  fail:
+    assert (PyErr_Occurred());
+    return FAILED;
+} /* Pipeline_start */
+
+static void Pipeline_stop(PipelineExecution *exec) {
+  /* Releases everything that Pipeline_start acquired.  The GIL must be
+   * held. */
+  Py_ssize_t i, j;
+
+  /* Closed first, since a step that finished just as the pipeline expired
+   * may still be linked into the port, and releasing it might free it: */
+  if (exec->port != NULL) {
+    CompletionPort_close(exec->port);
+    exec->port = NULL;
+  }
+  if (exec->jcs != NULL) {
+    for (i = 0; i < exec->nRuns; i++) {
+      for (j = 0; j < exec->nSteps; j++) {
+        JobCompletion *jc = exec->jcs[i * exec->nSteps + j];
+        if (jc == NULL) { continue; }
+
+        if (j >= exec->runs[i].nSubmitted) {
+          /* VIX never saw this step's job, so its reference is dropped
+           * here: */
+          JobCompletion_cancel(jc);
+          JobCompletion_issued(jc, VIX_INVALID_HANDLE);
+        }
+        JobCompletion_release(jc);
+      }
+      if (exec->runs[i].admission != NULL) {
+        AdmissionGate_release(exec->runs[i].admission);
+      }
+      if (exec->runs[i].contentCache != NULL) {
+        ContentCache_release(exec->runs[i].contentCache);
+      }
+      if (exec->runs[i].vmH != VIX_INVALID_HANDLE) {
+        Vix_ReleaseHandle(exec->runs[i].vmH);
+      }
+    }
+    for (j = 0; j < exec->nSteps; j++) {
+      if (exec->steps[j].snapH != VIX_INVALID_HANDLE) {
+        Vix_ReleaseHandle(exec->steps[j].snapH);
+      }
+    }
+    pyvix_main_free(exec->jcs);
+    exec->jcs = NULL;
+  }
+  if (exec->runs != NULL) {
+    pyvix_main_free(exec->runs);
+    exec->runs = NULL;
+  }
+} /* Pipeline_stop */
+
+static status Pipeline_execute(VM **vms, Py_ssize_t nRuns,
+    const PipelineStep *steps, Py_ssize_t nSteps, int maxParallel,
+    double deadline, PipelineStepResult *results
+  )
+{
+  /* Runs the pipeline on the calling thread (see Pipeline_start for the
+   * arguments).  Returns FAILED (with an exception set) only if the pipeline
+   * couldn't be started at all.  The GIL must be held, and is released while
+   * the pipeline runs. */
+  PipelineExecution exec;
+
+  if (Pipeline_start(&exec, vms, nRuns, steps, nSteps, maxParallel,
+        deadline, results
+      ) != SUCCEEDED
+     )
+  {
+    Pipeline_stop(&exec);
+    return FAILED;
+  }
+
+  LEAVE_PYTHON
+  Pipeline_drive(&exec);
+  ENTER_PYTHON
+
+  Pipeline_stop(&exec);
+  return SUCCEEDED;
+} /* Pipeline_execute */
+
+/**************************** Reporting Runs *********************************/
+
+static PyObject *Pipeline_report(const PipelineStep *steps,
+    const PipelineStepResult *results, Py_ssize_t nSteps
+  )
+{
+  /* Returns the list of (name, seconds, outcome, value) tuples that describes
+   * one run of the pipeline. */
+  PyObject *report = PyList_New(nSteps);
+  Py_ssize_t j;
+
+  if (report == NULL) { goto fail; }
+
+  for (j = 0; j < nSteps; j++) {
+    const PipelineStepResult *res = &results[j];
+    PyObject *value;
+    PyObject *entry;
+
+    switch (res->outcome) {
+      case PIPELINE_STEP_OK:
+        if (steps[j].kind == PIPELINE_WAIT_FOR_TOOLS) {
+          value = PyBool_FromLong(res->toolsRunning);
+        } else {
+          value = Py_None;
+          Py_INCREF(value);
+        }
+        break;
+      case PIPELINE_STEP_ERROR:
+        autoRaiseVIXError(res->err);
+        value = fetchRaisedException();
+        break;
+      case PIPELINE_STEP_TIMEOUT:
+        raiseNonNumericVIXError(VIXTimeoutError,
+            "The step did not complete within the pipeline's timeout, and was"
+            " cancelled."
+          );
+        value = fetchRaisedException();
+        break;
+      default:
+        value = Py_None;
+        Py_INCREF(value);
+        break;
+    }
+
+    entry = Py_BuildValue("(sdsN)", steps[j].name, res->seconds,
+        Pipeline_outcomeNames[res->outcome], value
+      );
+    if (entry == NULL) { goto fail; }
+    PyList_SET_ITEM(report, j, entry);
+  }
+
+  return report;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(report);
+    return NULL;
+} /* Pipeline_report */
+
+static status Pipeline_recordSteps(const JobDeadline *deadline,
+    const PipelineStep *steps, const PipelineStepResult *results,
+    Py_ssize_t nSteps
+  )
+{
+  /* Records each step of one run as a step of the pipeline's Deadline (if
+   * any). */
+  Py_ssize_t j;
+
+  if (deadline->budget == NULL) { return SUCCEEDED; }
+  for (j = 0; j < nSteps; j++) {
+    if (Deadline_recordStep(deadline->budget, steps[j].name,
+          results[j].seconds, Pipeline_outcomeNames[results[j].outcome]
+        ) != SUCCEEDED
+       )
+    { return FAILED; }
+  }
+  return SUCCEEDED;
+} /* Pipeline_recordSteps */
+
+static status Pipeline_fillBatchResults(PyObject *batchResults,
+    const PipelineStep *steps, const PipelineStepResult *results,
+    Py_ssize_t nRuns, Py_ssize_t nSteps, bool *timedOut
+  )
+{
+  /* Fills each slot of batchResults (a list of nRuns entries) that's still
+   * NULL with the report of the corresponding run, and sets *timedOut if any
+   * step ran out of time. */
+  Py_ssize_t i, j;
+
+  *timedOut = false;
+  for (i = 0; i < nRuns; i++) {
+    const PipelineStepResult *runResults = &results[i * nSteps];
+    PyObject *report;
+    if (PyList_GET_ITEM(batchResults, i) != NULL) { continue; }
+
+    report = Pipeline_report(steps, runResults, nSteps);
+    if (report == NULL) { return FAILED; }
+    PyList_SET_ITEM(batchResults, i, report);
+    for (j = 0; j < nSteps; j++) {
+      if (runResults[j].outcome == PIPELINE_STEP_TIMEOUT) { *timedOut = true; }
+    }
+  }
+
+  return SUCCEEDED;
+} /* Pipeline_fillBatchResults */
+
+/**************************** PipelineTask ***********************************/
+
+/* A pipeline that's run asynchronously is driven by the worker pool, as a
+ * PipelineTask; its Job's result is the value that the synchronous form would
+ * have returned. */
+typedef struct {
+  WorkerTask base;
+  PipelineExecution exec;
+  bool started;
+  /* The task's own copies of the steps and results arrays, and a reference
+   * to the tuple from which the steps borrow their strings: */
+  PipelineStep *steps;
+  PipelineStepResult *results;
+  PyObject *stepTuples;
+  /* For Host.runPipelines, the list of per-VM results, whose slots for the
+   * VMs that couldn't take part are already filled; otherwise NULL: */
+  PyObject *batchResults;
+} PipelineTask;
+
+static void PipelineTask_run(WorkerTask *task) {
+  Pipeline_drive(&((PipelineTask *) task)->exec);
+} /* PipelineTask_run */
+
+static void PipelineTask_release(PipelineTask *self) {
+  /* The GIL must be held. */
+  if (self->started) { Pipeline_stop(&self->exec); }
+  if (self->steps != NULL) { pyvix_main_free(self->steps); }
+  if (self->results != NULL) { pyvix_main_free(self->results); }
+  Py_XDECREF(self->stepTuples);
+  Py_XDECREF(self->batchResults);
+  Py_XDECREF(self->base.host);
+} /* PipelineTask_release */
+
+static void PipelineTask_finish(WorkerTask *task) {
+  PipelineTask *self = (PipelineTask *) task;
+  PyObject *result = NULL;
+
+  if (self->batchResults != NULL) {
+    bool timedOut;
+    if (Pipeline_fillBatchResults(self->batchResults, self->steps,
+          self->results, self->exec.nRuns, self->exec.nSteps, &timedOut
+        ) == SUCCEEDED
+       )
+    {
+      result = self->batchResults;
+      self->batchResults = NULL;
+    }
+  } else {
+    result = Pipeline_report(self->steps, self->results, self->exec.nSteps);
+  }
+
+  if (result == NULL) {
+    /* There's nobody to raise the exception to: */
+    SUPPRESS_EXCEPTION;
+    task->err = VIX_E_FAIL;
+  } else {
+    assert (task->jc->taskResult == NULL);
+    task->jc->taskResult = result;
+  }
+
+  PipelineTask_release(self);
+} /* PipelineTask_finish */
+
+static PyObject *Pipeline_dispatch(PyObject *owner, Host *host, VM **vms,
+    Py_ssize_t nRuns, PyObject *stepTuples, const PipelineStep *steps,
+    Py_ssize_t nSteps, int maxParallel, const JobDeadline *deadline,
+    PyObject *batchResults
+  )
+{
+  /* Queues the pipeline (see Pipeline_start for the arguments) in the worker
+   * pool, and returns a Job that stands for it.  batchResults is as described
+   * for PipelineTask.  The task takes its own references to everything it
+   * needs, so the caller retains its own. */
+  Job *job = NULL;
+  PipelineTask *task = NULL;
+
+  job = Job_create(owner, JOB_RESULT_TASK);
+  if (job == NULL) { goto fail; }
+
+  task = pyvix_plain_malloc(sizeof(PipelineTask));
+  if (task == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  task->base.run = PipelineTask_run;
+  task->base.finish = PipelineTask_finish;
+  task->base.jc = job->completion;
+  Py_INCREF(host);
+  task->base.host = host;
+  task->started = false;
+  Py_INCREF(stepTuples);
+  task->stepTuples = stepTuples;
+  Py_XINCREF(batchResults);
+  task->batchResults = batchResults;
+
+  task->steps = pyvix_main_malloc(
+      sizeof(PipelineStep) * (nSteps > 0 ? nSteps : 1)
+    );
+  task->results = pyvix_main_malloc(sizeof(PipelineStepResult)
+      * (nRuns * nSteps > 0 ? nRuns * nSteps : 1)
+    );
+  if (task->steps == NULL || task->results == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  memcpy(task->steps, steps, sizeof(PipelineStep) * nSteps);
+
+  task->started = true;
+  if (Pipeline_start(&task->exec, vms, nRuns, task->steps, nSteps,
+        maxParallel, deadline->at, task->results
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  task->exec.owner = job->completion;
+
+  if (WorkerPool_submit(&task->base, deadline->at) != SUCCEEDED) {
+    goto fail;
+  }
+
+  return Job_dispatched(job, true, deadline);
+  fail:
+    assert (PyErr_Occurred());
+    if (task != NULL) {
+      PipelineTask_release(task);
+      pyvix_plain_free(task);
+    }
+    if (job != NULL) {
+      /* The pool never saw the job, so its reference to the JobCompletion
+       * must be dropped here: */
+      JobCompletion_release(job->completion);
+      Py_DECREF(job);
+    }
+    return NULL;
+} /* Pipeline_dispatch */
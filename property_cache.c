@@ -0,0 +1,203 @@
+/******************************************************************************
+ * pyvix - Per-VM Property Cache
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Once a VM's propertyCacheTTL has been set, vm[propID] serves each property
+ * from a cache for up to that many seconds after fetching it from VIX, which
+ * spares callers that poll (e.g.) VIX_PROPERTY_VM_POWER_STATE most of the
+ * round-trips.
+ *
+ * So that pyvix never hands out a value that its own operations have made
+ * stale, every state-changing job that a VM submits (powerOn, revertToSnapshot
+ * and so forth) empties the cache as it's submitted, and the cache is bypassed
+ * (neither consulted nor filled) until all such jobs have finished.  Changes
+ * made by other clients of VIX are only noticed once the TTL expires.
+ *
+ * The GIL must be held during calls to every function in this file. */
+
+static void VMPropertyCache_init(VMPropertyCache *cache) {
+  cache->ttl = 0.0;
+  cache->entries = NULL;
+  cache->pendingJobs = NULL;
+  cache->nPendingJobs = 0;
+  cache->pendingJobsCapacity = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->invalidations = 0;
+} /* VMPropertyCache_init */
+
+static Py_ssize_t VMPropertyCache_prunePendingJobs(VMPropertyCache *cache) {
+  /* Forgets the pending jobs that have finished, and returns the number of
+   * those that haven't.  A job that was cancelled remains pending until VIX
+   * has finished with it, since it may still change the VM's state. */
+  Py_ssize_t i;
+  Py_ssize_t nStillPending = 0;
+
+  for (i = 0; i < cache->nPendingJobs; i++) {
+    JobCompletion *jc = cache->pendingJobs[i];
+    bool finished;
+
+    PyVixMutex_lock(&jc->lock);
+    finished = jc->vixFinished;
+    PyVixMutex_unlock(&jc->lock);
+
+    if (finished) {
+      JobCompletion_release(jc);
+    } else {
+      cache->pendingJobs[nStillPending++] = jc;
+    }
+  }
+  cache->nPendingJobs = nStillPending;
+
+  return nStillPending;
+} /* VMPropertyCache_prunePendingJobs */
+
+static void VMPropertyCache_invalidate(VMPropertyCache *cache) {
+  if (cache->entries != NULL) { PyDict_Clear(cache->entries); }
+  cache->invalidations++;
+} /* VMPropertyCache_invalidate */
+
+static void VMPropertyCache_clear(VMPropertyCache *cache) {
+  /* Disables the cache, dropping every cached value and pending job, and
+   * releases the memory that held them; only the counters are retained. */
+  Py_ssize_t i;
+
+  cache->ttl = 0.0;
+  Py_CLEAR(cache->entries);
+  for (i = 0; i < cache->nPendingJobs; i++) {
+    JobCompletion_release(cache->pendingJobs[i]);
+  }
+  if (cache->pendingJobs != NULL) {
+    pyvix_main_free(cache->pendingJobs);
+    cache->pendingJobs = NULL;
+  }
+  cache->nPendingJobs = 0;
+  cache->pendingJobsCapacity = 0;
+} /* VMPropertyCache_clear */
+
+static status VMPropertyCache_reserve(VMPropertyCache *cache) {
+  /* Ensures that the next call to VMPropertyCache_noteStateChange won't need
+   * to allocate memory (and thus can't fail). */
+  JobCompletion **grown;
+  Py_ssize_t newCapacity;
+
+  if (cache->nPendingJobs < cache->pendingJobsCapacity) { return SUCCEEDED; }
+  if (VMPropertyCache_prunePendingJobs(cache) < cache->pendingJobsCapacity) {
+    return SUCCEEDED;
+  }
+
+  newCapacity = (cache->pendingJobsCapacity > 0
+      ? cache->pendingJobsCapacity * 2 : 4
+    );
+  grown = pyvix_main_realloc(cache->pendingJobs,
+      sizeof(JobCompletion *) * newCapacity
+    );
+  if (grown == NULL) {
+    PyErr_NoMemory();
+    return FAILED;
+  }
+  cache->pendingJobs = grown;
+  cache->pendingJobsCapacity = newCapacity;
+
+  return SUCCEEDED;
+} /* VMPropertyCache_reserve */
+
+static void VMPropertyCache_noteStateChange(VMPropertyCache *cache,
+    JobCompletion *jc
+  )
+{
+  /* To be called when a job that may change the VM's properties is about to
+   * be submitted.  VMPropertyCache_reserve must have been called first.  The
+   * job is tracked whether or not the cache is currently enabled, in case
+   * it's enabled while the job is still running. */
+  assert (cache->nPendingJobs < cache->pendingJobsCapacity);
+
+  VMPropertyCache_invalidate(cache);
+
+  PyVixMutex_lock(&jc->lock);
+  jc->refCount++;
+  PyVixMutex_unlock(&jc->lock);
+  cache->pendingJobs[cache->nPendingJobs++] = jc;
+} /* VMPropertyCache_noteStateChange */
+
+static status VMPropertyCache_setTTL(VMPropertyCache *cache, double ttl) {
+  if (ttl < 0) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The property cache TTL must not be negative."
+      );
+    return FAILED;
+  }
+
+  if (ttl > 0 && cache->entries == NULL) {
+    cache->entries = PyDict_New();
+    if (cache->entries == NULL) { return FAILED; }
+  }
+  /* Values fetched under the old TTL might be kept too long under the new: */
+  VMPropertyCache_invalidate(cache);
+  cache->ttl = ttl;
+
+  return SUCCEEDED;
+} /* VMPropertyCache_setTTL */
+
+#define VMPropertyCache_isEnabled(cache) ((cache)->ttl > 0)
+
+static PyObject *VMPropertyCache_lookup(VMPropertyCache *cache, VixHandle h,
+    PyObject *key
+  )
+{
+  /* Returns a new reference to the value of property key (a property ID) of
+   * handle h, from the cache if it's fresh there, and otherwise from VIX.
+   * The cache must be enabled. */
+  PyObject *pyValue = NULL;
+  PyObject *entry;
+  const bool bypass = (VMPropertyCache_prunePendingJobs(cache) > 0);
+  const double now = PyVixClock_now();
+  const long intPropID = PyInt_AsLong(key);
+  if (PyErr_Occurred()) { goto fail; }
+
+  assert (VMPropertyCache_isEnabled(cache));
+  assert (cache->entries != NULL);
+
+  if (!bypass) {
+    entry = PyDict_GetItem(cache->entries, key);
+    if (entry != NULL && now < PyFloat_AS_DOUBLE(PyTuple_GET_ITEM(entry, 1))) {
+      cache->hits++;
+      pyValue = PyTuple_GET_ITEM(entry, 0);
+      Py_INCREF(pyValue);
+      return pyValue;
+    }
+  }
+
+  cache->misses++;
+  pyValue = pyf_extractProperty(h, (VixPropertyID) intPropID);
+  if (pyValue == NULL) { goto fail; }
+
+  if (!bypass) {
+    entry = Py_BuildValue("(Od)", pyValue, now + cache->ttl);
+    if (entry == NULL) { goto fail; }
+    if (PyDict_SetItem(cache->entries, key, entry) != 0) {
+      Py_DECREF(entry);
+      goto fail;
+    }
+    Py_DECREF(entry);
+  }
+
+  return pyValue;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(pyValue);
+    return NULL;
+} /* VMPropertyCache_lookup */
+
+static PyObject *VMPropertyCache_stats(VMPropertyCache *cache) {
+  VMPropertyCache_prunePendingJobs(cache);
+  return Py_BuildValue("{s:d,s:n,s:k,s:k,s:k,s:n}",
+      "ttl", cache->ttl,
+      "size", (cache->entries != NULL ? PyDict_Size(cache->entries) : 0),
+      "hits", cache->hits,
+      "misses", cache->misses,
+      "invalidations", cache->invalidations,
+      "pendingJobs", cache->nPendingJobs
+    );
+} /* VMPropertyCache_stats */
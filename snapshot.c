@@ -5,8 +5,8 @@
  *****************************************************************************/
 
 /* SnapshotTracker method declarations: */
-static status SnapshotTracker_add(SnapshotTracker **list_slot, Snapshot *cont);
-static status SnapshotTracker_remove(SnapshotTracker **list_slot,
+static status SnapshotTracker_add(SnapshotTracker *tracker, Snapshot *cont);
+static status SnapshotTracker_remove(SnapshotTracker *tracker,
     Snapshot *cont, bool
   );
 
@@ -17,6 +17,13 @@ static status SnapshotTracker_remove(SnapshotTracker **list_slot,
   StatefulHandleWrapper_changeState((StatefulHandleWrapper *) (snap), newState)
 
 
+/* Snapshot wrappers come and go in great numbers (each access to
+ * VM.rootSnapshots creates a fresh set), so deallocated ones are recycled: */
+#define SNAPSHOT_FREE_LIST_MAX_LENGTH 256
+static StatefulHandleWrapperFreeList Snapshot_freeList = {
+    &SnapshotType, NULL, 0, SNAPSHOT_FREE_LIST_MAX_LENGTH
+  };
+
 static status initSupport_Snapshot(void) {
   /* SnapshotType is a new-style class, so PyType_Ready must be called before
    * its getters and setters will function. */
@@ -33,11 +40,14 @@ static PyObject *pyf_Snapshot_new(
     PyTypeObject *subtype, PyObject *args, PyObject *kwargs
   )
 {
-  Snapshot *self = (Snapshot *) StatefulHandleWrapper_new(subtype);
+  Snapshot *self = (Snapshot *) StatefulHandleWrapper_newRecycled(subtype,
+      &Snapshot_freeList
+    );
   if (self == NULL) { goto fail; }
 
   /* Initialize Snapshot-specific fields: */
   self->vm = NULL;
+  TRACKER_LINKS_INIT(self);
 
   return (PyObject *) self;
   fail:
@@ -46,41 +56,61 @@ static PyObject *pyf_Snapshot_new(
     return NULL;
 } /* pyf_Snapshot_new */
 
-static status Snapshot_init(Snapshot *self, PyObject *args) {
-  status res = FAILED;
-
-  VM *vm;
-  VixHandle snapH;
-
-  if (!PyArg_ParseTuple(args, "O!" VixHandle_EXTRACTION_CODE,
-        &VMType, &vm, &snapH)
-     )
-  { goto fail; }
-
+static status Snapshot_attach(Snapshot *self, VM *vm, VixHandle snapH) {
+  /* Makes self, which must not have been opened yet, the wrapper of snapH (a
+   * handle to one of vm's snapshots) and enters self in the VM's open
+   * Snapshot tracker.  On success, self owns snapH; on failure, the caller
+   * still does. */
+  assert (self->state == STATE_CREATED);
   assert (self->vm == NULL);
-  Py_INCREF(vm);
-  self->vm = vm;
-
   assert (self->handle == VIX_INVALID_HANDLE);
   assert (snapH != VIX_INVALID_HANDLE);
-  self->handle = snapH;
-
-  assert (self->state == STATE_CREATED);
-  if (Snapshot_changeState(self, STATE_OPEN) != SUCCEEDED) { goto fail; }
 
   /* Enter self in the VM's open Snapshot tracker: */
   if (SnapshotTracker_add(&vm->openSnapshots, self) != SUCCEEDED) {
     goto fail;
   }
 
-  res = SUCCEEDED;
-  goto cleanup;
+  Py_INCREF(vm);
+  self->vm = vm;
+  self->handle = snapH;
+  return Snapshot_changeState(self, STATE_OPEN);
+  fail:
+    assert (PyErr_Occurred());
+    return FAILED;
+} /* Snapshot_attach */
+
+static PyObject *Snapshot_createFromHandle(VM *vm, VixHandle snapH) {
+  /* Creates an OPEN Snapshot that wraps snapH, one of vm's snapshots, without
+   * going through the Python call protocol (which would build an argument
+   * tuple only for Snapshot_init to parse it again).  If this succeeds, the
+   * new Snapshot owns snapH; otherwise, the caller still does.  The GIL must
+   * be held. */
+  Snapshot *self = (Snapshot *) pyf_Snapshot_new(&SnapshotType, NULL, NULL);
+  if (self == NULL) { goto fail; }
+
+  if (Snapshot_attach(self, vm, snapH) != SUCCEEDED) { goto fail; }
+
+  return (PyObject *) self;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(self);
+    return NULL;
+} /* Snapshot_createFromHandle */
+
+static status Snapshot_init(Snapshot *self, PyObject *args) {
+  VM *vm;
+  VixHandle snapH;
+
+  if (!PyArg_ParseTuple(args, "O!" VixHandle_EXTRACTION_CODE,
+        &VMType, &vm, &snapH)
+     )
+  { goto fail; }
+
+  return Snapshot_attach(self, vm, snapH);
   fail:
     assert (PyErr_Occurred());
-    assert (res == FAILED);
-    /* Fall through to cleanup: */
-  cleanup:
-    return res;
+    return FAILED;
 } /* Snapshot_init */
 
 #define Snapshot_clearVMReferences(snap) Py_CLEAR((snap)->vm)
@@ -108,7 +138,7 @@ static status Snapshot_close_withUnlink(Snapshot *self, bool allowedToRaise) {
   /* Since the caller is asking us to unlink, self should still have a VM, and
    * self should be present in the VM's open Snapshot tracker. */
   assert (self->vm != NULL);
-  assert (self->vm->openSnapshots != NULL);
+  assert (self->trackerLinks.tracker == &self->vm->openSnapshots);
 
   if (Snapshot_close_withoutUnlink(self, allowedToRaise) == SUCCEEDED) {
     assert (self->state == STATE_CLOSED);
@@ -173,8 +203,10 @@ static status Snapshot_delete(Snapshot *self, bool allowedToRaise) {
 static void pyf_Snapshot___del__(Snapshot *self) {
   Snapshot_delete(self, false);
 
-  /* Release the Snapshot struct itself: */
-  self->ob_type->tp_free((PyObject *) self);
+  /* Release (or recycle) the Snapshot struct itself: */
+  StatefulHandleWrapper_freeRecycled((StatefulHandleWrapper *) self,
+      &Snapshot_freeList
+    );
 } /* pyf_Snapshot___del__ */
 
 static PyObject *pyf_Snapshot_vm_get(Snapshot *self, void *closure) {
@@ -188,6 +220,10 @@ static PyMethodDef Snapshot_methods[] = {
         (PyCFunction) pyf_Snapshot_close,
         METH_NOARGS
       },
+    {"getProperties",
+        (PyCFunction) pyf_StatefulHandleWrapper_getProperties,
+        METH_O
+      },
     {NULL}  /* sentinel */
   };
 
@@ -259,4 +295,4 @@ PyTypeObject SnapshotType = { /* new-style class */
   };
 
 /* SnapshotTracker support defs: */
-LIFO_LINKED_LIST_DEFINE_BASIC_METHODS_PYALLOC_NOQUAL(SnapshotTracker, Snapshot)
+TRACKER_DEFINE_BASIC_METHODS(Snapshot)
@@ -0,0 +1,258 @@
+/******************************************************************************
+ * pyvix - Staging Guest File Contents in Memory
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* VM.writeGuestFile and VM.readGuestFile move the contents of a guest file
+ * to or from a Python buffer.  VIX only copies between files, so the contents
+ * pass through a StagedFile on the host:  wherever possible, an anonymous
+ * in-memory file (a memfd, which VIX reaches through /proc), and otherwise a
+ * file in a tmpfs (/dev/shm) or the temporary directory, which is deleted as
+ * soon as it's finished with.
+ *
+ * Only a file that VIX copies from is a memfd, though:  VIX is free to
+ * replace the file it copies into, rather than writing into it, which a
+ * /proc path doesn't allow.  For the same reason, that file is reopened by
+ * path before it's read back.
+ *
+ * The Python buffer is written into the StagedFile directly, without the GIL
+ * and without an intermediate copy; likewise, a guest file is read straight
+ * into the string that's returned.  Each copy's JobCompletion holds a
+ * reference to the StagedFile, so that it outlives VIX's use of it even if
+ * the job is cancelled or abandoned (see JobCompletion_complete).
+ *
+ * Host.broadcastFile stages a host file the same way, reading it only once,
+ * and copies it into every VM from that one StagedFile. */
+
+#ifdef _WIN32
+  #include <io.h>
+  #include <fcntl.h>
+  #define pyvix_open_rw(path)       _open(path, _O_RDWR | _O_BINARY)
+  #define pyvix_open_ro(path)       _open(path, _O_RDONLY | _O_BINARY)
+  #define pyvix_write               _write
+  #define pyvix_read                _read
+  #define pyvix_lseek               _lseeki64
+  #define pyvix_close               _close
+  #define pyvix_unlink              _unlink
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #ifdef __linux__
+    #include <sys/syscall.h>
+  #endif
+  #define pyvix_open_rw(path)       open(path, O_RDWR)
+  #define pyvix_open_ro(path)       open(path, O_RDONLY)
+  #define pyvix_write               write
+  #define pyvix_read                read
+  #define pyvix_lseek               lseek
+  #define pyvix_close               close
+  #define pyvix_unlink              unlink
+#endif
+
+/* Each read or write moves at most this much, which keeps the count within
+ * the range of every platform's I/O calls: */
+#define STAGED_IO_CHUNK_SIZE (16 * 1024 * 1024)
+
+static StagedFile *StagedFile_create(bool asSource) {
+  /* Returns a new, empty StagedFile, which VIX will copy from (if asSource
+   * is true) or into, or NULL if none could be created.  The GIL need not be
+   * held. */
+  StagedFile *sf = pyvix_plain_malloc(sizeof(StagedFile));
+  if (sf == NULL) { return NULL; }
+  PyVixMutex_init(&sf->lock);
+  sf->refCount = 1;
+  sf->fd = -1;
+  sf->path = NULL;
+  sf->ownsPath = false;
+  /* The source of a copy can go as soon as VIX has read it: */
+  sf->discardWhenDone = asSource;
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+  /* MFD_CLOEXEC is 1; the constant itself may be missing from older C
+   * libraries, as may memfd_create, even where the kernel provides it: */
+  sf->fd = (asSource
+      ? (int) syscall(SYS_memfd_create, "pyvix-staged", 1) : -1
+    );
+  if (sf->fd >= 0) {
+    char path[64];
+    /* VIX may open the path in a process of its own, so /proc/self won't
+     * do: */
+    sprintf(path, "/proc/%ld/fd/%d", (long) getpid(), sf->fd);
+    sf->path = TreeTransfer_strdup(path);
+    if (sf->path == NULL) { goto fail; }
+    return sf;
+  }
+#endif
+
+  {
+    const char *stagingDir = NULL;
+#ifndef _WIN32
+    if (access("/dev/shm", W_OK) == 0) { stagingDir = "/dev/shm"; }
+#endif
+    sf->path = TreeArchive_stagingPath(stagingDir);
+    if (sf->path == NULL) { goto fail; }
+    sf->ownsPath = true;
+    sf->fd = pyvix_open_rw(sf->path);
+    if (sf->fd < 0) { goto fail; }
+  }
+  return sf;
+
+  fail:
+    StagedFile_release(sf);
+    return NULL;
+} /* StagedFile_create */
+
+static void StagedFile_addRef(StagedFile *sf) {
+  PyVixMutex_lock(&sf->lock);
+  sf->refCount++;
+  PyVixMutex_unlock(&sf->lock);
+} /* StagedFile_addRef */
+
+static void StagedFile_release(StagedFile *sf) {
+  /* Drops one reference to sf, deleting the file if that was the last.  The
+   * GIL need not be held. */
+  bool isLast;
+
+  PyVixMutex_lock(&sf->lock);
+  isLast = (--sf->refCount == 0);
+  PyVixMutex_unlock(&sf->lock);
+  if (!isLast) { return; }
+
+  PyVixMutex_destroy(&sf->lock);
+  if (sf->fd >= 0) { pyvix_close(sf->fd); }
+  if (sf->path != NULL) {
+    if (sf->ownsPath) { pyvix_unlink(sf->path); }
+    pyvix_plain_free(sf->path);
+  }
+  pyvix_plain_free(sf);
+} /* StagedFile_release */
+
+static bool StagedFile_write(StagedFile *sf, const char *data,
+    Py_ssize_t len
+  )
+{
+  /* Writes len bytes of data into sf, which must be empty; returns false if
+   * that failed.  The GIL need not be held. */
+  while (len > 0) {
+    const long n = (long) pyvix_write(sf->fd, data, (unsigned int) (
+        len < STAGED_IO_CHUNK_SIZE ? len : STAGED_IO_CHUNK_SIZE
+      ));
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+} /* StagedFile_write */
+
+static VixError StagedFile_fill(StagedFile *sf, const char *hostPath,
+    unsigned char *digest, int64 *bytes
+  )
+{
+  /* Copies the host file at hostPath into sf, which must be empty, computing
+   * the digest of its content and its size along the way (see
+   * content_cache.c), so that the file is read only once.  The GIL need not
+   * be held. */
+  Sha256 h;
+  unsigned char *buf;
+  size_t n;
+  VixError err = VIX_OK;
+  FILE *f = fopen(hostPath, "rb");
+  if (f == NULL) {
+    return (errno == ENOENT ? VIX_E_FILE_NOT_FOUND : VIX_E_FILE_ACCESS_ERROR);
+  }
+
+  buf = pyvix_plain_malloc(CONTENT_HASH_BUFFER_SIZE);
+  if (buf == NULL) {
+    fclose(f);
+    return VIX_E_OUT_OF_MEMORY;
+  }
+
+  Sha256_init(&h);
+  while ((n = fread(buf, 1, CONTENT_HASH_BUFFER_SIZE, f)) > 0) {
+    Sha256_update(&h, buf, n);
+    if (!StagedFile_write(sf, (const char *) buf, (Py_ssize_t) n)) {
+      err = VIX_E_DISK_FULL;
+      break;
+    }
+  }
+  if (err == VIX_OK && ferror(f)) { err = VIX_E_FILE_ACCESS_ERROR; }
+  fclose(f);
+  pyvix_plain_free(buf);
+
+  if (err == VIX_OK) {
+    *bytes = (int64) h.nBytes;
+    Sha256_final(&h, digest);
+  }
+  return err;
+} /* StagedFile_fill */
+
+static PyObject *StagedFile_readAll(StagedFile *sf) {
+  /* Returns a string of sf's contents, as some other process (VIX) left
+   * them.  The GIL must be held, and is released while the file is read. */
+  PyObject *contents;
+  char *p;
+  Py_ssize_t remaining;
+  bool ok = true;
+  PY_LONG_LONG size;
+
+  if (sf->ownsPath) {
+    /* VIX may have replaced the file, rather than writing into it: */
+    const int fd = pyvix_open_ro(sf->path);
+    if (fd < 0) { goto ioFailed; }
+    pyvix_close(sf->fd);
+    sf->fd = fd;
+  }
+
+  size = (PY_LONG_LONG) pyvix_lseek(sf->fd, 0, SEEK_END);
+  if (size < 0 || pyvix_lseek(sf->fd, 0, SEEK_SET) != 0) { goto ioFailed; }
+  if (size > PY_SSIZE_T_MAX) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+
+  /* The string is filled in place; nothing else can see it until it's
+   * returned, so that's safe without the GIL: */
+  contents = PyString_FromStringAndSize(NULL, (Py_ssize_t) size);
+  if (contents == NULL) { return NULL; }
+  p = PyString_AS_STRING(contents);
+  remaining = (Py_ssize_t) size;
+
+  LEAVE_PYTHON
+  while (remaining > 0) {
+    const long n = (long) pyvix_read(sf->fd, p, (unsigned int) (
+        remaining < STAGED_IO_CHUNK_SIZE ? remaining : STAGED_IO_CHUNK_SIZE
+      ));
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) {
+      /* A file that shrank under us is as bad as an unreadable one: */
+      ok = false;
+      break;
+    }
+    p += n;
+    remaining -= n;
+  }
+  ENTER_PYTHON
+
+  if (!ok) {
+    Py_DECREF(contents);
+    goto ioFailed;
+  }
+  return contents;
+
+  ioFailed:
+    raiseNonNumericVIXError(VIXException,
+        "Could not read back the file that the guest's contents were copied"
+        " into."
+      );
+    return NULL;
+} /* StagedFile_readAll */
+
+static void StagedFile_attach(StagedFile *sf, JobCompletion *jc) {
+  /* Gives jc, which hasn't been passed to VIX yet, the caller's reference to
+   * sf. */
+  assert (jc->staged == NULL);
+  jc->staged = sf;
+} /* StagedFile_attach */
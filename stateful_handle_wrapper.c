@@ -82,7 +82,49 @@ static StatefulHandleWrapper *StatefulHandleWrapper_new(PyTypeObject *subtype) {
     return NULL;
 } /* StatefulHandleWrapper_new */
 
-static int StatefulHandleWrapper_length(StatefulHandleWrapper *self) {
+static StatefulHandleWrapper *StatefulHandleWrapper_newRecycled(
+    PyTypeObject *subtype, StatefulHandleWrapperFreeList *freeList
+  )
+{
+  /* Like StatefulHandleWrapper_new, but reuses an instance from freeList if
+   * possible.  The type-specific fields of a recycled instance are zeroed,
+   * just as tp_alloc would have left them. */
+  StatefulHandleWrapper *self = freeList->head;
+
+  if (subtype != freeList->type || self == NULL) {
+    return StatefulHandleWrapper_new(subtype);
+  }
+
+  freeList->head = (StatefulHandleWrapper *) self->ob_type;
+  freeList->length--;
+  memset(self, 0, subtype->tp_basicsize);
+  (void) PyObject_INIT(self, subtype);
+
+  self->state = STATE_CREATED;
+  self->handle = VIX_INVALID_HANDLE;
+  return self;
+} /* StatefulHandleWrapper_newRecycled */
+
+static void StatefulHandleWrapper_freeRecycled(StatefulHandleWrapper *self,
+    StatefulHandleWrapperFreeList *freeList
+  )
+{
+  /* To be called by tp_dealloc in place of tp_free, once self has been
+   * closed. */
+  if (self->ob_type != freeList->type
+      || freeList->length >= freeList->maxLength
+     )
+  {
+    self->ob_type->tp_free((PyObject *) self);
+    return;
+  }
+
+  self->ob_type = (PyTypeObject *) freeList->head;
+  freeList->head = self;
+  freeList->length++;
+} /* StatefulHandleWrapper_freeRecycled */
+
+static Py_ssize_t StatefulHandleWrapper_length(StatefulHandleWrapper *self) {
   /* The concept of length doesn't even make sense in this context, but it
    * wouldn't be a good idea to return zero, which would be taken to mean that
    * there are no entries available. */
@@ -116,6 +158,53 @@ static PyObject *StatefulHandleWrapper_subscript(StatefulHandleWrapper *self,
     return pyValue;
 } /* StatefulHandleWrapper_subscript */
 
+static PyObject *pyf_StatefulHandleWrapper_getProperties(
+    StatefulHandleWrapper *self, PyObject *pyPropIDs
+  )
+{
+  /* Implements obj.getProperties([P1, P2, ...]), which returns the tuple
+   * (obj[P1], obj[P2], ...), but fetches all of the properties at once. */
+  PyObject *res = NULL;
+  PyObject *idSeq = NULL;
+  VixPropertyID *propIDs = NULL;
+  Py_ssize_t nProps;
+  Py_ssize_t i;
+
+  SHW_REQUIRE_OPEN(self);
+
+  idSeq = PySequence_Fast(pyPropIDs,
+      "getProperties requires a sequence of property IDs."
+    );
+  if (idSeq == NULL) { goto fail; }
+  nProps = PySequence_Fast_GET_SIZE(idSeq);
+
+  propIDs = pyvix_main_malloc(
+      sizeof(VixPropertyID) * (nProps > 0 ? nProps : 1)
+    );
+  if (propIDs == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  for (i = 0; i < nProps; i++) {
+    const long intPropID = PyInt_AsLong(PySequence_Fast_GET_ITEM(idSeq, i));
+    if (PyErr_Occurred()) { goto fail; }
+    propIDs[i] = (VixPropertyID) intPropID;
+  }
+
+  res = pyf_extractProperties(self->handle, propIDs, nProps);
+  if (res == NULL) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    assert (res == NULL);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (propIDs != NULL) { pyvix_main_free(propIDs); }
+    Py_XDECREF(idSeq);
+    return res;
+} /* pyf_StatefulHandleWrapper_getProperties */
+
 static int StatefulHandleWrapper_ass_sub(StatefulHandleWrapper *self,
     PyObject *v, PyObject *w
   )
@@ -128,7 +217,7 @@ static int StatefulHandleWrapper_ass_sub(StatefulHandleWrapper *self,
 } /* StatefulHandleWrapper_ass_sub */
 
 static PyMappingMethods StatefulHandleWrapper_as_mapping = {
-    (inquiry) StatefulHandleWrapper_length, /* mp_length */
+    (lenfunc) StatefulHandleWrapper_length, /* mp_length */
     (binaryfunc) StatefulHandleWrapper_subscript, /* mp_subscript */
     (objobjargproc) StatefulHandleWrapper_ass_sub, /* mp_ass_subscript */
   };
@@ -0,0 +1,156 @@
+/******************************************************************************
+ * pyvix - Benchmark: VIX Event Delivery via VixEventRing vs. the GIL
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Fires FIND_ITEM events at an accumulator from many threads at once (as
+ * VIX's worker threads do during VixHost_FindItems) and reports the
+ * throughput of:
+ *   - legacy:  the former VixCallback_accumulateStringList, which acquired the
+ *              GIL to append each event's item to a Python list;
+ *   - ring:    the current one, which pushes each event's raw data into the
+ *              accumulator's VixEventRing without the GIL, followed by a
+ *              single batched VixCallbackAccumulator_flush.
+ * Each combination is measured with Python idle and with a Python thread
+ * spinning (i.e., competing for the GIL).
+ *
+ * This program includes pyvix's single translation unit and links against
+ * the stand-in libvix in ./standin, so it needs neither the VIX SDK nor a
+ * VMware host.  From this directory:
+ *   gcc -O2 -DNDEBUG -fno-strict-aliasing -Istandin -I/usr/include/python2.7 \
+ *       bench_event_ring.c standin/standin_vix.c \
+ *       -lpython2.7 -lpthread -o bench_event_ring
+ *   ./bench_event_ring [nEventsPerThread]                                   */
+
+#include "../../_vixmodule.c"
+
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "standin_vix.h"
+
+static void legacy_accumulateStringList(VixHandle jobH,
+    VixEventType eventType, VixHandle eventInfo, void *clientData
+  )
+{
+  /* Verbatim (apart from the name) from callback_accumulator.c before the
+   * introduction of VixEventRing. */
+  PyGILState_STATE gstate;
+  PyObject *pyStr = NULL;
+  VixCallbackAccumulator *acc = NULL;
+
+  if (eventType != VIX_EVENTTYPE_FIND_ITEM) { return; }
+
+  ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+
+  acc = (VixCallbackAccumulator *) clientData;
+  pyStr = pyf_extractProperty(eventInfo, VIX_PROPERTY_FOUND_ITEM_LOCATION);
+  if (pyStr == NULL) { goto fail; }
+
+  if (PyList_Append(acc->target, pyStr) != 0) { goto fail; }
+
+  goto cleanup;
+  fail:
+    SUPPRESS_EXCEPTION;
+  cleanup:
+    Py_XDECREF(pyStr);
+    LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+} /* legacy_accumulateStringList */
+
+static double secondsNow(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+} /* secondsNow */
+
+static double measure(bool useRing, int nThreads, int nEventsPerThread) {
+  /* Returns events per second.  The GIL must be held. */
+  VixCallbackAccumulator acc;
+  PyThreadState *ts;
+  double start, elapsed;
+
+  if (VixCallbackAccumulator_ListInit(&acc) != SUCCEEDED) {
+    PyErr_Print();
+    exit(1);
+  }
+
+  start = secondsNow();
+  ts = PyEval_SaveThread();
+  StandinVix_fireEvents(
+      (useRing ? VixCallback_accumulateStringList
+               : legacy_accumulateStringList),
+      &acc, nThreads, nEventsPerThread
+    );
+  PyEval_RestoreThread(ts);
+  if (useRing && VixCallbackAccumulator_flush(&acc) != SUCCEEDED) {
+    PyErr_Print();
+    exit(1);
+  }
+  elapsed = secondsNow() - start;
+
+  if (PyList_GET_SIZE(acc.target) != (Py_ssize_t) nThreads * nEventsPerThread) {
+    fprintf(stderr, "Lost events: got %d of %d.\n",
+        (int) PyList_GET_SIZE(acc.target), nThreads * nEventsPerThread
+      );
+    exit(1);
+  }
+  VixCallbackAccumulator_clear(&acc);
+
+  return nThreads * nEventsPerThread / elapsed;
+} /* measure */
+
+static void setPythonBusy(bool busy) {
+  /* The GIL must be held. */
+  if (busy) {
+    PyRun_SimpleString(
+        "import thread\n"
+        "_spinning = [True]\n"
+        "def _spin():\n"
+        "    while _spinning[0]:\n"
+        "        pass\n"
+        "thread.start_new_thread(_spin, ())\n"
+      );
+  } else {
+    PyThreadState *ts;
+    PyRun_SimpleString("_spinning[0] = False\n");
+    ts = PyEval_SaveThread();
+    usleep(100000);
+    PyEval_RestoreThread(ts);
+  }
+} /* setPythonBusy */
+
+int main(int argc, char **argv) {
+  static const int threadCounts[] = {1, 4, 16, 64};
+  int nEventsPerThread = (argc > 1 ? atoi(argv[1]) : 20000);
+  int busy, i;
+
+  Py_Initialize();
+  PyEval_InitThreads();
+  init_vixmodule();
+  if (PyErr_Occurred()) {
+    PyErr_Print();
+    return 1;
+  }
+
+  printf("%-6s %8s %10s %14s %14s %8s\n",
+      "python", "threads", "events", "legacy ev/s", "ring ev/s", "speedup"
+    );
+  for (busy = 0; busy <= 1; busy++) {
+    if (busy) { setPythonBusy(true); }
+
+    for (i = 0; i < (int) (sizeof(threadCounts) / sizeof(int)); i++) {
+      int nThreads = threadCounts[i];
+      double legacy = measure(false, nThreads, nEventsPerThread);
+      double ring = measure(true, nThreads, nEventsPerThread);
+
+      printf("%-6s %8d %10d %14.0f %14.0f %7.1fx\n",
+          (busy ? "busy" : "idle"), nThreads, nThreads * nEventsPerThread,
+          legacy, ring, ring / legacy
+        );
+    }
+
+    if (busy) { setPythonBusy(false); }
+  }
+
+  return 0;
+} /* main */
@@ -0,0 +1,219 @@
+/******************************************************************************
+ * pyvix - Benchmark: Guest File Contents Staged in Memory vs. Temporary Files
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Moves payloads of 1KB to 100MB into and out of the guest, and reports the
+ * time per transfer taken by:
+ *   - staged:    vm.writeGuestFile and vm.readGuestFile, which pass the
+ *                payload through a StagedFile (see staging.c);
+ *   - tempfile:  the pattern they replace, which writes the payload to a
+ *                temporary file on disk and copies that with
+ *                vm.copyFileFromHostToGuest (or copies into one with
+ *                vm.copyFileFromGuestToHost and reads it back), then deletes
+ *                it.
+ * Both are called through their Python methods.  The stand-in's file copies
+ * really copy, into a directory that stands in for the guest's file system
+ * (guestRoot, by default a new directory in the temporary directory), so
+ * both variants pay the same for VIX's part; what differs is the host's.
+ *
+ * This program includes pyvix's single translation unit and links against
+ * the stand-in libvix in ./standin, so it needs neither the VIX SDK nor a
+ * VMware host.  From this directory:
+ *   gcc -O2 -DNDEBUG -fno-strict-aliasing -Istandin -I/usr/include/python2.7 \
+ *       bench_guest_file_io.c standin/standin_vix.c \
+ *       -lpython2.7 -lpthread -o bench_guest_file_io
+ *   ./bench_guest_file_io [guestRoot]                                       */
+
+#include "../../_vixmodule.c"
+
+#include <sys/time.h>
+
+#include "standin_vix.h"
+
+#define GUEST_PATH "/pyvix-bench-guest-file"
+
+/* Each size is transferred often enough to move about this much, within
+ * [MIN_REPS, MAX_REPS] times: */
+#define BYTES_PER_SIZE (256 * 1024 * 1024)
+#define MIN_REPS 3
+#define MAX_REPS 1000
+
+static double secondsNow(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+} /* secondsNow */
+
+static void die(const char *what) {
+  if (PyErr_Occurred()) { PyErr_Print(); }
+  fprintf(stderr, "%s failed.\n", what);
+  exit(1);
+} /* die */
+
+static void callAndDiscard(PyObject *result, const char *what) {
+  if (result == NULL) { die(what); }
+  Py_DECREF(result);
+} /* callAndDiscard */
+
+static void writeStaged(VM *vm, PyObject *payload) {
+  callAndDiscard(PyObject_CallMethod((PyObject *) vm, "writeGuestFile", "sO",
+      GUEST_PATH, payload
+    ), "writeGuestFile");
+} /* writeStaged */
+
+static PyObject *readStaged(VM *vm) {
+  PyObject *contents = PyObject_CallMethod((PyObject *) vm, "readGuestFile",
+      "s", GUEST_PATH
+    );
+  if (contents == NULL) { die("readGuestFile"); }
+  return contents;
+} /* readStaged */
+
+static void writeViaTempFile(VM *vm, PyObject *payload) {
+  /* As Python code would:  write the payload to a temporary file, copy that
+   * into the guest, and delete it. */
+  char *tempPath = TreeArchive_stagingPath(NULL);
+  FILE *f;
+
+  if (tempPath == NULL) { die("TreeArchive_stagingPath"); }
+  f = fopen(tempPath, "wb");
+  if (f == NULL
+      || fwrite(PyString_AS_STRING(payload), 1, PyString_GET_SIZE(payload), f)
+          != (size_t) PyString_GET_SIZE(payload)
+      || fclose(f) != 0
+     )
+  { die("writing the temporary file"); }
+  callAndDiscard(PyObject_CallMethod((PyObject *) vm,
+      "copyFileFromHostToGuest", "ss", tempPath, GUEST_PATH
+    ), "copyFileFromHostToGuest");
+  unlink(tempPath);
+  pyvix_plain_free(tempPath);
+} /* writeViaTempFile */
+
+static PyObject *readViaTempFile(VM *vm) {
+  /* As Python code would:  copy the guest file into a temporary file, read
+   * that into a string, and delete it. */
+  char *tempPath = TreeArchive_stagingPath(NULL);
+  FILE *f;
+  long size;
+  PyObject *contents;
+
+  if (tempPath == NULL) { die("TreeArchive_stagingPath"); }
+  callAndDiscard(PyObject_CallMethod((PyObject *) vm,
+      "copyFileFromGuestToHost", "ss", GUEST_PATH, tempPath
+    ), "copyFileFromGuestToHost");
+  f = fopen(tempPath, "rb");
+  if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0) {
+    die("opening the temporary file");
+  }
+  rewind(f);
+  contents = PyString_FromStringAndSize(NULL, size);
+  if (contents == NULL) { die("PyString_FromStringAndSize"); }
+  if (fread(PyString_AS_STRING(contents), 1, size, f) != (size_t) size) {
+    die("reading the temporary file");
+  }
+  fclose(f);
+  unlink(tempPath);
+  pyvix_plain_free(tempPath);
+  return contents;
+} /* readViaTempFile */
+
+static void measure(VM *vm, long size) {
+  /* Prints a row of results for each direction.  The GIL must be held. */
+  long reps = BYTES_PER_SIZE / size;
+  PyObject *payload = PyString_FromStringAndSize(NULL, size);
+  double start, staged, viaTempFile;
+  long i;
+
+  if (payload == NULL) { die("PyString_FromStringAndSize"); }
+  for (i = 0; i < size; i++) {
+    PyString_AS_STRING(payload)[i] = (char) (i * 7 + (i >> 10));
+  }
+  if (reps < MIN_REPS) { reps = MIN_REPS; }
+  if (reps > MAX_REPS) { reps = MAX_REPS; }
+
+  start = secondsNow();
+  for (i = 0; i < reps; i++) { writeStaged(vm, payload); }
+  staged = (secondsNow() - start) / reps;
+  start = secondsNow();
+  for (i = 0; i < reps; i++) { writeViaTempFile(vm, payload); }
+  viaTempFile = (secondsNow() - start) / reps;
+  printf("%10ld %6ld %-6s %12.3f %12.3f %8.2fx\n", size, reps, "write",
+      staged * 1e3, viaTempFile * 1e3, viaTempFile / staged
+    );
+
+  start = secondsNow();
+  for (i = 0; i < reps; i++) {
+    PyObject *contents = readStaged(vm);
+    if (PyString_GET_SIZE(contents) != size) { die("readGuestFile's size"); }
+    Py_DECREF(contents);
+  }
+  staged = (secondsNow() - start) / reps;
+  start = secondsNow();
+  for (i = 0; i < reps; i++) {
+    PyObject *contents = readViaTempFile(vm);
+    if (PyString_GET_SIZE(contents) != size) { die("the temporary file"); }
+    Py_DECREF(contents);
+  }
+  viaTempFile = (secondsNow() - start) / reps;
+  printf("%10ld %6ld %-6s %12.3f %12.3f %8.2fx\n", size, reps, "read",
+      staged * 1e3, viaTempFile * 1e3, viaTempFile / staged
+    );
+
+  Py_DECREF(payload);
+} /* measure */
+
+int main(int argc, char **argv) {
+  static const long sizes[] = {
+      1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 100 * 1024 * 1024
+    };
+  char defaultGuestRoot[] = "/tmp/pyvix-bench-guest-XXXXXX";
+  const char *guestRoot;
+  char *guestFile;
+  Host *host;
+  PyObject *pyVMXPath;
+  VM *vm;
+  size_t i;
+
+  if (argc > 1) {
+    guestRoot = argv[1];
+  } else {
+    guestRoot = mkdtemp(defaultGuestRoot);
+    if (guestRoot == NULL) { die("mkdtemp"); }
+  }
+  StandinVix_setGuestRoot(guestRoot);
+
+  Py_Initialize();
+  init_vixmodule();
+  if (PyErr_Occurred()) { die("init_vixmodule"); }
+
+  /* The stand-in's VixHost_Connect and VixVM_Open can't succeed, so the Host
+   * and VM are put together by hand: */
+  host = (Host *) pyf_Host_new(&HostType, NULL, NULL);
+  if (host == NULL) { die("pyf_Host_new"); }
+  host->handle = 1;
+  host->state = STATE_OPEN;
+  pyVMXPath = PyString_FromString("/vms/standin/vm0.vmx");
+  if (pyVMXPath == NULL) { die("PyString_FromString"); }
+  vm = (VM *) VM_createFromHandle(host, pyVMXPath, 2);
+  if (vm == NULL) { die("VM_createFromHandle"); }
+
+  printf("%10s %6s %-6s %12s %12s %9s\n",
+      "bytes", "reps", "op", "staged ms", "tempfile ms", "speedup"
+    );
+  for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+    measure(vm, sizes[i]);
+  }
+
+  guestFile = malloc(strlen(guestRoot) + sizeof GUEST_PATH);
+  if (guestFile != NULL) {
+    strcpy(guestFile, guestRoot);
+    strcat(guestFile, GUEST_PATH);
+    unlink(guestFile);
+    free(guestFile);
+  }
+  if (argc <= 1) { rmdir(guestRoot); }
+
+  return 0;
+} /* main */
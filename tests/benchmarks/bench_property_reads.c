@@ -0,0 +1,107 @@
+/******************************************************************************
+ * pyvix - Benchmark: Reading a Property With and Without the Type Cache
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Evaluates vm[VIX_PROPERTY_VM_POWER_STATE] nReads (by default 1M) times in a
+ * tight loop, and reports the time taken and the number of VIX calls made per
+ * read by:
+ *   - uncached:  the former way, which asks VIX for the property's type before
+ *                every read (emulated by evicting the property ID from
+ *                propertyTypeCache before each read);
+ *   - cached:    the current way, which asks VIX for the type only once.
+ * The stand-in's property calls return at once, which flatters the uncached
+ * reads; so each variant is also measured with every property call made to
+ * take 2us, closer to the cost of a real VIX call.
+ *
+ * This program includes pyvix's single translation unit and links against
+ * the stand-in libvix in ./standin, so it needs neither the VIX SDK nor a
+ * VMware host.  From this directory:
+ *   gcc -O2 -DNDEBUG -fno-strict-aliasing -Istandin -I/usr/include/python2.7 \
+ *       bench_property_reads.c standin/standin_vix.c \
+ *       -lpython2.7 -lpthread -o bench_property_reads
+ *   ./bench_property_reads [nReads]                                         */
+
+#include "../../_vixmodule.c"
+
+#include <sys/time.h>
+
+#include "standin_vix.h"
+
+#define SLOW_PROPERTY_CALL_NANOS 2000
+
+static double secondsNow(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+} /* secondsNow */
+
+static void die(const char *what) {
+  if (PyErr_Occurred()) { PyErr_Print(); }
+  fprintf(stderr, "%s failed.\n", what);
+  exit(1);
+} /* die */
+
+static void measure(VM *vm, bool cached, long callNanos, long n) {
+  /* Prints a row of results for n reads.  The GIL must be held. */
+  PyObject *pyPropID = PyInt_FromLong(VIX_PROPERTY_VM_POWER_STATE);
+  long nCallsBefore;
+  double start, elapsed;
+  long i;
+
+  if (pyPropID == NULL) { die("PyInt_FromLong"); }
+  StandinVix_setPropertyCallNanos(callNanos);
+  PyVixAtomic_store(&propertyTypeCache[VIX_PROPERTY_VM_POWER_STATE], 0);
+
+  nCallsBefore = StandinVix_numPropertyCalls();
+  start = secondsNow();
+  for (i = 0; i < n; i++) {
+    PyObject *powerState;
+    if (!cached) {
+      PyVixAtomic_store(&propertyTypeCache[VIX_PROPERTY_VM_POWER_STATE], 0);
+    }
+    powerState = PyObject_GetItem((PyObject *) vm, pyPropID);
+    if (powerState == NULL) { die("vm[VIX_PROPERTY_VM_POWER_STATE]"); }
+    Py_DECREF(powerState);
+  }
+  elapsed = secondsNow() - start;
+
+  printf("%-10s %8ld %10ld %10.1f %14.2f\n",
+      cached ? "cached" : "uncached", callNanos, n, elapsed * 1e9 / n,
+      (double) (StandinVix_numPropertyCalls() - nCallsBefore) / n
+    );
+  Py_DECREF(pyPropID);
+} /* measure */
+
+int main(int argc, char **argv) {
+  long n = (argc > 1 ? atol(argv[1]) : 1000000);
+  Host *host;
+  PyObject *pyVMXPath;
+  VM *vm;
+
+  Py_Initialize();
+  init_vixmodule();
+  if (PyErr_Occurred()) { die("init_vixmodule"); }
+
+  /* The stand-in's VixHost_Connect and VixVM_Open can't succeed, so the Host
+   * and VM are put together by hand: */
+  host = (Host *) pyf_Host_new(&HostType, NULL, NULL);
+  if (host == NULL) { die("pyf_Host_new"); }
+  host->handle = 1;
+  host->state = STATE_OPEN;
+  pyVMXPath = PyString_FromString("/vms/standin/vm0.vmx");
+  if (pyVMXPath == NULL) { die("PyString_FromString"); }
+  vm = (VM *) VM_createFromHandle(host, pyVMXPath, 2);
+  if (vm == NULL) { die("VM_createFromHandle"); }
+
+  printf("%-10s %8s %10s %10s %14s\n",
+      "types", "call ns", "reads", "ns/read", "VIX calls/read"
+    );
+  measure(vm, false, 0, n);
+  measure(vm, true, 0, n);
+  /* The slow calls take long enough that fewer reads suffice: */
+  measure(vm, false, SLOW_PROPERTY_CALL_NANOS, n / 10);
+  measure(vm, true, SLOW_PROPERTY_CALL_NANOS, n / 10);
+
+  return 0;
+} /* main */
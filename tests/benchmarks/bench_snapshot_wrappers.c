@@ -0,0 +1,128 @@
+/******************************************************************************
+ * pyvix - Benchmark: Creating and Dropping Snapshot Wrappers
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Creates and drops nWrappers (by default 1M) Snapshot objects for a VM, and
+ * reports the time taken per wrapper by:
+ *   - call protocol:  the former way, PyObject_CallFunction on SnapshotType
+ *                     (which builds an argument tuple for Snapshot_init to
+ *                     parse), without a free list;
+ *   - fast ctor:      Snapshot_createFromHandle, without a free list;
+ *   - + free list:    Snapshot_createFromHandle, recycling the deallocated
+ *                     wrappers through Snapshot_freeList.
+ * It then does the same via the VM.rootSnapshots getter, for a VM with 1000
+ * root snapshots, with and without the free list.
+ *
+ * This program includes pyvix's single translation unit and links against
+ * the stand-in libvix in ./standin, so it needs neither the VIX SDK nor a
+ * VMware host.  From this directory:
+ *   gcc -O2 -DNDEBUG -fno-strict-aliasing -Istandin -I/usr/include/python2.7 \
+ *       bench_snapshot_wrappers.c standin/standin_vix.c \
+ *       -lpython2.7 -lpthread -o bench_snapshot_wrappers
+ *   ./bench_snapshot_wrappers [nWrappers]                                   */
+
+#include "../../_vixmodule.c"
+
+#include <sys/time.h>
+
+#include "standin_vix.h"
+
+#define N_ROOT_SNAPSHOTS 1000
+
+typedef enum {
+  VIA_CALL_PROTOCOL = 0,
+  VIA_FAST_CTOR     = 1,
+  VIA_ROOT_SNAPSHOTS = 2
+} Method;
+
+static double secondsNow(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+} /* secondsNow */
+
+static void die(const char *what) {
+  if (PyErr_Occurred()) { PyErr_Print(); }
+  fprintf(stderr, "%s failed.\n", what);
+  exit(1);
+} /* die */
+
+static double measure(VM *vm, Method method, bool useFreeList, long n) {
+  /* Returns nanoseconds per wrapper.  The GIL must be held. */
+  double start;
+  long i;
+
+  Snapshot_freeList.maxLength = (useFreeList
+      ? SNAPSHOT_FREE_LIST_MAX_LENGTH : 0
+    );
+
+  start = secondsNow();
+  if (method == VIA_ROOT_SNAPSHOTS) {
+    for (i = 0; i < n; i += N_ROOT_SNAPSHOTS) {
+      PyObject *snaps = PyObject_GetAttrString((PyObject *) vm,
+          "rootSnapshots"
+        );
+      if (snaps == NULL) { die("rootSnapshots"); }
+      Py_DECREF(snaps);
+    }
+  } else {
+    for (i = 0; i < n; i++) {
+      VixHandle snapH = (VixHandle) (0x20000000 + (i % N_ROOT_SNAPSHOTS));
+      PyObject *snap = (method == VIA_CALL_PROTOCOL
+          ? PyObject_CallFunction((PyObject *) &SnapshotType,
+                "O" VixHandle_FUNCTION_CALL_CODE, vm, snapH
+              )
+          : Snapshot_createFromHandle(vm, snapH)
+        );
+      if (snap == NULL) { die("creating a Snapshot"); }
+      Py_DECREF(snap);
+    }
+  }
+
+  return (secondsNow() - start) * 1e9 / n;
+} /* measure */
+
+int main(int argc, char **argv) {
+  long n = (argc > 1 ? atol(argv[1]) : 1000000);
+  Host *host;
+  PyObject *pyVMXPath;
+  VM *vm;
+
+  Py_Initialize();
+  init_vixmodule();
+  if (PyErr_Occurred()) { die("init_vixmodule"); }
+
+  /* The stand-in's VixHost_Connect and VixVM_Open can't succeed, so the Host
+   * and VM are put together by hand: */
+  host = (Host *) pyf_Host_new(&HostType, NULL, NULL);
+  if (host == NULL) { die("pyf_Host_new"); }
+  host->handle = 1;
+  host->state = STATE_OPEN;
+  pyVMXPath = PyString_FromString("/vms/standin/vm0.vmx");
+  if (pyVMXPath == NULL) { die("PyString_FromString"); }
+  vm = (VM *) VM_createFromHandle(host, pyVMXPath, 2);
+  if (vm == NULL) { die("VM_createFromHandle"); }
+  StandinVix_setNumRootSnapshots(N_ROOT_SNAPSHOTS);
+
+  printf("%-15s %-10s %10s %10s\n", "method", "free list", "wrappers",
+      "ns/wrapper"
+    );
+  printf("%-15s %-10s %10ld %10.1f\n", "call protocol", "no", n,
+      measure(vm, VIA_CALL_PROTOCOL, false, n)
+    );
+  printf("%-15s %-10s %10ld %10.1f\n", "fast ctor", "no", n,
+      measure(vm, VIA_FAST_CTOR, false, n)
+    );
+  printf("%-15s %-10s %10ld %10.1f\n", "fast ctor", "yes", n,
+      measure(vm, VIA_FAST_CTOR, true, n)
+    );
+  printf("%-15s %-10s %10ld %10.1f\n", "rootSnapshots", "no", n,
+      measure(vm, VIA_ROOT_SNAPSHOTS, false, n)
+    );
+  printf("%-15s %-10s %10ld %10.1f\n", "rootSnapshots", "yes", n,
+      measure(vm, VIA_ROOT_SNAPSHOTS, true, n)
+    );
+
+  return 0;
+} /* main */
@@ -0,0 +1,239 @@
+/******************************************************************************
+ * pyvix - Benchmark: Intrusive Trackers vs. the Former LIFO Linked Lists
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Tracks N freshly created Snapshot objects in a VM's openSnapshots, then
+ * either removes them one at a time (as closing each of them does) or
+ * releases them all at once (as closing the VM does), and reports the time
+ * taken per object by:
+ *   - legacy:     the LIFO linked list formerly generated by
+ *                 lifo_linked_list.h, which mallocs a node per object and
+ *                 searches for that node from the head upon removal;
+ *   - intrusive:  the current SnapshotTracker (intrusive_tracker.h).
+ * Objects are removed in LIFO order (the former lists' best case), in FIFO
+ * order (their worst case), and in random order.
+ *
+ * This program includes pyvix's single translation unit and links against
+ * the stand-in libvix in ./standin, so it needs neither the VIX SDK nor a
+ * VMware host.  From this directory:
+ *   gcc -O2 -DNDEBUG -fno-strict-aliasing -Istandin -I/usr/include/python2.7 \
+ *       bench_trackers.c standin/standin_vix.c \
+ *       -lpython2.7 -lpthread -o bench_trackers
+ *   ./bench_trackers [maxLegacyN]                                           */
+
+#include "../../_vixmodule.c"
+
+#include <sys/time.h>
+
+/* The former tracker, expanded from lifo_linked_list.h (with the
+ * PYALLOC allocation functions) for the Snapshot type alone: */
+typedef struct _LegacySnapshotTracker {
+  Snapshot *contained;
+  struct _LegacySnapshotTracker *next;
+} LegacySnapshotTracker;
+
+static status LegacySnapshotTracker_add(LegacySnapshotTracker **list_slot,
+    Snapshot *cont
+  )
+{
+  LegacySnapshotTracker *prev_head = *list_slot;
+  *list_slot = pyvix_main_malloc(sizeof(LegacySnapshotTracker));
+  if (*list_slot == NULL) {
+    *list_slot = prev_head;
+    return FAILED;
+  }
+  (*list_slot)->contained = cont;
+  (*list_slot)->next = prev_head;
+  return SUCCEEDED;
+} /* LegacySnapshotTracker_add */
+
+static status LegacySnapshotTracker_remove(LegacySnapshotTracker **list_slot,
+    Snapshot *cont
+  )
+{
+  LegacySnapshotTracker *nodeBack;
+  LegacySnapshotTracker *nodeForward;
+
+  nodeBack = nodeForward = *list_slot;
+  while (nodeForward != NULL && nodeForward->contained != cont) {
+    nodeBack = nodeForward;
+    nodeForward = nodeForward->next;
+  }
+  if (nodeForward == NULL) { return FAILED; }
+
+  if (nodeBack == nodeForward) {
+    *list_slot = nodeForward->next;
+  } else {
+    nodeBack->next = nodeForward->next;
+  }
+  pyvix_main_free(nodeForward);
+  return SUCCEEDED;
+} /* LegacySnapshotTracker_remove */
+
+static status LegacySnapshotTracker_release(LegacySnapshotTracker **list_slot) {
+  LegacySnapshotTracker *list = *list_slot;
+
+  while (list != NULL) {
+    LegacySnapshotTracker *next_list;
+    if (Snapshot_untrack(list->contained, true) != SUCCEEDED) {
+      return FAILED;
+    }
+    next_list = list->next;
+    pyvix_main_free(list);
+    list = next_list;
+  }
+  *list_slot = NULL;
+  return SUCCEEDED;
+} /* LegacySnapshotTracker_release */
+
+typedef enum {
+  REMOVE_LIFO   = 0,
+  REMOVE_FIFO   = 1,
+  REMOVE_RANDOM = 2,
+  RELEASE_ALL   = 3
+} Pattern;
+
+static const char *patternNames[] = {"remove LIFO", "remove FIFO",
+    "remove random", "release"
+  };
+
+static double secondsNow(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+} /* secondsNow */
+
+static void die(const char *what) {
+  if (PyErr_Occurred()) { PyErr_Print(); }
+  fprintf(stderr, "%s failed.\n", what);
+  exit(1);
+} /* die */
+
+static Snapshot **createSnapshots(Py_ssize_t n) {
+  Snapshot **snaps = malloc(sizeof(Snapshot *) * n);
+  Py_ssize_t i;
+
+  if (snaps == NULL) { die("malloc"); }
+  for (i = 0; i < n; i++) {
+    snaps[i] = (Snapshot *) pyf_Snapshot_new(&SnapshotType, NULL, NULL);
+    if (snaps[i] == NULL) { die("pyf_Snapshot_new"); }
+  }
+  return snaps;
+} /* createSnapshots */
+
+static void destroySnapshots(Snapshot **snaps, Py_ssize_t n) {
+  Py_ssize_t i;
+  for (i = 0; i < n; i++) {
+    /* Make sure the deallocator doesn't try to unlink the snapshot: */
+    snaps[i]->vm = NULL;
+    TRACKER_LINKS_INIT(snaps[i]);
+    Py_DECREF(snaps[i]);
+  }
+  free(snaps);
+} /* destroySnapshots */
+
+static Py_ssize_t *removalOrder(Py_ssize_t n, Pattern pattern) {
+  Py_ssize_t *order = malloc(sizeof(Py_ssize_t) * n);
+  Py_ssize_t i;
+
+  if (order == NULL) { die("malloc"); }
+  for (i = 0; i < n; i++) {
+    order[i] = (pattern == REMOVE_LIFO ? n - 1 - i : i);
+  }
+  if (pattern == REMOVE_RANDOM) {
+    srand(12345);
+    for (i = n - 1; i > 0; i--) {
+      Py_ssize_t j = rand() % (i + 1);
+      Py_ssize_t tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+  }
+  return order;
+} /* removalOrder */
+
+static double measure(bool legacy, Pattern pattern, Py_ssize_t n) {
+  /* Returns nanoseconds per object for adding n objects and then removing
+   * them according to pattern.  The GIL must be held. */
+  Snapshot **snaps = createSnapshots(n);
+  Py_ssize_t *order = removalOrder(n, pattern);
+  LegacySnapshotTracker *legacyList = NULL;
+  SnapshotTracker tracker;
+  double start, elapsed;
+  Py_ssize_t i;
+
+  TRACKER_INIT(&tracker);
+
+  start = secondsNow();
+  for (i = 0; i < n; i++) {
+    status res = (legacy
+        ? LegacySnapshotTracker_add(&legacyList, snaps[i])
+        : SnapshotTracker_add(&tracker, snaps[i])
+      );
+    if (res != SUCCEEDED) { die("add"); }
+  }
+  if (pattern == RELEASE_ALL) {
+    status res = (legacy
+        ? LegacySnapshotTracker_release(&legacyList)
+        : SnapshotTracker_release(&tracker)
+      );
+    if (res != SUCCEEDED) { die("release"); }
+  } else {
+    for (i = 0; i < n; i++) {
+      Snapshot *snap = snaps[order[i]];
+      status res = (legacy
+          ? LegacySnapshotTracker_remove(&legacyList, snap)
+          : SnapshotTracker_remove(&tracker, snap, true)
+        );
+      if (res != SUCCEEDED) { die("remove"); }
+    }
+  }
+  elapsed = secondsNow() - start;
+
+  if (legacyList != NULL || !TRACKER_IS_EMPTY(&tracker)) {
+    die("emptying the tracker");
+  }
+  free(order);
+  destroySnapshots(snaps, n);
+
+  return elapsed * 1e9 / n;
+} /* measure */
+
+int main(int argc, char **argv) {
+  static const Py_ssize_t counts[] = {10000, 30000, 100000};
+  /* Removing 100k objects from the former lists takes several seconds, so
+   * the legacy variant can be limited to this many objects: */
+  Py_ssize_t maxLegacyN = (argc > 1 ? atol(argv[1]) : 100000);
+  int p, i;
+
+  Py_Initialize();
+  init_vixmodule();
+  if (PyErr_Occurred()) {
+    PyErr_Print();
+    return 1;
+  }
+
+  printf("%-14s %8s %14s %14s %9s\n",
+      "pattern", "objects", "legacy ns/obj", "intrus. ns/obj", "speedup"
+    );
+  for (p = REMOVE_LIFO; p <= RELEASE_ALL; p++) {
+    for (i = 0; i < (int) (sizeof(counts) / sizeof(counts[0])); i++) {
+      Py_ssize_t n = counts[i];
+      double intrusive = measure(false, (Pattern) p, n);
+
+      if (n <= maxLegacyN) {
+        double legacy = measure(true, (Pattern) p, n);
+        printf("%-14s %8ld %14.1f %14.1f %8.1fx\n",
+            patternNames[p], (long) n, legacy, intrusive, legacy / intrusive
+          );
+      } else {
+        printf("%-14s %8ld %14s %14.1f %9s\n",
+            patternNames[p], (long) n, "-", intrusive, "-"
+          );
+      }
+    }
+  }
+
+  return 0;
+} /* main */
@@ -0,0 +1,430 @@
+/******************************************************************************
+ * pyvix - Stand-in libvix for the Benchmarks
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Defines every VIX function that pyvix references (see vix.h in this
+ * directory), so that pyvix can be linked without the VMware VIX SDK.  Only
+ * the calls that the benchmarks exercise do anything meaningful; the job
+ * functions all refuse their job by returning VIX_INVALID_HANDLE.
+ *
+ * In addition, StandinVix_fireEvents plays the part of VIX's worker threads,
+ * reporting events to a VixEventProc from many threads at once, and once
+ * StandinVix_setGuestRoot has been called, the file copies really copy. */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vix.h"
+#include "standin_vix.h"
+
+/* Handles at or above STANDIN_EVENT_HANDLE_BASE denote FIND_ITEM events; the
+ * item they report is derived from the handle itself. */
+#define STANDIN_EVENT_HANDLE_BASE 0x40000000
+
+/****************************** Properties ***********************************/
+
+/* The property calls are counted, and can each be made to take (by spinning)
+ * at least as long as a real VIX call, which crosses a process boundary: */
+static volatile long StandinVix_nPropertyCalls = 0;
+static long StandinVix_propertyCallNanos = 0;
+
+void StandinVix_setPropertyCallNanos(long nanos) {
+  StandinVix_propertyCallNanos = nanos;
+} /* StandinVix_setPropertyCallNanos */
+
+long StandinVix_numPropertyCalls(void) {
+  return StandinVix_nPropertyCalls;
+} /* StandinVix_numPropertyCalls */
+
+static void StandinVix_propertyCall(void) {
+  __sync_add_and_fetch(&StandinVix_nPropertyCalls, 1);
+  if (StandinVix_propertyCallNanos > 0) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L
+        + (now.tv_nsec - start.tv_nsec) < StandinVix_propertyCallNanos
+      );
+  }
+} /* StandinVix_propertyCall */
+
+static VixPropertyType StandinVix_propertyType(VixPropertyID propID) {
+  switch (propID) {
+    case VIX_PROPERTY_FOUND_ITEM_LOCATION:
+    case VIX_PROPERTY_VM_VMX_PATHNAME:
+    case VIX_PROPERTY_VM_NAME:
+    case VIX_PROPERTY_VM_GUESTOS:
+    case VIX_PROPERTY_SNAPSHOT_DISPLAYNAME:
+    case VIX_PROPERTY_SNAPSHOT_DESCRIPTION:
+      return VIX_PROPERTYTYPE_STRING;
+    case VIX_PROPERTY_VM_IS_RUNNING:
+    case VIX_PROPERTY_VM_READ_ONLY:
+      return VIX_PROPERTYTYPE_BOOL;
+    case VIX_PROPERTY_JOB_RESULT_HANDLE:
+      return VIX_PROPERTYTYPE_HANDLE;
+    default:
+      return VIX_PROPERTYTYPE_INTEGER;
+  }
+} /* StandinVix_propertyType */
+
+VixError Vix_GetPropertyType(VixHandle handle, VixPropertyID propertyID,
+    VixPropertyType *propertyType
+  )
+{
+  StandinVix_propertyCall();
+  *propertyType = StandinVix_propertyType(propertyID);
+  return VIX_OK;
+} /* Vix_GetPropertyType */
+
+VixError Vix_GetProperties(VixHandle handle, VixPropertyID firstPropertyID,
+    ...
+  )
+{
+  VixPropertyID propID = firstPropertyID;
+  va_list ap;
+
+  StandinVix_propertyCall();
+  va_start(ap, firstPropertyID);
+  while (propID != VIX_PROPERTY_NONE) {
+    void *out = va_arg(ap, void *);
+
+    switch (StandinVix_propertyType(propID)) {
+      case VIX_PROPERTYTYPE_STRING: {
+        char buf[64];
+        if (handle >= STANDIN_EVENT_HANDLE_BASE) {
+          sprintf(buf, "/vms/standin/vm%d.vmx",
+              handle - STANDIN_EVENT_HANDLE_BASE
+            );
+        } else {
+          sprintf(buf, "standin-%d-%d", handle, propID);
+        }
+        *(char **) out = strdup(buf);
+        break;
+      }
+      case VIX_PROPERTYTYPE_HANDLE:
+        *(VixHandle *) out = VIX_INVALID_HANDLE;
+        break;
+      default:
+        *(int *) out = (propID == VIX_PROPERTY_VM_POWER_STATE
+            ? VIX_POWERSTATE_POWERED_OFF : 0
+          );
+        break;
+    }
+
+    propID = va_arg(ap, VixPropertyID);
+  }
+  va_end(ap);
+
+  return VIX_OK;
+} /* Vix_GetProperties */
+
+const char *Vix_GetErrorText(VixError err, const char *locale) {
+  return "stand-in VIX error";
+}
+
+void Vix_ReleaseHandle(VixHandle handle) {}
+void Vix_AddRefHandle(VixHandle handle) {}
+VixHandleType Vix_GetHandleType(VixHandle handle) { return VIX_HANDLETYPE_VM; }
+void Vix_FreeBuffer(void *p) { free(p); }
+
+/****************************** Guest Files **********************************/
+
+/* The directory that stands in for the guest's file system, or NULL if the
+ * file copies are to refuse their jobs like the other job functions: */
+static char *StandinVix_guestRoot = NULL;
+
+/* The handle of every job that the stand-in completes; the job functions
+ * never look at it: */
+#define STANDIN_JOB_HANDLE 3
+
+void StandinVix_setGuestRoot(const char *dir) {
+  free(StandinVix_guestRoot);
+  StandinVix_guestRoot = (dir != NULL ? strdup(dir) : NULL);
+} /* StandinVix_setGuestRoot */
+
+static int StandinVix_copyBytes(const char *src, const char *dest) {
+  /* Returns 0 if src was copied to dest, or -1 if it wasn't. */
+  static char buf[1024 * 1024];
+  FILE *in = fopen(src, "rb");
+  FILE *out = NULL;
+  size_t n;
+  int result = -1;
+
+  if (in == NULL) { return -1; }
+  out = fopen(dest, "wb");
+  if (out == NULL) { goto done; }
+  while ((n = fread(buf, 1, sizeof buf, in)) > 0) {
+    if (fwrite(buf, 1, n, out) != n) { goto done; }
+  }
+  if (!ferror(in)) { result = 0; }
+  done:
+    if (out != NULL && fclose(out) != 0) { result = -1; }
+    fclose(in);
+    return result;
+} /* StandinVix_copyBytes */
+
+static VixHandle StandinVix_copyFile(const char *hostPath,
+    const char *guestPath, int toGuest, VixEventProc *callbackProc,
+    void *clientData
+  )
+{
+  /* Copies between hostPath and guestPath beneath StandinVix_guestRoot, and
+   * reports the job completed before returning, as VIX may.  The stand-in's
+   * error code property always reads as VIX_OK, so a failed copy is reported
+   * by refusing the job instead. */
+  char *guestFile;
+
+  if (StandinVix_guestRoot == NULL) { return VIX_INVALID_HANDLE; }
+  guestFile = malloc(strlen(StandinVix_guestRoot) + strlen(guestPath) + 1);
+  if (guestFile == NULL) { return VIX_INVALID_HANDLE; }
+  strcpy(guestFile, StandinVix_guestRoot);
+  strcat(guestFile, guestPath);
+  if ((toGuest
+        ? StandinVix_copyBytes(hostPath, guestFile)
+        : StandinVix_copyBytes(guestFile, hostPath)
+      ) != 0
+     )
+  {
+    free(guestFile);
+    return VIX_INVALID_HANDLE;
+  }
+  free(guestFile);
+
+  if (callbackProc != NULL) {
+    callbackProc(STANDIN_JOB_HANDLE, VIX_EVENTTYPE_JOB_COMPLETED,
+        VIX_INVALID_HANDLE, clientData
+      );
+  }
+  return STANDIN_JOB_HANDLE;
+} /* StandinVix_copyFile */
+
+/********************************* Jobs **************************************/
+
+VixError VixJob_Wait(VixHandle jobHandle, VixPropertyID firstPropertyID, ...) {
+  return VIX_E_NOT_SUPPORTED;
+}
+VixError VixJob_CheckCompletion(VixHandle jobHandle, Bool *complete) {
+  *complete = 1;
+  return VIX_OK;
+}
+VixError VixJob_GetError(VixHandle jobHandle) { return VIX_E_NOT_SUPPORTED; }
+int VixJob_GetNumProperties(VixHandle jobHandle, int resultPropertyID) {
+  return 0;
+}
+VixError VixJob_GetNthProperties(VixHandle jobHandle, int index,
+    int propertyID, ...
+  )
+{ return VIX_E_NOT_SUPPORTED; }
+
+VixHandle VixHost_Connect(int apiVersion, VixServiceProvider hostType,
+    const char *hostName, int hostPort, const char *userName,
+    const char *password, VixHostOptions options, VixHandle propertyListHandle,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+void VixHost_Disconnect(VixHandle hostHandle) {}
+VixHandle VixHost_RegisterVM(VixHandle hostHandle, const char *vmxFilePath,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixHost_UnregisterVM(VixHandle hostHandle, const char *vmxFilePath,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixHost_FindItems(VixHandle hostHandle, VixFindItemType searchType,
+    VixHandle searchCriteria, int32 timeout, VixEventProc *callbackProc,
+    void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+
+VixHandle VixVM_Open(VixHandle hostHandle, const char *vmxFilePathName,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_PowerOn(VixHandle vmHandle, VixVMPowerOpOptions powerOnOptions,
+    VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_PowerOff(VixHandle vmHandle,
+    VixVMPowerOpOptions powerOffOptions, VixEventProc *callbackProc,
+    void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_Reset(VixHandle vmHandle, VixVMPowerOpOptions resetOptions,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_Suspend(VixHandle vmHandle,
+    VixVMPowerOpOptions suspendOptions, VixEventProc *callbackProc,
+    void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_Delete(VixHandle vmHandle, VixVMDeleteOptions deleteOptions,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_WaitForToolsInGuest(VixHandle vmHandle, int timeoutInSeconds,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_LoginInGuest(VixHandle vmHandle, const char *userName,
+    const char *password, int options, VixEventProc *callbackProc,
+    void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_LogoutFromGuest(VixHandle vmHandle,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_RunProgramInGuest(VixHandle vmHandle,
+    const char *guestProgramName, const char *commandLineArgs,
+    VixRunProgramOptions options, VixHandle propertyListHandle,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_CopyFileFromHostToGuest(VixHandle vmHandle,
+    const char *hostPathName, const char *guestPathName, int options,
+    VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData
+  )
+{
+  return StandinVix_copyFile(hostPathName, guestPathName, 1,
+      callbackProc, clientData
+    );
+}
+VixHandle VixVM_CopyFileFromGuestToHost(VixHandle vmHandle,
+    const char *guestPathName, const char *hostPathName, int options,
+    VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData
+  )
+{
+  return StandinVix_copyFile(hostPathName, guestPathName, 0,
+      callbackProc, clientData
+    );
+}
+VixHandle VixVM_DeleteFileInGuest(VixHandle vmHandle,
+    const char *guestPathName, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_FileExistsInGuest(VixHandle vmHandle,
+    const char *guestPathName, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_CreateDirectoryInGuest(VixHandle vmHandle,
+    const char *pathName, VixHandle propertyListHandle,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_DirectoryExistsInGuest(VixHandle vmHandle,
+    const char *pathName, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_ListDirectoryInGuest(VixHandle vmHandle, const char *pathName,
+    int options, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_CreateTempFileInGuest(VixHandle vmHandle, int options,
+    VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_InstallTools(VixHandle vmHandle, int options,
+    const char *commandLineArgs, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_UpgradeVirtualHardware(VixHandle vmHandle, int options,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+
+static int StandinVix_nRootSnapshots = 0;
+
+void StandinVix_setNumRootSnapshots(int n) {
+  StandinVix_nRootSnapshots = n;
+} /* StandinVix_setNumRootSnapshots */
+
+VixError VixVM_GetNumRootSnapshots(VixHandle vmHandle, int *result) {
+  *result = StandinVix_nRootSnapshots;
+  return VIX_OK;
+}
+VixError VixVM_GetRootSnapshot(VixHandle vmHandle, int index,
+    VixHandle *snapshotHandle
+  )
+{
+  if (index < 0 || index >= StandinVix_nRootSnapshots) {
+    return VIX_E_INVALID_ARG;
+  }
+  *snapshotHandle = 0x20000000 + index;
+  return VIX_OK;
+}
+VixError VixVM_GetCurrentSnapshot(VixHandle vmHandle,
+    VixHandle *snapshotHandle
+  )
+{ return VIX_E_NOT_SUPPORTED; }
+VixError VixVM_GetNamedSnapshot(VixHandle vmHandle, const char *name,
+    VixHandle *snapshotHandle
+  )
+{ return VIX_E_NOT_SUPPORTED; }
+VixHandle VixVM_RemoveSnapshot(VixHandle vmHandle, VixHandle snapshotHandle,
+    VixRemoveSnapshotOptions options, VixEventProc *callbackProc,
+    void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_RevertToSnapshot(VixHandle vmHandle, VixHandle snapshotHandle,
+    VixVMPowerOpOptions options, VixHandle propertyListHandle,
+    VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+VixHandle VixVM_CreateSnapshot(VixHandle vmHandle, const char *name,
+    const char *description, VixCreateSnapshotOptions options,
+    VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData
+  )
+{ return VIX_INVALID_HANDLE; }
+
+/************************** Simulated worker threads *************************/
+
+typedef struct {
+  VixEventProc *proc;
+  void *clientData;
+  int firstItem;
+  int nEvents;
+} StandinVix_FireArgs;
+
+static void *StandinVix_fireThread(void *p) {
+  StandinVix_FireArgs *fa = (StandinVix_FireArgs *) p;
+  int i;
+
+  for (i = 0; i < fa->nEvents; i++) {
+    fa->proc(STANDIN_EVENT_HANDLE_BASE - 1, VIX_EVENTTYPE_FIND_ITEM,
+        STANDIN_EVENT_HANDLE_BASE + fa->firstItem + i, fa->clientData
+      );
+  }
+
+  return NULL;
+} /* StandinVix_fireThread */
+
+void StandinVix_fireEvents(VixEventProc *proc, void *clientData,
+    int nThreads, int nEventsPerThread
+  )
+{
+  pthread_t *threads = malloc(sizeof(pthread_t) * nThreads);
+  StandinVix_FireArgs *args = malloc(sizeof(StandinVix_FireArgs) * nThreads);
+  int t;
+
+  for (t = 0; t < nThreads; t++) {
+    args[t].proc = proc;
+    args[t].clientData = clientData;
+    args[t].firstItem = t * nEventsPerThread;
+    args[t].nEvents = nEventsPerThread;
+    pthread_create(&threads[t], NULL, StandinVix_fireThread, &args[t]);
+  }
+  for (t = 0; t < nThreads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  free(args);
+  free(threads);
+} /* StandinVix_fireEvents */
@@ -0,0 +1,35 @@
+/******************************************************************************
+ * pyvix - Benchmark Hooks of the Stand-in libvix
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+#ifndef STANDIN_VIX_HOOKS_H
+#define STANDIN_VIX_HOOKS_H
+
+/* Reports nThreads * nEventsPerThread VIX_EVENTTYPE_FIND_ITEM events to proc,
+ * from nThreads threads running concurrently, and returns once all of them
+ * have been delivered.  Each event's moreEventInfo handle yields a distinct
+ * VIX_PROPERTY_FOUND_ITEM_LOCATION. */
+void StandinVix_fireEvents(VixEventProc *proc, void *clientData,
+    int nThreads, int nEventsPerThread
+  );
+
+/* Sets the number of root snapshots that every VM reports having; each of
+ * them has a distinct handle. */
+void StandinVix_setNumRootSnapshots(int n);
+
+/* Makes each Vix_GetPropertyType and Vix_GetProperties call take at least
+ * nanos nanoseconds (0, the default, adds no delay). */
+void StandinVix_setPropertyCallNanos(long nanos);
+
+/* Returns the number of Vix_GetPropertyType and Vix_GetProperties calls made
+ * so far. */
+long StandinVix_numPropertyCalls(void);
+
+/* Makes VixVM_CopyFileFromHostToGuest and VixVM_CopyFileFromGuestToHost copy
+ * between the host path and the guest path beneath dir (which must not end
+ * with a separator), completing the job before they return.  dir NULL, the
+ * default, makes them refuse their jobs again. */
+void StandinVix_setGuestRoot(const char *dir);
+
+#endif /* STANDIN_VIX_HOOKS_H */
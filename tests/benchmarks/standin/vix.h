@@ -0,0 +1,234 @@
+/******************************************************************************
+ * pyvix - Stand-in vix.h for the Benchmarks
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Declares just the subset of the VIX API that pyvix references, so that the
+ * benchmarks in tests/benchmarks can be built and run on machines without the
+ * VMware VIX SDK.  The numeric values of the constants are arbitrary (except
+ * that the power states are distinct bits, as in the real header); nothing
+ * built against this file is binary-compatible with libvix. */
+
+#ifndef STANDIN_VIX_H
+#define STANDIN_VIX_H
+
+#include <stdint.h>
+
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+typedef char Bool;
+
+typedef int VixHandle;
+typedef uint64 VixError;
+typedef int VixPropertyID;
+typedef int VixPropertyType;
+typedef int VixEventType;
+typedef int VixToolsState;
+typedef int VixServiceProvider;
+typedef int VixHostOptions;
+typedef int VixFindItemType;
+typedef int VixVMPowerOpOptions;
+typedef int VixVMDeleteOptions;
+typedef int VixCreateSnapshotOptions;
+typedef int VixRemoveSnapshotOptions;
+typedef int VixRunProgramOptions;
+typedef int VixHandleType;
+typedef int VixPowerState;
+typedef void VixEventProc(VixHandle handle, VixEventType eventType, VixHandle moreEventInfo, void *clientData);
+
+#define VIX_API_VERSION 1
+#define VIX_INVALID_HANDLE 0
+#define VIX_OK 0
+#define VIX_PROPERTY_NONE 0
+#define VIX_ERROR_CODE(err) ((err) & 0xFFFF)
+#define VIX_SUCCEEDED(err) (VIX_OK == (err))
+#define VIX_FAILED(err) (VIX_OK != (err))
+#define VIX_EVENTTYPE_FIND_ITEM 1000
+#define VIX_EVENTTYPE_JOB_COMPLETED 1001
+#define VIX_EVENTTYPE_JOB_PROGRESS 1002
+#define VIX_E_ANON_GUEST_OPERATIONS_PROHIBITED 1003
+#define VIX_E_BAD_VM_INDEX 1004
+#define VIX_E_CANCELLED 1005
+#define VIX_E_CANNOT_AUTHENTICATE_WITH_GUEST 1006
+#define VIX_E_CANNOT_CONNECT_TO_VM 1007
+#define VIX_E_CANNOT_READ_VM_CONFIG 1008
+#define VIX_E_DISK_FULL 1009
+#define VIX_E_FAIL 1010
+#define VIX_E_FILE_ACCESS_ERROR 1011
+#define VIX_E_FILE_ALREADY_EXISTS 1012
+#define VIX_E_FILE_ALREADY_LOCKED 1013
+#define VIX_E_FILE_ERROR 1014
+#define VIX_E_FILE_NOT_FOUND 1015
+#define VIX_E_FILE_READ_ONLY 1016
+#define VIX_E_GUEST_OPERATIONS_PROHIBITED 1017
+#define VIX_E_GUEST_USER_PERMISSIONS 1018
+#define VIX_E_HOST_USER_PERMISSIONS 1019
+#define VIX_E_INCORRECT_FILE_TYPE 1020
+#define VIX_E_INVALID_ARG 1021
+#define VIX_E_INVALID_HANDLE 1022
+#define VIX_E_INVALID_PROPERTY_VALUE 1023
+#define VIX_E_INVALID_XML 1024
+#define VIX_E_MISSING_ANON_GUEST_ACCOUNT 1025
+#define VIX_E_MISSING_REQUIRED_PROPERTY 1026
+#define VIX_E_NOT_FOUND 1027
+#define VIX_E_NOT_SUPPORTED 1028
+#define VIX_E_NOT_SUPPORTED_FOR_VM_VERSION 1029
+#define VIX_E_NOT_SUPPORTED_ON_HANDLE_TYPE 1030
+#define VIX_E_NO_GUEST_OS_INSTALLED 1031
+#define VIX_E_OBJECT_IS_BUSY 1032
+#define VIX_E_OP_NOT_SUPPORTED_ON_GUEST 1033
+#define VIX_E_OUT_OF_MEMORY 1034
+#define VIX_E_POWEROP_SCRIPTS_NOT_AVAILABLE 1035
+#define VIX_E_PROGRAM_NOT_STARTED 1036
+#define VIX_E_READ_ONLY_PROPERTY 1037
+#define VIX_E_REQUIRES_LARGE_FILES 1038
+#define VIX_E_ROOT_GUEST_OPERATIONS_PROHIBITED 1039
+#define VIX_E_SUSPEND_ERROR 1040
+#define VIX_E_TEMPLATE_VM 1041
+#define VIX_E_TIMEOUT 1042
+#define VIX_E_TIMEOUT_WAITING_FOR_TOOLS 1043
+#define VIX_E_TOOLS_NOT_RUNNING 1044
+#define VIX_E_TOO_MANY_HANDLES 1045
+#define VIX_E_TYPE_MISMATCH 1046
+#define VIX_E_UNRECOGNIZED_COMMAND 1047
+#define VIX_E_UNRECOGNIZED_COMMAND_IN_GUEST 1048
+#define VIX_E_UNRECOGNIZED_PROPERTY 1049
+#define VIX_E_VM_ALREADY_LOADED 1050
+#define VIX_E_VM_INSUFFICIENT_HOST_MEMORY 1051
+#define VIX_E_VM_IS_RUNNING 1052
+#define VIX_E_VM_NOT_ENOUGH_CPUS 1053
+#define VIX_E_VM_NOT_FOUND 1054
+#define VIX_E_VM_NOT_RUNNING 1055
+#define VIX_FILE_ATTRIBUTES_DIRECTORY 1056
+#define VIX_FIND_RUNNING_VMS 1057
+#define VIX_HANDLETYPE_VM 1058
+#define VIX_POWERSTATE_BLOCKED_ON_MSG 256
+#define VIX_POWERSTATE_POWERED_OFF 1
+#define VIX_POWERSTATE_POWERED_ON 2
+#define VIX_POWERSTATE_POWERING_OFF 4
+#define VIX_POWERSTATE_POWERING_ON 8
+#define VIX_POWERSTATE_RESETTING 128
+#define VIX_POWERSTATE_SUSPENDED 16
+#define VIX_POWERSTATE_SUSPENDING 32
+#define VIX_POWERSTATE_TOOLS_RUNNING 64
+#define VIX_PROPERTYTYPE_ANY 1068
+#define VIX_PROPERTYTYPE_BLOB 1069
+#define VIX_PROPERTYTYPE_BOOL 1070
+#define VIX_PROPERTYTYPE_HANDLE 1071
+#define VIX_PROPERTYTYPE_INT64 1072
+#define VIX_PROPERTYTYPE_INTEGER 1073
+#define VIX_PROPERTYTYPE_STRING 1074
+#define VIX_PROPERTY_FOREIGN_VM_TOOLS_VERSION 1075
+#define VIX_PROPERTY_FOUND_ITEM_LOCATION 1076
+#define VIX_PROPERTY_GUEST_NAME 1077
+#define VIX_PROPERTY_GUEST_OS_FAMILY 1078
+#define VIX_PROPERTY_GUEST_OS_PACKAGE_LIST 1079
+#define VIX_PROPERTY_GUEST_OS_VERSION 1080
+#define VIX_PROPERTY_GUEST_POWER_OFF_SCRIPT 1081
+#define VIX_PROPERTY_GUEST_POWER_ON_SCRIPT 1082
+#define VIX_PROPERTY_GUEST_RESUME_SCRIPT 1083
+#define VIX_PROPERTY_GUEST_SUSPEND_SCRIPT 1084
+#define VIX_PROPERTY_GUEST_TOOLS_API_OPTIONS 1085
+#define VIX_PROPERTY_GUEST_TOOLS_PRODUCT_NAM 1086
+#define VIX_PROPERTY_GUEST_TOOLS_VERSION 1087
+#define VIX_PROPERTY_HOST_API_VERSION 1088
+#define VIX_PROPERTY_HOST_HOSTTYPE 1089
+#define VIX_PROPERTY_JOB_RESULT_COMMAND_OUTPUT 1090
+#define VIX_PROPERTY_JOB_RESULT_ERROR_CODE 1091
+#define VIX_PROPERTY_JOB_RESULT_EXIT_CODE 1092
+#define VIX_PROPERTY_JOB_RESULT_EXTRA_ERROR_INFO 1093
+#define VIX_PROPERTY_JOB_RESULT_FILE_FLAGS 1094
+#define VIX_PROPERTY_JOB_RESULT_FILE_MOD_TIME 1095
+#define VIX_PROPERTY_JOB_RESULT_FILE_SIZE 1096
+#define VIX_PROPERTY_JOB_RESULT_FOUND_ITEM_DESCRIPTION 1097
+#define VIX_PROPERTY_JOB_RESULT_FOUND_ITEM_NAME 1098
+#define VIX_PROPERTY_JOB_RESULT_GUEST_OBJECT_EXISTS 1099
+#define VIX_PROPERTY_JOB_RESULT_GUEST_PROGRAM_ELAPSED_TIME 1100
+#define VIX_PROPERTY_JOB_RESULT_GUEST_PROGRAM_EXIT_CODE 1101
+#define VIX_PROPERTY_JOB_RESULT_HANDLE 1102
+#define VIX_PROPERTY_JOB_RESULT_ITEM_NAME 1103
+#define VIX_PROPERTY_JOB_RESULT_LINE_NUM 1104
+#define VIX_PROPERTY_JOB_RESULT_PROCESS_ID 1105
+#define VIX_PROPERTY_JOB_RESULT_SCREEN_IMAGE_DATA 1106
+#define VIX_PROPERTY_JOB_RESULT_SCREEN_IMAGE_SIZE 1107
+#define VIX_PROPERTY_JOB_RESULT_USER_MESSAGE 1108
+#define VIX_PROPERTY_JOB_RESULT_VM_IN_GROUP 1109
+#define VIX_PROPERTY_SNAPSHOT_DESCRIPTION 1110
+#define VIX_PROPERTY_SNAPSHOT_DISPLAYNAME 1111
+#define VIX_PROPERTY_SNAPSHOT_POWERSTATE 1112
+#define VIX_PROPERTY_TYPE_BLOB 1113
+#define VIX_PROPERTY_VM_GUESTOS 1114
+#define VIX_PROPERTY_VM_IN_VMTEAM 1115
+#define VIX_PROPERTY_VM_IS_RECORDING 1116
+#define VIX_PROPERTY_VM_IS_REPLAYING 1117
+#define VIX_PROPERTY_VM_IS_RUNNING 1118
+#define VIX_PROPERTY_VM_MEMORY_SIZE 1119
+#define VIX_PROPERTY_VM_NAME 1120
+#define VIX_PROPERTY_VM_NUM_VCPUS 1121
+#define VIX_PROPERTY_VM_POWER_STATE 1122
+#define VIX_PROPERTY_VM_READ_ONLY 1123
+#define VIX_PROPERTY_VM_SSL_ERROR 1124
+#define VIX_PROPERTY_VM_SUPPORTED_FEATURES 1125
+#define VIX_PROPERTY_VM_TEAM_PATHNAME 1126
+#define VIX_PROPERTY_VM_TOOLS_STATE 1127
+#define VIX_PROPERTY_VM_VMTEAM_PATHNAME 1128
+#define VIX_PROPERTY_VM_VMX_PATHNAME 1129
+#define VIX_RUNPROGRAM_RETURN_IMMEDIATELY 1130
+#define VIX_SERVICEPROVIDER_VMWARE_SERVER 1131
+#define VIX_SERVICEPROVIDER_VMWARE_WORKSTATION 1132
+#define VIX_SNAPSHOT_REMOVE_CHILDREN 1133
+#define VIX_TOOLSSTATE_NOT_INSTALLED 1134
+#define VIX_TOOLSSTATE_RUNNING 1135
+#define VIX_TOOLSSTATE_UNKNOWN 1136
+#define VIX_VMPOWEROP_LAUNCH_GUI 1137
+#define VIX_VMPOWEROP_NORMAL 1138
+#define VIX_VMPOWEROP_SUPPRESS_SNAPSHOT_POWERON 1139
+
+const char *Vix_GetErrorText(VixError err, const char *locale);
+void Vix_ReleaseHandle(VixHandle handle);
+void Vix_AddRefHandle(VixHandle handle);
+VixHandleType Vix_GetHandleType(VixHandle handle);
+VixError Vix_GetProperties(VixHandle handle, VixPropertyID firstPropertyID, ...);
+VixError Vix_GetPropertyType(VixHandle handle, VixPropertyID propertyID, VixPropertyType *propertyType);
+void Vix_FreeBuffer(void *p);
+VixHandle VixHost_Connect(int apiVersion, VixServiceProvider hostType, const char *hostName, int hostPort, const char *userName, const char *password, VixHostOptions options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+void VixHost_Disconnect(VixHandle hostHandle);
+VixHandle VixHost_RegisterVM(VixHandle hostHandle, const char *vmxFilePath, VixEventProc *callbackProc, void *clientData);
+VixHandle VixHost_UnregisterVM(VixHandle hostHandle, const char *vmxFilePath, VixEventProc *callbackProc, void *clientData);
+VixHandle VixHost_FindItems(VixHandle hostHandle, VixFindItemType searchType, VixHandle searchCriteria, int32 timeout, VixEventProc *callbackProc, void *clientData);
+VixError VixJob_Wait(VixHandle jobHandle, VixPropertyID firstPropertyID, ...);
+VixError VixJob_CheckCompletion(VixHandle jobHandle, Bool *complete);
+VixError VixJob_GetError(VixHandle jobHandle);
+int VixJob_GetNumProperties(VixHandle jobHandle, int resultPropertyID);
+VixError VixJob_GetNthProperties(VixHandle jobHandle, int index, int propertyID, ...);
+VixHandle VixVM_Open(VixHandle hostHandle, const char *vmxFilePathName, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_PowerOn(VixHandle vmHandle, VixVMPowerOpOptions powerOnOptions, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_PowerOff(VixHandle vmHandle, VixVMPowerOpOptions powerOffOptions, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_Reset(VixHandle vmHandle, VixVMPowerOpOptions resetOptions, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_Suspend(VixHandle vmHandle, VixVMPowerOpOptions suspendOptions, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_Delete(VixHandle vmHandle, VixVMDeleteOptions deleteOptions, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_WaitForToolsInGuest(VixHandle vmHandle, int timeoutInSeconds, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_LoginInGuest(VixHandle vmHandle, const char *userName, const char *password, int options, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_LogoutFromGuest(VixHandle vmHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_RunProgramInGuest(VixHandle vmHandle, const char *guestProgramName, const char *commandLineArgs, VixRunProgramOptions options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_CopyFileFromHostToGuest(VixHandle vmHandle, const char *hostPathName, const char *guestPathName, int options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_CopyFileFromGuestToHost(VixHandle vmHandle, const char *guestPathName, const char *hostPathName, int options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_DeleteFileInGuest(VixHandle vmHandle, const char *guestPathName, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_FileExistsInGuest(VixHandle vmHandle, const char *guestPathName, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_CreateDirectoryInGuest(VixHandle vmHandle, const char *pathName, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_DirectoryExistsInGuest(VixHandle vmHandle, const char *pathName, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_ListDirectoryInGuest(VixHandle vmHandle, const char *pathName, int options, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_CreateTempFileInGuest(VixHandle vmHandle, int options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_InstallTools(VixHandle vmHandle, int options, const char *commandLineArgs, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_UpgradeVirtualHardware(VixHandle vmHandle, int options, VixEventProc *callbackProc, void *clientData);
+VixError VixVM_GetNumRootSnapshots(VixHandle vmHandle, int *result);
+VixError VixVM_GetRootSnapshot(VixHandle vmHandle, int index, VixHandle *snapshotHandle);
+VixError VixVM_GetCurrentSnapshot(VixHandle vmHandle, VixHandle *snapshotHandle);
+VixError VixVM_GetNamedSnapshot(VixHandle vmHandle, const char *name, VixHandle *snapshotHandle);
+VixHandle VixVM_RemoveSnapshot(VixHandle vmHandle, VixHandle snapshotHandle, VixRemoveSnapshotOptions options, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_RevertToSnapshot(VixHandle vmHandle, VixHandle snapshotHandle, VixVMPowerOpOptions options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+VixHandle VixVM_CreateSnapshot(VixHandle vmHandle, const char *name, const char *description, VixCreateSnapshotOptions options, VixHandle propertyListHandle, VixEventProc *callbackProc, void *clientData);
+
+#endif /* STANDIN_VIX_H */
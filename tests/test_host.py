@@ -11,6 +11,14 @@ def test_Host_connect_noArgs():
     # VMWare Server without any explicit security information.
     h = Host()
 
+def test_Host_connect_timeout():
+    # Connecting and opening a VM are bounded by a timeout like any other job:
+    h = Host(timeout=60)
+    assert not h.closed
+    vm = h.openVM(_support.site_config.generic_vmx, timeout=60)
+    assert not vm.closed
+    assert not VM(h, _support.site_config.generic_vmx, timeout=60).closed
+
 def test_Host_connect_badSecurityInfo():
     if site_config.skip_tests_bad_credentials_host_authentification:
         return None
@@ -40,6 +48,362 @@ def test_Host_findRunningVMs():
     print 'Here are the paths of the VMs that are running on this host:'
     print vmPaths
 
+def test_Host_findRunningVMs_async():
+    h = Host()
+    job = h.findRunningVMPaths(async_=True)
+    assert isinstance(job, Job)
+    assert job.owner is h
+    assert job.wait()
+    assert job.done()
+    assert job.result() == h.findRunningVMPaths()
+
+def test_slabStats():
+    h = Host()
+    h.findRunningVMPaths()
+    stats = slabStats()
+    for name in ('JobCompletion', 'CompletionPort',
+        'VixEventRing', 'VixEventRecord'
+      ):
+        counters = stats[name]
+        assert counters['allocated'] == counters['live'] + counters['free']
+
+    # Finished jobs hand their JobCompletions back for reuse:
+    nAllocatedBefore = stats['JobCompletion']['allocated']
+    for i in xrange(200):
+        h.findRunningVMPaths()
+    assert slabStats()['JobCompletion']['allocated'] <= nAllocatedBefore + 64
+
+def test_Host_iterRunningVMPaths():
+    h = Host()
+    it = h.iterRunningVMPaths()
+    assert iter(it) is it
+    streamed = list(it)
+    assert sorted(streamed) == sorted(h.findRunningVMPaths())
+    # An exhausted iterator stays exhausted:
+    assert list(it) == []
+
+def _runWithClosedVM(h, vm, runBatch, failureOf, after=()):
+    # Runs runBatch([vm, closedVM] + after), where closedVM is a closed VM of
+    # h's, and checks that closedVM's failure is reported in its own slot of
+    # the results, without aborting the rest of the batch.  failureOf(results,
+    # i) picks out what the batch reported for its i'th VM.  Returns the
+    # results.
+    # openVM would merely return vm again:
+    closedVM = VM(h, _support.site_config.generic_vmx)
+    closedVM.close()
+    results = runBatch([vm, closedVM] + list(after))
+    assert isinstance(failureOf(results, 1), VIXClientProgrammerError)
+    return results
+
+def test_Host_powerOpsMany():
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    results = _runWithClosedVM(h, vm,
+        lambda vms: h.powerOnMany(vms, max_parallel=1),
+        lambda results, i: results[i]
+      )
+    assert len(results) == 2
+    assert results[0] is None
+    assert isinstance(h.powerOnMany([vm])[0], VIXException)
+
+    assert h.resetMany([vm]) == [None]
+    assert h.powerOffMany([vm], max_parallel=4) == [None]
+    assert vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF != 0
+    assert h.powerOnMany([]) == []
+
+    py.test.raises(TypeError, h.powerOnMany, [vm, 'not a VM'])
+    py.test.raises(VIXClientProgrammerError,
+        h.powerOnMany, [vm], max_parallel=0
+      )
+
+def test_Host_runPipelines():
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    results = _runWithClosedVM(h, vm,
+        lambda vms: h.runPipelines(vms,
+            [('powerOn',), ('waitForTools',), ('powerOff',)], max_parallel=1
+          ),
+        lambda results, i: results[i]
+      )
+    assert len(results) == 2
+    assert [step[2] for step in results[0]] == ['ok', 'ok', 'ok']
+    assert vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF != 0
+
+    assert h.runPipelines([], [('powerOn',)]) == []
+    py.test.raises(TypeError, h.runPipelines, [vm, 'not a VM'], [])
+    py.test.raises(VIXClientProgrammerError,
+        h.runPipelines, [vm], [('powerOn',)], max_parallel=0
+      )
+
+def test_Host_broadcastFile():
+    import os, tempfile
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_ON == 0:
+        vm.powerOn()
+    vm.waitForToolsInGuest()
+    vm.loginInGuest(site_config.guest_username, site_config.guest_password)
+
+    fd, src = tempfile.mkstemp()
+    os.write(fd, 'broadcast' * 1000)
+    os.close(fd)
+    dest = '%spyvix_test_broadcast_%d' % (site_config.guest_dest_dir,
+        os.getpid()
+      )
+    try:
+        results = _runWithClosedVM(h, vm,
+            lambda vms: h.broadcastFile(vms, src, dest, max_parallel=1),
+            lambda results, i: results[i][3]
+          )
+        assert len(results) == 2
+        assert results[0][0] is vm
+        assert results[0][2:] == ('ok', None)
+        assert results[0][1] >= 0.0
+        assert results[1][2] == 'error'
+        assert dest in vm.contentCache
+
+        # The guest is known to hold src already:
+        results = h.broadcastFile([vm], src, dest, dedupe=True)
+        assert [r[2] for r in results] == ['unchanged']
+
+        assert h.broadcastFile([], src, dest) == []
+        py.test.raises(VIXException, h.broadcastFile, [vm], src + '.missing',
+            dest
+          )
+        py.test.raises(TypeError, h.broadcastFile, [vm, 'not a VM'], src,
+            dest
+          )
+        py.test.raises(VIXClientProgrammerError,
+            h.broadcastFile, [vm], src, dest, max_parallel=0
+          )
+    finally:
+        os.remove(src)
+
+def test_Host_admissionControl():
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    stats = h.admissionStats()
+    assert sorted(stats.keys()) == ['guest_io', 'power', 'snapshot']
+    assert stats['power']['limit'] == 0
+
+    h.setAdmissionLimits(power=1, guest_io=2)
+    stats = h.admissionStats()
+    assert stats['power']['limit'] == 1
+    assert stats['snapshot']['limit'] == 0
+    assert stats['guest_io']['limit'] == 2
+
+    # Each job holds the only power slot until VIX has reported on it:
+    jobs = [vm.reset(async_=True) for i in range(3)]
+    for job in jobs:
+        job.result()
+    assert h.powerOffMany([vm]) == [None]
+    assert [step[2] for step in vm.runPipeline([('powerOn',)])] == ['ok']
+    vm.powerOff()
+
+    power = h.admissionStats()['power']
+    assert power['admitted'] == stats['power']['admitted'] + 6
+    assert power['inFlight'] == 0
+    assert power['waiting'] == 0
+    assert power['queued'] <= 6
+    assert power['maxWaitTime'] <= power['totalWaitTime']
+
+    py.test.raises(VIXClientProgrammerError,
+        h.setAdmissionLimits, snapshot=-1
+      )
+    assert h.admissionStats()['snapshot']['limit'] == 0
+    h.setAdmissionLimits(power=0, guest_io=0)
+    assert h.admissionStats()['power']['limit'] == 0
+
+def test_workerPool():
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    before = workerPoolStats()
+    configureWorkerPool(workers=2, queue_size=8)
+    assert h.workerLimit is None
+    h.workerLimit = 1
+    assert h.workerLimit == 1
+
+    jobs = [vm.runPipeline([('reset',)], async_=True) for i in range(4)]
+    jobs.append(h.runPipelines([vm], [('powerOff',)], async_=True))
+    for job in jobs[:4]:
+        assert isinstance(job, Job)
+        assert [step[2] for step in job.result()] == ['ok']
+    assert [step[2] for step in jobs[4].result()[0]] == ['ok']
+
+    stats = workerPoolStats()
+    assert stats['submitted'] == before['submitted'] + 5
+    assert stats['completed'] == before['completed'] + 5
+    assert stats['queueDepth'] == 0
+    assert stats['queueSize'] == 8
+    assert stats['totalRunTime'] > before['totalRunTime']
+
+    h.workerLimit = None
+    py.test.raises(VIXClientProgrammerError, setattr, h, 'workerLimit', -1)
+    py.test.raises(VIXClientProgrammerError, configureWorkerPool, workers=0)
+    configureWorkerPool(workers=4, queue_size=64)
+
+def test_Host_openVMs():
+    h = Host()
+    goodPath = _support.site_config.generic_vmx
+    missingPath = goodPath + '.missing'
+
+    # Failures are reported per path, without aborting the rest of the batch:
+    results = h.openVMs([goodPath, missingPath, goodPath], max_parallel=2)
+    assert len(results) == 3
+    assert isinstance(results[0], VM)
+    assert isinstance(results[1], VIXException)
+    # A path listed twice is opened only once:
+    assert results[2] is results[0]
+    assert not results[0].closed
+    assert results[0][VIX_PROPERTY_VM_VMX_PATHNAME] == goodPath
+
+    # An already open VM is reused:
+    assert h.openVMs([goodPath]) == [results[0]]
+
+    # The opened VMs belong to h, so closing h closes them:
+    h.close()
+    assert results[0].closed
+
+    h = Host()
+    assert h.openVMs([]) == []
+    py.test.raises(TypeError, h.openVMs, [goodPath, None])
+    py.test.raises(VIXClientProgrammerError,
+        h.openVMs, [goodPath], max_parallel=0
+      )
+
+def test_Host_openVMsByPath():
+    import weakref
+    VM_PATH = _support.site_config.generic_vmx
+
+    h = Host()
+    assert h.getOpenVM(VM_PATH) is None
+    assert h.openVMsByPath == {}
+
+    vm = h.openVM(VM_PATH)
+    assert h.openVM(VM_PATH) is vm
+    assert h.getOpenVM(VM_PATH) is vm
+    assert h.openVMsByPath == {VM_PATH: vm}
+
+    # Invoking the VM constructor directly opens a distinct VM, but doesn't
+    # displace vm from the index:
+    other = VM(h, VM_PATH)
+    assert other is not vm
+    assert h.getOpenVM(VM_PATH) is vm
+    other.close()
+
+    vm.close()
+    assert h.getOpenVM(VM_PATH) is None
+    reopened = h.openVM(VM_PATH)
+    assert reopened is not vm
+
+    # The index doesn't keep VMs alive:
+    ref = weakref.ref(reopened)
+    del reopened
+    assert ref() is None
+    assert h.getOpenVM(VM_PATH) is None
+    assert h.openVMsByPath == {}
+
+def test_Host_propertyTable():
+    import array
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    props = [VIX_PROPERTY_VM_POWER_STATE, VIX_PROPERTY_VM_TOOLS_STATE,
+        VIX_PROPERTY_VM_VMX_PATHNAME, VIX_PROPERTY_VM_NUM_VCPUS,
+        VIX_PROPERTY_VM_MEMORY_SIZE
+      ]
+
+    table = _runWithClosedVM(h, vm,
+        lambda vms: h.propertyTable(vms, props),
+        lambda table, i: table['errors'][i], after=[vm]
+      )
+    assert table['vmxPath'] == [vm.vmxPath, None, vm.vmxPath]
+    assert table['errors'][0] is None
+    assert table['errors'][2] is None
+
+    powerStates = table[VIX_PROPERTY_VM_POWER_STATE]
+    assert isinstance(powerStates, array.array)
+    assert len(powerStates) == 3
+    assert table[VIX_PROPERTY_VM_VMX_PATHNAME] == [
+        vm[VIX_PROPERTY_VM_VMX_PATHNAME], None, vm[VIX_PROPERTY_VM_VMX_PATHNAME]
+      ]
+    for p in props:
+        assert table[p][0] == vm[p]
+        assert table[p][2] == vm[p]
+
+    table = h.propertyTable([], props)
+    assert table['errors'] == []
+    assert len(table[VIX_PROPERTY_VM_POWER_STATE]) == 0
+    py.test.raises(TypeError, h.propertyTable, [vm, 'not a VM'], props)
+    py.test.raises(TypeError, h.propertyTable, [vm], ['not a property ID'])
+
+def test_Host_watchPowerState():
+    import threading, time
+    h = Host()
+    vm = h.openVM(_support.site_config.generic_vmx)
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+    offState = vm[VIX_PROPERTY_VM_POWER_STATE]
+
+    changes = []
+    changed = threading.Event()
+    def callback(batch):
+        changes.extend(batch)
+        changed.set()
+
+    w = h.watchPowerState(callback, interval=0.01)
+    assert isinstance(w, PowerStateWatcher)
+    assert h.powerStateWatcher is w
+    assert w.running
+    assert w.interval == 0.01
+    py.test.raises(VIXClientProgrammerError, h.watchPowerState, callback)
+    # Anything under a millisecond would have the watcher spin:
+    py.test.raises(VIXClientProgrammerError, setattr, w, 'interval', 0.0005)
+    assert w.interval == 0.01
+
+    # Let the watcher observe the VM's initial state before changing it:
+    deadline = time.time() + 10
+    while w.stats['sweeps'] < 2 and time.time() < deadline:
+        time.sleep(0.01)
+    vm.powerOn()
+    try:
+        changed.wait(10)
+        assert len(changes) >= 1
+        assert changes[0][0] is vm
+        assert changes[0][1] == offState
+        assert changes[0][2] & VIX_POWERSTATE_POWERED_ON != 0
+    finally:
+        vm.powerOff()
+
+    stats = w.stats
+    assert stats['sweeps'] >= 2
+    assert stats['changes'] >= 1
+    assert 0 <= stats['lastSweepSeconds'] <= stats['maxSweepSeconds']
+    assert stats['maxSweepSeconds'] <= stats['totalSweepSeconds']
+
+    w.stop()
+    assert not w.running
+    assert h.powerStateWatcher is None
+    nSweeps = w.stats['sweeps']
+    time.sleep(0.05)
+    assert w.stats['sweeps'] == nSweeps
+
+    # Closing the Host stops its watcher:
+    w = h.watchPowerState(callback, interval=0.01)
+    h.close()
+    assert not w.running
+
 def test_Host_registerAndUnregisterVM():
     VM_PATH = _support.site_config.generic_vmx
 
@@ -40,6 +40,74 @@ def test_VM_propertyRetrieval():
     vm[VIX_PROPERTY_VM_POWER_STATE]
     vm[VIX_PROPERTY_VM_VMX_PATHNAME]
 
+def test_VM_getProperties():
+    h, vm = _openGenericVM()
+    props = [VIX_PROPERTY_VM_VMX_PATHNAME, VIX_PROPERTY_VM_POWER_STATE]
+    assert vm.getProperties(props) == tuple(vm[p] for p in props)
+    assert vm.getProperties(()) == ()
+
+    # Long lists span several of the underlying batches:
+    manyProps = props * 20
+    assert vm.getProperties(manyProps) == tuple(vm[p] for p in manyProps)
+
+    py.test.raises(TypeError, vm.getProperties, None)
+    py.test.raises(TypeError, vm.getProperties, [VIX_PROPERTY_VM_POWER_STATE,
+        'not a property ID'
+      ])
+    vm.close()
+    py.test.raises(VIXClientProgrammerError, vm.getProperties, props)
+
+def test_VM_propertyCache():
+    h, vm = _openGenericVM()
+    P = VIX_PROPERTY_VM_POWER_STATE
+
+    # The cache is disabled unless a TTL is set:
+    assert vm.propertyCacheTTL == 0
+    vm[P]
+    vm[P]
+    assert vm.propertyCacheStats['hits'] == 0
+
+    vm.propertyCacheTTL = 60
+    state = vm[P]
+    assert vm[P] == state
+    stats = vm.propertyCacheStats
+    assert (stats['hits'], stats['misses'], stats['size']) == (1, 1, 1)
+
+    # The VM's own state-changing operations invalidate the cache, so they're
+    # reflected at once:
+    try:
+        if state & VIX_POWERSTATE_POWERED_OFF != 0:
+            vm.powerOn()
+            assert vm[P] & VIX_POWERSTATE_POWERED_ON != 0
+        else:
+            vm.powerOff()
+            assert vm[P] & VIX_POWERSTATE_POWERED_OFF != 0
+        assert vm.propertyCacheStats['invalidations'] > \
+            stats['invalidations']
+    finally:
+        if state & VIX_POWERSTATE_POWERED_OFF != 0:
+            vm.powerOff()
+        else:
+            vm.powerOn()
+    assert vm[P] == state
+
+    vm.invalidatePropertyCache()
+    assert vm.propertyCacheStats['size'] == 0
+
+    # Expired values are fetched anew:
+    vm.propertyCacheTTL = 0.01
+    nMissesBefore = vm.propertyCacheStats['misses']
+    vm[P]
+    time.sleep(0.05)
+    vm[P]
+    assert vm.propertyCacheStats['misses'] == nMissesBefore + 2
+
+    vm.propertyCacheTTL = None
+    assert vm.propertyCacheTTL == 0
+    py.test.raises(VIXClientProgrammerError,
+        setattr, vm, 'propertyCacheTTL', -1
+      )
+
 def test_VM_close_explicit_delHostFirst():
     h, vm = _openGenericVM()
     assert not vm.closed
@@ -158,6 +226,161 @@ def test_VM_reset():
 
     test_VM_powerOnPowerOffAndSuspend(actionWhilePoweredOn)
 
+def test_VM_asyncJobs():
+    h, vm = _openGenericVM()
+
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    completed = []
+    job = vm.powerOn(async_=True)
+    assert isinstance(job, Job)
+    assert job.owner is vm
+    job.add_done_callback(completed.append)
+    assert job.wait()
+    assert job.done()
+    assert job.result() is None
+
+    # A job that has already completed runs its done-callbacks immediately:
+    job.add_done_callback(completed.append)
+    assert job in completed
+
+    # VIX errors are raised by result(), not when the job is submitted:
+    job = vm.powerOn(async_=True)
+    py.test.raises(VIXException, job.result)
+
+    assert vm.waitForToolsInGuest(async_=True).result()
+    vm.powerOff(async_=True).result()
+    assert vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF != 0
+
+def test_VM_completionQueue():
+    import select
+    h, vm = _openGenericVM()
+
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    q = CompletionQueue()
+    assert q.drain() == []
+    assert q.pending == 0
+
+    jobs = [vm.powerOn(async_=True), vm.waitForToolsInGuest(async_=True)]
+    for job in jobs:
+        q.add(job)
+    py.test.raises(VIXClientProgrammerError, q.add, jobs[0])
+
+    finished = []
+    while len(finished) < len(jobs):
+        readable = select.select([q], [], [], 300)[0]
+        assert readable == [q]
+        finished.extend(q.drain(max_n=1))
+    assert sorted(finished) == sorted(jobs)
+    for job in finished:
+        assert job.done()
+
+    # Once drained, the queue's descriptor is no longer readable:
+    assert select.select([q], [], [], 0)[0] == []
+    assert q.drain(timeout=0.01) == []
+
+    # A job that has already completed is posted immediately:
+    job = vm.powerOff(async_=True)
+    job.wait()
+    q.add(job)
+    assert q.pending == 1
+    assert q.drain(timeout=None) == [job]
+
+def test_VM_jobTimeoutsAndCancellation():
+    h, vm = _openGenericVM()
+
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    # The tools can't come up while the VM is powered off.  A timeout passed
+    # to result() limits only that wait, without cancelling the job:
+    job = vm.waitForToolsInGuest(async_=True)
+    py.test.raises(VIXTimeoutError, job.result, timeout=0.1)
+    assert not job.done()
+    assert job.cancel()
+    assert job.done() and job.cancelled()
+    assert not job.cancel()
+    py.test.raises(VIXException, job.result)
+
+    # A job that overruns the timeout it was issued with is cancelled, though
+    # VIX carries on with it regardless:
+    py.test.raises(VIXTimeoutError, vm.powerOn, timeout=0)
+    assert vm.waitForToolsInGuest(timeout=300)
+
+    # An async job's timeout is enforced whenever it's waited upon:
+    job = vm.powerOff(async_=True, timeout=0)
+    assert job.wait()
+    assert job.cancelled()
+    py.test.raises(VIXTimeoutError, job.result)
+
+    while vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        time.sleep(0.5)
+
+def test_VM_deadline():
+    h, vm = _openGenericVM()
+
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    assert Deadline.current() is None
+    with Deadline(600) as d:
+        assert Deadline.current() is d
+        vm.powerOn()
+        assert vm.waitForToolsInGuest()
+    assert Deadline.current() is None
+
+    assert [step[0] for step in d.steps] == ['powerOn', 'waitForToolsInGuest']
+    assert [step[2] for step in d.steps] == ['ok', 'ok']
+    assert not d.expired
+    assert 0 < d.remaining < 600
+
+    # Once the budget has run out, operations fail without being submitted:
+    d = Deadline(0)
+    py.test.raises(VIXTimeoutError, vm.powerOff, timeout=d)
+    assert d.steps == [('powerOff', 0.0, 'skipped')]
+    assert vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_ON != 0
+
+    # A timeout must be a number, but may be too long to ever run out:
+    py.test.raises(VIXClientProgrammerError, Deadline, float('nan'))
+    py.test.raises(VIXClientProgrammerError, vm.powerOff, timeout=float('nan'))
+    vm.powerOff(timeout=1e300)
+    vm.powerOn(timeout=Deadline(1e300))
+    vm.powerOff()
+
+def test_VM_runPipeline():
+    h, vm = _openGenericVM()
+
+    if vm[VIX_PROPERTY_VM_POWER_STATE] & VIX_POWERSTATE_POWERED_OFF == 0:
+        vm.powerOff()
+
+    steps = [('powerOn',), ('waitForTools', 300),
+        ('login', site_config.guest_username, site_config.guest_password),
+        ('powerOff',)
+      ]
+    with Deadline(600) as d:
+        report = vm.runPipeline(steps)
+    assert [(name, outcome) for (name, secs, outcome, value) in report] == [
+        ('powerOn', 'ok'), ('waitForTools', 'ok'), ('login', 'ok'),
+        ('powerOff', 'ok')
+      ]
+    assert report[1][3] is True
+    assert min(secs for (name, secs, outcome, value) in report) >= 0
+    assert [step[0] for step in d.steps] == [step[0] for step in report]
+
+    # A failed step stops the pipeline, without raising:
+    report = vm.runPipeline([('powerOff',), ('powerOn',)])
+    assert report[0][2] == 'error'
+    assert isinstance(report[0][3], VIXException)
+    assert report[1][2:] == ('skipped', None)
+
+    assert vm.runPipeline([]) == []
+    py.test.raises(VIXClientProgrammerError, vm.runPipeline, [('bogus',)])
+    py.test.raises(VIXClientProgrammerError, vm.runPipeline, ['powerOn'])
+    py.test.raises(TypeError, vm.runPipeline, [('copyIn', 'src')])
+
 def test_snapshotOps():
     h, vm = _openGenericVM()
 
@@ -329,3 +552,250 @@ def test_VM_loginInGuest_plusCopyAndRun():
 
     print 'Removing dummy file from temporary desination on host...'
     os.remove(DUMMY_PROGRAM_DEST_PATH_HOST)
+
+
+def _makeTree(root, files):
+    for relPath, contents in files.items():
+        path = os.path.join(root, *relPath.split('/'))
+        if not os.path.isdir(os.path.dirname(path)):
+            os.makedirs(os.path.dirname(path))
+        f = file(path, 'wb')
+        try:
+            f.write(contents)
+        finally:
+            f.close()
+
+
+def test_VM_copyTree():
+    import shutil
+    h, vm = _openGenericVM()
+    vm.loginInGuest(site_config.guest_username, site_config.guest_password)
+
+    files = {
+        'top.txt': 'top',
+        'sub/one.bin': '\x00\x01' * 4096,
+        'sub/deeper/two.txt': 'two',
+      }
+    srcRoot = tempfile.mkdtemp()
+    backRoot = os.path.join(tempfile.mkdtemp(), 'back')
+    guestRoot = site_config.guest_dest_dir + 'pyvix_test_tree_%d' % os.getpid()
+    try:
+        _makeTree(srcRoot, files)
+        os.mkdir(os.path.join(srcRoot, 'empty'))
+
+        manifest = vm.copyTreeToGuest(srcRoot, guestRoot, max_parallel=2)
+        byPath = dict((e[0], e) for e in manifest)
+        assert sorted(byPath.keys()) == sorted(
+            files.keys() + ['sub/', 'sub/deeper/', 'empty/']
+          )
+        for relPath, contents in files.items():
+            relPath, nBytes, seconds, outcome, error = byPath[relPath]
+            assert nBytes == len(contents)
+            assert seconds >= 0.0
+            assert outcome == 'ok'
+            assert error is None
+
+        # And back again, into a host directory that doesn't exist yet:
+        manifest = vm.copyTreeFromGuest(guestRoot, backRoot, max_parallel=3,
+            timeout=60
+          )
+        assert len(manifest) == len(files) + 3
+        assert [e for e in manifest if e[3] != 'ok'] == []
+        for relPath, contents in files.items():
+            path = os.path.join(backRoot, *relPath.split('/'))
+            assert file(path, 'rb').read() == contents
+        assert os.path.isdir(os.path.join(backRoot, 'empty'))
+
+        py.test.raises(VIXClientProgrammerError,
+            vm.copyTreeToGuest, srcRoot, guestRoot, max_parallel=0
+          )
+    finally:
+        shutil.rmtree(srcRoot)
+        shutil.rmtree(os.path.dirname(backRoot))
+
+
+def test_VM_copyTreePacked():
+    import shutil
+    h, vm = _openGenericVM()
+    vm.loginInGuest(site_config.guest_username, site_config.guest_password)
+
+    files = {'sub/script.sh': '#!/bin/sh\necho hi\n'}
+    for i in range(20):
+        files['many/file%02d.txt' % i] = 'contents %d' % i
+    # Longer than a tar header has room for:
+    files['sub/' + 'n' * 120] = 'long name'
+
+    srcRoot = tempfile.mkdtemp()
+    backRoot = os.path.join(tempfile.mkdtemp(), 'back')
+    guestRoot = '%spyvix_test_packed_%d' % (site_config.guest_dest_dir,
+        os.getpid()
+      )
+    try:
+        _makeTree(srcRoot, files)
+        os.chmod(os.path.join(srcRoot, 'sub', 'script.sh'), 0755)
+
+        manifest = vm.copyTreeToGuest(srcRoot, guestRoot, mode='archive')
+        assert sorted(e[0] for e in manifest) == sorted(
+            files.keys() + ['sub/', 'many/']
+          )
+        assert [e for e in manifest if e[3] != 'ok'] == []
+
+        # Packed on the way back, since the tree holds more than 10 files:
+        manifest = vm.copyTreeFromGuest(guestRoot, backRoot, mode='auto',
+            archive_min_files=10
+          )
+        assert len(manifest) == len(files) + 2
+        for relPath, contents in files.items():
+            path = os.path.join(backRoot, *relPath.split('/'))
+            assert file(path, 'rb').read() == contents
+        if sys.platform != 'win32':
+            assert os.access(os.path.join(backRoot, 'sub', 'script.sh'),
+                os.X_OK
+              )
+
+        # The default command quotes a guestDir that holds a single quote,
+        # and refuses one that its shell would otherwise interpret:
+        manifest = vm.copyTreeToGuest(srcRoot, guestRoot + "_it's",
+            mode='archive'
+          )
+        assert [e for e in manifest if e[3] != 'ok'] == []
+        py.test.raises(VIXClientProgrammerError,
+            vm.copyTreeToGuest, srcRoot, guestRoot + '_$HOME', mode='archive'
+          )
+
+        # A failing guest command is raised:
+        py.test.raises(VIXException,
+            vm.copyTreeToGuest, srcRoot, guestRoot, mode='archive',
+            unpack_command=('/bin/sh', '-c "exit 3"')
+          )
+        py.test.raises(VIXClientProgrammerError,
+            vm.copyTreeToGuest, srcRoot, guestRoot, mode='zip'
+          )
+    finally:
+        shutil.rmtree(srcRoot)
+        shutil.rmtree(os.path.dirname(backRoot))
+
+
+def test_VM_syncToGuest():
+    import shutil
+    h, vm = _openGenericVM()
+    vm.loginInGuest(site_config.guest_username, site_config.guest_password)
+    vm.clearContentCache()
+
+    files = {'a.txt': 'a', 'sub/b.txt': 'b' * 1000, 'sub/c.txt': 'c'}
+    srcRoot = tempfile.mkdtemp()
+    guestRoot = '%spyvix_test_sync_%d' % (site_config.guest_dest_dir,
+        os.getpid()
+      )
+    try:
+        _makeTree(srcRoot, files)
+
+        manifest = vm.syncToGuest(srcRoot, guestRoot)
+        assert [e for e in manifest if e[3] != 'ok'] == []
+
+        # Nothing has changed since, so nothing is copied:
+        manifest = vm.syncToGuest(srcRoot, guestRoot)
+        assert len(manifest) == len(files) + 1
+        assert [e for e in manifest if e[3] != 'unchanged'] == []
+
+        file(os.path.join(srcRoot, 'sub', 'c.txt'), 'wb').write('changed')
+        manifest = vm.syncToGuest(srcRoot, guestRoot)
+        assert [e[0] for e in manifest if e[3] == 'ok'] == ['sub/c.txt']
+        assert len([k for k in vm.contentCache if k.startswith(guestRoot)]) \
+            == len(files) + 2
+
+        # A dedupe copy of what's already there completes without a job:
+        src = os.path.join(srcRoot, 'a.txt')
+        hits = vm.contentCacheStats['hits']
+        vm.copyFileFromHostToGuest(src, guestRoot + '/a.txt', dedupe=True)
+        assert vm.contentCacheStats['hits'] == hits + 1
+
+        # Plain copies make the guest's content unknown:
+        vm.copyFileFromHostToGuest(src, guestRoot + '/a.txt')
+        assert guestRoot + '/a.txt' not in vm.contentCache
+
+        vm.clearContentCache()
+        assert vm.contentCache == {}
+        manifest = vm.syncToGuest(srcRoot, guestRoot)
+        assert [e for e in manifest if e[3] != 'ok'] == []
+    finally:
+        shutil.rmtree(srcRoot)
+
+
+def test_VM_contentCacheFollowsSnapshots():
+    import shutil
+    h, vm = _openGenericVM()
+    vm.loginInGuest(site_config.guest_username, site_config.guest_password)
+    vm.clearContentCache()
+
+    srcRoot = tempfile.mkdtemp()
+    src = os.path.join(srcRoot, 'f.txt')
+    file(src, 'wb').write('contents')
+    guestPath = '%spyvix_test_cc_%d' % (site_config.guest_dest_dir,
+        os.getpid()
+      )
+    snapName = 'pyvix_test_cc_%d' % os.getpid()
+    try:
+        vm.copyFileFromHostToGuest(src, guestPath, dedupe=True)
+        snap = vm.createSnapshot(snapName)
+        try:
+            vm.copyFileFromHostToGuest(src, guestPath + '.2', dedupe=True)
+            assert guestPath + '.2' in vm.contentCache
+
+            # Reverting restores what the guest held when the snapshot was
+            # taken:
+            vm.revertToSnapshot(snap)
+            assert vm.contentCache.keys() == [guestPath]
+        finally:
+            vm.removeSnapshot(snap)
+        assert vm.contentCacheStats['snapshots'] == 0
+
+        # Two snapshots that share a name can't be told apart, so reverting
+        # to either forgets everything:
+        first = vm.createSnapshot(snapName)
+        try:
+            vm.copyFileFromHostToGuest(src, guestPath + '.2', dedupe=True)
+            second = vm.createSnapshot(snapName)
+            try:
+                vm.revertToSnapshot(first)
+                assert vm.contentCache == {}
+            finally:
+                vm.removeSnapshot(second)
+        finally:
+            vm.removeSnapshot(first)
+    finally:
+        shutil.rmtree(srcRoot)
+
+
+def test_VM_writeAndReadGuestFile():
+    import array
+    h, vm = _openGenericVM()
+    vm.loginInGuest(site_config.guest_username, site_config.guest_password)
+
+    guestPath = '%spyvix_test_gf_%d' % (site_config.guest_dest_dir,
+        os.getpid()
+      )
+    # Anything that supports the buffer protocol will do:
+    for data, expected in (
+        ('contents', 'contents'),
+        ('', ''),
+        (bytearray('\x00\xff' * 1000), '\x00\xff' * 1000),
+        (buffer('0123456789', 4), '456789'),
+        (array.array('B', [1, 2, 3]), '\x01\x02\x03'),
+        (os.urandom(1024 * 1024), None),
+      ):
+        if expected is None:
+            expected = data
+        vm.writeGuestFile(guestPath, data)
+        assert vm.readGuestFile(guestPath) == expected
+
+    job = vm.writeGuestFile(guestPath, 'async', async_=True)
+    job.wait()
+    job = vm.readGuestFile(guestPath, async_=True)
+    job.wait()
+    assert job.result() == 'async'
+
+    py.test.raises(TypeError, vm.writeGuestFile, guestPath, 1)
+    py.test.raises(VIXException, vm.readGuestFile,
+        guestPath + '.nonexistent'
+      )
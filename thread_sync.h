@@ -0,0 +1,232 @@
+/******************************************************************************
+ * pyvix - Portable Mutex and Event Primitives
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+#ifndef _THREAD_SYNC_H
+#define _THREAD_SYNC_H
+
+/* The primitives in this file are used to coordinate VIX's worker threads
+ * (which invoke our callbacks) with Python threads.  Unlike the PyThread_*
+ * lock API, they offer a timed wait, and none of them ever touch the Python
+ * API, so they may be used whether or not the GIL is held.
+ *
+ * PyVixAtomic is a word that's only ever accessed via the PyVixAtomic_*
+ * functions, all of which act as full memory barriers.
+ *
+ * PyVixClock_now returns the seconds elapsed since some fixed point in the
+ * past, from a clock that isn't affected by changes to the system time. */
+
+#ifdef _WIN32
+  #include <windows.h>
+
+  typedef CRITICAL_SECTION PyVixMutex;
+
+  #define PyVixMutex_init(m)      InitializeCriticalSection(m)
+  #define PyVixMutex_destroy(m)   DeleteCriticalSection(m)
+  #define PyVixMutex_lock(m)      EnterCriticalSection(m)
+  #define PyVixMutex_unlock(m)    LeaveCriticalSection(m)
+
+  /* A PyVixEvent is a manual-reset event: once signalled, it stays signalled
+   * and releases every waiter, present and future, until it's reset. */
+  typedef struct {
+    HANDLE h;
+  } PyVixEvent;
+
+  static status PyVixEvent_init(PyVixEvent *ev) {
+    ev->h = CreateEvent(NULL, TRUE, FALSE, NULL);
+    return (ev->h != NULL ? SUCCEEDED : FAILED);
+  } /* PyVixEvent_init */
+
+  static void PyVixEvent_destroy(PyVixEvent *ev) {
+    CloseHandle(ev->h);
+  } /* PyVixEvent_destroy */
+
+  static void PyVixEvent_signal(PyVixEvent *ev) {
+    SetEvent(ev->h);
+  } /* PyVixEvent_signal */
+
+  static void PyVixEvent_reset(PyVixEvent *ev) {
+    ResetEvent(ev->h);
+  } /* PyVixEvent_reset */
+
+  typedef volatile LONG PyVixAtomic;
+
+  static long PyVixAtomic_load(PyVixAtomic *a) {
+    long v = *a;
+    MemoryBarrier();
+    return v;
+  } /* PyVixAtomic_load */
+
+  static void PyVixAtomic_store(PyVixAtomic *a, long v) {
+    InterlockedExchange(a, v);
+  } /* PyVixAtomic_store */
+
+  static bool PyVixAtomic_compareAndSwap(PyVixAtomic *a, long expected,
+      long desired
+    )
+  {
+    return (InterlockedCompareExchange(a, desired, expected) == expected);
+  } /* PyVixAtomic_compareAndSwap */
+
+  static long PyVixAtomic_increment(PyVixAtomic *a) {
+    return InterlockedIncrement(a);
+  } /* PyVixAtomic_increment */
+
+  static long PyVixAtomic_decrement(PyVixAtomic *a) {
+    return InterlockedDecrement(a);
+  } /* PyVixAtomic_decrement */
+
+  static double PyVixClock_now(void) {
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double) count.QuadPart / (double) frequency.QuadPart;
+  } /* PyVixClock_now */
+
+  static bool PyVixEvent_wait(PyVixEvent *ev, long timeoutMillis) {
+    return (WaitForSingleObject(ev->h,
+        (timeoutMillis < 0 ? INFINITE : (DWORD) timeoutMillis)
+      ) == WAIT_OBJECT_0);
+  } /* PyVixEvent_wait */
+#else
+  #include <errno.h>
+  #include <pthread.h>
+  #include <time.h>
+
+  typedef pthread_mutex_t PyVixMutex;
+
+  #define PyVixMutex_init(m)      pthread_mutex_init(m, NULL)
+  #define PyVixMutex_destroy(m)   pthread_mutex_destroy(m)
+  #define PyVixMutex_lock(m)      pthread_mutex_lock(m)
+  #define PyVixMutex_unlock(m)    pthread_mutex_unlock(m)
+
+  /* A PyVixEvent is a manual-reset event: once signalled, it stays signalled
+   * and releases every waiter, present and future, until it's reset. */
+  typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool signalled;
+  } PyVixEvent;
+
+  /* A timed wait is measured against the same clock as PyVixClock_now, so
+   * that stepping the wall clock can't stretch (or shrink) a deadline.  Mac
+   * OS X lacks pthread_condattr_setclock, so there the wall clock it is: */
+  #ifdef __APPLE__
+    #define PYVIX_EVENT_CLOCK CLOCK_REALTIME
+  #else
+    #define PYVIX_EVENT_CLOCK CLOCK_MONOTONIC
+  #endif
+
+  static status PyVixEvent_init(PyVixEvent *ev) {
+    pthread_condattr_t attr;
+    int condErr;
+
+    if (pthread_mutex_init(&ev->lock, NULL) != 0) { return FAILED; }
+    if (pthread_condattr_init(&attr) != 0) {
+      pthread_mutex_destroy(&ev->lock);
+      return FAILED;
+    }
+  #ifndef __APPLE__
+    pthread_condattr_setclock(&attr, PYVIX_EVENT_CLOCK);
+  #endif
+    condErr = pthread_cond_init(&ev->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (condErr != 0) {
+      pthread_mutex_destroy(&ev->lock);
+      return FAILED;
+    }
+    ev->signalled = false;
+    return SUCCEEDED;
+  } /* PyVixEvent_init */
+
+  static void PyVixEvent_destroy(PyVixEvent *ev) {
+    pthread_cond_destroy(&ev->cond);
+    pthread_mutex_destroy(&ev->lock);
+  } /* PyVixEvent_destroy */
+
+  static void PyVixEvent_signal(PyVixEvent *ev) {
+    pthread_mutex_lock(&ev->lock);
+    ev->signalled = true;
+    pthread_cond_broadcast(&ev->cond);
+    pthread_mutex_unlock(&ev->lock);
+  } /* PyVixEvent_signal */
+
+  static void PyVixEvent_reset(PyVixEvent *ev) {
+    pthread_mutex_lock(&ev->lock);
+    ev->signalled = false;
+    pthread_mutex_unlock(&ev->lock);
+  } /* PyVixEvent_reset */
+
+  /* GCC's __sync builtins are full barriers: */
+  typedef volatile long PyVixAtomic;
+
+  static long PyVixAtomic_load(PyVixAtomic *a) {
+    long v = *a;
+    __sync_synchronize();
+    return v;
+  } /* PyVixAtomic_load */
+
+  static void PyVixAtomic_store(PyVixAtomic *a, long v) {
+    __sync_synchronize();
+    *a = v;
+    __sync_synchronize();
+  } /* PyVixAtomic_store */
+
+  static bool PyVixAtomic_compareAndSwap(PyVixAtomic *a, long expected,
+      long desired
+    )
+  {
+    return __sync_bool_compare_and_swap(a, expected, desired);
+  } /* PyVixAtomic_compareAndSwap */
+
+  static long PyVixAtomic_increment(PyVixAtomic *a) {
+    return __sync_add_and_fetch(a, 1);
+  } /* PyVixAtomic_increment */
+
+  static long PyVixAtomic_decrement(PyVixAtomic *a) {
+    return __sync_sub_and_fetch(a, 1);
+  } /* PyVixAtomic_decrement */
+
+  static double PyVixClock_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+  } /* PyVixClock_now */
+
+  static bool PyVixEvent_wait(PyVixEvent *ev, long timeoutMillis) {
+    /* Returns true if the event was signalled, false if the wait timed out.
+     * A negative timeoutMillis means "wait forever". */
+    bool signalled;
+
+    pthread_mutex_lock(&ev->lock);
+    if (timeoutMillis < 0) {
+      while (!ev->signalled) {
+        pthread_cond_wait(&ev->cond, &ev->lock);
+      }
+    } else {
+      struct timespec deadline;
+
+      clock_gettime(PYVIX_EVENT_CLOCK, &deadline);
+      deadline.tv_sec += timeoutMillis / 1000;
+      deadline.tv_nsec += (timeoutMillis % 1000) * 1000000L;
+      if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+      }
+
+      while (!ev->signalled) {
+        if (pthread_cond_timedwait(&ev->cond, &ev->lock, &deadline)
+            == ETIMEDOUT
+           )
+        { break; }
+      }
+    }
+    signalled = ev->signalled;
+    pthread_mutex_unlock(&ev->lock);
+
+    return signalled;
+  } /* PyVixEvent_wait */
+#endif
+
+#endif /* not def _THREAD_SYNC_H */
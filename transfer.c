@@ -0,0 +1,765 @@
+/******************************************************************************
+ * pyvix - Directory Tree Transfers
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* VM.copyTreeToGuest and VM.copyTreeFromGuest copy a whole directory tree,
+ * one VIX job per file or directory, keeping up to max_parallel of those jobs
+ * in flight (each of which must also be admitted as guest I/O by the VM's
+ * Host; see admission.c).
+ *
+ * A directory's entries are only discovered once the directory has been
+ * dealt with:  when copying to the guest, a host directory is read once its
+ * counterpart has been created in the guest; when copying from the guest, a
+ * guest directory is listed (by a VIX job of its own) once its counterpart
+ * has been created on the host.  So the transfer gets under way without first
+ * walking the whole tree, and the entries of a directory that couldn't be
+ * created are never attempted.
+ *
+ * Like a pipeline, the transfer is driven by the calling thread with the GIL
+ * released; the outcome of each entry is reported in a manifest.
+ *
+ * VM.syncToGuest is a transfer to the guest with dedupe set:  each file is
+ * hashed before it's started, and skipped (as "unchanged") if the VM's
+ * ContentCache says the guest already holds it; likewise for the directories
+ * that earlier syncs created. */
+
+#include <errno.h>
+#ifdef _WIN32
+  #include <direct.h>
+  #define TREE_HOST_SEP             '\\'
+  #define pyvix_mkdir(path)         _mkdir(path)
+#else
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <dirent.h>
+  #define TREE_HOST_SEP             '/'
+  #define pyvix_mkdir(path)         mkdir(path, 0777)
+#endif
+
+#define TREE_INITIAL_CAPACITY 64
+
+/**************************** Paths and Entries ******************************/
+
+static char *TreeTransfer_join(const char *root, const char *relPath,
+    char sep
+  )
+{
+  /* Returns (as a string allocated with pyvix_plain_malloc, or NULL if memory
+   * ran out) the path of relPath beneath root, with relPath's '/'s replaced
+   * by sep.  The GIL need not be held. */
+  const size_t rootLen = strlen(root);
+  const size_t relLen = strlen(relPath);
+  const bool needsSep = (relLen > 0 && rootLen > 0
+      && root[rootLen - 1] != sep
+    );
+  char *path = pyvix_plain_malloc(rootLen + (needsSep ? 1 : 0) + relLen + 1);
+  char *p;
+
+  if (path == NULL) { return NULL; }
+  memcpy(path, root, rootLen);
+  p = path + rootLen;
+  if (needsSep) { *p++ = sep; }
+  for (; *relPath != '\0'; relPath++) {
+    *p++ = (*relPath == '/' ? sep : *relPath);
+  }
+  *p = '\0';
+
+  return path;
+} /* TreeTransfer_join */
+
+static char *TreeTransfer_hostPath(TreeTransfer *t, Py_ssize_t i) {
+  return TreeTransfer_join(t->hostRoot, t->entries[i].relPath,
+      TREE_HOST_SEP
+    );
+} /* TreeTransfer_hostPath */
+
+static char *TreeTransfer_guestPath(TreeTransfer *t, Py_ssize_t i) {
+  return TreeTransfer_join(t->guestRoot, t->entries[i].relPath,
+      t->guestSep
+    );
+} /* TreeTransfer_guestPath */
+
+static bool TreeTransfer_addEntry(TreeTransfer *t, Py_ssize_t parent,
+    const char *name, bool isDir, int64 bytes
+  )
+{
+  /* Appends the entry called name within the directory entries[parent] (or,
+   * if parent is -1, the root of the tree), and queues it to be started.
+   * Returns false if memory ran out.  The GIL need not be held. */
+  TreeEntry *e;
+  char *relPath;
+
+  if (t->nEntries == t->capacity) {
+    const Py_ssize_t newCapacity = t->capacity * 2;
+    TreeEntry *entries = pyvix_plain_realloc(t->entries,
+        sizeof(TreeEntry) * newCapacity
+      );
+    Py_ssize_t *ready;
+    if (entries == NULL) { return false; }
+    t->entries = entries;
+    ready = pyvix_plain_realloc(t->ready, sizeof(Py_ssize_t) * newCapacity);
+    if (ready == NULL) { return false; }
+    t->ready = ready;
+    t->capacity = newCapacity;
+  }
+
+  if (parent < 0) {
+    relPath = pyvix_plain_malloc(1);
+    if (relPath == NULL) { return false; }
+    relPath[0] = '\0';
+  } else {
+    const char *parentPath = t->entries[parent].relPath;
+    relPath = TreeTransfer_join(parentPath, name, '/');
+    if (relPath == NULL) { return false; }
+  }
+
+  e = &t->entries[t->nEntries];
+  e->relPath = relPath;
+  e->isDir = isDir;
+  e->bytes = bytes;
+  e->outcome = PIPELINE_STEP_SKIPPED;
+  e->err = VIX_OK;
+  e->startedAt = 0.0;
+  e->seconds = 0.0;
+  e->jc = NULL;
+
+  t->ready[t->readyTail++] = t->nEntries++;
+  return true;
+} /* TreeTransfer_addEntry */
+
+static bool TreeTransfer_isDotName(const char *name) {
+  return strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+} /* TreeTransfer_isDotName */
+
+/*************************** Discovering Entries *****************************/
+
+static VixError TreeTransfer_readHostDir(TreeTransfer *t, Py_ssize_t dir) {
+  /* Adds the files and subdirectories of the host directory entries[dir].
+   * Anything else (devices, sockets and the like) is ignored.  The GIL need
+   * not be held. */
+  VixError err = VIX_OK;
+  char *dirPath = TreeTransfer_hostPath(t, dir);
+  if (dirPath == NULL) { return VIX_E_OUT_OF_MEMORY; }
+
+#ifdef _WIN32
+  {
+    WIN32_FIND_DATAA found;
+    HANDLE h;
+    char *pattern = TreeTransfer_join(dirPath, "*", '\\');
+    if (pattern == NULL) {
+      err = VIX_E_OUT_OF_MEMORY;
+      goto cleanup;
+    }
+    h = FindFirstFileA(pattern, &found);
+    pyvix_plain_free(pattern);
+    if (h == INVALID_HANDLE_VALUE) {
+      err = VIX_E_FILE_NOT_FOUND;
+      goto cleanup;
+    }
+    do {
+      const bool isDir = (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+      if (TreeTransfer_isDotName(found.cFileName)) { continue; }
+      if (!TreeTransfer_addEntry(t, dir, found.cFileName, isDir,
+            (isDir ? 0 : ((((int64) found.nFileSizeHigh) << 32)
+                | found.nFileSizeLow
+              ))
+          ))
+      {
+        err = VIX_E_OUT_OF_MEMORY;
+        break;
+      }
+    } while (FindNextFileA(h, &found));
+    FindClose(h);
+  }
+#else
+  {
+    DIR *d = opendir(dirPath);
+    struct dirent *de;
+    if (d == NULL) {
+      err = (errno == ENOENT ? VIX_E_FILE_NOT_FOUND : VIX_E_FILE_ACCESS_ERROR);
+      goto cleanup;
+    }
+    while ((de = readdir(d)) != NULL) {
+      struct stat st;
+      char *childPath;
+      int statRes;
+
+      if (TreeTransfer_isDotName(de->d_name)) { continue; }
+      childPath = TreeTransfer_join(dirPath, de->d_name, TREE_HOST_SEP);
+      if (childPath == NULL) {
+        err = VIX_E_OUT_OF_MEMORY;
+        break;
+      }
+      statRes = stat(childPath, &st);
+      pyvix_plain_free(childPath);
+      if (statRes != 0 || !(S_ISDIR(st.st_mode) || S_ISREG(st.st_mode))) {
+        continue;
+      }
+      if (!TreeTransfer_addEntry(t, dir, de->d_name, S_ISDIR(st.st_mode),
+            S_ISDIR(st.st_mode) ? 0 : (int64) st.st_size
+          ))
+      {
+        err = VIX_E_OUT_OF_MEMORY;
+        break;
+      }
+    }
+    closedir(d);
+  }
+#endif
+
+  cleanup:
+    pyvix_plain_free(dirPath);
+    return err;
+} /* TreeTransfer_readHostDir */
+
+static VixError TreeTransfer_readGuestListing(TreeTransfer *t, Py_ssize_t dir,
+    VixHandle jobH
+  )
+{
+  /* Adds the entries reported by jobH, the finished VixVM_ListDirectoryInGuest
+   * job of the guest directory entries[dir].  The GIL need not be held. */
+  const int n = VixJob_GetNumProperties(jobH,
+      VIX_PROPERTY_JOB_RESULT_ITEM_NAME
+    );
+  int i;
+
+  for (i = 0; i < n; i++) {
+    char *name = NULL;
+    int flags = 0;
+    int64 bytes = 0;
+    bool added;
+    VixError err = VixJob_GetNthProperties(jobH, i,
+        VIX_PROPERTY_JOB_RESULT_ITEM_NAME, &name,
+        VIX_PROPERTY_JOB_RESULT_FILE_FLAGS, &flags,
+        VIX_PROPERTY_JOB_RESULT_FILE_SIZE, &bytes,
+        VIX_PROPERTY_NONE
+      );
+    if (VIX_FAILED(err)) { return err; }
+
+    if (name == NULL || TreeTransfer_isDotName(name)) {
+      added = true;
+    } else {
+      const bool isDir = ((flags & VIX_FILE_ATTRIBUTES_DIRECTORY) != 0);
+      added = TreeTransfer_addEntry(t, dir, name, isDir, isDir ? 0 : bytes);
+    }
+    if (name != NULL) { pyvix_vix_buffer_free(name); }
+    if (!added) { return VIX_E_OUT_OF_MEMORY; }
+  }
+
+  return VIX_OK;
+} /* TreeTransfer_readGuestListing */
+
+/***************************** Driving Entries *******************************/
+
+static bool TreeTransfer_isUnchanged(TreeTransfer *t, Py_ssize_t i,
+    unsigned char *digest, bool *hashed
+  )
+{
+  /* Under dedupe, works out the digest with which entries[i] would leave the
+   * guest (setting *hashed if it could), and returns whether the guest is
+   * known to hold it already; if so, the entry is finished with as unchanged
+   * (and a directory's entries are discovered at once).  The GIL need not be
+   * held. */
+  TreeEntry *e = &t->entries[i];
+  char *guestPath;
+  bool unchanged;
+
+  *hashed = false;
+  if (!t->dedupe || t->direction != TREE_TO_GUEST) { return false; }
+
+  if (e->isDir) {
+    memcpy(digest, ContentCache_directoryDigest, CONTENT_DIGEST_SIZE);
+  } else {
+    char *hostPath = TreeTransfer_hostPath(t, i);
+    int64 bytes;
+    if (hostPath == NULL) { return false; }
+    /* A file that can't be read is left for its copy to fail on: */
+    if (!ContentCache_hashFile(hostPath, digest, &bytes)) {
+      pyvix_plain_free(hostPath);
+      return false;
+    }
+    pyvix_plain_free(hostPath);
+  }
+  *hashed = true;
+
+  guestPath = TreeTransfer_guestPath(t, i);
+  if (guestPath == NULL) { return false; }
+  unchanged = ContentCache_holds(t->contentCache, guestPath, digest,
+      e->bytes
+    );
+  pyvix_plain_free(guestPath);
+  if (!unchanged) { return false; }
+
+  e->err = (e->isDir ? TreeTransfer_readHostDir(t, i) : VIX_OK);
+  /* The entries may have moved: */
+  e = &t->entries[i];
+  e->outcome = (VIX_FAILED(e->err) ? PIPELINE_STEP_ERROR
+      : PIPELINE_STEP_UNCHANGED
+    );
+  e->seconds = PyVixClock_now() - e->startedAt;
+  return true;
+} /* TreeTransfer_isUnchanged */
+
+static VixHandle TreeTransfer_submit(TreeTransfer *t, Py_ssize_t i,
+    JobCompletion *jc, const unsigned char *digest, VixError *err
+  )
+{
+  /* Submits the VIX job that deals with entries[i], reporting to jc, and
+   * returns its handle; or, if the entry failed before a job could be
+   * submitted, sets *err and returns VIX_INVALID_HANDLE.  A file copied to
+   * the guest is recorded with digest, unless that's NULL.  The GIL need not
+   * be held. */
+  TreeEntry *e = &t->entries[i];
+  char *hostPath = TreeTransfer_hostPath(t, i);
+  char *guestPath = TreeTransfer_guestPath(t, i);
+  VixHandle jobH = VIX_INVALID_HANDLE;
+
+  if (hostPath == NULL || guestPath == NULL) {
+    *err = VIX_E_OUT_OF_MEMORY;
+    goto cleanup;
+  }
+
+  if (t->direction == TREE_TO_GUEST) {
+    if (e->isDir) {
+      jobH = VixVM_CreateDirectoryInGuest(t->vmH, guestPath,
+          VIX_INVALID_HANDLE, Job_vixCallback, jc
+        );
+    } else {
+      ContentCache_expectCopy(t->contentCache, jc, guestPath, digest);
+      jobH = VixVM_CopyFileFromHostToGuest(t->vmH, hostPath, guestPath,
+          0, /* options:  Must be 0 in current release. */
+          VIX_INVALID_HANDLE, Job_vixCallback, jc
+        );
+    }
+  } else {
+    if (e->isDir) {
+      /* The host directory is created first, so that the directory's files
+       * can be started as soon as the listing arrives: */
+      if (!t->scanOnly && pyvix_mkdir(hostPath) != 0 && errno != EEXIST) {
+        *err = VIX_E_FILE_ACCESS_ERROR;
+        goto cleanup;
+      }
+      jobH = VixVM_ListDirectoryInGuest(t->vmH, guestPath,
+          0, /* options:  Must be 0 in current release. */
+          Job_vixCallback, jc
+        );
+    } else {
+      jobH = VixVM_CopyFileFromGuestToHost(t->vmH, guestPath, hostPath,
+          0, /* options:  Must be 0 in current release. */
+          VIX_INVALID_HANDLE, Job_vixCallback, jc
+        );
+    }
+  }
+
+  cleanup:
+    if (hostPath != NULL) { pyvix_plain_free(hostPath); }
+    if (guestPath != NULL) { pyvix_plain_free(guestPath); }
+    return jobH;
+} /* TreeTransfer_submit */
+
+static void TreeTransfer_start(TreeTransfer *t, Py_ssize_t i) {
+  /* Starts entries[i], which ends up either in flight or finished (if it
+   * failed to start, or wasn't admitted before the deadline).  The GIL need
+   * not be held. */
+  TreeEntry *e = &t->entries[i];
+  JobCompletion *jc;
+  VixHandle jobH;
+  VixError err = VIX_OK;
+  unsigned char digest[CONTENT_DIGEST_SIZE];
+  bool hashed;
+
+  e->startedAt = PyVixClock_now();
+  /* A scan only lists directories: */
+  if (t->scanOnly && !e->isDir) { return; }
+  if (TreeTransfer_isUnchanged(t, i, digest, &hashed)) { return; }
+
+  jc = JobCompletion_new(false);
+  if (jc == NULL) {
+    e->outcome = PIPELINE_STEP_ERROR;
+    e->err = VIX_E_OUT_OF_MEMORY;
+    return;
+  }
+  err = AdmissionGate_enter(t->admission, ADMISSION_GUEST_IO, t->deadline);
+  if (VIX_FAILED(err)) {
+    e->outcome = (err == VIX_E_CANCELLED ? PIPELINE_STEP_TIMEOUT
+        : PIPELINE_STEP_ERROR
+      );
+    e->err = err;
+    e->seconds = PyVixClock_now() - e->startedAt;
+    /* VIX never saw the job, so both references are dropped: */
+    JobCompletion_issued(jc, VIX_INVALID_HANDLE);
+    JobCompletion_release(jc);
+    return;
+  }
+  AdmissionGate_attach(t->admission, ADMISSION_GUEST_IO, jc);
+  CompletionPort_addRef(t->port);
+  jc->port = t->port;
+
+  jobH = TreeTransfer_submit(t, i, jc, (hashed ? digest : NULL), &err);
+  if (VIX_FAILED(err)) {
+    /* Reported just as VIX would have: */
+    JobCompletion_complete(jc, VIX_INVALID_HANDLE, err, true);
+    JobCompletion_release(jc);
+  } else {
+    JobCompletion_issued(jc, jobH);
+  }
+
+  e->jc = jc;
+  t->inFlight[t->nInFlight++] = i;
+} /* TreeTransfer_start */
+
+static void TreeTransfer_finish(TreeTransfer *t, Py_ssize_t i) {
+  /* Records the outcome of entries[i], whose job has completed, and (if it's
+   * a directory that's now in place) discovers its entries.  The caller
+   * remains responsible for the entry's job.  The GIL need not be held. */
+  TreeEntry *e = &t->entries[i];
+  JobCompletion *jc = e->jc;
+  VixError err;
+  VixHandle jobH;
+  double completedAt;
+
+  PyVixMutex_lock(&jc->lock);
+  assert (jc->completed);
+  err = jc->err;
+  jobH = jc->jobH;
+  completedAt = jc->completedAt;
+  PyVixMutex_unlock(&jc->lock);
+
+  /* Creating a guest directory that already exists is no failure: */
+  if (t->direction == TREE_TO_GUEST && e->isDir
+      && err == VIX_E_FILE_ALREADY_EXISTS
+     )
+  { err = VIX_OK; }
+
+  /* Now that the guest directory is known to exist, later syncs can skip
+   * creating it: */
+  if (t->dedupe && t->direction == TREE_TO_GUEST && e->isDir
+      && !VIX_FAILED(err)
+     )
+  {
+    char *guestPath = TreeTransfer_guestPath(t, i);
+    if (guestPath != NULL) {
+      ContentCache_store(t->contentCache, guestPath,
+          ContentCache_directoryDigest
+        );
+      pyvix_plain_free(guestPath);
+    }
+  }
+
+  if (!VIX_FAILED(err) && e->isDir) {
+    err = (t->direction == TREE_TO_GUEST
+        ? TreeTransfer_readHostDir(t, i)
+        : TreeTransfer_readGuestListing(t, i, jobH)
+      );
+    /* The entries may have moved: */
+    e = &t->entries[i];
+  }
+
+  e->seconds = completedAt - e->startedAt;
+  e->err = err;
+  e->outcome = (VIX_FAILED(err) ? PIPELINE_STEP_ERROR : PIPELINE_STEP_OK);
+} /* TreeTransfer_finish */
+
+static Py_ssize_t TreeTransfer_takeInFlight(TreeTransfer *t,
+    JobCompletion *jc
+  )
+{
+  /* Removes the entry whose job is jc from the entries in flight, and returns
+   * its index, or -1 if it's not among them. */
+  int k;
+
+  for (k = 0; k < t->nInFlight; k++) {
+    const Py_ssize_t i = t->inFlight[k];
+    if (t->entries[i].jc == jc) {
+      t->inFlight[k] = t->inFlight[--t->nInFlight];
+      return i;
+    }
+  }
+  return -1;
+} /* TreeTransfer_takeInFlight */
+
+static void TreeTransfer_expire(TreeTransfer *t) {
+  /* Cancels the entries in flight once the deadline has passed; the entries
+   * that were never started remain skipped.  Their jobs may still be linked
+   * into the port, so they're only released by TreeTransfer_destroy.  The
+   * GIL need not be held. */
+  while (t->nInFlight > 0) {
+    const Py_ssize_t i = t->inFlight[--t->nInFlight];
+    TreeEntry *e = &t->entries[i];
+
+    if (JobCompletion_cancel(e->jc)) {
+      e->outcome = PIPELINE_STEP_TIMEOUT;
+      e->err = VIX_E_CANCELLED;
+      e->seconds = PyVixClock_now() - e->startedAt;
+    } else {
+      /* The entry finished just in time: */
+      TreeTransfer_finish(t, i);
+    }
+  }
+} /* TreeTransfer_expire */
+
+static void TreeTransfer_drive(TreeTransfer *t) {
+  /* Starts entries as they're discovered, until all of them have finished or
+   * the deadline has passed.  The GIL need not be held. */
+  CompletionPort *port = t->port;
+
+  for (;;) {
+    JobCompletion *chain;
+
+    while (t->nInFlight < t->maxParallel && t->readyHead < t->readyTail) {
+      TreeTransfer_start(t, t->ready[t->readyHead++]);
+    }
+    if (t->nInFlight == 0) { break; }
+
+    if (!PyVixEvent_wait(&port->nonEmpty, millisUntilDeadline(t->deadline))) {
+      TreeTransfer_expire(t);
+      break;
+    }
+
+    PyVixMutex_lock(&port->lock);
+    chain = CompletionPort_takeLocked(port, -1);
+    PyVixMutex_unlock(&port->lock);
+
+    while (chain != NULL) {
+      JobCompletion *jc = chain;
+      Py_ssize_t i;
+      chain = jc->portNext;
+      jc->portNext = NULL;
+
+      i = TreeTransfer_takeInFlight(t, jc);
+      if (i < 0) { continue; }
+      TreeTransfer_finish(t, i);
+      t->entries[i].jc = NULL;
+      JobCompletion_release(jc);
+    }
+  }
+} /* TreeTransfer_drive */
+
+/************************** Setting Up and Reporting *************************/
+
+static char TreeTransfer_guessGuestSep(const char *guestDir) {
+  /* A guest path that uses backslashes and no slashes is taken to be a
+   * Windows path: */
+  return (strchr(guestDir, '\\') != NULL && strchr(guestDir, '/') == NULL
+      ? '\\' : '/'
+    );
+} /* TreeTransfer_guessGuestSep */
+
+static char *TreeTransfer_strdup(const char *s) {
+  char *copy = pyvix_plain_malloc(strlen(s) + 1);
+  if (copy != NULL) { strcpy(copy, s); }
+  return copy;
+} /* TreeTransfer_strdup */
+
+static status TreeTransfer_init(TreeTransfer *t, VM *vm,
+    TreeDirection direction, const char *hostDir, const char *guestDir,
+    int maxParallel, double deadline
+  )
+{
+  /* Prepares t to transfer the tree rooted at hostDir to guestDir within vm,
+   * or vice versa.  Whether or not this succeeds, TreeTransfer_destroy must
+   * be called once t is finished with.  The GIL must be held. */
+  t->direction = direction;
+  t->scanOnly = false;
+  /* Held until TreeTransfer_destroy, since the transfer runs without the
+   * GIL, during which vm may be closed: */
+  t->vmH = vm->handle;
+  Vix_AddRefHandle(t->vmH);
+  t->admission = vm->host->admission;
+  AdmissionGate_addRef(t->admission);
+  t->contentCache = vm->contentCache;
+  ContentCache_addRef(t->contentCache);
+  t->dedupe = false;
+  t->hostRoot = TreeTransfer_strdup(hostDir);
+  t->guestRoot = TreeTransfer_strdup(guestDir);
+  t->guestSep = TreeTransfer_guessGuestSep(guestDir);
+  t->nEntries = 0;
+  t->capacity = TREE_INITIAL_CAPACITY;
+  t->entries = pyvix_plain_malloc(sizeof(TreeEntry) * t->capacity);
+  t->ready = pyvix_plain_malloc(sizeof(Py_ssize_t) * t->capacity);
+  t->readyHead = t->readyTail = 0;
+  t->inFlight = pyvix_plain_malloc(sizeof(Py_ssize_t)
+      * (maxParallel > 0 ? maxParallel : 1)
+    );
+  t->nInFlight = 0;
+  t->maxParallel = maxParallel;
+  t->deadline = deadline;
+  t->port = CompletionPort_new();
+
+  if (maxParallel < 1) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "max_parallel must be at least 1."
+      );
+    return FAILED;
+  }
+  if (t->hostRoot == NULL || t->guestRoot == NULL || t->entries == NULL
+      || t->ready == NULL || t->inFlight == NULL || t->port == NULL
+     )
+  {
+    PyErr_NoMemory();
+    return FAILED;
+  }
+
+  /* The root itself is the first entry: */
+  if (!TreeTransfer_addEntry(t, -1, NULL, true, 0)) {
+    PyErr_NoMemory();
+    return FAILED;
+  }
+  return SUCCEEDED;
+} /* TreeTransfer_init */
+
+static void TreeTransfer_destroy(TreeTransfer *t) {
+  /* The GIL must be held. */
+  Py_ssize_t i;
+
+  /* Closed before the entries' jobs are released, as in Pipeline_stop: */
+  if (t->port != NULL) { CompletionPort_close(t->port); }
+  if (t->entries != NULL) {
+    for (i = 0; i < t->nEntries; i++) {
+      if (t->entries[i].jc != NULL) {
+        JobCompletion_release(t->entries[i].jc);
+      }
+      pyvix_plain_free(t->entries[i].relPath);
+    }
+    pyvix_plain_free(t->entries);
+  }
+  if (t->ready != NULL) { pyvix_plain_free(t->ready); }
+  if (t->inFlight != NULL) { pyvix_plain_free(t->inFlight); }
+  if (t->hostRoot != NULL) { pyvix_plain_free(t->hostRoot); }
+  if (t->guestRoot != NULL) { pyvix_plain_free(t->guestRoot); }
+  AdmissionGate_release(t->admission);
+  ContentCache_release(t->contentCache);
+  Vix_ReleaseHandle(t->vmH);
+} /* TreeTransfer_destroy */
+
+static PyObject *TreeTransfer_entryError(const TreeEntry *e) {
+  /* Returns a new reference to the exception that describes the failure of
+   * e, or to None if e didn't fail.  The GIL must be held. */
+  switch (e->outcome) {
+    case PIPELINE_STEP_ERROR:
+      autoRaiseVIXError(e->err);
+      return fetchRaisedException();
+    case PIPELINE_STEP_TIMEOUT:
+      raiseNonNumericVIXError(VIXTimeoutError,
+          "The entry was not transferred within the timeout, and was"
+          " cancelled."
+        );
+      return fetchRaisedException();
+    default:
+      Py_RETURN_NONE;
+  }
+} /* TreeTransfer_entryError */
+
+static status TreeTransfer_checkRoot(const TreeTransfer *t) {
+  /* Raises the error of the root of the tree, if it failed.  The GIL must be
+   * held. */
+  const TreeEntry *root = &t->entries[0];
+
+  if (root->outcome == PIPELINE_STEP_ERROR) {
+    autoRaiseVIXError(root->err);
+    return FAILED;
+  } else if (root->outcome != PIPELINE_STEP_OK
+      && root->outcome != PIPELINE_STEP_UNCHANGED
+     )
+  {
+    raiseNonNumericVIXError(VIXTimeoutError,
+        "The root of the tree was not transferred within the timeout."
+      );
+    return FAILED;
+  }
+  return SUCCEEDED;
+} /* TreeTransfer_checkRoot */
+
+static PyObject *TreeTransfer_manifest(TreeTransfer *t) {
+  /* Returns a list with one (relPath, bytes, seconds, outcome, error) tuple
+   * per entry below the root, in the order the entries were found; the
+   * relPath of a directory ends with '/'.  If the root itself failed, raises
+   * its error instead.  The GIL must be held. */
+  PyObject *manifest = NULL;
+  Py_ssize_t i;
+
+  if (TreeTransfer_checkRoot(t) != SUCCEEDED) { goto fail; }
+
+  manifest = PyList_New(t->nEntries - 1);
+  if (manifest == NULL) { goto fail; }
+  for (i = 1; i < t->nEntries; i++) {
+    const TreeEntry *e = &t->entries[i];
+    PyObject *relPath;
+    PyObject *error;
+    PyObject *entry;
+
+    relPath = (e->isDir ? PyString_FromFormat("%s/", e->relPath)
+        : PyString_FromString(e->relPath)
+      );
+    if (relPath == NULL) { goto fail; }
+    error = TreeTransfer_entryError(e);
+    if (error == NULL) {
+      Py_DECREF(relPath);
+      goto fail;
+    }
+
+    entry = Py_BuildValue("(NLdsN)", relPath, (PY_LONG_LONG) e->bytes,
+        e->seconds, Pipeline_outcomeNames[e->outcome], error
+      );
+    if (entry == NULL) { goto fail; }
+    PyList_SET_ITEM(manifest, i - 1, entry);
+  }
+
+  return manifest;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(manifest);
+    return NULL;
+} /* TreeTransfer_manifest */
+
+static PyObject *TreeTransfer_run(VM *vm, TreeDirection direction,
+    const char *hostDir, const char *guestDir, int maxParallel, bool dedupe,
+    const JobDeadline *deadline
+  )
+{
+  /* Transfers the tree rooted at hostDir to guestDir within vm (or vice
+   * versa), and returns its manifest (see TreeTransfer_manifest).  If dedupe
+   * is true, what the guest already holds is skipped.  The whole transfer is
+   * recorded as a single step of deadline's Deadline (if any).  The GIL must
+   * be held, and is released while the transfer runs. */
+  TreeTransfer t;
+  PyObject *manifest = NULL;
+  bool timedOut = false;
+  Py_ssize_t i;
+
+  if (TreeTransfer_init(&t, vm, direction, hostDir, guestDir, maxParallel,
+        deadline->at
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  t.dedupe = dedupe;
+
+  LEAVE_PYTHON
+  TreeTransfer_drive(&t);
+  ENTER_PYTHON
+
+  for (i = 0; i < t.nEntries; i++) {
+    if (t.entries[i].outcome == PIPELINE_STEP_TIMEOUT) {
+      timedOut = true;
+      break;
+    }
+  }
+  /* Recorded before the manifest can raise the root's failure: */
+  if (JobDeadline_recordStep(deadline, (timedOut ? "timeout"
+          : t.entries[0].outcome == PIPELINE_STEP_ERROR ? "error" : "ok"
+        )) != SUCCEEDED
+     )
+  { goto fail; }
+  manifest = TreeTransfer_manifest(&t);
+  if (manifest == NULL) { goto fail; }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(manifest);
+    /* Fall through to cleanup: */
+  cleanup:
+    TreeTransfer_destroy(&t);
+    return manifest;
+} /* TreeTransfer_run */
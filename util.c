@@ -4,6 +4,44 @@
  * Available under the MIT license (see docs/license.txt for details).
  *****************************************************************************/
 
+/* A VixPropertyID's type never changes, so rather than asking VIX for it
+ * before every read, pyvix remembers the type of each property ID that it has
+ * looked up in a table indexed directly by the ID.  The table is shared by all
+ * threads (it's consulted with the GIL released), so its entries are atomics.
+ * An entry holds 0 if the type isn't known yet, and otherwise the type plus 1
+ * (VIX's type codes are all non-negative).
+ * Every property ID that VIX defines is below PROPERTY_TYPE_CACHE_SIZE; the
+ * types of any others are simply looked up each time. */
+#define PROPERTY_TYPE_CACHE_SIZE 8192
+
+static PyVixAtomic propertyTypeCache[PROPERTY_TYPE_CACHE_SIZE];
+
+static VixError PropertyTypeCache_lookup(VixHandle h, VixPropertyID propID,
+    VixPropertyType *propType
+  )
+{
+  /* Stores the type of property propID in *propType, asking VIX (via handle
+   * h) only if the type isn't already in the cache.  The GIL need not be
+   * held. */
+  const bool cacheable = (propID >= 0 && propID < PROPERTY_TYPE_CACHE_SIZE);
+  VixError err;
+
+  if (cacheable) {
+    const long cached = PyVixAtomic_load(&propertyTypeCache[propID]);
+    if (cached != 0) {
+      *propType = (VixPropertyType) (cached - 1);
+      return VIX_OK;
+    }
+  }
+
+  err = Vix_GetPropertyType(h, propID, propType);
+  /* Threads that race to fill the same entry store the same value: */
+  if (cacheable && !VIX_FAILED(err) && *propType != VIX_PROPERTYTYPE_ANY) {
+    PyVixAtomic_store(&propertyTypeCache[propID], (long) *propType + 1);
+  }
+  return err;
+} /* PropertyTypeCache_lookup */
+
 static PyObject *pyf_extractProperty(VixHandle h, VixPropertyID propID) {
   /* Looks up the specified property propID on handle h, then converts the C
    * property value to an appropriate Python object. */
@@ -11,7 +49,7 @@ static PyObject *pyf_extractProperty(VixHandle h, VixPropertyID propID) {
   VixError err = VIX_OK;
   VixPropertyType propType = VIX_PROPERTYTYPE_ANY;
 
-  err = Vix_GetPropertyType(h, propID, &propType);
+  err = PropertyTypeCache_lookup(h, propID, &propType);
   CHECK_VIX_ERROR(err);
 
   switch (propType) {
@@ -73,3 +111,251 @@ static PyObject *pyf_extractProperty(VixHandle h, VixPropertyID propID) {
     Py_XDECREF(pyProp);
     return NULL;
 } /* pyf_extractProperty */
+
+/* Vix_GetProperties takes its (propertyID, result pointer) pairs as varargs,
+ * so a variable number of properties can't be fetched with a single call.
+ * Instead, pyf_extractProperties fetches them in batches through a call with
+ * a fixed number of slots; the unused trailing slots hold VIX_PROPERTY_NONE,
+ * which terminates the list early. */
+#define PROPERTY_BATCH_SIZE 16
+
+typedef union {
+  int i;
+  int64 i64;
+  char *s;
+} PropertyValue;
+
+static VixError fetchPropertyBatch(VixHandle h, const VixPropertyID *ids,
+    PropertyValue *vals, Py_ssize_t n
+  )
+{
+  /* Fetches ids[0:n] (n <= PROPERTY_BATCH_SIZE) into vals[0:n] with a single
+   * Vix_GetProperties call.  The GIL need not be held. */
+  VixPropertyID slotIDs[PROPERTY_BATCH_SIZE];
+  PropertyValue unused;
+  PropertyValue *slots[PROPERTY_BATCH_SIZE];
+  Py_ssize_t i;
+
+  assert (n > 0 && n <= PROPERTY_BATCH_SIZE);
+  for (i = 0; i < PROPERTY_BATCH_SIZE; i++) {
+    slotIDs[i] = (i < n ? ids[i] : VIX_PROPERTY_NONE);
+    slots[i] = (i < n ? &vals[i] : &unused);
+  }
+
+  return Vix_GetProperties(h,
+      slotIDs[0], slots[0], slotIDs[1], slots[1],
+      slotIDs[2], slots[2], slotIDs[3], slots[3],
+      slotIDs[4], slots[4], slotIDs[5], slots[5],
+      slotIDs[6], slots[6], slotIDs[7], slots[7],
+      slotIDs[8], slots[8], slotIDs[9], slots[9],
+      slotIDs[10], slots[10], slotIDs[11], slots[11],
+      slotIDs[12], slots[12], slotIDs[13], slots[13],
+      slotIDs[14], slots[14], slotIDs[15], slots[15],
+      VIX_PROPERTY_NONE
+    );
+} /* fetchPropertyBatch */
+
+static PyObject *pyf_extractProperties(VixHandle h,
+    const VixPropertyID *propIDs, Py_ssize_t n
+  )
+{
+  /* The batched counterpart of pyf_extractProperty:  returns a tuple of the
+   * values of the properties propIDs[0:n] of handle h, fetched with one
+   * Vix_GetProperties call per PROPERTY_BATCH_SIZE properties, and with the
+   * GIL released during the VIX calls. */
+  PyObject *pyProps = NULL;
+  VixPropertyType *types = NULL;
+  PropertyValue *vals = NULL;
+  VixError err = VIX_OK;
+  Py_ssize_t i;
+
+  types = pyvix_main_malloc(sizeof(VixPropertyType) * (n > 0 ? n : 1));
+  vals = pyvix_main_malloc(sizeof(PropertyValue) * (n > 0 ? n : 1));
+  if (types == NULL || vals == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  for (i = 0; i < n; i++) {
+    types[i] = VIX_PROPERTYTYPE_ANY;
+    vals[i].s = NULL;
+  }
+
+  LEAVE_PYTHON
+  for (i = 0; i < n && !VIX_FAILED(err); i++) {
+    err = PropertyTypeCache_lookup(h, propIDs[i], &types[i]);
+  }
+  ENTER_PYTHON
+  CHECK_VIX_ERROR(err);
+
+  /* Only fixed-size types can be fetched into a PropertyValue: */
+  for (i = 0; i < n; i++) {
+    switch (types[i]) {
+      case VIX_PROPERTYTYPE_STRING:
+      case VIX_PROPERTYTYPE_INTEGER:
+      case VIX_PROPERTYTYPE_INT64:
+      case VIX_PROPERTYTYPE_BOOL:
+        break;
+      default:
+        raiseNonNumericVIXError(VIXInternalError,
+            "Unable to extract this property type."
+          );
+        goto fail;
+    }
+  }
+
+  LEAVE_PYTHON
+  for (i = 0; i < n && !VIX_FAILED(err); i += PROPERTY_BATCH_SIZE) {
+    err = fetchPropertyBatch(h, propIDs + i, vals + i,
+        (n - i < PROPERTY_BATCH_SIZE ? n - i : PROPERTY_BATCH_SIZE)
+      );
+  }
+  ENTER_PYTHON
+  CHECK_VIX_ERROR(err);
+
+  pyProps = PyTuple_New(n);
+  if (pyProps == NULL) { goto fail; }
+  for (i = 0; i < n; i++) {
+    PyObject *pyProp = NULL;
+
+    switch (types[i]) {
+      case VIX_PROPERTYTYPE_STRING:
+        assert (vals[i].s != NULL);
+        pyProp = PyString_FromString(vals[i].s);
+        break;
+      case VIX_PROPERTYTYPE_INTEGER:
+        pyProp = PyInt_FromLong(vals[i].i);
+        break;
+      case VIX_PROPERTYTYPE_INT64:
+        pyProp = PythonIntOrLongFrom64BitValue(vals[i].i64);
+        break;
+      case VIX_PROPERTYTYPE_BOOL:
+        pyProp = PyBool_FromLong(vals[i].i);
+        break;
+      default:
+        assert (false);
+    }
+    if (pyProp == NULL) { goto fail; }
+    PyTuple_SET_ITEM(pyProps, i, pyProp);
+  }
+
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    Py_CLEAR(pyProps);
+    /* Fall through to cleanup: */
+  cleanup:
+    if (types != NULL && vals != NULL) {
+      for (i = 0; i < n; i++) {
+        if (types[i] == VIX_PROPERTYTYPE_STRING && vals[i].s != NULL) {
+          pyvix_vix_buffer_free(vals[i].s);
+        }
+      }
+    }
+    if (vals != NULL) { pyvix_main_free(vals); }
+    if (types != NULL) { pyvix_main_free(types); }
+    return pyProps;
+} /* pyf_extractProperties */
+
+static status checkTimeoutSeconds(double secs) {
+  /* Raises VIXClientProgrammerError unless secs is a valid timeout. */
+  if (secs != secs) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The timeout must be a number."
+      );
+    return FAILED;
+  }
+  if (secs < 0) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The timeout must not be negative."
+      );
+    return FAILED;
+  }
+  return SUCCEEDED;
+} /* checkTimeoutSeconds */
+
+static long timeoutMillisFromPython(PyObject *pyTimeout) {
+  /* Converts a timeout in seconds (None meaning "forever") to milliseconds.
+   * Returns -2 if an exception was raised. */
+  double secs;
+
+  if (pyTimeout == NULL || pyTimeout == Py_None) { return -1; }
+
+  secs = PyFloat_AsDouble(pyTimeout);
+  if (PyErr_Occurred()) { return -2; }
+  if (checkTimeoutSeconds(secs) != SUCCEEDED) { return -2; }
+  /* A timeout too long to count in milliseconds might as well be forever: */
+  if (secs >= LONG_MAX / 1000) { return -1; }
+  return (long) (secs * 1000.0);
+} /* timeoutMillisFromPython */
+
+static status deadlineFromPython(PyObject *pyTimeout, double *deadline) {
+  /* Converts a timeout in seconds from now (None meaning "forever") to a
+   * deadline, which is NO_DEADLINE if there's no timeout.  A Deadline object
+   * may also serve as the timeout. */
+  long timeoutMillis;
+
+  if (pyTimeout != NULL && PyObject_TypeCheck(pyTimeout, &DeadlineType)) {
+    *deadline = ((Deadline *) pyTimeout)->expiresAt;
+    return SUCCEEDED;
+  }
+
+  timeoutMillis = timeoutMillisFromPython(pyTimeout);
+  if (timeoutMillis == -2) { return FAILED; }
+
+  *deadline = (timeoutMillis == -1
+      ? NO_DEADLINE : PyVixClock_now() + timeoutMillis / 1000.0
+    );
+  return SUCCEEDED;
+} /* deadlineFromPython */
+
+static long millisUntilDeadline(double deadline) {
+  /* Returns the number of milliseconds left before deadline (never fewer than
+   * 0), or -1 ("forever") for NO_DEADLINE or a deadline too far off to count
+   * in milliseconds.  The GIL need not be held. */
+  double remaining;
+  long millis;
+
+  if (deadline == NO_DEADLINE) { return -1; }
+  remaining = (deadline - PyVixClock_now()) * 1000.0;
+  if (remaining <= 0) { return 0; }
+  /* As in timeoutMillisFromPython (a Deadline may be that far off): */
+  if (remaining >= (double) LONG_MAX) { return -1; }
+  /* Rounded up (without libm's ceil), so that a wait never ends early: */
+  millis = (long) remaining;
+  return (millis < remaining ? millis + 1 : millis);
+} /* millisUntilDeadline */
+
+static PyObject *pyf_slabStats(PyObject *self) {
+  /* Returns a dict that maps the name of each PyVixSlab to a dict of its
+   * counters:  {'allocated': ..., 'live': ..., 'free': ...}. */
+  PyObject *stats = PyDict_New();
+  PyVixSlab *slab;
+
+  if (stats == NULL) { goto fail; }
+
+  for (slab = pyvix_slabRegistry; slab != NULL; slab = slab->nextInRegistry) {
+    Py_ssize_t nAllocated, nLive, nFree;
+    PyObject *counters;
+    int setRes;
+
+    if (slab->threadsafe) { PyVixMutex_lock(&slab->lock); }
+    nAllocated = slab->nAllocated;
+    nLive = slab->nLive;
+    nFree = slab->nFree;
+    if (slab->threadsafe) { PyVixMutex_unlock(&slab->lock); }
+
+    counters = Py_BuildValue("{s:n,s:n,s:n}",
+        "allocated", nAllocated, "live", nLive, "free", nFree
+      );
+    if (counters == NULL) { goto fail; }
+    setRes = PyDict_SetItemString(stats, slab->name, counters);
+    Py_DECREF(counters);
+    if (setRes != 0) { goto fail; }
+  }
+
+  return stats;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(stats);
+    return NULL;
+} /* pyf_slabStats */
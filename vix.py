@@ -26,8 +26,20 @@ VIXException             = _v.VIXException
 VIXInternalError         = _v.VIXInternalError
 VIXSecurityException     = _v.VIXSecurityException
 VIXClientProgrammerError = _v.VIXClientProgrammerError
+VIXTimeoutError          = _v.VIXTimeoutError
 
 # Main classes:
 Host = _v.Host
 VM = _v.VM
 Snapshot = _v.Snapshot
+Job = _v.Job
+CompletionQueue = _v.CompletionQueue
+Deadline = _v.Deadline
+PowerStateWatcher = _v.PowerStateWatcher
+
+# The native worker pool:
+configureWorkerPool = _v.configureWorkerPool
+workerPoolStats = _v.workerPoolStats
+
+# Diagnostics:
+slabStats = _v.slabStats
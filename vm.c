@@ -7,8 +7,12 @@
  *****************************************************************************/
 
 /* VMTracker method declarations: */
-static status VMTracker_add(VMTracker **list_slot, VM *cont);
-static status VMTracker_remove(VMTracker **list_slot, VM *cont, bool);
+static status VMTracker_add(VMTracker *tracker, VM *cont);
+static status VMTracker_remove(VMTracker *tracker, VM *cont, bool);
+
+/* Host path index method declarations: */
+static status Host_indexVM(Host *host, VM *vm);
+static void Host_unindexVM(Host *host, VM *vm);
 
 #define VM_REQUIRE_OPEN(vm) \
   SHW_REQUIRE_OPEN((StatefulHandleWrapper *) (vm))
@@ -17,6 +21,11 @@ static status VMTracker_remove(VMTracker **list_slot, VM *cont, bool);
   StatefulHandleWrapper_changeState((StatefulHandleWrapper *) (vm), newState)
 
 
+#define VM_FREE_LIST_MAX_LENGTH 64
+static StatefulHandleWrapperFreeList VM_freeList = {
+    &VMType, NULL, 0, VM_FREE_LIST_MAX_LENGTH
+  };
+
 static status initSupport_VM(void) {
   /* VMType is a new-style class, so PyType_Ready must be called before its
    * getters and setters will function. */
@@ -33,12 +42,23 @@ static PyObject *pyf_VM_new(
     PyTypeObject *subtype, PyObject *args, PyObject *kwargs
   )
 {
-  VM *self = (VM *) StatefulHandleWrapper_new(subtype);
+  VM *self = (VM *) StatefulHandleWrapper_newRecycled(subtype, &VM_freeList);
   if (self == NULL) { goto fail; }
 
   /* Initialize VM-specific fields: */
   self->host = NULL;
+  TRACKER_LINKS_INIT(self);
+  TRACKER_INIT(&self->openSnapshots);
   self->vmxPath = NULL;
+  self->weakreflist = NULL;
+  VMPropertyCache_init(&self->propCache);
+  self->watchedPowerState = POWER_STATE_UNKNOWN;
+  self->contentCache = ContentCache_new();
+  if (self->contentCache == NULL) {
+    Py_CLEAR(self);
+    PyErr_NoMemory();
+    goto fail;
+  }
 
   return (PyObject *) self;
   fail:
@@ -47,52 +67,117 @@ static PyObject *pyf_VM_new(
     return NULL;
 } /* pyf_VM_new */
 
-static status VM_init(VM *self, PyObject *args) {
-  status res = FAILED;
-  VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
+static status VM_attach(VM *self, Host *host, const char *vmxPath,
+    VixHandle vmH
+  )
+{
+  /* Makes self, which must not have been opened yet, the wrapper of vmH (the
+   * handle of the VM at vmxPath on host) and enters self in the host's open
+   * VM tracker.  On success, self owns vmH; on failure, the caller still
+   * does. */
+  assert (self->state == STATE_CREATED);
+  assert (self->host == NULL);
+  assert (self->vmxPath == NULL);
+  assert (self->handle == VIX_INVALID_HANDLE);
 
-  Host *host;
-  char *vmxPath;
+  self->vmxPath = strdup(vmxPath);
+  if (self->vmxPath == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
 
-  if (!PyArg_ParseTuple(args, "O!s", &HostType, &host, &vmxPath)) { goto fail; }
+  /* Enter self in the host's open VM tracker and its index: */
+  if (VMTracker_add(&host->openVMs, self) != SUCCEEDED) { goto fail; }
+  if (Host_indexVM(host, self) != SUCCEEDED) {
+    VMTracker_remove(&host->openVMs, self, false);
+    goto fail;
+  }
 
-  assert (self->host == NULL);
   Py_INCREF(host);
   self->host = host;
-  assert (self->vmxPath == NULL);
-  assert (self->handle == VIX_INVALID_HANDLE);
+  self->handle = vmH;
+  return VM_changeState(self, STATE_OPEN);
+  fail:
+    assert (PyErr_Occurred());
+    free(self->vmxPath); self->vmxPath = NULL;
+    return FAILED;
+} /* VM_attach */
 
-  LEAVE_PYTHON
-  self->vmxPath = strdup(vmxPath);
-  ENTER_PYTHON
+static PyObject *VM_createFromHandle(Host *host, PyObject *pyVMXPath,
+    VixHandle vmH
+  )
+{
+  /* Creates an OPEN VM that wraps vmH, a handle that VixVM_Open yielded for
+   * the VM at pyVMXPath on host, without calling the VM constructor (which
+   * would open the VM all over again).  If this succeeds, the new VM owns
+   * vmH; otherwise, the caller still does.  The GIL must be held. */
+  VM *self;
+
+  assert (PyString_Check(pyVMXPath));
+  self = (VM *) pyf_VM_new(&VMType, NULL, NULL);
+  if (self == NULL) { goto fail; }
+
+  if (VM_attach(self, host, PyString_AS_STRING(pyVMXPath), vmH)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  return (PyObject *) self;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(self);
+    return NULL;
+} /* VM_createFromHandle */
+
+static status VM_init(VM *self, PyObject *args, PyObject *kwargs) {
+  status res = FAILED;
+  VixHandle jobH = VIX_INVALID_HANDLE;
+  VixHandle vmH = VIX_INVALID_HANDLE;
+  Job *job = NULL;
+  PyObject *pyHandle = NULL;
+
+  static char* kwarg_list[] = {"host", "vmxPath", "timeout", NULL};
+  Host *host;
+  char *vmxPath;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!s|O", kwarg_list,
+       &HostType, &host, &vmxPath, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "VM", &deadline) != SUCCEEDED) {
+    goto fail;
+  }
 
-  if (self->vmxPath == NULL) { Py_DECREF(host); self->host = NULL; goto fail; }
+  /* Waited for via a Job, so that a hung host can't hold the caller beyond
+   * its timeout: */
+  job = Job_create((PyObject *) self, JOB_RESULT_HANDLE);
+  if (job == NULL) { goto fail; }
 
   LEAVE_PYTHON
-  jobH = VixVM_Open(host->handle, vmxPath, NULL, NULL);
-  err = VixJob_Wait(jobH, VIX_PROPERTY_JOB_RESULT_HANDLE, &self->handle,
-      VIX_PROPERTY_NONE
+  jobH = VixVM_Open(host->handle, vmxPath,
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  assert (self->state == STATE_CREATED);
-  if (VM_changeState(self, STATE_OPEN) != SUCCEEDED) { goto fail; }
+  pyHandle = Job_issued(job, jobH, false, &deadline);
+  if (pyHandle == NULL) { goto fail; }
+  vmH = (VixHandle) PyInt_AS_LONG(pyHandle);
 
-  /* Enter self in the host's open VM tracker: */
-  if (VMTracker_add(&host->openVMs, self) != SUCCEEDED) { goto fail; }
+  if (VM_attach(self, host, vmxPath, vmH) != SUCCEEDED) { goto fail; }
+  vmH = VIX_INVALID_HANDLE;
 
   res = SUCCEEDED;
   goto cleanup;
   fail:
-    if(self && self->vmxPath)
-      free(self->vmxPath);
     assert (PyErr_Occurred());
     assert (res == FAILED);
     /* Fall through to cleanup: */
   cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
+    if (vmH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(vmH); }
+    Py_XDECREF(pyHandle);
     return res;
 } /* VM_init */
 
@@ -101,9 +186,11 @@ static status VM_init(VM *self, PyObject *args) {
 #define VM_hasBeenUntracked(vm) ((vm)->host == NULL)
 
 static status VM_close_withoutUnlink(VM *self, bool allowedToRaise) {
-  if (self->openSnapshots != NULL) {
+  VMPropertyCache_clear(&self->propCache);
+
+  if (!TRACKER_IS_EMPTY(&self->openSnapshots)) {
     if (SnapshotTracker_release(&self->openSnapshots) == SUCCEEDED) {
-      assert (self->openSnapshots == NULL);
+      assert (TRACKER_IS_EMPTY(&self->openSnapshots));
     } else {
       if (allowedToRaise) { goto fail; } else { SUPPRESS_EXCEPTION; }
     }
@@ -129,7 +216,7 @@ static status VM_close_withUnlink(VM *self, bool allowedToRaise) {
   /* Since the caller is asking us to unlink, self should still have a host,
    * and self should be present in the host's open VM tracker. */
   assert (self->host != NULL);
-  assert (self->host->openVMs != NULL);
+  assert (self->trackerLinks.tracker == &self->host->openVMs);
 
   if (VM_close_withoutUnlink(self, allowedToRaise) == SUCCEEDED) {
     assert (self->state == STATE_CLOSED);
@@ -137,7 +224,8 @@ static status VM_close_withUnlink(VM *self, bool allowedToRaise) {
     if (allowedToRaise) { goto fail; } else { SUPPRESS_EXCEPTION; }
   }
 
-  /* Remove self from the host's open VM tracker: */
+  /* Remove self from the host's open VM tracker and its index: */
+  Host_unindexVM(self->host, self);
   if (VMTracker_remove(&self->host->openVMs, self, true) != SUCCEEDED) {
     if (allowedToRaise) { goto fail; } else { SUPPRESS_EXCEPTION; }
   }
@@ -194,22 +282,69 @@ static status VM_delete(VM *self, bool allowedToRaise) {
 } /* VM_delete */
 
 static void pyf_VM___del__(VM *self) {
+  if (self->weakreflist != NULL) {
+    PyObject_ClearWeakRefs((PyObject *) self);
+  }
   VM_delete(self, false);
+  VMPropertyCache_clear(&self->propCache);
+  if (self->contentCache != NULL) {
+    ContentCache_release(self->contentCache);
+    self->contentCache = NULL;
+  }
 
-  /* Release the VM struct itself: */
-  self->ob_type->tp_free((PyObject *) self);
+  /* Release (or recycle) the VM struct itself: */
+  StatefulHandleWrapper_freeRecycled((StatefulHandleWrapper *) self,
+      &VM_freeList
+    );
 } /* pyf_VM___del__ */
 
-static PyObject *pyf_VM_powerOnOrOff(VM *self, PyObject *args, bool shouldPowerOn) {
-  VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
-  int options = VIX_VMPOWEROP_NORMAL;
+static Job *VM_createStateChangingJob(VM *self, JobResultKind resultKind) {
+  /* Like Job_create, but for the jobs that may change self's properties (its
+   * power state, tools state, and so on), whose submission must invalidate
+   * self's property cache. */
+  Job *job;
 
-  VM_REQUIRE_OPEN(self);
+  if (VMPropertyCache_reserve(&self->propCache) != SUCCEEDED) { return NULL; }
+  job = Job_create((PyObject *) self, resultKind);
+  if (job == NULL) { return NULL; }
+  VMPropertyCache_noteStateChange(&self->propCache, job->completion);
 
-  if (!PyArg_ParseTuple(args, "|i" , &options)) { goto fail; }
+  return job;
+} /* VM_createStateChangingJob */
 
+static VixHandle VM_submitPowerOp(VixHandle vmH, VMPowerOp op,
+    int powerOnOptions, void *clientData
+  )
+{
+  /* Submits the VIX job for op, reporting to Job_vixCallback with
+   * clientData.  The GIL need not be held. */
+  switch (op) {
+    case VM_POWER_ON:
+      return VixVM_PowerOn(vmH, powerOnOptions, VIX_INVALID_HANDLE,
+          Job_vixCallback, clientData
+        );
+    case VM_POWER_OFF:
+      return VixVM_PowerOff(vmH, 0, Job_vixCallback, clientData);
+    case VM_RESET:
+      return VixVM_Reset(vmH,
+          /* powerOnOptions:  Must be VIX_VMPOWEROP_NORMAL in current
+           * release: */
+          VIX_VMPOWEROP_NORMAL,
+          Job_vixCallback, clientData
+        );
+    case VM_SUSPEND:
+      return VixVM_Suspend(vmH,
+          /* powerOffOptions:  Must be VIX_VMPOWEROP_NORMAL in current
+           * release: */
+          VIX_VMPOWEROP_NORMAL,
+          Job_vixCallback, clientData
+        );
+  }
+
+  return VIX_INVALID_HANDLE;
+} /* VM_submitPowerOp */
+
+static int VM_normalizePowerOnOptions(int options) {
   if (options != VIX_VMPOWEROP_NORMAL
       // ugly, I know. :(
 #if defined VIX_VMPOWEROP_LAUNCH_GUI
@@ -218,224 +353,286 @@ static PyObject *pyf_VM_powerOnOrOff(VM *self, PyObject *args, bool shouldPowerO
       ) {
     options = VIX_VMPOWEROP_NORMAL;
   }
-  LEAVE_PYTHON
+  return options;
+} /* VM_normalizePowerOnOptions */
 
+static PyObject *VM_powerOp(VM *self, VMPowerOp op, int options, bool async,
+    const JobDeadline *deadline
+  )
+{
+  VixHandle jobH = VIX_INVALID_HANDLE;
+  Job *job = VM_createStateChangingJob(self, JOB_RESULT_NONE);
+  if (job == NULL) { return NULL; }
+  if (Job_admit(job, self->host->admission, ADMISSION_POWER, deadline)
+      != SUCCEEDED
+     )
+  { return NULL; }
 
-  if (shouldPowerOn) {
-    jobH = VixVM_PowerOn(self->handle, options, VIX_INVALID_HANDLE, NULL, NULL);
-  } else {
-    jobH = VixVM_PowerOff(self->handle, 0, NULL, NULL);
-  }
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
+  LEAVE_PYTHON
+  jobH = VM_submitPowerOp(self->handle, op, options, Job_CLIENT_DATA(job));
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, deadline);
+} /* VM_powerOp */
+
+static PyObject *pyf_VM_powerOnOrOff(VM *self, PyObject *args,
+    PyObject *kwargs, bool shouldPowerOn
+  )
+{
+  static char* kwarg_list[] = {"options", "async_", "timeout", NULL};
+  int options = VIX_VMPOWEROP_NORMAL;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  VM_REQUIRE_OPEN(self);
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iiO", kwarg_list,
+       &options, &async, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout,
+        (shouldPowerOn ? "powerOn" : "powerOff"), &deadline
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  return VM_powerOp(self, (shouldPowerOn ? VM_POWER_ON : VM_POWER_OFF),
+      VM_normalizePowerOnOptions(options), (bool) async, &deadline
+    );
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_powerOn */
 
-static PyObject *pyf_VM_powerOn(VM *self, PyObject *args) {
-  return pyf_VM_powerOnOrOff(self, args, true);
+static PyObject *pyf_VM_powerOn(VM *self, PyObject *args, PyObject *kwargs) {
+  return pyf_VM_powerOnOrOff(self, args, kwargs, true);
 } /* pyf_VM_powerOn */
 
-static PyObject *pyf_VM_powerOff(VM *self, PyObject *args) {
-  return pyf_VM_powerOnOrOff(self, args, false);
+static PyObject *pyf_VM_powerOff(VM *self, PyObject *args, PyObject *kwargs) {
+  return pyf_VM_powerOnOrOff(self, args, kwargs, false);
 } /* pyf_VM_powerOn */
 
-static PyObject *pyf_VM_reset(VM *self) {
-  VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
+static status VM_parseAsyncAndTimeout(PyObject *args, PyObject *kwargs,
+    const char *opName, int *async, JobDeadline *deadline
+  )
+{
+  /* Parses the argument list of the VM method opName, whose only arguments
+   * are the async_ flag and the timeout, which is converted to a deadline. */
+  static char* kwarg_list[] = {"async_", "timeout", NULL};
+  PyObject *pyTimeout = NULL;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iO", kwarg_list,
+       async, &pyTimeout
+     ))
+  { return FAILED; }
+  return JobDeadline_fromPython(pyTimeout, opName, deadline);
+} /* VM_parseAsyncAndTimeout */
+
+static PyObject *pyf_VM_reset(VM *self, PyObject *args, PyObject *kwargs) {
+  int async = false;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
+  if (VM_parseAsyncAndTimeout(args, kwargs, "reset", &async, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
-  LEAVE_PYTHON
-  jobH = VixVM_Reset(self->handle,
-      /* powerOnOptions:  Must be VIX_VMPOWEROP_NORMAL in current release: */
-      VIX_VMPOWEROP_NORMAL,
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+  return VM_powerOp(self, VM_RESET, VIX_VMPOWEROP_NORMAL, (bool) async,
+      &deadline
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
-  ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
-
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_reset */
 
-static PyObject *pyf_VM_suspend(VM *self) {
-  VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
+static PyObject *pyf_VM_suspend(VM *self, PyObject *args, PyObject *kwargs) {
+  int async = false;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
+  if (VM_parseAsyncAndTimeout(args, kwargs, "suspend", &async, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
-  LEAVE_PYTHON
-  jobH = VixVM_Suspend(self->handle,
-      /* powerOffOptions:  Must be VIX_VMPOWEROP_NORMAL in current release: */
-      VIX_VMPOWEROP_NORMAL,
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+  return VM_powerOp(self, VM_SUSPEND, VIX_VMPOWEROP_NORMAL, (bool) async,
+      &deadline
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
-  ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
-
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_suspend */
 
-static PyObject *pyf_VM_upgradeVirtualHardware(VM *self) {
+static PyObject *pyf_VM_upgradeVirtualHardware(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
+  Job *job = NULL;
+  int async = false;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
+  if (VM_parseAsyncAndTimeout(args, kwargs, "upgradeVirtualHardware", &async,
+        &deadline
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  job = VM_createStateChangingJob(self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_POWER, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
   jobH = VixVM_UpgradeVirtualHardware(self->handle,
       0, /* options:  Must be 0 in current release. */
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_upgradeVirtualHardware */
 
-static PyObject *pyf_VM_waitForToolsInGuest(VM *self, PyObject *args) {
+static PyObject *pyf_VM_waitForToolsInGuest(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
-  VixToolsState toolsState = VIX_TOOLSSTATE_UNKNOWN;
+  Job *job = NULL;
 
+  static char* kwarg_list[] = {"timeoutSecs", "async_", "timeout", NULL};
   int timeoutSecs = NO_TIMEOUT;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+  bool enforcingTimeoutSecs = false;
+  PyObject *res;
 
   VM_REQUIRE_OPEN(self);
-  if (!PyArg_ParseTuple(args, "|i", &timeoutSecs)) { goto fail; }
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iiO", kwarg_list,
+       &timeoutSecs, &async, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "waitForToolsInGuest", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
-  LEAVE_PYTHON
-  /* XXX: As of VMWare Server 1.0RC1, the timeout either doesn't work, or
-   * requires the use of the async callback instead of VixJob_Wait.  At any
-   * rate, the timeout doesn't work as expected at present. */
-  jobH = VixVM_WaitForToolsInGuest(self->handle, timeoutSecs, NULL, NULL);
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
-  ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
+  /* Some releases of VIX don't honour timeoutSecs (VMWare Server 1.0RC1, for
+   * one, never gave up), so unless a timeout of the usual kind was given,
+   * timeoutSecs is also enforced as the job's deadline: */
+  if (deadline.at == NO_DEADLINE && timeoutSecs > 0) {
+    deadline.at = PyVixClock_now() + timeoutSecs;
+    enforcingTimeoutSecs = true;
+  }
+
+  job = VM_createStateChangingJob(self, JOB_RESULT_TOOLS_STATE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_POWER, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
-  err = Vix_GetProperties(self->handle, VIX_PROPERTY_VM_TOOLS_STATE,
-      &toolsState, VIX_PROPERTY_NONE
+  jobH = VixVM_WaitForToolsInGuest(self->handle, timeoutSecs,
+      Job_vixCallback, Job_CLIENT_DATA(job)
     );
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  /* If the VM's "tools state" is still undefined even after the VixJob_Wait
-   * call returned, then we timed out. */
-  pyRes = PyBool_FromLong(toolsState != VIX_TOOLSSTATE_UNKNOWN);
-  goto cleanup;
+  res = Job_issued(job, jobH, async, &deadline);
+  if (res == NULL && enforcingTimeoutSecs && !async
+      && PyErr_ExceptionMatches(VIXTimeoutError)
+     )
+  {
+    /* Just as when VIX itself gives up, running out of timeoutSecs isn't an
+     * error: */
+    PyErr_Clear();
+    Py_RETURN_FALSE;
+  }
+  return res;
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_waitForToolsInGuest */
 
-static PyObject *pyf_VM_installTools(VM *self) {
+static PyObject *pyf_VM_installTools(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
+  Job *job = NULL;
+  int async = false;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
+  if (VM_parseAsyncAndTimeout(args, kwargs, "installTools", &async,
+        &deadline
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  job = VM_createStateChangingJob(self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_POWER, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
   jobH = VixVM_InstallTools(self->handle,
       0, /* options:  Must be 0 in current release. */
       NULL, /* commandLineArgs:  Must be NULL in current release. */
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_installTools */
 
-static PyObject *pyf_VM_delete(VM *self) {
+static PyObject *pyf_VM_delete(VM *self, PyObject *args, PyObject *kwargs) {
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err = VIX_OK;
-  PyObject *pyRes = NULL;
+  Job *job = NULL;
+  int async = false;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
+  if (VM_parseAsyncAndTimeout(args, kwargs, "delete", &async, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_POWER, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
   jobH = VixVM_Delete(self->handle,
       0, /* deleteOptions:  Must be 0 in current release. */
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_delete */
 
 static PyObject *pyf_VM_createSnapshot(VM *self,
@@ -443,56 +640,55 @@ static PyObject *pyf_VM_createSnapshot(VM *self,
   )
 {
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
-  PyObject *pySnap = NULL;
-  VixHandle snapH;
+  Job *job = NULL;
 
-  static char* kwarg_list[] = {"name", "description", "options", NULL};
+  static char* kwarg_list[] = {"name", "description", "options", "async_",
+      "timeout", NULL
+    };
   char *name = NULL;
   char *description = NULL;
   int options = 0;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ssi", kwarg_list,
-       &name, &description, &options
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ssiiO", kwarg_list,
+       &name, &description, &options, &async, &pyTimeout
      ))
   { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "createSnapshot", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  job = Job_create((PyObject *) self, JOB_RESULT_SNAPSHOT);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_SNAPSHOT, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
+  ContentCache_expectSnapshotOp(self->contentCache, job->completion,
+      CONTENT_UPDATE_SNAPSHOT_TAKEN, VIX_INVALID_HANDLE,
+      (name != NULL ? name : "")
+    );
   jobH = VixVM_CreateSnapshot(self->handle,
       name, description, options,
       /* propertyListHandle:  Must be VIX_INVALID_HANDLE in current release: */
       VIX_INVALID_HANDLE,
-      NULL, /* callbackProc */
-      NULL  /* clientData */
-    );
-  err = VixJob_Wait(jobH,
-      VIX_PROPERTY_JOB_RESULT_HANDLE, &snapH,
-      VIX_PROPERTY_NONE
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
-
-  assert (snapH != VIX_INVALID_HANDLE);
-  pySnap = PyObject_CallFunction((PyObject *) &SnapshotType,
-      "O" VixHandle_FUNCTION_CALL_CODE, self, snapH
-    );
-  /* If the creation of pySnap succeeded, the Snapshot instance now owns snapH;
-   * if the creation failed, we need to release snapH: */
-  if (pySnap == NULL) {
-    Vix_ReleaseHandle(snapH);
-    goto fail;
-  }
 
-  goto cleanup;
+  /* The resulting Snapshot takes ownership of the job's result handle: */
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    Py_XDECREF(pySnap);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pySnap;
+    return NULL;
 } /* pyf_VM_createSnapshot */
 
 static PyObject *pyf_VM_getNamedSnapshot(VM *self, PyObject *args)
@@ -513,8 +709,7 @@ static PyObject *pyf_VM_getNamedSnapshot(VM *self, PyObject *args)
   CHECK_VIX_ERROR(err);
 
   assert (snapH != VIX_INVALID_HANDLE);
-  pySnap = PyObject_CallFunction((PyObject *) &SnapshotType,
-      "Oi", self, snapH);
+  pySnap = Snapshot_createFromHandle(self, snapH);
   /* If the creation of pySnap succeeded, the Snapshot instance now owns snapH;
    * if the creation failed, we need to release snapH: */
   if (pySnap == NULL) {
@@ -549,8 +744,7 @@ static PyObject *pyf_VM_getCurrentSnapshot(VM *self, PyObject *args)
   CHECK_VIX_ERROR(err);
 
   assert (snapH != VIX_INVALID_HANDLE);
-  pySnap = PyObject_CallFunction((PyObject *) &SnapshotType,
-      "O" VixHandle_FUNCTION_CALL_CODE, self, snapH);
+  pySnap = Snapshot_createFromHandle(self, snapH);
   /* If the creation of pySnap succeeded, the Snapshot instance now owns snapH;
    * if the creation failed, we need to release snapH: */
   if (pySnap == NULL) {
@@ -574,56 +768,89 @@ static PyObject *pyf_VM_getCurrentSnapshot(VM *self, PyObject *args)
 
 
 
-static PyObject *pyf_VM_removeSnapshot(VM *self, PyObject *args) {
-  PyObject *pyRes = NULL;
+static PyObject *pyf_VM_removeSnapshot(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
+  Job *job = NULL;
 
+  static char* kwarg_list[] = {"snapshot", "options", "async_", "timeout",
+      NULL
+    };
   Snapshot *pySnap;
   int options = 0;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
 
-  if (!PyArg_ParseTuple(args, "O!|i", &SnapshotType, &pySnap, &options)) { goto fail; }
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|iiO", kwarg_list,
+       &SnapshotType, &pySnap, &options, &async, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "removeSnapshot", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
 #ifdef VIX_SNAPSHOT_REMOVE_CHILDREN
   if (options != 0 && options != VIX_SNAPSHOT_REMOVE_CHILDREN)
 #endif
     options = 0;
 
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_SNAPSHOT, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
   LEAVE_PYTHON
+  ContentCache_expectSnapshotOp(self->contentCache, job->completion,
+      CONTENT_UPDATE_SNAPSHOT_REMOVED, pySnap->handle, NULL
+    );
   jobH = VixVM_RemoveSnapshot(self->handle,
       pySnap->handle,
       options,
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_removeSnapshot */
 
-static PyObject *pyf_VM_revertToSnapshot(VM *self, PyObject *args) {
-  PyObject *pyRes = NULL;
+static PyObject *pyf_VM_revertToSnapshot(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
+  Job *job = NULL;
 
+  static char* kwarg_list[] = {"snapshot", "options", "async_", "timeout",
+      NULL
+    };
   Snapshot *pySnap;
   int options = VIX_VMPOWEROP_NORMAL;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
   VM_REQUIRE_OPEN(self);
 
-  if (!PyArg_ParseTuple(args, "O!|i", &SnapshotType, &pySnap, &options)) { goto fail; }
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|iiO", kwarg_list,
+       &SnapshotType, &pySnap, &options, &async, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "revertToSnapshot", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 #ifdef VIX_VMPOWEROP_SUPPRESS_SNAPSHOT_POWERON
   if (options & VIX_VMPOWEROP_SUPPRESS_SNAPSHOT_POWERON)
     options = VIX_VMPOWEROP_SUPPRESS_SNAPSHOT_POWERON;
@@ -631,29 +858,31 @@ static PyObject *pyf_VM_revertToSnapshot(VM *self, PyObject *args) {
     options = 0;
 #endif
 
+  job = VM_createStateChangingJob(self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_SNAPSHOT, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
   LEAVE_PYTHON
+  ContentCache_expectSnapshotOp(self->contentCache, job->completion,
+      CONTENT_UPDATE_REVERTED, pySnap->handle, NULL
+    );
   jobH = VixVM_RevertToSnapshot(self->handle,
       pySnap->handle,
       options,
       /* propertyListHandle:  Must be VIX_INVALID_HANDLE in current release: */
       VIX_INVALID_HANDLE,
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_revertToSnapshot */
 
 static PyObject *pyf_VM_loginInGuest(VM *self,
@@ -661,67 +890,120 @@ static PyObject *pyf_VM_loginInGuest(VM *self,
   )
 {
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
-  PyObject *pyRes = NULL;
+  Job *job = NULL;
 
-  static char* kwarg_list[] = {"username", "password", "options", NULL};
+  static char* kwarg_list[] = {"username", "password", "options", "async_",
+      "timeout", NULL
+    };
   char *username = NULL;
   char *password = NULL;
   int options = 0;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
 
   VM_REQUIRE_OPEN(self);
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|i", kwarg_list,
-       &username, &password, &options
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|iiO", kwarg_list,
+       &username, &password, &options, &async, &pyTimeout
      ))
   { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "loginInGuest", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (Job_admit(job, self->host->admission, ADMISSION_GUEST_IO, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
   jobH = VixVM_LoginInGuest(self->handle,
       username, password, options,
-      NULL, /* callbackProc */
-      NULL  /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_loginInGuest */
 
-static PyObject *pyf_VM_copyFile(VM *self, PyObject *args,
+static PyObject *pyf_VM_copyFile(VM *self, PyObject *args, PyObject *kwargs,
     bool fromHostToGuest
   )
 {
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
-  PyObject *pyRes = NULL;
+  Job *job = NULL;
 
+  static char* kwarg_list[] = {"src", "dest", "async_", "timeout", "dedupe",
+      NULL
+    };
   char *src;
   char *dest;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  int dedupe = false;
+  JobDeadline deadline;
+  bool hashed = false;
+  unsigned char digest[CONTENT_DIGEST_SIZE];
+  int64 bytes = 0;
 
   VM_REQUIRE_OPEN(self);
 
-  if (!PyArg_ParseTuple(args, "ss", &src, &dest)) { goto fail; }
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|iOi", kwarg_list,
+       &src, &dest, &async, &pyTimeout, &dedupe
+     ))
+  { goto fail; }
+  if (dedupe && !fromHostToGuest) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "dedupe applies only to copies into the guest."
+      );
+    goto fail;
+  }
+  if (JobDeadline_fromPython(pyTimeout, (fromHostToGuest
+          ? "copyFileFromHostToGuest" : "copyFileFromGuestToHost"
+        ), &deadline
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  if (dedupe) {
+    /* If src can't be read, the copy goes ahead unhashed, so that VIX
+     * reports the problem: */
+    LEAVE_PYTHON
+    hashed = ContentCache_hashFile(src, digest, &bytes);
+    ENTER_PYTHON
+  }
+
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  if (hashed && ContentCache_holds(self->contentCache, dest, digest, bytes)) {
+    /* The guest already holds src's content at dest: */
+    return Job_satisfied(job, async, &deadline);
+  }
+  if (Job_admit(job, self->host->admission, ADMISSION_GUEST_IO, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
   LEAVE_PYTHON
   if (fromHostToGuest) {
+    ContentCache_expectCopy(self->contentCache, job->completion, dest,
+        (hashed ? digest : NULL)
+      );
     jobH = VixVM_CopyFileFromHostToGuest(self->handle,
         src, dest,
         0, /* options:  Must be 0 in current release. */
         /* propertyList:  Must be VIX_INVALID_HANDLE in current release: */
         VIX_INVALID_HANDLE,
-        NULL, /* callbackProc */
-        NULL  /* clientData */
+        Job_vixCallback, /* callbackProc */
+        Job_CLIENT_DATA(job)  /* clientData */
       );
   } else {
     jobH = VixVM_CopyFileFromGuestToHost(self->handle,
@@ -729,130 +1011,446 @@ static PyObject *pyf_VM_copyFile(VM *self, PyObject *args,
         0, /* options:  Must be 0 in current release. */
         /* propertyList:  Must be VIX_INVALID_HANDLE in current release: */
         VIX_INVALID_HANDLE,
-        NULL, /* callbackProc */
-        NULL  /* clientData */
+        Job_vixCallback, /* callbackProc */
+        Job_CLIENT_DATA(job)  /* clientData */
       );
   }
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
-  goto cleanup;
+  return Job_issued(job, jobH, async, &deadline);
   fail:
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
-    /* Fall through to cleanup: */
-  cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
+    return NULL;
 } /* pyf_VM_copyFile */
 
-static PyObject *pyf_VM_copyFileFromHostToGuest(VM *self, PyObject *args) {
-  return pyf_VM_copyFile(self, args, true);
+static PyObject *pyf_VM_copyFileFromHostToGuest(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return pyf_VM_copyFile(self, args, kwargs, true);
 } /* pyf_VM_copyFileFromHostToGuest */
 
-static PyObject *pyf_VM_copyFileFromGuestToHost(VM *self, PyObject *args) {
-  return pyf_VM_copyFile(self, args, false);
+static PyObject *pyf_VM_copyFileFromGuestToHost(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return pyf_VM_copyFile(self, args, kwargs, false);
 } /* pyf_VM_copyFileFromGuestToHost */
 
+static PyObject *pyf_VM_writeGuestFile(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Writes data, which may be any object that supports the buffer protocol,
+   * to the guest file at guestPath, by way of a StagedFile (see staging.c)
+   * rather than a host file of the caller's. */
+  VixHandle jobH = VIX_INVALID_HANDLE;
+  Job *job = NULL;
+
+  static char* kwarg_list[] = {"guestPath", "data", "async_", "timeout",
+      NULL
+    };
+  char *guestPath;
+  Py_buffer data;
+  bool haveData = false;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+  StagedFile *sf = NULL;
+  bool staged;
+
+  VM_REQUIRE_OPEN(self);
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss*|iO", kwarg_list,
+       &guestPath, &data, &async, &pyTimeout
+     ))
+  { goto fail; }
+  haveData = true;
+  if (JobDeadline_fromPython(pyTimeout, "writeGuestFile", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  LEAVE_PYTHON
+  sf = StagedFile_create(true);
+  staged = (sf != NULL && StagedFile_write(sf, data.buf, data.len));
+  ENTER_PYTHON
+  PyBuffer_Release(&data);
+  haveData = false;
+  if (!staged) {
+    raiseNonNumericVIXError(VIXException,
+        "Could not stage the data to be written to the guest."
+      );
+    goto fail;
+  }
 
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
+  /* From here on, sf goes wherever job->completion does: */
+  StagedFile_attach(sf, job->completion);
+  sf = NULL;
+  if (Job_admit(job, self->host->admission, ADMISSION_GUEST_IO, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
-struct runProgramCallbackData {
-  PyObject * funcPtr;
-  PyObject * funcArg;
-};
+  LEAVE_PYTHON
+  ContentCache_expectCopy(self->contentCache, job->completion, guestPath,
+      NULL
+    );
+  jobH = VixVM_CopyFileFromHostToGuest(self->handle,
+      job->completion->staged->path, guestPath,
+      0, /* options:  Must be 0 in current release. */
+      /* propertyList:  Must be VIX_INVALID_HANDLE in current release: */
+      VIX_INVALID_HANDLE,
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
+    );
+  ENTER_PYTHON
 
+  return Job_issued(job, jobH, async, &deadline);
+  fail:
+    assert (PyErr_Occurred());
+    if (haveData) { PyBuffer_Release(&data); }
+    if (sf != NULL) { StagedFile_release(sf); }
+    return NULL;
+} /* pyf_VM_writeGuestFile */
 
-static void runProgramInGuestCallback(VixHandle handle,
-				      VixEventType eventType,
-				      VixHandle moreEventInfo,
-				      void *clientData)
+static PyObject *pyf_VM_readGuestFile(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
 {
-  struct runProgramCallbackData * cbackData = (struct runProgramCallbackData*) clientData;
-  PyObject *result = NULL;
-  PyObject *args = NULL;
-  PyGILState_STATE gstate;
+  /* Returns the contents of the guest file at guestPath as a string, which
+   * VIX copies by way of a StagedFile (see staging.c) rather than a host file
+   * of the caller's. */
+  VixHandle jobH = VIX_INVALID_HANDLE;
+  Job *job = NULL;
 
-  if (eventType != VIX_EVENTTYPE_JOB_COMPLETED)
-    return;
+  static char* kwarg_list[] = {"guestPath", "async_", "timeout", NULL};
+  char *guestPath;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+  StagedFile *sf;
 
-  ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  VM_REQUIRE_OPEN(self);
 
-  // Python expects a tuple, we can't just pass the cbackData->funcArg
-  args = Py_BuildValue("(O)", cbackData->funcArg);
-  Py_DECREF(cbackData->funcArg);
-  result = PyObject_CallObject(cbackData->funcPtr, args);
-  Py_XDECREF(result);
-  Py_XDECREF(args);
-  Py_DECREF(cbackData->funcPtr);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|iO", kwarg_list,
+       &guestPath, &async, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "readGuestFile", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
-  LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
-  pyvix_plain_free(cbackData);
-}
+  LEAVE_PYTHON
+  sf = StagedFile_create(false);
+  ENTER_PYTHON
+  if (sf == NULL) {
+    raiseNonNumericVIXError(VIXException,
+        "Could not stage a file for the guest's contents to be copied into."
+      );
+    goto fail;
+  }
 
+  job = Job_create((PyObject *) self, JOB_RESULT_STAGED);
+  if (job == NULL) {
+    StagedFile_release(sf);
+    goto fail;
+  }
+  StagedFile_attach(sf, job->completion);
+  if (Job_admit(job, self->host->admission, ADMISSION_GUEST_IO, &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  LEAVE_PYTHON
+  jobH = VixVM_CopyFileFromGuestToHost(self->handle,
+      guestPath, sf->path,
+      0, /* options:  Must be 0 in current release. */
+      /* propertyList:  Must be VIX_INVALID_HANDLE in current release: */
+      VIX_INVALID_HANDLE,
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job)  /* clientData */
+    );
+  ENTER_PYTHON
 
+  return Job_issued(job, jobH, async, &deadline);
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_VM_readGuestFile */
 
 static PyObject *pyf_VM_runProgramInGuest(VM *self, PyObject *args, PyObject *keywds) {
   VixHandle jobH = VIX_INVALID_HANDLE;
-  VixError err;
-  PyObject *pyRes = NULL;
+  Job *job = NULL;
+  PyObject *cbArgs = NULL;
 
   char *progPath;
   char *progArg;
   PyObject *funcPtr = NULL;
-  PyObject *funcArg = NULL;
+  PyObject *funcArg = Py_None;
   int options = 0;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
 
-  VixEventProc * cback = NULL;
-  struct runProgramCallbackData * cbackData = NULL;
   VM_REQUIRE_OPEN(self);
-  static char *kwlist[] = {"prog", "progArg", "options", "cback", "cbackArg", NULL};
-  if (! PyArg_ParseTupleAndKeywords(args, keywds, "ss|iOO", kwlist,
-				    &progPath, &progArg, &options, &funcPtr, &funcArg)) {
+  static char *kwlist[] = {"prog", "progArg", "options", "cback", "cbackArg",
+      "async_", "timeout", NULL
+    };
+  if (! PyArg_ParseTupleAndKeywords(args, keywds, "ss|iOOiO", kwlist,
+				    &progPath, &progArg, &options, &funcPtr, &funcArg, &async,
+				    &pyTimeout)) {
     goto fail;
   }
+  if (JobDeadline_fromPython(pyTimeout, "runProgramInGuest", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
 
-  LEAVE_PYTHON
+  job = Job_create((PyObject *) self, JOB_RESULT_NONE);
+  if (job == NULL) { goto fail; }
 
   if (funcPtr != NULL) {
-    cback = runProgramInGuestCallback;
-    cbackData = pyvix_plain_malloc(sizeof(*cbackData));
-    Py_XINCREF(funcPtr);
-    cbackData->funcPtr = funcPtr;
-
-    if (funcArg == NULL)
-      funcArg = Py_None;
-    Py_XINCREF(funcArg);
-    cbackData->funcArg = funcArg;
+    /* cback(cbackArg) is called once the program has been run: */
+    cbArgs = PyTuple_Pack(1, funcArg);
+    if (cbArgs == NULL) { goto fail; }
+    if (Job_addDoneCallback(job, funcPtr, cbArgs) != SUCCEEDED) { goto fail; }
+    Py_CLEAR(cbArgs);
+  }
+  if (Job_admit(job, self->host->admission, ADMISSION_GUEST_IO, &deadline)
+      != SUCCEEDED
+     )
+  {
+    /* Job_admit disposed of the job: */
+    job = NULL;
+    goto fail;
   }
 
+  LEAVE_PYTHON
   jobH = VixVM_RunProgramInGuest(self->handle,
       progPath, progArg,
       options,
       VIX_INVALID_HANDLE, /* propertyList:  Must be VIX_INVALID_HANDLE in current release: */
-      cback, /* callbackProc */
-      cbackData /* clientData */
+      Job_vixCallback, /* callbackProc */
+      Job_CLIENT_DATA(job) /* clientData */
     );
-  err = VixJob_Wait(jobH, VIX_PROPERTY_NONE);
   ENTER_PYTHON
-  CHECK_VIX_ERROR(err);
 
-  pyRes = Py_None;
-  Py_INCREF(Py_None);
+  return Job_issued(job, jobH, async, &deadline);
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(cbArgs);
+    if (job != NULL) {
+      /* VIX never saw the job, so its reference to the JobCompletion must be
+       * dropped here: */
+      JobCompletion_release(job->completion);
+      Py_DECREF(job);
+    }
+    return NULL;
+} /* pyf_VM_runProgramInGuest */
+
+static PyObject *pyf_VM_runPipeline(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Runs the steps of a pipeline (see pipeline.c) one after another, without
+   * the GIL, and returns a list of (name, seconds, outcome, value) tuples, one
+   * per step.  Each step is also recorded in the Deadline (if any) on which
+   * the pipeline draws.  If async_ is true, the pipeline is run by the worker
+   * pool instead, and a Job whose result is that list is returned. */
+  static char* kwarg_list[] = {"steps", "async_", "timeout", NULL};
+  PyObject *pySteps;
+  int async = false;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  PyObject *stepTuples = NULL;
+  PipelineStep *steps = NULL;
+  PipelineStepResult *results = NULL;
+  Py_ssize_t nSteps = 0;
+  PyObject *report = NULL;
+
+  VM_REQUIRE_OPEN(self);
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iO", kwarg_list,
+       &pySteps, &async, &pyTimeout
+     ))
+  { goto fail; }
+
+  steps = Pipeline_parseSteps(pySteps, &stepTuples, &nSteps);
+  if (steps == NULL) { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "runPipeline", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  if (async) {
+    report = Pipeline_dispatch((PyObject *) self, self->host, &self, 1,
+        stepTuples, steps, nSteps, 1, &deadline, NULL
+      );
+    if (report == NULL) { goto fail; }
+    goto cleanup;
+  }
+
+  results = pyvix_main_malloc(
+      sizeof(PipelineStepResult) * (nSteps > 0 ? nSteps : 1)
+    );
+  if (results == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  if (Pipeline_execute(&self, 1, steps, nSteps, 1, deadline.at, results)
+      != SUCCEEDED
+     )
+  { goto fail; }
+  report = Pipeline_report(steps, results, nSteps);
+  if (report == NULL) { goto fail; }
+  if (Pipeline_recordSteps(&deadline, steps, results, nSteps) != SUCCEEDED) {
+    goto fail;
+  }
+
   goto cleanup;
   fail:
-    Py_XDECREF(funcArg);
-    Py_XDECREF(funcPtr);
-    pyvix_plain_free(cbackData);
     assert (PyErr_Occurred());
-    assert (pyRes == NULL);
+    Py_CLEAR(report);
     /* Fall through to cleanup: */
   cleanup:
-    if (jobH != VIX_INVALID_HANDLE) { Vix_ReleaseHandle(jobH); }
-    return pyRes;
-} /* pyf_VM_runProgramInGuest */
+    if (results != NULL) { pyvix_main_free(results); }
+    if (steps != NULL) { pyvix_main_free(steps); }
+    Py_XDECREF(stepTuples);
+    return report;
+} /* pyf_VM_runPipeline */
+
+static PyObject *pyf_VM_copyTree(VM *self, PyObject *args, PyObject *kwargs,
+    TreeDirection direction
+  )
+{
+  /* Copies a directory tree into or out of the guest, and returns a manifest
+   * of (relPath, bytes, seconds, outcome, error) tuples.  Under mode='files',
+   * at most max_parallel files (or directories) are in flight at once (see
+   * transfer.c); under mode='archive', the tree is transferred as a single
+   * archive (see archive.c); and under mode='auto', as an archive if it holds
+   * at least archive_min_files files, of at most archive_max_bytes in all. */
+  static char* toGuestKwargs[] = {"hostDir", "guestDir", "max_parallel",
+      "timeout", "mode", "unpack_command", "archive_min_files",
+      "archive_max_bytes", "staging_dir", NULL
+    };
+  static char* fromGuestKwargs[] = {"guestDir", "hostDir", "max_parallel",
+      "timeout", "mode", "pack_command", "archive_min_files",
+      "archive_max_bytes", "staging_dir", NULL
+    };
+  char *hostDir;
+  char *guestDir;
+  int maxParallel = DEFAULT_MAX_PARALLEL_JOBS;
+  PyObject *pyTimeout = NULL;
+  char *mode = NULL;
+  PyObject *pyCommand = NULL;
+  int minFiles = TREE_ARCHIVE_DEFAULT_MIN_FILES;
+  PY_LONG_LONG maxBytes = TREE_ARCHIVE_DEFAULT_MAX_BYTES;
+  char *stagingDir = NULL;
+  TreeArchiveOptions options;
+  JobDeadline deadline;
+  int parsed;
+
+  VM_REQUIRE_OPEN(self);
+
+  if (direction == TREE_TO_GUEST) {
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "ss|iOzOiLz",
+        toGuestKwargs, &hostDir, &guestDir, &maxParallel, &pyTimeout, &mode,
+        &pyCommand, &minFiles, &maxBytes, &stagingDir
+      );
+  } else {
+    parsed = PyArg_ParseTupleAndKeywords(args, kwargs, "ss|iOzOiLz",
+        fromGuestKwargs, &guestDir, &hostDir, &maxParallel, &pyTimeout, &mode,
+        &pyCommand, &minFiles, &maxBytes, &stagingDir
+      );
+  }
+  if (!parsed) { goto fail; }
+  if (TreeArchiveOptions_fromPython(&options, mode, pyCommand, minFiles,
+        maxBytes, stagingDir
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, (direction == TREE_TO_GUEST
+          ? "copyTreeToGuest" : "copyTreeFromGuest"
+        ), &deadline
+      ) != SUCCEEDED
+     )
+  { goto fail; }
+
+  if (options.mode == TREE_MODE_FILES) {
+    return TreeTransfer_run(self, direction, hostDir, guestDir, maxParallel,
+        false, &deadline
+      );
+  } else {
+    return TreeArchive_run(self, direction, hostDir, guestDir, maxParallel,
+        &options, &deadline
+      );
+  }
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_VM_copyTree */
+
+static PyObject *pyf_VM_copyTreeToGuest(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return pyf_VM_copyTree(self, args, kwargs, TREE_TO_GUEST);
+} /* pyf_VM_copyTreeToGuest */
+
+static PyObject *pyf_VM_copyTreeFromGuest(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  return pyf_VM_copyTree(self, args, kwargs, TREE_FROM_GUEST);
+} /* pyf_VM_copyTreeFromGuest */
+
+static PyObject *pyf_VM_syncToGuest(VM *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Like copyTreeToGuest under mode='files', but skips every file (and
+   * directory) that self's ContentCache says the guest already holds, and
+   * records what it copies (see content_cache.c).  Skipped entries are
+   * reported as "unchanged". */
+  static char* kwarg_list[] = {"hostDir", "guestDir", "max_parallel",
+      "timeout", NULL
+    };
+  char *hostDir;
+  char *guestDir;
+  int maxParallel = DEFAULT_MAX_PARALLEL_JOBS;
+  PyObject *pyTimeout = NULL;
+  JobDeadline deadline;
+
+  VM_REQUIRE_OPEN(self);
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|iO", kwarg_list,
+       &hostDir, &guestDir, &maxParallel, &pyTimeout
+     ))
+  { goto fail; }
+  if (JobDeadline_fromPython(pyTimeout, "syncToGuest", &deadline)
+      != SUCCEEDED
+     )
+  { goto fail; }
+
+  return TreeTransfer_run(self, TREE_TO_GUEST, hostDir, guestDir, maxParallel,
+      true, &deadline
+    );
+  fail:
+    assert (PyErr_Occurred());
+    return NULL;
+} /* pyf_VM_syncToGuest */
+
+static PyObject *pyf_VM_clearContentCache(VM *self) {
+  /* Forgets everything self has recorded about the guest's files, as must be
+   * done once the guest may have changed them behind pyvix's back. */
+  ContentCache_clear(self->contentCache);
+  Py_RETURN_NONE;
+} /* pyf_VM_clearContentCache */
 
 static PyObject *pyf_VM_host_get(VM *self, void *closure) {
   PyObject *host = (self->host != NULL ? (PyObject *) self->host : Py_None);
@@ -904,9 +1502,7 @@ static PyObject *pyf_VM_rootSnapshots_get(VM *self, void *closure) {
     CHECK_VIX_ERROR(err);
 
     assert (snapH != VIX_INVALID_HANDLE);
-    pySnap = PyObject_CallFunction((PyObject *) &SnapshotType,
-        "Oi", self, snapH
-      );
+    pySnap = Snapshot_createFromHandle(self, snapH);
     /* If the creation of pySnap succeeded, the Snapshot instance now owns
      * snapH; if the creation failed, we need to release snapH: */
     if (pySnap == NULL) {
@@ -945,6 +1541,61 @@ static PyObject *pyf_VM_vmxPath_get(VM *self, void *closure) {
     return Py_None;
 } /* pyf_VM_vmxPath_get */
 
+static PyObject *VM_subscript(VM *self, PyObject *key) {
+  if (!VMPropertyCache_isEnabled(&self->propCache)) {
+    return StatefulHandleWrapper_subscript((StatefulHandleWrapper *) self,
+        key
+      );
+  }
+  return VMPropertyCache_lookup(&self->propCache, self->handle, key);
+} /* VM_subscript */
+
+static PyMappingMethods VM_as_mapping = {
+    (lenfunc) StatefulHandleWrapper_length, /* mp_length */
+    (binaryfunc) VM_subscript,          /* mp_subscript */
+    (objobjargproc) StatefulHandleWrapper_ass_sub, /* mp_ass_subscript */
+  };
+
+static PyObject *pyf_VM_invalidatePropertyCache(VM *self, PyObject *args) {
+  VMPropertyCache_invalidate(&self->propCache);
+  Py_RETURN_NONE;
+} /* pyf_VM_invalidatePropertyCache */
+
+static PyObject *pyf_VM_propertyCacheTTL_get(VM *self, void *closure) {
+  return PyFloat_FromDouble(self->propCache.ttl);
+} /* pyf_VM_propertyCacheTTL_get */
+
+static int pyf_VM_propertyCacheTTL_set(VM *self, PyObject *value,
+    void *closure
+  )
+{
+  double ttl = 0.0;
+
+  if (value == NULL) {
+    PyErr_SetString(PyExc_TypeError, "Can't delete propertyCacheTTL.");
+    return -1;
+  }
+  /* None disables the cache, as does 0: */
+  if (value != Py_None) {
+    ttl = PyFloat_AsDouble(value);
+    if (PyErr_Occurred()) { return -1; }
+  }
+
+  return (VMPropertyCache_setTTL(&self->propCache, ttl) == SUCCEEDED ? 0 : -1);
+} /* pyf_VM_propertyCacheTTL_set */
+
+static PyObject *pyf_VM_propertyCacheStats_get(VM *self, void *closure) {
+  return VMPropertyCache_stats(&self->propCache);
+} /* pyf_VM_propertyCacheStats_get */
+
+static PyObject *pyf_VM_contentCache_get(VM *self, void *closure) {
+  return ContentCache_contents(self->contentCache);
+} /* pyf_VM_contentCache_get */
+
+static PyObject *pyf_VM_contentCacheStats_get(VM *self, void *closure) {
+  return ContentCache_stats(self->contentCache);
+} /* pyf_VM_contentCacheStats_get */
+
 
 static PyMethodDef VM_methods[] = {
     {"close",
@@ -953,35 +1604,35 @@ static PyMethodDef VM_methods[] = {
       },
     {"powerOn",
         (PyCFunction) pyf_VM_powerOn,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"powerOff",
         (PyCFunction) pyf_VM_powerOff,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"reset",
         (PyCFunction) pyf_VM_reset,
-        METH_NOARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"suspend",
         (PyCFunction) pyf_VM_suspend,
-        METH_NOARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"installTools",
         (PyCFunction) pyf_VM_installTools,
-        METH_NOARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"waitForToolsInGuest",
         (PyCFunction) pyf_VM_waitForToolsInGuest,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"upgradeVirtualHardware",
         (PyCFunction) pyf_VM_upgradeVirtualHardware,
-        METH_NOARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"delete",
         (PyCFunction) pyf_VM_delete,
-        METH_NOARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"createSnapshot",
         /* It should actually be PyCFunctionWithKeywords, but GCC grumbles
@@ -1003,11 +1654,11 @@ static PyMethodDef VM_methods[] = {
       },
     {"removeSnapshot",
         (PyCFunction) pyf_VM_removeSnapshot,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"revertToSnapshot",
         (PyCFunction) pyf_VM_revertToSnapshot,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"loginInGuest",
         /* It should actually be PyCFunctionWithKeywords, but GCC grumbles
@@ -1017,16 +1668,52 @@ static PyMethodDef VM_methods[] = {
       },
     {"copyFileFromHostToGuest",
         (PyCFunction) pyf_VM_copyFileFromHostToGuest,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
       },
     {"copyFileFromGuestToHost",
         (PyCFunction) pyf_VM_copyFileFromGuestToHost,
-        METH_VARARGS
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"writeGuestFile",
+        (PyCFunction) pyf_VM_writeGuestFile,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"readGuestFile",
+        (PyCFunction) pyf_VM_readGuestFile,
+        METH_VARARGS | METH_KEYWORDS
       },
     {"runProgramInGuest",
         (PyCFunction) pyf_VM_runProgramInGuest,
         METH_VARARGS | METH_KEYWORDS
       },
+    {"copyTreeToGuest",
+        (PyCFunction) pyf_VM_copyTreeToGuest,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"copyTreeFromGuest",
+        (PyCFunction) pyf_VM_copyTreeFromGuest,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"syncToGuest",
+        (PyCFunction) pyf_VM_syncToGuest,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"runPipeline",
+        (PyCFunction) pyf_VM_runPipeline,
+        METH_VARARGS | METH_KEYWORDS
+      },
+    {"getProperties",
+        (PyCFunction) pyf_StatefulHandleWrapper_getProperties,
+        METH_O
+      },
+    {"invalidatePropertyCache",
+        (PyCFunction) pyf_VM_invalidatePropertyCache,
+        METH_NOARGS
+      },
+    {"clearContentCache",
+        (PyCFunction) pyf_VM_clearContentCache,
+        METH_NOARGS
+      },
     {NULL}  /* sentinel */
   };
 
@@ -1058,6 +1745,32 @@ static PyGetSetDef VM_getters_setters[] = {
         NULL,
         "The path to the corresponding vmx for this virtual machine."
       },
+    {"propertyCacheTTL",
+        (getter) pyf_VM_propertyCacheTTL_get,
+        (setter) pyf_VM_propertyCacheTTL_set,
+        "The number of seconds for which vm[propID] may serve a property value"
+        " from a cache, rather than fetching it anew; 0 (the default) disables"
+        " the cache."
+      },
+    {"propertyCacheStats",
+        (getter) pyf_VM_propertyCacheStats_get,
+        NULL,
+        "A dict of the property cache's counters (hits, misses,"
+        " invalidations) and current state."
+      },
+    {"contentCache",
+        (getter) pyf_VM_contentCache_get,
+        NULL,
+        "A dict that maps each guest path whose content this VM knows (from"
+        " hashed copies) to its SHA-256 hex digest, or to None for a directory"
+        " that syncToGuest created."
+      },
+    {"contentCacheStats",
+        (getter) pyf_VM_contentCacheStats_get,
+        NULL,
+        "A dict of the content cache's counters (hits, misses, bytesSkipped,"
+        " reverts) and current size."
+      },
     {NULL}  /* sentinel */
   };
 
@@ -1075,7 +1788,7 @@ PyTypeObject VMType = { /* new-style class */
     0,                                  /* tp_repr */
     0,                                  /* tp_as_number */
     0,                                  /* tp_as_sequence */
-    &StatefulHandleWrapper_as_mapping,  /* tp_as_mapping */
+    &VM_as_mapping,                     /* tp_as_mapping */
     0,                                  /* tp_hash */
     0,                                  /* tp_call */
     0,                                  /* tp_str */
@@ -1088,7 +1801,7 @@ PyTypeObject VMType = { /* new-style class */
     0,		                              /* tp_traverse */
     0,		                              /* tp_clear */
     0,		                              /* tp_richcompare */
-    0,		                              /* tp_weaklistoffset */
+    offsetof(VM, weakreflist),          /* tp_weaklistoffset */
 
     0,                    		          /* tp_iter */
     0,		                              /* tp_iternext */
@@ -1115,4 +1828,4 @@ PyTypeObject VMType = { /* new-style class */
   };
 
 /* VMTracker support defs: */
-LIFO_LINKED_LIST_DEFINE_BASIC_METHODS_PYALLOC_NOQUAL(VMTracker, VM)
+TRACKER_DEFINE_BASIC_METHODS(VM)
@@ -0,0 +1,416 @@
+/******************************************************************************
+ * pyvix - Implementation of PowerStateWatcher Class
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* host.watchPowerState(callback, interval) starts a PowerStateWatcher:  a
+ * native thread that, every interval seconds, fetches the power state of each
+ * of the Host's open VMs (with the GIL released), compares it with the state
+ * it last observed for that VM, and, if any have changed, calls
+ *   callback([(vm, oldState, newState), ...])
+ * once for the whole sweep.  A VM's first observation merely records its
+ * state.  The callback runs on the watcher's thread; whatever it raises is
+ * counted and then discarded.
+ *
+ * The watcher stops when asked to, or when its Host is closed. */
+
+#include "pythread.h"
+
+/* The shortest interval allowed; the watcher waits in whole milliseconds, so
+ * anything shorter would have it sweep back to back: */
+#define POWER_STATE_WATCHER_MIN_INTERVAL 0.001
+
+static status initSupport_PowerStateWatcher(void) {
+  /* PowerStateWatcherType is a new-style class, so PyType_Ready must be
+   * called before its getters and setters will function. */
+  if (PyType_Ready(&PowerStateWatcherType) < 0) { goto fail; }
+
+  return SUCCEEDED;
+  fail:
+    /* This function is indirectly called by the module loader, which makes no
+     * provision for error recovery. */
+    return FAILED;
+} /* initSupport_PowerStateWatcher */
+
+static status PowerStateWatcher_sweep(PowerStateWatcher *self) {
+  /* Polls every VM that's open on self->host once, and reports the changes.
+   * The GIL must be held; it's released while VIX is polled. */
+  status res = FAILED;
+  Host *host = self->host;
+  const Py_ssize_t nVMs = host->openVMs.count;
+  VM **vms = NULL;
+  VixHandle *vmHandles = NULL;
+  int *states = NULL;
+  VixError *errs = NULL;
+  PyObject *changes = NULL;
+  double start, elapsed;
+  Py_ssize_t nHeld = 0;
+  Py_ssize_t i;
+  VM *vm;
+
+  vms = pyvix_main_malloc(sizeof(VM *) * (nVMs > 0 ? nVMs : 1));
+  vmHandles = pyvix_main_malloc(sizeof(VixHandle) * (nVMs > 0 ? nVMs : 1));
+  states = pyvix_main_malloc(sizeof(int) * (nVMs > 0 ? nVMs : 1));
+  errs = pyvix_main_malloc(sizeof(VixError) * (nVMs > 0 ? nVMs : 1));
+  if (vms == NULL || vmHandles == NULL || states == NULL || errs == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  /* Hold references to the VMs and their handles, in case a VM is closed
+   * while the GIL is released: */
+  for (vm = host->openVMs.head; vm != NULL; vm = vm->trackerLinks.next) {
+    assert (nHeld < nVMs);
+    Py_INCREF(vm);
+    vms[nHeld] = vm;
+    vmHandles[nHeld] = vm->handle;
+    Vix_AddRefHandle(vmHandles[nHeld]);
+    nHeld++;
+  }
+  assert (nHeld == nVMs);
+
+  start = PyVixClock_now();
+  LEAVE_PYTHON
+  for (i = 0; i < nVMs; i++) {
+    errs[i] = Vix_GetProperties(vmHandles[i],
+        VIX_PROPERTY_VM_POWER_STATE, &states[i],
+        VIX_PROPERTY_NONE
+      );
+    Vix_ReleaseHandle(vmHandles[i]);
+  }
+  ENTER_PYTHON
+  elapsed = PyVixClock_now() - start;
+
+  self->nSweeps++;
+  self->lastSweepSeconds = elapsed;
+  self->totalSweepSeconds += elapsed;
+  if (elapsed > self->maxSweepSeconds) { self->maxSweepSeconds = elapsed; }
+
+  changes = PyList_New(0);
+  if (changes == NULL) { goto fail; }
+  for (i = 0; i < nVMs; i++) {
+    vm = vms[i];
+    if (VIX_FAILED(errs[i])) {
+      self->nPollErrors++;
+      continue;
+    }
+    if (vm->watchedPowerState != POWER_STATE_UNKNOWN
+        && vm->watchedPowerState != states[i]
+       )
+    {
+      PyObject *change = Py_BuildValue("(Oii)",
+          vm, vm->watchedPowerState, states[i]
+        );
+      if (change == NULL) { goto fail; }
+      if (PyList_Append(changes, change) != 0) {
+        Py_DECREF(change);
+        goto fail;
+      }
+      Py_DECREF(change);
+    }
+    vm->watchedPowerState = states[i];
+  }
+
+  for (i = 0; i < nHeld; i++) { Py_CLEAR(vms[i]); }
+
+  /* The callback might stop the watcher, close the Host, or even drop the
+   * last reference to it, so self->host mustn't be used hereafter: */
+  if (PyList_GET_SIZE(changes) > 0 && self->host != NULL) {
+    PyObject *cbRes;
+    self->nChanges += PyList_GET_SIZE(changes);
+    cbRes = PyObject_CallFunctionObjArgs(self->callback, changes, NULL);
+    if (cbRes == NULL) {
+      self->nCallbackErrors++;
+      SUPPRESS_EXCEPTION;
+    } else {
+      Py_DECREF(cbRes);
+    }
+  }
+
+  res = SUCCEEDED;
+  goto cleanup;
+  fail:
+    assert (PyErr_Occurred());
+    assert (res == FAILED);
+    for (i = 0; i < nHeld; i++) { Py_XDECREF(vms[i]); }
+    /* Fall through to cleanup: */
+  cleanup:
+    Py_XDECREF(changes);
+    if (errs != NULL) { pyvix_main_free(errs); }
+    if (states != NULL) { pyvix_main_free(states); }
+    if (vmHandles != NULL) { pyvix_main_free(vmHandles); }
+    if (vms != NULL) { pyvix_main_free(vms); }
+    return res;
+} /* PowerStateWatcher_sweep */
+
+static void PowerStateWatcher_run(void *arg) {
+  /* The body of the watcher's thread, which owns a reference to the
+   * watcher. */
+  PowerStateWatcher *self = (PowerStateWatcher *) arg;
+  PyGILState_STATE gstate;
+
+  ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  while (self->host != NULL) {
+    long intervalMillis;
+
+    if (PowerStateWatcher_sweep(self) != SUCCEEDED) {
+      /* There's nobody to report the failure to, but the next sweep may
+       * fare better: */
+      SUPPRESS_EXCEPTION;
+    }
+    intervalMillis = (long) (self->interval * 1000);
+
+    LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+    PyVixEvent_wait(&self->wakeup, intervalMillis);
+    ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  }
+
+  PyVixEvent_signal(&self->exited);
+  Py_DECREF(self);
+  LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+} /* PowerStateWatcher_run */
+
+static status PowerStateWatcher_setInterval(PowerStateWatcher *self,
+    double interval
+  )
+{
+  if (!(interval >= POWER_STATE_WATCHER_MIN_INTERVAL)) {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "The watcher's interval must be at least 0.001 seconds."
+      );
+    return FAILED;
+  }
+  /* A new interval takes effect after the current wait: */
+  self->interval = interval;
+  return SUCCEEDED;
+} /* PowerStateWatcher_setInterval */
+
+static PowerStateWatcher *PowerStateWatcher_start(Host *host,
+    PyObject *callback, double interval
+  )
+{
+  /* Starts a watcher of host's open VMs.  The GIL must be held. */
+  PowerStateWatcher *self = NULL;
+
+  if (!PyCallable_Check(callback)) {
+    PyErr_SetString(PyExc_TypeError, "callback must be callable.");
+    goto fail;
+  }
+
+  self = PyObject_New(PowerStateWatcher, &PowerStateWatcherType);
+  if (self == NULL) { goto fail; }
+  if (PyVixEvent_init(&self->wakeup) != SUCCEEDED) {
+    PyObject_Del(self);
+    return (PowerStateWatcher *) PyErr_NoMemory();
+  }
+  if (PyVixEvent_init(&self->exited) != SUCCEEDED) {
+    PyVixEvent_destroy(&self->wakeup);
+    PyObject_Del(self);
+    return (PowerStateWatcher *) PyErr_NoMemory();
+  }
+  self->host = NULL;
+  self->callback = NULL;
+  self->threadStarted = false;
+  self->threadID = 0;
+  self->nSweeps = 0;
+  self->nChanges = 0;
+  self->nPollErrors = 0;
+  self->nCallbackErrors = 0;
+  self->lastSweepSeconds = 0.0;
+  self->maxSweepSeconds = 0.0;
+  self->totalSweepSeconds = 0.0;
+
+  if (PowerStateWatcher_setInterval(self, interval) != SUCCEEDED) {
+    goto fail;
+  }
+  Py_INCREF(callback);
+  self->callback = callback;
+  self->host = host;
+
+  /* The thread's reference (it can't run until the GIL is released): */
+  Py_INCREF(self);
+  self->threadID = PyThread_start_new_thread(PowerStateWatcher_run, self);
+  if (self->threadID == -1) {
+    Py_DECREF(self);
+    self->host = NULL;
+    PyErr_SetString(PyExc_RuntimeError, "Unable to start the watcher thread.");
+    goto fail;
+  }
+  self->threadStarted = true;
+
+  return self;
+  fail:
+    assert (PyErr_Occurred());
+    Py_XDECREF(self);
+    return NULL;
+} /* PowerStateWatcher_start */
+
+static void PowerStateWatcher_stop(PowerStateWatcher *self) {
+  /* Tells the watcher's thread to stop, and waits for it to exit (unless
+   * this is that thread).  The GIL must be held; it's released during the
+   * wait.  Never raises. */
+  self->host = NULL;
+  PyVixEvent_signal(&self->wakeup);
+
+  if (self->threadStarted
+      && self->threadID != (long) PyThread_get_thread_ident()
+     )
+  {
+    LEAVE_PYTHON
+    PyVixEvent_wait(&self->exited, -1);
+    ENTER_PYTHON
+  }
+} /* PowerStateWatcher_stop */
+
+static void pyf_PowerStateWatcher___del__(PowerStateWatcher *self) {
+  /* The thread owns a reference, so it has exited (or never started): */
+  assert (self->host == NULL);
+  Py_CLEAR(self->callback);
+  PyVixEvent_destroy(&self->wakeup);
+  PyVixEvent_destroy(&self->exited);
+
+  /* Release the PowerStateWatcher struct itself: */
+  PyObject_Del(self);
+} /* pyf_PowerStateWatcher___del__ */
+
+static PyObject *pyf_PowerStateWatcher_stop(PowerStateWatcher *self,
+    PyObject *args
+  )
+{
+  Host *host = self->host;
+
+  PowerStateWatcher_stop(self);
+  /* The Host no longer needs to keep its stopped watcher: */
+  if (host != NULL && host->watcher == self) {
+    host->watcher = NULL;
+    Py_DECREF(self);
+  }
+  Py_RETURN_NONE;
+} /* pyf_PowerStateWatcher_stop */
+
+static PyObject *pyf_PowerStateWatcher_running_get(PowerStateWatcher *self,
+    void *closure
+  )
+{
+  return PyBool_FromLong(self->host != NULL);
+} /* pyf_PowerStateWatcher_running_get */
+
+static PyObject *pyf_PowerStateWatcher_interval_get(PowerStateWatcher *self,
+    void *closure
+  )
+{
+  return PyFloat_FromDouble(self->interval);
+} /* pyf_PowerStateWatcher_interval_get */
+
+static int pyf_PowerStateWatcher_interval_set(PowerStateWatcher *self,
+    PyObject *value, void *closure
+  )
+{
+  double interval;
+
+  if (value == NULL) {
+    PyErr_SetString(PyExc_TypeError, "Can't delete interval.");
+    return -1;
+  }
+  interval = PyFloat_AsDouble(value);
+  if (PyErr_Occurred()) { return -1; }
+
+  return (PowerStateWatcher_setInterval(self, interval) == SUCCEEDED ? 0 : -1);
+} /* pyf_PowerStateWatcher_interval_set */
+
+static PyObject *pyf_PowerStateWatcher_stats_get(PowerStateWatcher *self,
+    void *closure
+  )
+{
+  return Py_BuildValue("{s:k,s:k,s:k,s:k,s:d,s:d,s:d}",
+      "sweeps", self->nSweeps,
+      "changes", self->nChanges,
+      "pollErrors", self->nPollErrors,
+      "callbackErrors", self->nCallbackErrors,
+      "lastSweepSeconds", self->lastSweepSeconds,
+      "maxSweepSeconds", self->maxSweepSeconds,
+      "totalSweepSeconds", self->totalSweepSeconds
+    );
+} /* pyf_PowerStateWatcher_stats_get */
+
+static PyMethodDef PowerStateWatcher_methods[] = {
+    {"stop",
+        (PyCFunction) pyf_PowerStateWatcher_stop,
+        METH_NOARGS
+      },
+    {NULL}  /* sentinel */
+  };
+
+static PyGetSetDef PowerStateWatcher_getters_setters[] = {
+    {"running",
+        (getter) pyf_PowerStateWatcher_running_get,
+        NULL,
+        "True until the watcher has been stopped."
+      },
+    {"interval",
+        (getter) pyf_PowerStateWatcher_interval_get,
+        (setter) pyf_PowerStateWatcher_interval_set,
+        "The number of seconds between sweeps."
+      },
+    {"stats",
+        (getter) pyf_PowerStateWatcher_stats_get,
+        NULL,
+        "A dict of counters (sweeps, changes, pollErrors, callbackErrors) and"
+        " the durations of the sweeps' VIX polling, in seconds (last, max,"
+        " total)."
+      },
+    {NULL}  /* sentinel */
+  };
+
+PyTypeObject PowerStateWatcherType = { /* new-style class */
+    PyObject_HEAD_INIT(NULL)
+    0,                                  /* ob_size */
+    "pyvix.vix.PowerStateWatcher",      /* tp_name */
+    sizeof(PowerStateWatcher),          /* tp_basicsize */
+    0,                                  /* tp_itemsize */
+    (destructor) pyf_PowerStateWatcher___del__, /* tp_dealloc */
+    0,                                  /* tp_print */
+    0,                                  /* tp_getattr */
+    0,                                  /* tp_setattr */
+    0,                                  /* tp_compare */
+    0,                                  /* tp_repr */
+    0,                                  /* tp_as_number */
+    0,                                  /* tp_as_sequence */
+    0,                                  /* tp_as_mapping */
+    0,                                  /* tp_hash */
+    0,                                  /* tp_call */
+    0,                                  /* tp_str */
+    0,                                  /* tp_getattro */
+    0,                                  /* tp_setattro */
+    0,                                  /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+    0,                                  /* tp_doc */
+    0,		                              /* tp_traverse */
+    0,		                              /* tp_clear */
+    0,		                              /* tp_richcompare */
+    0,		                              /* tp_weaklistoffset */
+
+    0,                    		          /* tp_iter */
+    0,		                              /* tp_iternext */
+
+    PowerStateWatcher_methods,          /* tp_methods */
+    NULL,                               /* tp_members */
+    PowerStateWatcher_getters_setters,  /* tp_getset */
+    0,                                  /* tp_base */
+    0,                                  /* tp_dict */
+    0,                                  /* tp_descr_get */
+    0,                                  /* tp_descr_set */
+    0,                                  /* tp_dictoffset */
+
+    0,                                  /* tp_init */
+    0,                                  /* tp_alloc */
+    /* Watchers are only started via Host.watchPowerState: */
+    0,                                  /* tp_new */
+    0,                                  /* tp_free */
+    0,                                  /* tp_is_gc */
+    0,                                  /* tp_bases */
+    0,                                  /* tp_mro */
+    0,                                  /* tp_cache */
+    0,                                  /* tp_subclasses */
+    0                                   /* tp_weaklist */
+  };
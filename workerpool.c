@@ -0,0 +1,330 @@
+/******************************************************************************
+ * pyvix - Native Worker Pool
+ * Available under the MIT license (see docs/license.txt for details).
+ *****************************************************************************/
+
+/* Most VIX operations are issued asynchronously (see job.c), but some work,
+ * such as driving a pipeline (see pipeline.c), needs a thread for as long as
+ * it runs.  Rather than tie up the calling Python thread, such work can be
+ * queued as a WorkerTask in this pool of native threads; the caller gets back
+ * a Job, which the pool completes once the task has finished.
+ *
+ * The queue is bounded:  a submission that finds it full waits (without the
+ * GIL) until there's room, or until the submission's deadline passes, in
+ * which case it fails with VIXTimeoutError.  Each Host may also limit how many
+ * workers run its tasks at once; a task whose Host is at its limit stays
+ * queued, without holding up the tasks of other Hosts behind it.
+ *
+ * The pool's threads are started when the first task is submitted, and run
+ * until the process exits (or until the pool is configured to have fewer of
+ * them). */
+
+#include "pythread.h"
+
+#define WORKER_POOL_DEFAULT_WORKERS 4
+#define WORKER_POOL_DEFAULT_QUEUE_SIZE 64
+
+static WorkerPool WorkerPool_global;
+
+static status initSupport_WorkerPool(void) {
+  WorkerPool *pool = &WorkerPool_global;
+
+  if (PyVixEvent_init(&pool->workAvailable) != SUCCEEDED) { return FAILED; }
+  if (PyVixEvent_init(&pool->spaceAvailable) != SUCCEEDED) {
+    PyVixEvent_destroy(&pool->workAvailable);
+    return FAILED;
+  }
+  PyVixMutex_init(&pool->lock);
+  PyVixEvent_signal(&pool->spaceAvailable);
+
+  pool->head = pool->tail = NULL;
+  pool->queueDepth = 0;
+  pool->queueSize = WORKER_POOL_DEFAULT_QUEUE_SIZE;
+  pool->nWorkers = 0;
+  pool->targetWorkers = WORKER_POOL_DEFAULT_WORKERS;
+  pool->nActive = 0;
+  pool->perHostLimit = 0;
+
+  pool->nSubmitted = 0;
+  pool->nCompleted = 0;
+  pool->nRejected = 0;
+  pool->totalWaitTime = 0.0;
+  pool->maxWaitTime = 0.0;
+  pool->totalRunTime = 0.0;
+  pool->maxRunTime = 0.0;
+
+  return SUCCEEDED;
+} /* initSupport_WorkerPool */
+
+static bool WorkerPool_hostHasRoomLocked(WorkerPool *pool, Host *host) {
+  const int limit = (host->poolLimit >= 0 ? host->poolLimit
+      : pool->perHostLimit
+    );
+  return (limit == 0 || host->poolActive < limit);
+} /* WorkerPool_hostHasRoomLocked */
+
+static WorkerTask *WorkerPool_takeRunnableLocked(WorkerPool *pool) {
+  /* Unlinks and returns the oldest queued task whose Host isn't at its limit,
+   * or returns NULL if there's none.  pool->lock must be held. */
+  WorkerTask *prev = NULL;
+  WorkerTask *task;
+
+  for (task = pool->head; task != NULL; prev = task, task = task->next) {
+    if (!WorkerPool_hostHasRoomLocked(pool, task->host)) { continue; }
+
+    if (prev == NULL) { pool->head = task->next; }
+    else { prev->next = task->next; }
+    if (pool->tail == task) { pool->tail = prev; }
+    task->next = NULL;
+    pool->queueDepth--;
+    PyVixEvent_signal(&pool->spaceAvailable);
+    return task;
+  }
+
+  return NULL;
+} /* WorkerPool_takeRunnableLocked */
+
+static void WorkerPool_finishTask(WorkerTask *task) {
+  /* Finishes task (with the GIL), then completes its Job and frees it.
+   * Called on a worker thread, without the GIL. */
+  JobCompletion *jc = task->jc;
+  PyGILState_STATE gstate;
+
+  ENTER_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+  task->finish(task);
+  LEAVE_PYTHON_WITHOUT_CODE_BLOCK(gstate);
+
+  /* The pool plays VIX's part in the life of the task's Job: */
+  JobCompletion_complete(jc, VIX_INVALID_HANDLE, task->err, true);
+  JobCompletion_release(jc);
+  pyvix_plain_free(task);
+} /* WorkerPool_finishTask */
+
+static void WorkerPool_workerMain(void *unused) {
+  WorkerPool *pool = &WorkerPool_global;
+
+  PyVixMutex_lock(&pool->lock);
+  for (;;) {
+    WorkerTask *task;
+    double waited, ran;
+    bool cancelled;
+
+    if (pool->nWorkers > pool->targetWorkers) { break; }
+
+    task = WorkerPool_takeRunnableLocked(pool);
+    if (task == NULL) {
+      /* Reset while holding the lock, so that a task queued after the scan
+       * can't be missed: */
+      PyVixEvent_reset(&pool->workAvailable);
+      PyVixMutex_unlock(&pool->lock);
+      PyVixEvent_wait(&pool->workAvailable, -1);
+      PyVixMutex_lock(&pool->lock);
+      continue;
+    }
+
+    task->host->poolActive++;
+    pool->nActive++;
+    task->startedAt = PyVixClock_now();
+    waited = task->startedAt - task->enqueuedAt;
+    pool->totalWaitTime += waited;
+    if (waited > pool->maxWaitTime) { pool->maxWaitTime = waited; }
+    PyVixMutex_unlock(&pool->lock);
+
+    /* A task whose Job was cancelled while it was queued isn't run at all: */
+    PyVixMutex_lock(&task->jc->lock);
+    cancelled = task->jc->completed;
+    PyVixMutex_unlock(&task->jc->lock);
+    if (!cancelled) { task->run(task); }
+    ran = PyVixClock_now() - task->startedAt;
+
+    /* The task's reference to its Host lasts until finish, so the Host's
+     * slot can be given up first: */
+    PyVixMutex_lock(&pool->lock);
+    task->host->poolActive--;
+    pool->nActive--;
+    pool->nCompleted++;
+    pool->totalRunTime += ran;
+    if (ran > pool->maxRunTime) { pool->maxRunTime = ran; }
+    /* Another task of the same Host might have become runnable: */
+    PyVixEvent_signal(&pool->workAvailable);
+    PyVixMutex_unlock(&pool->lock);
+
+    WorkerPool_finishTask(task);
+
+    PyVixMutex_lock(&pool->lock);
+  }
+  pool->nWorkers--;
+  PyVixMutex_unlock(&pool->lock);
+} /* WorkerPool_workerMain */
+
+static status WorkerPool_startWorkersLocked(WorkerPool *pool) {
+  /* Starts threads until there are targetWorkers of them.  pool->lock must be
+   * held, as must the GIL. */
+  while (pool->nWorkers < pool->targetWorkers) {
+    if (PyThread_start_new_thread(WorkerPool_workerMain, NULL) == -1) {
+      PyErr_SetString(PyExc_RuntimeError,
+          "Unable to start a worker pool thread."
+        );
+      return FAILED;
+    }
+    pool->nWorkers++;
+  }
+  return SUCCEEDED;
+} /* WorkerPool_startWorkersLocked */
+
+static status WorkerPool_submit(WorkerTask *task, double deadline) {
+  /* Queues task (allocated with pyvix_plain_malloc), whose run, finish, jc
+   * and host fields must have been set, waiting (without the GIL) for room in
+   * the queue until deadline.  On success, the pool takes over task; on
+   * failure, the caller keeps it.  The GIL must be held. */
+  WorkerPool *pool = &WorkerPool_global;
+  bool hadRoom;
+
+  task->err = VIX_OK;
+  task->next = NULL;
+
+  PyVixMutex_lock(&pool->lock);
+  if (WorkerPool_startWorkersLocked(pool) != SUCCEEDED) {
+    PyVixMutex_unlock(&pool->lock);
+    return FAILED;
+  }
+
+  while (pool->queueDepth >= pool->queueSize) {
+    PyVixEvent_reset(&pool->spaceAvailable);
+    PyVixMutex_unlock(&pool->lock);
+
+    LEAVE_PYTHON
+    hadRoom = PyVixEvent_wait(&pool->spaceAvailable,
+        millisUntilDeadline(deadline)
+      );
+    ENTER_PYTHON
+
+    PyVixMutex_lock(&pool->lock);
+    if (!hadRoom && pool->queueDepth >= pool->queueSize) {
+      pool->nRejected++;
+      PyVixMutex_unlock(&pool->lock);
+      raiseNonNumericVIXError(VIXTimeoutError,
+          "The worker pool's queue stayed full until the timeout."
+        );
+      return FAILED;
+    }
+  }
+
+  task->enqueuedAt = PyVixClock_now();
+  if (pool->tail == NULL) {
+    pool->head = pool->tail = task;
+  } else {
+    pool->tail->next = task;
+    pool->tail = task;
+  }
+  pool->queueDepth++;
+  pool->nSubmitted++;
+  PyVixEvent_signal(&pool->workAvailable);
+  PyVixMutex_unlock(&pool->lock);
+
+  return SUCCEEDED;
+} /* WorkerPool_submit */
+
+static void WorkerPool_setHostLimit(Host *host, int limit) {
+  WorkerPool *pool = &WorkerPool_global;
+
+  PyVixMutex_lock(&pool->lock);
+  host->poolLimit = limit;
+  /* A raised limit might make queued tasks runnable: */
+  PyVixEvent_signal(&pool->workAvailable);
+  PyVixMutex_unlock(&pool->lock);
+} /* WorkerPool_setHostLimit */
+
+static int WorkerPool_hostLimit(Host *host) {
+  WorkerPool *pool = &WorkerPool_global;
+  int limit;
+
+  PyVixMutex_lock(&pool->lock);
+  limit = host->poolLimit;
+  PyVixMutex_unlock(&pool->lock);
+  return limit;
+} /* WorkerPool_hostLimit */
+
+/************************** Python Interface *********************************/
+
+static PyObject *pyf_configureWorkerPool(PyObject *self, PyObject *args,
+    PyObject *kwargs
+  )
+{
+  /* Changes whichever of the pool's settings are given:  the number of
+   * worker threads, the number of tasks that may wait in the queue, and the
+   * default limit on the number of workers that may run one Host's tasks at
+   * once (0 for none).  Workers beyond a reduced count exit once they've
+   * finished their current tasks. */
+  static char* kwarg_list[] = {"workers", "queue_size", "per_host_limit",
+      NULL
+    };
+  WorkerPool *pool = &WorkerPool_global;
+  int workers = -1;
+  Py_ssize_t queueSize = -1;
+  int perHostLimit = -1;
+  bool started;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs,
+       "|i" Py_ssize_t_EXTRACTION_CODE "i", kwarg_list,
+       &workers, &queueSize, &perHostLimit
+     ))
+  { return NULL; }
+  if (workers == 0 || workers < -1 || queueSize == 0 || queueSize < -1
+      || perHostLimit < -1
+     )
+  {
+    raiseNonNumericVIXError(VIXClientProgrammerError,
+        "workers and queue_size must be at least 1, and per_host_limit must"
+        " not be negative."
+      );
+    return NULL;
+  }
+
+  PyVixMutex_lock(&pool->lock);
+  started = (pool->nWorkers > 0);
+  if (workers != -1) { pool->targetWorkers = workers; }
+  if (queueSize != -1) { pool->queueSize = queueSize; }
+  if (perHostLimit != -1) { pool->perHostLimit = perHostLimit; }
+  /* Wake the idle workers (so that any surplus exit, and so that a raised
+   * limit takes effect) and any submitters waiting for room: */
+  PyVixEvent_signal(&pool->workAvailable);
+  if (pool->queueDepth < pool->queueSize) {
+    PyVixEvent_signal(&pool->spaceAvailable);
+  }
+  if (started && WorkerPool_startWorkersLocked(pool) != SUCCEEDED) {
+    PyVixMutex_unlock(&pool->lock);
+    return NULL;
+  }
+  PyVixMutex_unlock(&pool->lock);
+
+  Py_RETURN_NONE;
+} /* pyf_configureWorkerPool */
+
+static PyObject *pyf_workerPoolStats(PyObject *self) {
+  /* Returns a dict of the pool's settings and counters.  The times are in
+   * seconds:  waitTime is spent in the queue, runTime on a worker. */
+  WorkerPool *pool = &WorkerPool_global;
+  PyObject *stats;
+
+  PyVixMutex_lock(&pool->lock);
+  /* Py_BuildValue can't release the GIL, so it's safe to call with the lock
+   * held: */
+  stats = Py_BuildValue("{s:i,s:i,s:n,s:n,s:i,s:k,s:k,s:k,s:d,s:d,s:d,s:d}",
+      "workers", pool->nWorkers,
+      "activeWorkers", pool->nActive,
+      "queueDepth", pool->queueDepth,
+      "queueSize", pool->queueSize,
+      "perHostLimit", pool->perHostLimit,
+      "submitted", pool->nSubmitted,
+      "completed", pool->nCompleted,
+      "rejected", pool->nRejected,
+      "totalWaitTime", pool->totalWaitTime,
+      "maxWaitTime", pool->maxWaitTime,
+      "totalRunTime", pool->totalRunTime,
+      "maxRunTime", pool->maxRunTime
+    );
+  PyVixMutex_unlock(&pool->lock);
+
+  return stats;
+} /* pyf_workerPoolStats */